@@ -0,0 +1,47 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <fw/Action.h>
+
+#include "EmulatedPrinter.h"
+
+namespace Clef::Fw {
+/**
+ * A whole XYE segment of state.range(0) points, 5 mm apart in X, on the
+ * emulator: queueing the points, then running the main loop and the step
+ * timers until the segment finishes, as in the MoveXYE action test. Each
+ * loop is 1 ms of the printer's time.
+ */
+void BM_MoveXYESegment(benchmark::State &state) {
+  const uint16_t numPoints = state.range(0);
+  uint64_t numLoops = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    EmulatedPrinter printer;
+    state.ResumeTiming();
+
+    Action::MoveXYE action({0, 0, 0, 0});
+    for (uint16_t i = 1; i <= numPoints; ++i) {
+      Axes::XAxis::GcodePosition xPos(5 * i);
+      Axes::YAxis::GcodePosition yPos(5 * (i % 2));
+      Axes::EAxis::GcodePosition ePos(i);
+      action.pushPoint(printer.context, &xPos, &yPos, ePos);
+    }
+    action.onStart(printer.context);
+    uint64_t displacement = 3;
+    while (!action.isFinished(printer.context)) {
+      printer.clock.advance(1000);
+      printer.displacementSensor.inject(displacement++);
+      printer.pressureSensor.inject(0);
+      printer.stepTimer.pulseOnce();
+      printer.eAxisTimer.pulseOnce();
+      action.onLoop(printer.context);
+      ++numLoops;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * numPoints);
+  state.counters["loops"] =
+      benchmark::Counter(numLoops, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_MoveXYESegment)->Arg(1)->Arg(8)->Unit(benchmark::kMicrosecond);
+}  // namespace Clef::Fw
@@ -0,0 +1,53 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "EmulatedPrinter.h"
+
+namespace Clef::Fw {
+EmulatedPrinter::EmulatedPrinter()
+    : globalMutex(std::make_shared<std::mutex>()),
+      clock(),
+      serial(globalMutex),
+      actionQueue(),
+      xyePositionQueue(),
+      planner(),
+      parser(),
+      xAxisTimer(),
+      yAxisTimer(),
+      zAxisTimer(),
+      eAxisTimer(),
+      stepTimer(),
+      displacementSensorInput(),
+      displacementSensor(clock, 0.1),
+      pressureSensor(clock, 0.02),
+      extrusionPredictor(0.2),
+      xAxis(Clef::Impl::Emulator::xAxisStepper, xAxisTimer),
+      yAxis(Clef::Impl::Emulator::yAxisStepper, yAxisTimer),
+      zAxis(Clef::Impl::Emulator::zAxisStepper, zAxisTimer),
+      eAxis(Clef::Impl::Emulator::eAxisStepper, eAxisTimer,
+             displacementSensor, pressureSensor, extrusionPredictor),
+      axes(xAxis, yAxis, zAxis, eAxis),
+      stepEngine(axes, stepTimer),
+      context({axes, parser, clock, serial, actionQueue,
+                xyePositionQueue, planner, stepEngine}) {
+  Clef::Impl::Emulator::xAxisStepper = Clef::Impl::Emulator::XAxisStepper();
+  Clef::Impl::Emulator::yAxisStepper = Clef::Impl::Emulator::YAxisStepper();
+  Clef::Impl::Emulator::zAxisStepper = Clef::Impl::Emulator::ZAxisStepper();
+  Clef::Impl::Emulator::eAxisStepper = Clef::Impl::Emulator::EAxisStepper();
+  clock.init();
+  serial.init();
+  axes.init();
+  stepEngine.init();
+  displacementSensorInput.setConversionCallback(
+      DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT,
+                         USTEPS_PER_MM_E>::injectWrapper,
+      &displacementSensor);
+}
+
+void EmulatedPrinter::clearActions() {
+  while (actionQueue.size() > 0) {
+    actionQueue.pop(context);
+  }
+  while (xyePositionQueue.pop()) {
+  }
+}
+}  // namespace Clef::Fw
@@ -0,0 +1,72 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/GcodeParser.h>
+#include <if/Clock.h>
+#include <impl/emulator/PwmTimer.h>
+#include <impl/emulator/SensorInput.h>
+#include <impl/emulator/Serial.h>
+#include <impl/emulator/Stepper.h>
+
+#include <memory>
+#include <mutex>
+
+namespace Clef::Fw {
+/**
+ * Clock which only moves when told to, so that timings depend on the number
+ * of iterations rather than on how fast the benchmark runs.
+ */
+class ManualClock : public Clef::If::Clock {
+ public:
+  Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC> getMicros()
+      const override {
+    return micros_;
+  }
+
+  void advance(const uint64_t micros) { micros_ += micros; }
+
+ private:
+  uint64_t micros_ = 0;
+};
+
+/**
+ * The firmware wired to emulated peripherals, as in the IntegrationFixture of
+ * the tests. The steppers of the emulator are global, so they are moved back
+ * to the origin whenever a printer is made.
+ */
+struct EmulatedPrinter {
+  EmulatedPrinter();
+
+  /**
+   * Empty the action and XYE position queues, whether or not the actions
+   * have run.
+   */
+  void clearActions();
+
+  std::shared_ptr<std::mutex> globalMutex;
+  ManualClock clock;
+  Clef::Impl::Emulator::Serial serial;
+  ActionQueue actionQueue;
+  XYEPositionQueue xyePositionQueue;
+  Planner planner;
+  GcodeParser parser;
+  Clef::Impl::Emulator::GenericTimer xAxisTimer;
+  Clef::Impl::Emulator::GenericTimer yAxisTimer;
+  Clef::Impl::Emulator::GenericTimer zAxisTimer;
+  Clef::Impl::Emulator::GenericTimer eAxisTimer;
+  Clef::Impl::Emulator::GenericTimer stepTimer;
+  Clef::Impl::Emulator::DisplacementSensorInput displacementSensorInput;
+  DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E>
+      displacementSensor;
+  PressureSensor pressureSensor;
+  LinearExtrusionPredictor extrusionPredictor;
+  Axes::XAxis xAxis;
+  Axes::YAxis yAxis;
+  Axes::ZAxis zAxis;
+  Axes::EAxis eAxis;
+  Axes axes;
+  StepEngine stepEngine;
+  Context context;
+};
+}  // namespace Clef::Fw
@@ -0,0 +1,47 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <fw/ExtrusionPredictor.h>
+
+namespace Clef::Fw {
+namespace {
+/**
+ * The feedrate of an XYE move, which the E axis works out for every point of
+ * a segment, partway through a move that is behind on extrusion.
+ */
+void runDetermineXYFeedrate(benchmark::State &state,
+                            ExtrusionPredictor &predictor) {
+  predictor.reset(0, 0, 0);
+  for (uint16_t i = 1; i <= 100; ++i) {
+    predictor.evolve(4000 * i, 2 * i, 1.9f * i, 5000);
+    while (!predictor.advance()) {
+    }
+  }
+  float x = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(
+        predictor.determineXYFeedrate(0, 0, 0, 800, 600, 400, x, 0.75f * x));
+    x = x < 800 ? x + 1 : 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+}  // namespace
+
+void BM_LinearDetermineXYFeedrate(benchmark::State &state) {
+  LinearExtrusionPredictor predictor(0.2);
+  runDetermineXYFeedrate(state, predictor);
+}
+BENCHMARK(BM_LinearDetermineXYFeedrate);
+
+void BM_KalmanDetermineXYFeedrate(benchmark::State &state) {
+  KalmanFilterExtrusionPredictor predictor;
+  runDetermineXYFeedrate(state, predictor);
+}
+BENCHMARK(BM_KalmanDetermineXYFeedrate);
+
+void BM_FixedPointKalmanDetermineXYFeedrate(benchmark::State &state) {
+  FixedPointKalmanFilterExtrusionPredictor predictor;
+  runDetermineXYFeedrate(state, predictor);
+}
+BENCHMARK(BM_FixedPointKalmanDetermineXYFeedrate);
+}  // namespace Clef::Fw
@@ -0,0 +1,35 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "EmulatedPrinter.h"
+
+namespace Clef::Fw {
+namespace {
+/**
+ * Lines like those of a sliced print; each is ingested on its own and the
+ * actions it queues are dropped.
+ */
+const std::vector<std::string> LINES = {
+    "G1 X10.5 Y20.25 E0.4\n", "G1 X12.75 Y21.5 E0.8\n", "G1 F3000\n",
+    "G1 X11 Y19.125 E1.2\n",  "G1 Z0.3\n",              "G0 X0 Y0\n",
+};
+}  // namespace
+
+void BM_GcodeParserIngest(benchmark::State &state) {
+  EmulatedPrinter printer;
+  size_t line = 0;
+  for (auto _ : state) {
+    printer.serial.inject(LINES[line]);
+    printer.parser.ingest(printer.context);
+    printer.clearActions();
+    benchmark::DoNotOptimize(printer.serial.extract());
+    line = (line + 1) % LINES.size();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GcodeParserIngest);
+}  // namespace Clef::Fw
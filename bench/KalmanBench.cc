@@ -0,0 +1,80 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <fw/kalman/Degen.h>
+#include <fw/kalman/DegenFixed.h>
+#include <math.h>
+
+namespace Clef::Fw {
+namespace {
+/**
+ * A sample of an extruder running at 400 usteps/s with 250 Hz sensors, like
+ * the one in the replay tests.
+ */
+struct Sample {
+  float xe;
+  float xs;
+  float P;
+};
+
+constexpr uint16_t NUM_SAMPLES = 1000;
+constexpr float DELTAT = 0.004f;
+
+const Sample *getSamples() {
+  static Sample samples[NUM_SAMPLES];
+  static bool isInitialized = false;
+  if (!isInitialized) {
+    float xe = 0, xs = 0;
+    for (uint16_t i = 0; i < NUM_SAMPLES; ++i) {
+      xe += 400 * DELTAT;
+      const float Ph = 10 * (xe - xs + 20);
+      xs += 0.08f * Ph / 1.16f * DELTAT;
+      samples[i] = {roundf(xe), roundf(xs + 0.5f * sinf(i)),
+                    roundf(4900 + Ph + cosf(i * 0.7f))};
+    }
+    isInitialized = true;
+  }
+  return samples;
+}
+}  // namespace
+
+/**
+ * One evolution per iteration; the filter starts over at the end of the
+ * recording so that it stays in the range that it runs in.
+ */
+void BM_DegenFilterEvolve(benchmark::State &state) {
+  const Sample *const samples = getSamples();
+  Kalman::DegenFilter filter;
+  uint16_t i = 0;
+  for (auto _ : state) {
+    filter.evolve(samples[i].xe, samples[i].xs, samples[i].P, DELTAT);
+    benchmark::DoNotOptimize(filter.getState().get(0, 0));
+    if (++i == NUM_SAMPLES) {
+      i = 0;
+      filter.init();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DegenFilterEvolve);
+
+void BM_DegenFixedFilterEvolve(benchmark::State &state) {
+  using Scalar = Kalman::DegenFixedFilter::Scalar;
+  const Sample *const samples = getSamples();
+  Kalman::DegenFixedFilter filter;
+  uint16_t i = 0;
+  for (auto _ : state) {
+    filter.evolve(Scalar(static_cast<double>(samples[i].xe)),
+                  Scalar(static_cast<double>(samples[i].xs)),
+                  Scalar(static_cast<double>(samples[i].P)),
+                  Scalar(static_cast<double>(DELTAT)));
+    benchmark::DoNotOptimize(filter.getState().get(0, 0));
+    if (++i == NUM_SAMPLES) {
+      i = 0;
+      filter.init();
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DegenFixedFilterEvolve);
+}  // namespace Clef::Fw
@@ -0,0 +1,126 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <if/Memory.h>
+#include <util/Matrix.h>
+
+namespace Clef::Util {
+namespace {
+/**
+ * Fill a matrix with a well-conditioned (diagonally dominant) pattern.
+ */
+template <uint16_t R, uint16_t C>
+void fill(RamMatrix<R, C> &matrix) {
+  for (uint16_t r = 0; r < R; ++r) {
+    for (uint16_t c = 0; c < C; ++c) {
+      matrix.set(r, c, r == c ? 10.0f + r : 1.0f / (1 + r + 2 * c));
+    }
+  }
+}
+}  // namespace
+
+/**
+ * Product of square matrices; the filters have 2 and 9 states.
+ */
+template <uint16_t N>
+void BM_MatrixDot(benchmark::State &state) {
+  float leftMem[N * N], rightMem[N * N], outputMem[N * N];
+  RamMatrix<N, N> left(leftMem), right(rightMem), output(outputMem);
+  fill(left);
+  fill(right);
+  for (auto _ : state) {
+    Matrix::dot(left, right, output);
+    benchmark::DoNotOptimize(outputMem);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK_TEMPLATE(BM_MatrixDot, 2);
+BENCHMARK_TEMPLATE(BM_MatrixDot, 9);
+
+/**
+ * Product of a matrix and a vector, such as Hk * x with 2 observations.
+ */
+template <uint16_t M, uint16_t N>
+void BM_MatrixDotVector(benchmark::State &state) {
+  float leftMem[M * N], rightMem[N], outputMem[M];
+  RamMatrix<M, N> left(leftMem);
+  RamMatrix<N, 1> right(rightMem);
+  RamMatrix<M, 1> output(outputMem);
+  fill(left);
+  fill(right);
+  for (auto _ : state) {
+    Matrix::dot(left, right, output);
+    benchmark::DoNotOptimize(outputMem);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK_TEMPLATE(BM_MatrixDotVector, 2, 9);
+BENCHMARK_TEMPLATE(BM_MatrixDotVector, 9, 9);
+
+template <uint16_t N>
+void BM_MatrixInverse(benchmark::State &state) {
+  float matMem[N * N], outputMem[N * N], scratchMem[N * N];
+  RamMatrix<N, N> mat(matMem), output(outputMem), scratch(scratchMem);
+  fill(mat);
+  for (auto _ : state) {
+    Matrix::inverse(mat, output, scratch);
+    benchmark::DoNotOptimize(outputMem);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK_TEMPLATE(BM_MatrixInverse, 2);
+BENCHMARK_TEMPLATE(BM_MatrixInverse, 9);
+
+/**
+ * Covariance prediction of the 9-state filter, F P F^T + Q, through the
+ * virtual BaseMatrix interface.
+ */
+void BM_CovariancePredictionVirtual(benchmark::State &state) {
+  const uint16_t N = 9;
+  float memF[N * N], memP[N * N], memQ[N], scratch1[N * N], scratch2[N * N],
+      outputMem[N * N];
+  RamMatrix<N, N> F(memF), P(memP), FP(scratch1), FPFT(scratch2),
+      output(outputMem);
+  fill(F);
+  fill(P);
+  for (uint16_t i = 0; i < N; ++i) {
+    memQ[i] = i + 1;
+  }
+  Clef::If::RomDiagonalMatrix<N> Q(memQ);
+  for (auto _ : state) {
+    Matrix::dot(F, P, FP);
+    Matrix::dot(FP, F.transpose(), FPFT);
+    Matrix::add(FPFT, Q, output);
+    benchmark::DoNotOptimize(outputMem);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_CovariancePredictionVirtual);
+
+/**
+ * The same product with the statically dispatched kernels.
+ */
+void BM_CovariancePredictionStatic(benchmark::State &state) {
+  const uint16_t N = 9;
+  float memF[N * N], memP[N * N], memQ[N], scratch1[N * N], scratch2[N * N],
+      outputMem[N * N];
+  RamMatrix<N, N> fillF(memF), fillP(memP);
+  fill(fillF);
+  fill(fillP);
+  for (uint16_t i = 0; i < N; ++i) {
+    memQ[i] = i + 1;
+  }
+  Clef::If::RomDiagonalMatrix<N> romQ(memQ);
+  StaticRamMatrix<N, N> F(memF), P(memP), FP(scratch1), FPFT(scratch2),
+      output(outputMem);
+  const StaticDiagonalMatrix<Clef::If::RomDiagonalMatrix<N>, N> Q(romQ);
+  for (auto _ : state) {
+    Matrix::dot(F, P, FP);
+    Matrix::dot(FP, F.transpose(), FPFT);
+    Matrix::add(FPFT, Q, output);
+    benchmark::DoNotOptimize(outputMem);
+    benchmark::ClobberMemory();
+  }
+}
+BENCHMARK(BM_CovariancePredictionStatic);
+}  // namespace Clef::Util
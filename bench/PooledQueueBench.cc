@@ -0,0 +1,43 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <benchmark/benchmark.h>
+#include <fw/Action.h>
+#include <util/PooledQueue.h>
+
+namespace Clef::Util {
+/**
+ * Push and pop one element at a time, as the queues of the firmware mostly
+ * are used.
+ */
+template <typename T, uint16_t N>
+void BM_PooledQueuePushPop(benchmark::State &state) {
+  PooledQueue<T, N> queue;
+  T element{};
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(queue.push(element));
+    benchmark::DoNotOptimize(queue.pop());
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_PooledQueuePushPop, int32_t, 16);
+BENCHMARK_TEMPLATE(BM_PooledQueuePushPop, Clef::Fw::XYEPosition, 128);
+
+/**
+ * Fill the queue, then empty it.
+ */
+template <typename T, uint16_t N>
+void BM_PooledQueueFillDrain(benchmark::State &state) {
+  PooledQueue<T, N> queue;
+  T element{};
+  for (auto _ : state) {
+    while (queue.push(element)) {
+    }
+    while (queue.pop()) {
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * PooledQueue<T, N>::capacity);
+}
+BENCHMARK_TEMPLATE(BM_PooledQueueFillDrain, int32_t, 16);
+BENCHMARK_TEMPLATE(BM_PooledQueueFillDrain, Clef::Fw::XYEPosition, 128);
+}  // namespace Clef::Util
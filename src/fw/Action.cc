@@ -6,15 +6,41 @@
 
 namespace Clef::Fw {
 namespace Action {
-Action::Action(const Type type, const XYZEPosition &startPosition)
-    : type_(type), endPosition_(startPosition) {}
+Action::Action(const XYZEPosition &startPosition)
+    : endPosition_(startPosition) {}
 
 XYZEPosition Action::getEndPosition() const { return endPosition_; }
 
+namespace {
+/**
+ * Commit the XY segment that follows the active one, so that the step engine
+ * can start it without waiting for the main loop.
+ */
+void commitNextMoveXy(Context &context) {
+  ActionQueue::Iterator it = context.actionQueue.first();
+  for (uint16_t i = 1; i < context.actionQueue.size(); ++i) {
+    it = it.next();
+    switch (it->getType()) {
+      case Type::SET_FEEDRATE:
+        break;
+      case Type::MOVE_XY:
+        it->get<MoveXY>().commit(context);
+        return;
+      default:
+        return;
+    }
+  }
+}
+}  // namespace
+
 MoveXY::MoveXY(const XYZEPosition &startPosition,
                const Axes::XAxis::GcodePosition *const endPositionX,
                const Axes::YAxis::GcodePosition *const endPositionY)
-    : Action(Type::MOVE_XY, startPosition) {
+    : Action(startPosition),
+      startPosition_(startPosition.asXyePosition()),
+      planned_(false),
+      committed_(false),
+      sequence_(0) {
   if (endPositionX) {
     endPosition_.x = *endPositionX;
   }
@@ -23,20 +49,51 @@ MoveXY::MoveXY(const XYZEPosition &startPosition,
   }
 }
 
-void MoveXY::onStart(Context &context) {
-  context.axes.setXyParams(
-      context.actionQueue.getStartPosition().asXyePosition(),
-      getEndPosition().asXyePosition(), context.axes.getFeedrate());
+void MoveXY::setPlannedSpeeds(const float nominalSpeed,
+                              const float maxEntrySpeed) {
+  profile_.nominalSpeed = nominalSpeed;
+  profile_.maxEntrySpeed = maxEntrySpeed;
+  planned_ = true;
+}
+
+bool MoveXY::commit(Context &context) {
+  if (committed_) {
+    return true;
+  }
+  if (!context.stepEngine.hasCapacity()) {
+    return false;
+  }
+  profile_.locked = true;
+  StepEngine::StepBlock block =
+      context.stepEngine.makeBlock(getEndPosition(), StepEngine::XY_MASK);
+  block.setSpeeds(profile_.entrySpeed, profile_.nominalSpeed,
+                  profile_.exitSpeed, profile_.acceleration);
+  committed_ = context.stepEngine.push(&block);
+  sequence_ = block.sequence;
+  return committed_;
+}
+
+void MoveXY::onStart(Context &context) { commit(context); }
+
+void MoveXY::onLoop(Context &context) {
+  if (commit(context)) {
+    commitNextMoveXy(context);
+  }
 }
 
 bool MoveXY::isFinished(const Context &context) const {
-  return context.axes.getX().isAtTargetPosition() &&
-         context.axes.getY().isAtTargetPosition();
+  return committed_ && context.stepEngine.isCompleted(sequence_);
 }
 
 void MoveXY::onPush(Context &context) {
   context.axes.getX().acquire();
   context.axes.getY().acquire();
+  profile_.setGeometry(startPosition_, getEndPosition().asXyePosition());
+  if (planned_) {
+    context.planner.replan(context.actionQueue);
+  } else {
+    context.planner.push(context.actionQueue, profile_);
+  }
 }
 
 void MoveXY::onPop(Context &context) {
@@ -45,9 +102,12 @@ void MoveXY::onPop(Context &context) {
 }
 
 MoveXYE::MoveXYE(const XYZEPosition &startPosition)
-    : Action(Type::MOVE_XYE, startPosition),
+    : Action(startPosition),
       segmentStart_(startPosition.asXyePosition()),
+      xyFeedrate_(0.0f),
+      firstSequence_(0),
       numPointsPushed_(0),
+      numPointsCommitted_(0),
       numPointsCompleted_(0),
       hasNewEndPosition_(false) {}
 
@@ -96,10 +156,8 @@ bool MoveXYE::checkNewPointDirection(
 
 void MoveXYE::onStart(Context &context) {
   // It should be guaranteed that the queue contains at least one point
-  XYEPosition segmentEndPosition = *context.xyePositionQueue.first();
-  XYEPosition startPosition = segmentStart_;
-
-  context.axes.setXyParams(startPosition, segmentEndPosition, 1.0f);
+  xyFeedrate_ = Axes::XAxis::GcodeFeedrate(1.0f);
+  commitPoints(context);
   context.axes.getE().beginExtrusion(context.clock.getMicros());
   context.axes.getE().setFeedrate(20.0f);
   context.axes.getE().setExtrusionEndpoint(getEndPosition().e);
@@ -110,38 +168,34 @@ void MoveXYE::onLoop(Context &context) {
     context.axes.getE().setExtrusionEndpoint(getEndPosition().e);
     hasNewEndPosition_ = false;
   }
-  if (context.axes.getX().isAtTargetPosition() &&
-      context.axes.getY().isAtTargetPosition()) {
-    if (context.xyePositionQueue.first()) {
-      segmentStart_ = *context.xyePositionQueue.first();
-      context.xyePositionQueue.pop();
-      numPointsCompleted_++;
-      if (numPointsCompleted_ < numPointsPushed_) {
-        XYEPosition endPosition = *context.xyePositionQueue.first();
-        float newFeedrate;
-        context.axes.getE().throttle(
-            segmentStart_, endPosition,
-            context.axes.getCurrentPosition().asXyePosition(), &newFeedrate);
-        typename Axes::XAxis::UstepFeedrate ustepFeedrate(newFeedrate);
-        context.axes.setXyParams(segmentStart_, endPosition, ustepFeedrate);
-      }
-    }
+  while (numPointsCompleted_ < numPointsCommitted_ &&
+         context.stepEngine.isCompleted(firstSequence_ + numPointsCompleted_)) {
+    segmentStart_ = *context.xyePositionQueue.first();
+    context.xyePositionQueue.pop();
+    numPointsCompleted_++;
   }
+  commitPoints(context);
   if (context.xyePositionQueue.first()) {
-    XYEPosition endPosition = *context.xyePositionQueue.first();
     float newFeedrate;
     if (context.axes.getE().throttle(
             segmentStart_, *context.xyePositionQueue.first(),
             context.axes.getCurrentPosition().asXyePosition(), &newFeedrate)) {
-      typename Axes::XAxis::UstepFeedrate ustepFeedrate(newFeedrate);
-      context.axes.setXyParams(segmentStart_, endPosition, ustepFeedrate);
+      // The step engine ramps to the new feedrate within the XY acceleration
+      // limits
+      xyFeedrate_ = newFeedrate;
+      context.stepEngine.setNominalSpeed(
+          *typename Axes::XAxis::GcodeFeedrate(xyFeedrate_) / 60);
 
       char buffer[64];
       sprintf(buffer, ";xy feedrate = %d",
               static_cast<int32_t>(
-                  *typename Axes::XAxis::GcodeFeedrate(ustepFeedrate)));
+                  *typename Axes::XAxis::GcodeFeedrate(xyFeedrate_)));
       context.serial.writeLine(buffer);
     }
+  } else {
+    // The XY axes may finish before the material has caught up with the
+    // extruder; the extrusion is only done once the prediction says so
+    context.axes.getE().updatePrediction();
   }
 }
 
@@ -150,6 +204,31 @@ bool MoveXYE::isFinished(const Context &context) const {
          context.axes.getE().isExtrusionDone();
 }
 
+void MoveXYE::commitPoints(Context &context) {
+  // Only keep one block queued behind the active one, since changes of the
+  // feedrate re-stamp every queued block with interrupts disabled
+  while (numPointsCommitted_ < numPointsPushed_ &&
+         numPointsCommitted_ - numPointsCompleted_ < 2 &&
+         context.stepEngine.hasCapacity()) {
+    XYEPositionQueue::Iterator it = context.xyePositionQueue.first();
+    for (uint32_t i = numPointsCompleted_; i < numPointsCommitted_; ++i) {
+      it = it.next();
+    }
+
+    // E is not part of the block since it is driven by the extrusion throttle
+    StepEngine::StepBlock block = context.stepEngine.makeBlock(
+        {it->x, it->y, 0, 0}, StepEngine::XY_MASK);
+    block.setConstantSpeed(
+        *typename Axes::XAxis::GcodeFeedrate(xyFeedrate_) / 60,
+        MAX_ACCEL_X < MAX_ACCEL_Y ? MAX_ACCEL_X : MAX_ACCEL_Y);
+    context.stepEngine.push(&block);
+    if (numPointsCommitted_ == 0) {
+      firstSequence_ = block.sequence;
+    }
+    numPointsCommitted_++;
+  }
+}
+
 void MoveXYE::onPush(Context &context) {
   context.axes.getX().acquire();
   context.axes.getY().acquire();
@@ -164,19 +243,27 @@ void MoveXYE::onPop(Context &context) {
 
 MoveE::MoveE(const XYZEPosition &startPosition,
              const Axes::EAxis::GcodePosition endPositionE)
-    : Action(Type::MOVE_E, startPosition) {
+    : Action(startPosition), committed_(false), sequence_(0) {
   endPosition_.e = endPositionE;
 }
 
-void MoveE::onStart(Context &context) {
-  // Use constant feedrate
-  context.axes.getE().setFeedrate(
-      Axes::EAxis::GcodeFeedrate(*context.axes.getFeedrate() / 10));
-  context.axes.getE().setTargetPosition(getEndPosition().e);
-}
+void MoveE::onStart(Context &context) { commit(context); }
+
+void MoveE::onLoop(Context &context) { commit(context); }
 
 bool MoveE::isFinished(const Context &context) const {
-  return context.axes.getE().isAtTargetPosition();
+  return committed_ && context.stepEngine.isCompleted(sequence_);
+}
+
+void MoveE::commit(Context &context) {
+  if (!committed_) {
+    // Use constant feedrate
+    StepEngine::StepBlock block =
+        context.stepEngine.makeBlock(getEndPosition(), StepEngine::E_MASK);
+    block.setConstantSpeed(*context.axes.getFeedrate() / 10 / 60, 0.0f);
+    committed_ = context.stepEngine.push(&block);
+    sequence_ = block.sequence;
+  }
 }
 
 void MoveE::onPush(Context &context) { context.axes.getE().acquire(); }
@@ -185,18 +272,27 @@ void MoveE::onPop(Context &context) { context.axes.getE().release(); }
 
 MoveZ::MoveZ(const XYZEPosition &startPosition,
              const Axes::ZAxis::GcodePosition endPositionZ)
-    : Action(Type::MOVE_Z, startPosition) {
+    : Action(startPosition), committed_(false), sequence_(0) {
   endPosition_.z = endPositionZ;
 }
 
-void MoveZ::onStart(Context &context) {
-  // Use constant feedrate
-  context.axes.getZ().setFeedrate(Axes::ZAxis::GcodeFeedrate(600.0f));
-  context.axes.getZ().setTargetPosition(getEndPosition().z);
-}
+void MoveZ::onStart(Context &context) { commit(context); }
+
+void MoveZ::onLoop(Context &context) { commit(context); }
 
 bool MoveZ::isFinished(const Context &context) const {
-  return context.axes.getZ().isAtTargetPosition();
+  return committed_ && context.stepEngine.isCompleted(sequence_);
+}
+
+void MoveZ::commit(Context &context) {
+  if (!committed_) {
+    // Use constant feedrate
+    StepEngine::StepBlock block =
+        context.stepEngine.makeBlock(getEndPosition(), StepEngine::Z_MASK);
+    block.setConstantSpeed(10.0f, 0.0f);
+    committed_ = context.stepEngine.push(&block);
+    sequence_ = block.sequence;
+  }
 }
 
 void MoveZ::onPush(Context &context) { context.axes.getZ().acquire(); }
@@ -205,7 +301,7 @@ void MoveZ::onPop(Context &context) { context.axes.getZ().release(); }
 
 SetFeedrate::SetFeedrate(const XYZEPosition &startPosition,
                          const float rawFeedrateMmPerMin)
-    : Action(Type::SET_FEEDRATE, startPosition),
+    : Action(startPosition),
       rawFeedrateMmPerMin_(rawFeedrateMmPerMin) {}
 
 void SetFeedrate::onStart(Context &context) {
@@ -213,6 +309,10 @@ void SetFeedrate::onStart(Context &context) {
 }
 
 bool SetFeedrate::isFinished(const Context &context) const { return true; }
+
+void SetFeedrate::onPush(Context &context) {
+  context.planner.setFeedrate(rawFeedrateMmPerMin_);
+}
 }  // namespace Action
 
 ActionQueue::ActionQueue()
@@ -226,15 +326,20 @@ void ActionQueue::updateXyeSegment(const Action::MoveXYE &moveXye) {
   endPosition_ = moveXye.getEndPosition();
 }
 
-bool ActionQueue::checkConservation() const {
-  return size() ==
-         (moveXyQueue_.size() + moveXyeQueue_.size() + moveEQueue_.size() +
-          moveZQueue_.size() + setFeedrateQueue_.size());
+bool ActionQueue::push(Context &context, const Action::AnyAction &action) {
+  if (!PooledQueue::push(action)) {
+    return false;
+  }
+  Iterator it = last();
+  endPosition_ = it->getEndPosition();
+  it->onPush(context);
+  return true;
 }
 
-bool ActionQueue::push(Action::Action *const action) {
-  return PooledQueue::push(action);
+void ActionQueue::pop(Context &context) {
+  Iterator it = first();
+  it->onPop(context);
+  startPosition_ = it->getEndPosition();
+  PooledQueue::pop();
 }
-
-void ActionQueue::pop() { PooledQueue::pop(); }
 }  // namespace Clef::Fw
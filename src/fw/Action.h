@@ -2,7 +2,11 @@
 
 #pragma once
 
+#include <assert.h>
 #include <fw/Axes.h>
+#include <fw/Config.h>
+#include <fw/Planner.h>
+#include <fw/StepEngine.h>
 #include <if/Clock.h>
 #include <if/Serial.h>
 #include <util/PooledQueue.h>
@@ -18,69 +22,78 @@ class Context;
 namespace Action {
 enum class Type { MOVE_XY, MOVE_XYE, MOVE_E, MOVE_Z, SET_FEEDRATE };
 
+class AnyAction;
+
 /**
- * Data structure to store parameters for commands the printer to execute; every
- * action implements this interface. The type of the action is stored in memory
- * so that derivatives of this class can be in a union.
+ * Data structure to store parameters for commands the printer to execute. Every
+ * action provides onStart(), onLoop(), isFinished(), onPush() and onPop() (see
+ * AnyAction); they are not virtual since actions are stored in a tagged union
+ * and dispatched on their type.
  */
 class Action {
-  friend class Clef::Fw::ActionQueue;
-
  public:
-  Action(const Type type, const XYZEPosition &startPosition);
-  Type getType() const { return type_; }
+  Action(const XYZEPosition &startPosition);
   XYZEPosition getEndPosition() const;
 
-  /**
-   * Executed when the action reaches the front of the queue and becomes active.
-   */
-  virtual void onStart(Context &context) = 0;
+ protected:
+  XYZEPosition endPosition_;
+};
 
-  /**
-   * Executed from the main event loop while the action is active.
-   */
-  virtual void onLoop(Context &context) = 0;
+class MoveXY : public Action {
+  friend class AnyAction;
+
+ public:
+  static constexpr Type TYPE = Type::MOVE_XY;
+
+  MoveXY() : MoveXY({0, 0, 0, 0}, nullptr, nullptr) {}
+  MoveXY(const XYZEPosition &startPosition,
+         const Axes::XAxis::GcodePosition *const endPositionX,
+         const Axes::YAxis::GcodePosition *const endPositionY);
 
   /**
-   * Check whether this action is completed. Called from the main event loop.
-   * Should have no side-effects.
+   * Speed profile assigned by the planner; only valid once the action has been
+   * pushed to the queue.
    */
-  virtual bool isFinished(const Context &context) const = 0;
+  MotionProfile &getProfile() { return profile_; }
+  const MotionProfile &getProfile() const { return profile_; }
 
- protected:
   /**
-   * Executed when the action is pushed to the queue.
+   * Use speeds that were planned ahead of time (in mm/s) instead of the
+   * feedrate and the junction with the previous segment; must be called
+   * before the action is pushed. Entry and exit speeds are still planned
+   * against the rest of the queue, so the toolhead can always stop in time.
    */
-  virtual void onPush(Context &context) = 0;
+  void setPlannedSpeeds(const float nominalSpeed, const float maxEntrySpeed);
 
   /**
-   * Executed when the action is removed from the queue.
+   * Hand the segment to the step engine, which may happen before the action
+   * becomes active; afterwards the planner no longer changes the profile.
+   * Returns false if the step engine has no room for the segment.
    */
-  virtual void onPop(Context &context) = 0;
+  bool commit(Context &context);
 
- protected:
-  Type type_;
-  XYZEPosition endPosition_;
-};
+  void onStart(Context &context);
+  void onLoop(Context &context);
+  bool isFinished(const Context &context) const;
 
-class MoveXY : public Action {
- public:
-  MoveXY() : MoveXY({0, 0, 0, 0}, nullptr, nullptr) {}
-  MoveXY(const XYZEPosition &startPosition,
-         const Axes::XAxis::GcodePosition *const endPositionX,
-         const Axes::YAxis::GcodePosition *const endPositionY);
-
-  void onStart(Context &context) override;
-  void onLoop(Context &context) override {}
-  bool isFinished(const Context &context) const override;
+ private:
+  void onPush(Context &context);
+  void onPop(Context &context);
 
  private:
-  void onPush(Context &context) override;
-  void onPop(Context &context) override;
+  XYEPosition startPosition_;
+  MotionProfile profile_;
+  bool planned_; /*!< Whether the speeds were set by setPlannedSpeeds(). */
+  bool committed_;
+  uint16_t sequence_; /*!< Sequence number of the step block. */
 };
 
 class MoveXYE : public Action {
+  friend class AnyAction;
+
  public:
+  static constexpr Type TYPE = Type::MOVE_XYE;
+
   MoveXYE() : MoveXYE({0, 0, 0, 0}) {}
   MoveXYE(const XYZEPosition &startPosition);
 
@@ -104,68 +117,225 @@ class MoveXYE : public Action {
    */
   bool checkNewPointDirection(const Axes::EAxis::GcodePosition &newE) const;
 
-  void onStart(Context &context) override;
-  void onLoop(Context &context) override;
-  bool isFinished(const Context &context) const override;
+  void onStart(Context &context);
+  void onLoop(Context &context);
+  bool isFinished(const Context &context) const;
+
+ private:
+  void onPush(Context &context);
+  void onPop(Context &context);
 
  private:
-  void onPush(Context &context) override;
-  void onPop(Context &context) override;
+  /**
+   * Queue step blocks for upcoming points so that the step engine can move on
+   * to the next point without waiting for the main loop.
+   */
+  void commitPoints(Context &context);
 
  private:
   XYEPosition segmentStart_;
+  Axes::XAxis::UstepFeedrate xyFeedrate_;
+  uint16_t firstSequence_; /*!< Sequence number of the first point's block;
+                              the blocks of later points follow it. */
   uint32_t numPointsPushed_;
+  uint32_t numPointsCommitted_;
   uint32_t numPointsCompleted_;
   bool hasNewEndPosition_;
 };
 
 class MoveE : public Action {
+  friend class AnyAction;
+
  public:
+  static constexpr Type TYPE = Type::MOVE_E;
+
   MoveE() : MoveE({0, 0, 0, 0}, 0) {}
   MoveE(const XYZEPosition &startPosition,
         const Axes::EAxis::GcodePosition endPositionE);
 
-  void onStart(Context &context) override;
-  void onLoop(Context &context) override {}
-  bool isFinished(const Context &context) const override;
+  void onStart(Context &context);
+  void onLoop(Context &context);
+  bool isFinished(const Context &context) const;
+
+ private:
+  void onPush(Context &context);
+  void onPop(Context &context);
+  void commit(Context &context);
 
  private:
-  void onPush(Context &context) override;
-  void onPop(Context &context) override;
+  bool committed_;
+  uint16_t sequence_; /*!< Sequence number of the step block. */
 };
 
 class MoveZ : public Action {
+  friend class AnyAction;
+
  public:
+  static constexpr Type TYPE = Type::MOVE_Z;
+
   MoveZ() : MoveZ({0, 0, 0, 0}, 0) {}
   MoveZ(const XYZEPosition &startPosition,
         const Axes::ZAxis::GcodePosition endPositionZ);
 
-  void onStart(Context &context) override;
-  void onLoop(Context &context) override {}
-  bool isFinished(const Context &context) const override;
+  void onStart(Context &context);
+  void onLoop(Context &context);
+  bool isFinished(const Context &context) const;
+
+ private:
+  void onPush(Context &context);
+  void onPop(Context &context);
+  void commit(Context &context);
 
  private:
-  void onPush(Context &context) override;
-  void onPop(Context &context) override;
+  bool committed_;
+  uint16_t sequence_; /*!< Sequence number of the step block. */
 };
 
 class SetFeedrate : public Action {
+  friend class AnyAction;
+
  public:
+  static constexpr Type TYPE = Type::SET_FEEDRATE;
+
   SetFeedrate() : SetFeedrate({0, 0, 0, 0}, 1200) {}
   SetFeedrate(const XYZEPosition &startPosition,
               const float rawFeedrateMmPerMin);
 
-  void onStart(Context &context) override;
-  void onLoop(Context &context) override {}
-  bool isFinished(const Context &context) const override;
+  /**
+   * Feedrate in raw mm/min.
+   */
+  float getFeedrate() const { return rawFeedrateMmPerMin_; }
+
+  void onStart(Context &context);
+  void onLoop(Context &context) {}
+  bool isFinished(const Context &context) const;
 
  private:
-  void onPush(Context &context) override {}
-  void onPop(Context &context) override {}
+  void onPush(Context &context);
+  void onPop(Context &context) {}
 
  private:
   float rawFeedrateMmPerMin_;
 };
+
+/**
+ * Storage for an action of any type, tagged with the type. Every slot of the
+ * action queue is the same size and can hold any action, so the queue does not
+ * need a separate pool per type, and calls are dispatched with a switch on the
+ * tag rather than through a vtable.
+ */
+class AnyAction {
+  friend class Clef::Fw::ActionQueue;
+
+ private:
+  /**
+   * Call a function with the stored action as its concrete type.
+   */
+  template <typename F>
+  auto visit(F &&f) {
+    switch (type_) {
+      case Type::MOVE_XY:
+        return f(moveXy_);
+      case Type::MOVE_XYE:
+        return f(moveXye_);
+      case Type::MOVE_E:
+        return f(moveE_);
+      case Type::MOVE_Z:
+        return f(moveZ_);
+      case Type::SET_FEEDRATE:
+      default:
+        return f(setFeedrate_);
+    }
+  }
+  template <typename F>
+  auto visit(F &&f) const {
+    return const_cast<AnyAction *>(this)->visit(
+        [&f](const auto &action) { return f(action); });
+  }
+
+  MoveXY &member(MoveXY *) { return moveXy_; }
+  MoveXYE &member(MoveXYE *) { return moveXye_; }
+  MoveE &member(MoveE *) { return moveE_; }
+  MoveZ &member(MoveZ *) { return moveZ_; }
+  SetFeedrate &member(SetFeedrate *) { return setFeedrate_; }
+
+ public:
+  AnyAction() : AnyAction(SetFeedrate()) {}
+  AnyAction(const MoveXY &action) : type_(MoveXY::TYPE), moveXy_(action) {}
+  AnyAction(const MoveXYE &action) : type_(MoveXYE::TYPE), moveXye_(action) {}
+  AnyAction(const MoveE &action) : type_(MoveE::TYPE), moveE_(action) {}
+  AnyAction(const MoveZ &action) : type_(MoveZ::TYPE), moveZ_(action) {}
+  AnyAction(const SetFeedrate &action)
+      : type_(SetFeedrate::TYPE), setFeedrate_(action) {}
+
+  Type getType() const { return type_; }
+
+  /**
+   * Access the stored action as its concrete type, which must match the tag.
+   */
+  template <typename T>
+  T &get() {
+    assert(type_ == T::TYPE);
+    return member(static_cast<T *>(nullptr));
+  }
+  template <typename T>
+  const T &get() const {
+    assert(type_ == T::TYPE);
+    return const_cast<AnyAction *>(this)->member(static_cast<T *>(nullptr));
+  }
+
+  XYZEPosition getEndPosition() const {
+    return visit([](const auto &action) { return action.getEndPosition(); });
+  }
+
+  /**
+   * Executed when the action reaches the front of the queue and becomes active.
+   */
+  void onStart(Context &context) {
+    visit([&context](auto &action) { action.onStart(context); });
+  }
+
+  /**
+   * Executed from the main event loop while the action is active.
+   */
+  void onLoop(Context &context) {
+    visit([&context](auto &action) { action.onLoop(context); });
+  }
+
+  /**
+   * Check whether this action is completed. Called from the main event loop.
+   * Should have no side-effects.
+   */
+  bool isFinished(const Context &context) const {
+    return visit(
+        [&context](const auto &action) { return action.isFinished(context); });
+  }
+
+ private:
+  /**
+   * Executed when the action is pushed to the queue.
+   */
+  void onPush(Context &context) {
+    visit([&context](auto &action) { action.onPush(context); });
+  }
+
+  /**
+   * Executed when the action is removed from the queue.
+   */
+  void onPop(Context &context) {
+    visit([&context](auto &action) { action.onPop(context); });
+  }
+
+ private:
+  Type type_;
+  union {
+    MoveXY moveXy_;
+    MoveXYE moveXye_;
+    MoveE moveE_;
+    MoveZ moveZ_;
+    SetFeedrate setFeedrate_;
+  };
+};
 }  // namespace Action
 
 struct Context {
@@ -175,87 +345,29 @@ struct Context {
   Clef::If::RWSerial &serial;
   Clef::Fw::ActionQueue &actionQueue;
   Clef::Fw::XYEPositionQueue &xyePositionQueue;
+  Clef::Fw::Planner &planner;
+  Clef::Fw::StepEngine &stepEngine;
 };
 
-class ActionQueue : public Clef::Util::PooledQueue<Action::Action *, 32> {
+class ActionQueue
+    : public Clef::Util::PooledQueue<Action::AnyAction, ACTION_QUEUE_SIZE> {
  public:
+  /**
+   * Bytes of memory taken by each slot of the queue, whatever type of action it
+   * holds.
+   */
+  static constexpr uint16_t bytesPerAction = sizeof(Action::AnyAction);
+
   ActionQueue();
-  bool push(Context &context, const Action::Action &action) {
-    bool success = false;
-    switch (action.getType()) {
-      case Action::Type::MOVE_XY:
-        success =
-            moveXyQueue_.push(static_cast<const Action::MoveXY &>(action)) &&
-            push(&*moveXyQueue_.last());
-        break;
-      case Action::Type::MOVE_XYE:
-        success =
-            moveXyeQueue_.push(static_cast<const Action::MoveXYE &>(action)) &&
-            push(&*moveXyeQueue_.last());
-        break;
-      case Action::Type::MOVE_E:
-        success =
-            moveEQueue_.push(static_cast<const Action::MoveE &>(action)) &&
-            push(&*moveEQueue_.last());
-        break;
-      case Action::Type::MOVE_Z:
-        success =
-            moveZQueue_.push(static_cast<const Action::MoveZ &>(action)) &&
-            push(&*moveZQueue_.last());
-        break;
-      case Action::Type::SET_FEEDRATE:
-        success = setFeedrateQueue_.push(
-                      static_cast<const Action::SetFeedrate &>(action)) &&
-                  push(&*setFeedrateQueue_.last());
-        break;
-    }
-    if (success) {
-      Iterator it = last();
-      endPosition_ = (*it)->getEndPosition();
-      (*it)->onPush(context);
-    }
-    return success;
-  }
-  void pop(Context &context) {
-    Iterator it = first();
-    (*it)->onPop(context);
-    startPosition_ = (*it)->getEndPosition();
-    switch ((*it)->getType()) {
-      case Action::Type::MOVE_XY:
-        moveXyQueue_.pop();
-        break;
-      case Action::Type::MOVE_XYE:
-        moveXyeQueue_.pop();
-        break;
-      case Action::Type::MOVE_E:
-        moveEQueue_.pop();
-        break;
-      case Action::Type::MOVE_Z:
-        moveZQueue_.pop();
-        break;
-      case Action::Type::SET_FEEDRATE:
-        setFeedrateQueue_.pop();
-        break;
-    }
-    pop();
-  }
+
+  /**
+   * Copy an action into the next slot of the queue; returns false if the queue
+   * is full.
+   */
+  bool push(Context &context, const Action::AnyAction &action);
+  void pop(Context &context);
   XYZEPosition getStartPosition() const;
   XYZEPosition getEndPosition() const;
-  bool hasCapacityFor(const Action::Type type) const {
-    switch (type) {
-      case Action::Type::MOVE_XY:
-        return moveXyQueue_.getNumSpacesLeft() > 0;
-      case Action::Type::MOVE_XYE:
-        return moveXyeQueue_.getNumSpacesLeft() > 0;
-      case Action::Type::MOVE_E:
-        return moveEQueue_.getNumSpacesLeft() > 0;
-      case Action::Type::MOVE_Z:
-        return moveZQueue_.getNumSpacesLeft() > 0;
-      case Action::Type::SET_FEEDRATE:
-        return setFeedrateQueue_.getNumSpacesLeft() > 0;
-    }
-    return false;
-  }
 
   /**
    * If a point is added to an XYE segment, this queue needs to know about it so
@@ -263,25 +375,9 @@ class ActionQueue : public Clef::Util::PooledQueue<Action::Action *, 32> {
    */
   void updateXyeSegment(const Action::MoveXYE &moveXye);
 
-  /**
-   * Debugging method for making sure that the total size of this queue is equal
-   * to the sum of the sizes of the subqueues.
-   */
-  bool checkConservation() const;
-
- private:
-  bool push(Action::Action *action);
-  void pop();
-
  private:
   XYZEPosition startPosition_; /*!< Remember start position of the current
                                         first action. */
   XYZEPosition endPosition_;   /*!< Remember end position of the last action. */
-
-  Clef::Util::PooledQueue<Action::MoveXY, 8> moveXyQueue_;
-  Clef::Util::PooledQueue<Action::MoveXYE, 8> moveXyeQueue_;
-  Clef::Util::PooledQueue<Action::MoveE, 4> moveEQueue_;
-  Clef::Util::PooledQueue<Action::MoveZ, 4> moveZQueue_;
-  Clef::Util::PooledQueue<Action::SetFeedrate, 4> setFeedrateQueue_;
 };
 }  // namespace Clef::Fw
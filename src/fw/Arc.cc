@@ -0,0 +1,145 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "Arc.h"
+
+#include <math.h>
+
+namespace Clef::Fw {
+ArcInterpolator::ArcInterpolator()
+    : centerX_(0),
+      centerY_(0),
+      startRadialX_(0),
+      startRadialY_(0),
+      radialX_(0),
+      radialY_(0),
+      segmentAngle_(0),
+      cosSegment_(1),
+      sinSegment_(0),
+      startE_(0),
+      endX_(0),
+      endY_(0),
+      endE_(0),
+      numSegments_(0),
+      segment_(1),
+      pointX_(0),
+      pointY_(0),
+      pointE_(0) {}
+
+bool ArcInterpolator::getCenterOffset(const float startX, const float startY,
+                                      const float endX, const float endY,
+                                      const float radius, const bool clockwise,
+                                      float *const offsetX,
+                                      float *const offsetY) {
+  const float dx = endX - startX;
+  const float dy = endY - startY;
+  const float chordSquared = dx * dx + dy * dy;
+  const float discriminant = 4 * radius * radius - chordSquared;
+  if (chordSquared == 0 || discriminant < 0) {
+    return false;
+  }
+
+  // Distance from the midpoint of the chord to the center, relative to the
+  // length of the chord; the center lies to the right of the chord for a
+  // clockwise arc of less than 180 degrees
+  float h = -sqrtf(discriminant) / sqrtf(chordSquared);
+  if (!clockwise) {
+    h = -h;
+  }
+  if (radius < 0) {
+    h = -h;
+  }
+  *offsetX = 0.5f * (dx - dy * h);
+  *offsetY = 0.5f * (dy + dx * h);
+  return true;
+}
+
+bool ArcInterpolator::begin(const float startX, const float startY,
+                            const float startE, const float endX,
+                            const float endY, const float endE,
+                            const float offsetX, const float offsetY,
+                            const bool clockwise, const float tolerance) {
+  const float radius = sqrtf(offsetX * offsetX + offsetY * offsetY);
+  if (radius == 0) {
+    numSegments_ = 0;
+    return false;
+  }
+  centerX_ = startX + offsetX;
+  centerY_ = startY + offsetY;
+  startRadialX_ = -offsetX;
+  startRadialY_ = -offsetY;
+  radialX_ = startRadialX_;
+  radialY_ = startRadialY_;
+  startE_ = startE;
+  endX_ = endX;
+  endY_ = endY;
+  endE_ = endE;
+
+  // Signed angle from the start to the end, going the requested way round
+  const float endRadialX = endX - centerX_;
+  const float endRadialY = endY - centerY_;
+  float angle = atan2f(startRadialX_ * endRadialY - startRadialY_ * endRadialX,
+                       startRadialX_ * endRadialX + startRadialY_ * endRadialY);
+  const float epsilon = 1e-6f;
+  if (clockwise && angle >= -epsilon) {
+    angle -= 2 * M_PI;
+  } else if (!clockwise && angle <= epsilon) {
+    angle += 2 * M_PI;
+  }
+
+  // A chord subtending theta deviates from the arc by r * (1 - cos(theta / 2))
+  const float maxSegmentAngle =
+      tolerance < radius ? 2 * acosf(1 - tolerance / radius) : M_PI / 2;
+  const float numSegments = ceilf(fabsf(angle) / maxSegmentAngle);
+  numSegments_ = numSegments < 1       ? 1
+                 : numSegments > 65535 ? 65535
+                                       : static_cast<uint16_t>(numSegments);
+  segmentAngle_ = angle / numSegments_;
+  cosSegment_ = cosf(segmentAngle_);
+  sinSegment_ = sinf(segmentAngle_);
+  segment_ = 1;
+  computePoint();
+  return true;
+}
+
+bool ArcInterpolator::isActive() const { return segment_ <= numSegments_; }
+
+uint16_t ArcInterpolator::getNumSegments() const { return numSegments_; }
+
+void ArcInterpolator::getPoint(float *const x, float *const y,
+                               float *const e) const {
+  *x = pointX_;
+  *y = pointY_;
+  *e = pointE_;
+}
+
+void ArcInterpolator::advance() {
+  segment_++;
+  if (isActive()) {
+    computePoint();
+  }
+}
+
+void ArcInterpolator::computePoint() {
+  if (segment_ == numSegments_) {
+    // Finish exactly at the requested end
+    pointX_ = endX_;
+    pointY_ = endY_;
+    pointE_ = endE_;
+    return;
+  }
+  if (segment_ % ARC_CORRECTION_SEGMENTS == 0) {
+    const float angle = segmentAngle_ * segment_;
+    const float cosAngle = cosf(angle);
+    const float sinAngle = sinf(angle);
+    radialX_ = startRadialX_ * cosAngle - startRadialY_ * sinAngle;
+    radialY_ = startRadialX_ * sinAngle + startRadialY_ * cosAngle;
+  } else {
+    const float radialX = radialX_ * cosSegment_ - radialY_ * sinSegment_;
+    radialY_ = radialX_ * sinSegment_ + radialY_ * cosSegment_;
+    radialX_ = radialX;
+  }
+  pointX_ = centerX_ + radialX_;
+  pointY_ = centerY_ + radialY_;
+  pointE_ = startE_ + (endE_ - startE_) * segment_ / numSegments_;
+}
+}  // namespace Clef::Fw
@@ -0,0 +1,81 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/Config.h>
+#include <stdint.h>
+
+namespace Clef::Fw {
+/**
+ * Split a circular arc in the XY plane into chords, with E interpolated
+ * linearly along the arc. Points are generated one at a time so that the arc
+ * can be fed into the queues as space frees up. Coordinates are in G-code mm.
+ */
+class ArcInterpolator {
+ public:
+  ArcInterpolator();
+
+  /**
+   * Get the offset from the start of the arc to its center (the I and J
+   * arguments) from its radius; a negative radius selects the arc of more than
+   * 180 degrees. Returns false if no such arc exists.
+   */
+  static bool getCenterOffset(const float startX, const float startY,
+                              const float endX, const float endY,
+                              const float radius, const bool clockwise,
+                              float *const offsetX, float *const offsetY);
+
+  /**
+   * Start a new arc around the center at the given offset from the start. If
+   * the start and end coincide, the arc is a full circle. Returns false if the
+   * radius is zero.
+   */
+  bool begin(const float startX, const float startY, const float startE,
+             const float endX, const float endY, const float endE,
+             const float offsetX, const float offsetY, const bool clockwise,
+             const float tolerance = ARC_TOLERANCE);
+
+  /**
+   * Check whether any points of the arc remain.
+   */
+  bool isActive() const;
+
+  uint16_t getNumSegments() const;
+
+  /**
+   * Get the end of the next chord without consuming it.
+   */
+  void getPoint(float *const x, float *const y, float *const e) const;
+
+  /**
+   * Move on to the next chord.
+   */
+  void advance();
+
+ private:
+  /**
+   * Compute the end of the next chord.
+   */
+  void computePoint();
+
+ private:
+  float centerX_;
+  float centerY_;
+  float startRadialX_; /*!< Vector from the center to the start. */
+  float startRadialY_;
+  float radialX_; /*!< Vector from the center to the end of the last chord. */
+  float radialY_;
+  float segmentAngle_; /*!< Signed angle subtended by each chord. */
+  float cosSegment_;
+  float sinSegment_;
+  float startE_;
+  float endX_;
+  float endY_;
+  float endE_;
+  uint16_t numSegments_;
+  uint16_t segment_; /*!< Index of the next chord, starting from 1. */
+  float pointX_;     /*!< End of the next chord. */
+  float pointY_;
+  float pointE_;
+};
+}  // namespace Clef::Fw
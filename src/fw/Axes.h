@@ -10,6 +10,7 @@
 #include <if/Stepper.h>
 #include <math.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <util/Initialized.h>
 #include <util/Units.h>
 
@@ -32,10 +33,14 @@ class Axis : public Clef::Util::Initialized {
   Axis(Clef::If::Stepper<USTEPS_PER_MM> &stepper, Clef::If::PwmTimer &pwmTimer)
       : stepper_(stepper), pwmTimer_(pwmTimer) {}
 
+  /**
+   * Round to the nearest ustep, so that a position converted from usteps
+   * converts back to the same usteps even where the float in mm is inexact.
+   */
   static StepperPosition gcodePositionToStepper(const GcodePosition pos) {
-    return StepperPosition(
-        *Clef::Util::Position<float, Clef::Util::PositionUnit::USTEP,
-                              USTEPS_PER_MM>(pos));
+    return StepperPosition(static_cast<int32_t>(
+        lroundf(*Clef::Util::Position<float, Clef::Util::PositionUnit::USTEP,
+                                      USTEPS_PER_MM>(pos))));
   }
 
   static GcodePosition stepperPositionToGcode(const StepperPosition pos) {
@@ -68,6 +73,23 @@ class Axis : public Clef::Util::Initialized {
     }
   }
 
+  /**
+   * Prepare the stepper to be pulsed by the step engine instead of this axis's
+   * own timer. The stepper is set to full resolution so that each pulse is
+   * exactly one microstep.
+   */
+  void setStepTarget(const StepperPosition position) {
+    using Resolution = typename Clef::If::Stepper<USTEPS_PER_MM>::Resolution;
+    stepper_.setResolution(Resolution::_32);
+    stepper_.setTargetPosition(position);
+  }
+
+  /**
+   * Pulse the stepper directly; intended to be called from the step engine.
+   */
+  void pulse() { stepper_.pulse(); }
+  void unpulse() { stepper_.unpulse(); }
+
   StepperPosition getTargetStepperPosition() const {
     return stepper_.getTargetPosition();
   }
@@ -92,24 +114,24 @@ class Axis : public Clef::Util::Initialized {
                               USTEPS_PER_MM>(1.0f) /
          stepperFeedrate)
             .asFrequency());
-    Resolution resolution = Resolution::_32;
-    Clef::Util::Frequency pulseFrequency(feedrateFrequency);
-    if (feedrateFrequency < maxFrequency) {
-    } else if (feedrateFrequency < (maxFrequency * 2)) {
-      resolution = Resolution::_16;
-      pulseFrequency = feedrateFrequency / 2;
-    } else if (feedrateFrequency < (maxFrequency * 4)) {
-      resolution = Resolution::_8;
-      pulseFrequency = feedrateFrequency / 4;
-    } else if (feedrateFrequency < (maxFrequency * 8)) {
-      resolution = Resolution::_4;
-      pulseFrequency = feedrateFrequency / 8;
-    } else if (feedrateFrequency < (maxFrequency * 16)) {
-      resolution = Resolution::_2;
-      pulseFrequency = feedrateFrequency / 16;
-    } else {
-      resolution = Resolution::_1;
-      pulseFrequency = feedrateFrequency / 32;
+    uint8_t shift = 0;
+    while (shift < 5 && feedrateFrequency >= maxFrequency * (1 << shift)) {
+      ++shift;
+    }
+
+    // A coarser resolution moves the stepper several microsteps per pulse, so
+    // only use it if the stepper stays aligned and does not overshoot the
+    // target; the speed is capped instead
+    const int32_t position = *stepper_.getPosition();
+    const int32_t distance = abs(*stepper_.getTargetPosition() - position);
+    while (shift > 0 &&
+           (position % (1 << shift) != 0 || distance < (1 << shift))) {
+      --shift;
+    }
+    const Resolution resolution = static_cast<Resolution>(5 - shift);
+    Clef::Util::Frequency pulseFrequency(feedrateFrequency / (1 << shift));
+    if (pulseFrequency > maxFrequency) {
+      pulseFrequency = maxFrequency;
     }
     stepper_.setResolution(resolution);
     pwmTimer_.setFrequency(pulseFrequency);
@@ -128,7 +150,29 @@ class Axis : public Clef::Util::Initialized {
     axis->stepper_.unpulse();
     if (axis->stepper_.isAtTargetPosition()) {
       axis->pwmTimer_.disable();
+    } else {
+      axis->refineResolution();
+    }
+  }
+
+  /**
+   * Switch to a finer resolution if the next pulse would overshoot the target.
+   */
+  void refineResolution() {
+    using Resolution = typename Clef::If::Stepper<USTEPS_PER_MM>::Resolution;
+    uint8_t shift = 5 - static_cast<uint8_t>(stepper_.getResolution());
+    if (shift == 0) {
+      return;
+    }
+    const int32_t distance =
+        abs(*stepper_.getTargetPosition() - *stepper_.getPosition());
+    if (distance >= (1 << shift)) {
+      return;
     }
+    while (shift > 0 && distance < (1 << shift)) {
+      --shift;
+    }
+    stepper_.setResolution(static_cast<Resolution>(5 - shift));
   }
 
  protected:
@@ -194,42 +238,67 @@ class ExtrusionAxis : public Axis<USTEPS_PER_MM> {
         displacementSensor_(displacementSensor),
         pressureSensor_(pressureSensor),
         predictor_(predictor),
-        displacementSensorOffset_(0.0f) {
+        displacementSensorOffset_(0.0f),
+        numDisplacementSensorSamples_(0) {
     displacementSensorToken_ = displacementSensor_.subscribe();
     pressureSensorToken_ = pressureSensor_.subscribe();
   }
 
   /**
-   * Set the amount by which the displacement sensor and axis differ. This
-   * should be done during global firmware initialization and homing.
+   * Add a sample to the amount by which the displacement sensor and axis
+   * differ, and return whether enough samples have been taken. The offset is
+   * the mean of the samples, since the noise of a single sample would be left
+   * in every extrusion. This should be done during global firmware
+   * initialization and homing, while the extruder is at rest.
    */
-  void setDisplacementSensorOffset(
+  bool calibrateDisplacementSensor(
       const typename Axis<USTEPS_PER_MM>::template Position<
           float, Clef::Util::PositionUnit::USTEP>
-          offset) {
-    displacementSensorOffset_ = offset;
+          position) {
+    numDisplacementSensorSamples_++;
+    displacementSensorOffset_ =
+        displacementSensorOffset_ +
+        (position - displacementSensorOffset_) /
+            static_cast<float>(numDisplacementSensorSamples_);
+    return numDisplacementSensorSamples_ >= DISPLACEMENT_OFFSET_SAMPLES;
   }
 
   /**
-   * If there is new sensor data, handle feedrate throttling. Returns the
-   * feedrate at which the XY axes should operate.
+   * Feed new sensor data, if there is any, to the predictor. Returns whether
+   * the prediction has been updated.
+   *
+   * An evolution of the predictor is spread over several calls, one bounded
+   * step per call, so that the main loop is not held up; new sensor data
+   * waits until the evolution in progress is finished.
    */
-  bool throttle(const XYEPosition &startPosition,
-                const XYEPosition &endPosition,
-                const XYEPosition &currentPosition, float *xyFeedrate) {
+  bool updatePrediction() {
     bool hasNewData = false;
-    if (displacementSensor_.checkOut(displacementSensorToken_)) {
+    if (predictor_.isEvolving()) {
+      hasNewData = predictor_.advance();
+    } else if (displacementSensor_.checkOut(displacementSensorToken_)) {
       if (pressureSensor_.checkOut(pressureSensorToken_)) {
-        hasNewData = true;
         float t = *pressureSensor_.getMeasurementTime();
         float xe = *this->stepper_.getPosition();
         float xs = *displacementSensor_.readPosition();
         float P = pressureSensor_.readPressure();
         predictor_.evolve(t / 1e6, xe, xs, P);
+        hasNewData = !predictor_.isEvolving();
         pressureSensor_.release(pressureSensorToken_);
       }
       displacementSensor_.release(displacementSensorToken_);
     }
+    return hasNewData;
+  }
+
+  /**
+   * Update the prediction and handle feedrate throttling. Sets the feedrate at
+   * which the XY axes should operate, and returns whether the prediction has
+   * been updated.
+   */
+  bool throttle(const XYEPosition &startPosition,
+                const XYEPosition &endPosition,
+                const XYEPosition &currentPosition, float *xyFeedrate) {
+    const bool hasNewData = updatePrediction();
     *xyFeedrate = predictor_.determineXYFeedrate(
         *XYEPosition::XAxis::gcodePositionToStepper(startPosition.x),
         *XYEPosition::YAxis::gcodePositionToStepper(startPosition.y),
@@ -284,6 +353,7 @@ class ExtrusionAxis : public Axis<USTEPS_PER_MM> {
       float, Clef::Util::PositionUnit::USTEP>
       displacementSensorOffset_; /*!< Subtract this quantity from xs to get the
                                     corresponding value of xe. */
+  uint8_t numDisplacementSensorSamples_;
 };
 
 class Axes : public Clef::Util::Initialized {
@@ -318,20 +388,6 @@ class Axes : public Clef::Util::Initialized {
 
   XAxis::GcodeFeedrate getFeedrate() const { return feedrate_; }
 
-  /**
-   * Set the XY position and feedrate.
-   */
-  void setXyParams(const XYEPosition &startPosition,
-                   const XYEPosition &endPosition,
-                   const XAxis::GcodeFeedrate feedrate) {
-    const XYEPosition difference = endPosition - startPosition;
-    const float magnitude = difference.getXyMagnitude();
-    getX().setFeedrate(feedrate * fabs(*difference.x / magnitude));
-    getY().setFeedrate(feedrate * fabs(*difference.y / magnitude));
-    getX().setTargetPosition(endPosition.x);
-    getY().setTargetPosition(endPosition.y);
-  }
-
   XYZEPosition getCurrentPosition() const {
     return {getX().getGcodePosition(), getY().getGcodePosition(),
             getZ().getGcodePosition(), getE().getGcodePosition()};
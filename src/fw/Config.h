@@ -15,3 +15,43 @@
  * Set a limit on stepper motor pulse frequency.
  */
 #define MAX_STEPPER_FREQ 16000.0f
+
+/**
+ * Motion planner limits. Accelerations are in mm/s^2, speeds in mm/s, and the
+ * junction deviation (how far the toolhead may cut a corner in an equivalent
+ * circular arc) is in mm.
+ */
+#define MAX_ACCEL_X 400.0f
+#define MAX_ACCEL_Y 400.0f
+#define JUNCTION_DEVIATION 0.05f
+#define MIN_PLANNER_SPEED 0.5f
+
+/**
+ * Step engine parameters. The block queue holds one less block than its size;
+ * the step rate is updated this many times per second while accelerating.
+ */
+#define STEP_BLOCK_QUEUE_SIZE 8
+#define ACCELERATION_TICKS_PER_SECOND 100L
+
+/**
+ * Number of slots in the action queue (it holds one less action than this).
+ * Every slot is the size of the largest action, so this is bounded by SRAM.
+ */
+#define ACTION_QUEUE_SIZE 16
+
+/**
+ * Extrusion endpoint detection. The displacement sensor offset is the mean of
+ * this many samples taken at startup, and an extrusion is done once the
+ * predicted position is within this many extruder microsteps of its endpoint.
+ */
+#define DISPLACEMENT_OFFSET_SAMPLES 16
+#define EXTRUSION_END_TOLERANCE 2.0f
+
+/**
+ * Arcs (G2/G3) are split into chords which deviate from the arc by at most this
+ * many mm. Every this many chords, the position along the arc is computed
+ * exactly rather than by rotating the previous one, to stop rounding errors
+ * from accumulating.
+ */
+#define ARC_TOLERANCE 0.01f
+#define ARC_CORRECTION_SEGMENTS 12
@@ -2,6 +2,7 @@
 
 #include "ExtrusionPredictor.h"
 
+#include <fw/Config.h>
 #include <math.h>
 
 namespace Clef::Fw {
@@ -18,8 +19,15 @@ void ExtrusionPredictor::setEndpoint(const float endpoint) {
 
 float ExtrusionPredictor::getEndpoint() const { return endpoint_; }
 
+bool ExtrusionPredictor::advance() { return true; }
+
+bool ExtrusionPredictor::isEvolving() const { return false; }
+
 bool ExtrusionPredictor::isBeyondEndpoint() const {
-  return getRelativeExtrusionPosition() >= getEndpoint();
+  // The prediction of a finished extrusion settles around the endpoint, and
+  // is as likely to settle just short of it as just past it
+  return getRelativeExtrusionPosition() >=
+         getEndpoint() - EXTRUSION_END_TOLERANCE;
 }
 
 float ExtrusionPredictor::determineXYFeedrate(
@@ -70,16 +78,23 @@ float LinearExtrusionPredictor::getExtrusionRate() const { return dxsdt_; }
 void KalmanFilterExtrusionPredictor::reset(const float t, const float xe0,
                                            const float xs0) {
   ExtrusionPredictor::reset(t, xe0, xs0);
+  filter_.cancel();
   filter_.init();
   t_ = t;
 }
 
 void KalmanFilterExtrusionPredictor::evolve(const float t, const float xe,
                                             const float xs, const float P) {
-  filter_.evolve(xe - xe0_, xs - xs0_, P, t - t_);
+  filter_.begin(xe - xe0_, xs - xs0_, P, t - t_);
   t_ = t;
 }
 
+bool KalmanFilterExtrusionPredictor::advance() { return filter_.advance(); }
+
+bool KalmanFilterExtrusionPredictor::isEvolving() const {
+  return filter_.isEvolving();
+}
+
 float KalmanFilterExtrusionPredictor::getRelativeExtrusionPosition() const {
   return filter_.getState().get(0, 0);
 }
@@ -87,4 +102,49 @@ float KalmanFilterExtrusionPredictor::getRelativeExtrusionPosition() const {
 float KalmanFilterExtrusionPredictor::getExtrusionRate() const {
   return 60 * filter_.getState().get(1, 0);
 }
+
+void FixedPointKalmanFilterExtrusionPredictor::reset(const float t,
+                                                     const float xe0,
+                                                     const float xs0) {
+  ExtrusionPredictor::reset(t, xe0, xs0);
+  filter_.cancel();
+  filter_.init();
+  t_ = t;
+  origin_ = 0.0f;
+}
+
+void FixedPointKalmanFilterExtrusionPredictor::evolve(const float t,
+                                                      const float xe,
+                                                      const float xs,
+                                                      const float P) {
+  using Scalar = Kalman::DegenFixedFilter::Scalar;
+  // The model only uses positions in differences (and xs is not scaled), so
+  // moving the origin by whole usteps changes nothing but the range
+  const float distance = xe - xe0_ - origin_;
+  if (distance > REBASE_DISTANCE || distance < -REBASE_DISTANCE) {
+    const float offset = static_cast<int32_t>(distance);
+    origin_ += offset;
+    filter_.offsetState(0, Scalar(-offset));
+  }
+  filter_.begin(Scalar(xe - xe0_ - origin_), Scalar(xs - xs0_ - origin_),
+                Scalar(P), Scalar(t - t_));
+  t_ = t;
+}
+
+bool FixedPointKalmanFilterExtrusionPredictor::advance() {
+  return filter_.advance();
+}
+
+bool FixedPointKalmanFilterExtrusionPredictor::isEvolving() const {
+  return filter_.isEvolving();
+}
+
+float FixedPointKalmanFilterExtrusionPredictor::getRelativeExtrusionPosition()
+    const {
+  return origin_ + filter_.getUnscaledState(0).toFloat();
+}
+
+float FixedPointKalmanFilterExtrusionPredictor::getExtrusionRate() const {
+  return 60 * filter_.getUnscaledState(1).toFloat();
+}
 }  // namespace Clef::Fw
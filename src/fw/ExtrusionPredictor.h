@@ -3,6 +3,7 @@
 #pragma once
 
 #include <fw/kalman/Degen.h>
+#include <fw/kalman/DegenFixed.h>
 #include <util/Units.h>
 
 namespace Clef::Fw {
@@ -20,7 +21,8 @@ class ExtrusionPredictor {
   float getEndpoint() const;
 
   /**
-   * Check whether the target extrusion amount has been reached or exceeded.
+   * Check whether the target extrusion amount has been reached or exceeded, to
+   * within EXTRUSION_END_TOLERANCE.
    */
   bool isBeyondEndpoint() const;
 
@@ -33,7 +35,9 @@ class ExtrusionPredictor {
                             const float y) const;
 
   /**
-   * Evolve the internal stage of the predictor.
+   * Evolve the internal stage of the predictor. Predictors which are
+   * expensive to evolve may only start here, in which case the work is done
+   * by calls to advance().
    *
    * Units are abandoned at this stage because prediction algorithms are
    * math-intensive and we want to avoid templating. Units are:
@@ -44,6 +48,14 @@ class ExtrusionPredictor {
   virtual void evolve(const float t, const float xe, const float xs,
                       const float P) = 0;
 
+  /**
+   * Do a bounded amount of the work of the evolution in progress; returns
+   * true once it is finished (or if there is none). Until then, the
+   * predictor gives the estimate from before the evolution.
+   */
+  virtual bool advance();
+  virtual bool isEvolving() const;
+
  protected:
   /**
    * Get the progress of the extrusion relative to the baseline xs0_.
@@ -93,6 +105,8 @@ class KalmanFilterExtrusionPredictor : public ExtrusionPredictor {
 
   void evolve(const float t, const float xe, const float xs,
               const float P) override;
+  bool advance() override;
+  bool isEvolving() const override;
 
  private:
   float getRelativeExtrusionPosition() const override;
@@ -102,4 +116,35 @@ class KalmanFilterExtrusionPredictor : public ExtrusionPredictor {
   Kalman::DegenFilter filter_;
   float t_ = 0.0f;
 };
+
+/**
+ * The same Kalman filter in fixed point, which is much cheaper on targets
+ * without an FPU. Positions are relative to an origin that starts at the reset
+ * and follows the extruder, so they stay within the range of Q16.16 however
+ * long the extrusion is.
+ */
+class FixedPointKalmanFilterExtrusionPredictor : public ExtrusionPredictor {
+ public:
+  /**
+   * Distance (in usteps) of the extruder from the origin of the filter at
+   * which the origin moves to the extruder, well inside +/-32768 usteps.
+   */
+  static constexpr float REBASE_DISTANCE = 8192.0f;
+
+  void reset(const float t, const float xe0, const float xs0) override;
+
+  void evolve(const float t, const float xe, const float xs,
+              const float P) override;
+  bool advance() override;
+  bool isEvolving() const override;
+
+ private:
+  float getRelativeExtrusionPosition() const override;
+  float getExtrusionRate() const override;
+
+ private:
+  Kalman::DegenFixedFilter filter_;
+  float t_ = 0.0f;
+  float origin_ = 0.0f; /*!< Origin of the filter relative to xe0_ and xs0_. */
+};
 }  // namespace Clef::Fw
@@ -4,7 +4,6 @@
 
 #include <if/Memory.h>
 #include <stdio.h>
-#include <stdlib.h>
 #include <string.h>
 
 namespace Clef::Fw {
@@ -18,152 +17,627 @@ STRING(INVALID_INT_ERROR, "invalid_int_error");
 STRING(INVALID_FLOAT_ERROR, "invalid_float_error");
 STRING(MISSING_COMMAND_CODE_ERROR, "missing_command_code_error");
 STRING(INVALID_G_CODE_ERROR, "invalid_g_code_error");
+STRING(INVALID_M_CODE_ERROR, "invalid_m_code_error");
+STRING(INVALID_ARC_ERROR, "invalid_arc_error");
+STRING(INVALID_FRAME_ERROR, "invalid_frame_error");
+STRING(RESEND, "resend");
 STRING(INSUFFICIENT_QUEUE_CAPACITY_ERROR, "alloc_error");
 }  // namespace Str
 
-GcodeParser::GcodeParser() { reset(); }
+GcodeParser::GcodeParser()
+    : arcIsExtruding_(false),
+      arcHasLineNumber_(false),
+      arcLineNumber_(0),
+      parseStats_({0, 0}),
+      enqueueMicros_(0),
+      nextLineNumber_(1),
+      resendRequested_(false),
+      binaryMode_(false),
+      binaryState_(BinaryState::SYNC),
+      binaryLength_(0),
+      binaryReceived_(0),
+      binaryCrc_(0),
+      binaryExpectedCrc_(0),
+      binaryTargets_{0, 0, 0, 0} {
+  resetLine();
+}
 
 void GcodeParser::ingest(Context &context) {
+  if (arc_.isActive()) {
+    // Later lines wait until the whole arc is queued
+    continueArc(context);
+    if (arc_.isActive()) {
+      return;
+    }
+    acknowledge(context, arcHasLineNumber_, arcLineNumber_);
+  }
+  if (!context.serial.isReadyToRead()) {
+    return;
+  }
+  const uint64_t startMicros = *context.clock.getMicros();
+  enqueueMicros_ = 0;
+  char newChar;
+  while (!arc_.isActive() && context.serial.read(&newChar)) {
+    if (binaryMode_) {
+      ingestBinary(context, static_cast<uint8_t>(newChar));
+    } else if (newChar == '\n') {
+      processLine(context);
+      resetLine();
+    } else if (!tokenize(newChar)) {
+      // Flush the line until a new line is detected
+      while (context.serial.read(&newChar) && newChar != '\n') {
+      }
+      context.serial.writeLine(Str::BUFFER_OVERFLOW_ERROR);
+      resetLine();
+    }
+  }
+  parseStats_.micros +=
+      *context.clock.getMicros() - startMicros - enqueueMicros_;
+}
+
+bool GcodeParser::isBusy() const { return arc_.isActive(); }
+
+const GcodeParser::ParseStats &GcodeParser::getParseStats() const {
+  return parseStats_;
+}
+
+void GcodeParser::resetParseStats() { parseStats_ = {0, 0}; }
+
+void GcodeParser::processLine(Context &context) {
   const uint16_t errorBufferSize = 64;
   char errorBuffer[errorBufferSize];
-  char newChar;
-  while (context.serial.read(&newChar)) {
-    if (newChar == '\n') {
-      commentMode_ = false;
-      // Process the line
-      if (parse(errorBufferSize, errorBuffer)) {
-        bool anyCodes = false;
-        for (uint8_t i = 0; i < 26; ++i) {
-          if (buckets_[i]) {
-            anyCodes = true;
-          }
-        }
-        if (anyCodes) {
-          if (interpret(context, errorBufferSize, errorBuffer)) {
-            context.serial.writeLine(Str::OK);
-          } else {
-            context.serial.writeLine(errorBuffer);
-          }
-        }
+  finishWord();
+  if (lineLength_ > 0) {
+    parseStats_.numLines++;
+  }
+  int32_t lineNumber;
+  bool hasLineNumber;
+  if (!checkFraming(&lineNumber, &hasLineNumber)) {
+    requestResend(context);
+    return;
+  }
+  const bool parsed = !tokenError_;
+  if (!parsed) {
+    snprintf(errorBuffer, errorBufferSize, "%s: %c", tokenError_,
+             tokenErrorCode_);
+  }
+
+  if (hasLineNumber) {
+    int32_t mcode;
+    const bool isM110 =
+        parsed && parseInt('M', &mcode, 0, nullptr) && mcode == 110;
+    if (!checkLineNumber(context, lineNumber, isM110)) {
+      return;
+    }
+  }
+
+  if (!parsed) {
+    context.serial.writeLine(errorBuffer);
+    return;
+  }
+  const bool anyCodes = presentSlots_ & ~(1UL << LINE_NUMBER_SLOT);
+  if (anyCodes || hasLineNumber) {
+    const bool success =
+        !anyCodes || interpret(context, errorBufferSize, errorBuffer);
+    if (success && arc_.isActive()) {
+      arcHasLineNumber_ = hasLineNumber;
+      arcLineNumber_ = lineNumber;
+    } else {
+      reportResult(context, success, hasLineNumber, lineNumber, errorBuffer);
+    }
+  }
+}
+
+void GcodeParser::ingestBinary(Context &context, const uint8_t byte) {
+  switch (binaryState_) {
+    case BinaryState::SYNC:
+      if (byte == BINARY_SYNC) {
+        binaryState_ = BinaryState::LENGTH;
+      }
+      break;
+    case BinaryState::LENGTH:
+      if (byte == 0 || byte > size_) {
+        // Corrupted; look for the start of the next frame
+        requestResend(context);
+        binaryState_ = BinaryState::SYNC;
       } else {
-        context.serial.writeLine(errorBuffer);
+        binaryLength_ = byte;
+        binaryReceived_ = 0;
+        binaryCrc_ = Clef::Util::crc16Update(Clef::Util::CRC16_INIT, byte);
+        binaryState_ = BinaryState::BODY;
       }
-      reset();
-    } else if (newChar == ';') {
-      // If there is a semicolon, ignore everything until the next new line.
-      commentMode_ = true;
-    } else if (!commentMode_) {
-      // Add the char to the buffer
-      if (!append(newChar)) {
-        // Flush the buffer until a new line is detected
-        while ((newChar = context.serial.read(&newChar))) {
-          if (newChar == '\n') {
-            break;
-          }
-        }
-        context.serial.writeLine(Str::BUFFER_OVERFLOW_ERROR);
-        reset();
+      break;
+    case BinaryState::BODY:
+      buffer_[binaryReceived_++] = byte;
+      binaryCrc_ = Clef::Util::crc16Update(binaryCrc_, byte);
+      if (binaryReceived_ == binaryLength_) {
+        binaryState_ = BinaryState::CRC_HIGH;
       }
+      break;
+    case BinaryState::CRC_HIGH:
+      binaryExpectedCrc_ = static_cast<uint16_t>(byte) << 8;
+      binaryState_ = BinaryState::CRC_LOW;
+      break;
+    case BinaryState::CRC_LOW:
+      binaryState_ = BinaryState::SYNC;
+      if ((binaryExpectedCrc_ | byte) == binaryCrc_) {
+        processFrame(context);
+      } else {
+        requestResend(context);
+      }
+      break;
+  }
+}
+
+void GcodeParser::processFrame(Context &context) {
+  const uint16_t errorBufferSize = 64;
+  char errorBuffer[errorBufferSize];
+  Clef::Util::ByteReader reader(reinterpret_cast<const uint8_t *>(buffer_),
+                                binaryLength_);
+  uint32_t lineNumber;
+  uint8_t type;
+  parseStats_.numLines++;
+  if (!reader.readVarint(&lineNumber) || !reader.readByte(&type)) {
+    requestResend(context);
+    return;
+  }
+  if (!checkLineNumber(context, lineNumber, false)) {
+    return;
+  }
+  snprintf(errorBuffer, errorBufferSize, "%s", Str::INVALID_FRAME_ERROR);
+  bool success = false;
+  switch (static_cast<FrameType>(type)) {
+    case FrameType::MOVE:
+      success = decodeMove(context, &reader, errorBufferSize, errorBuffer);
+      break;
+    case FrameType::SEGMENT:
+      success = decodeSegment(context, &reader, errorBufferSize, errorBuffer);
+      break;
+    case FrameType::ASCII:
+      success = reader.isAtEnd();
+      binaryMode_ = !success;
+      break;
+    default:
+      break;
+  }
+  reportResult(context, success, true, lineNumber, errorBuffer);
+}
+
+bool GcodeParser::decodeMove(Context &context,
+                             Clef::Util::ByteReader *const reader,
+                             const uint16_t errorBufferSize,
+                             char *const errorBuffer) {
+  uint8_t flags;
+  if (!reader->readByte(&flags)) {
+    return false;
+  }
+  int32_t targets[4];
+  if (!readTargets(reader, flags, targets)) {
+    return false;
+  }
+  uint32_t feedrate = 0;
+  if ((flags & BINARY_F_FLAG) && !reader->readVarint(&feedrate)) {
+    return false;
+  }
+  if (!reader->isAtEnd()) {
+    return false;
+  }
+
+  const float x = *Axes::XAxis::stepperPositionToGcode(
+      Axes::XAxis::StepperPosition(targets[0]));
+  const float y = *Axes::YAxis::stepperPositionToGcode(
+      Axes::YAxis::StepperPosition(targets[1]));
+  const float z = *Axes::ZAxis::stepperPositionToGcode(
+      Axes::ZAxis::StepperPosition(targets[2]));
+  const float e = *Axes::EAxis::stepperPositionToGcode(
+      Axes::EAxis::StepperPosition(targets[3]));
+  const float f = feedrate;
+  if (!enqueueMove(context, flags & BINARY_X_FLAG ? &x : nullptr,
+                   flags & BINARY_Y_FLAG ? &y : nullptr,
+                   flags & BINARY_Z_FLAG ? &z : nullptr,
+                   flags & BINARY_E_FLAG ? &e : nullptr,
+                   flags & BINARY_F_FLAG ? &f : nullptr, errorBufferSize,
+                   errorBuffer)) {
+    return false;
+  }
+  memcpy(binaryTargets_, targets, sizeof(binaryTargets_));
+  return true;
+}
+
+bool GcodeParser::decodeSegment(Context &context,
+                                Clef::Util::ByteReader *const reader,
+                                const uint16_t errorBufferSize,
+                                char *const errorBuffer) {
+  uint8_t flags;
+  int32_t targets[4];
+  uint32_t nominalSpeed, maxEntrySpeed;
+  if (!reader->readByte(&flags) ||
+      (flags & ~(BINARY_X_FLAG | BINARY_Y_FLAG | BINARY_ABSOLUTE_FLAG)) ||
+      !readTargets(reader, flags, targets) ||
+      !reader->readVarint(&nominalSpeed) ||
+      !reader->readVarint(&maxEntrySpeed) || !reader->isAtEnd() ||
+      nominalSpeed == 0) {
+    return false;
+  }
+  if (context.actionQueue.getNumSpacesLeft() == 0) {
+    snprintf(errorBuffer, errorBufferSize, "%s",
+             Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR);
+    return false;
+  }
+
+  const uint64_t startMicros = *context.clock.getMicros();
+  const Axes::XAxis::GcodePosition x =
+      Axes::XAxis::stepperPositionToGcode(
+          Axes::XAxis::StepperPosition(targets[0]));
+  const Axes::YAxis::GcodePosition y =
+      Axes::YAxis::stepperPositionToGcode(
+          Axes::YAxis::StepperPosition(targets[1]));
+  Action::MoveXY moveXy(context.actionQueue.getEndPosition(),
+                        flags & BINARY_X_FLAG ? &x : nullptr,
+                        flags & BINARY_Y_FLAG ? &y : nullptr);
+  moveXy.setPlannedSpeeds(nominalSpeed / 1000.0f, maxEntrySpeed / 1000.0f);
+  context.actionQueue.push(context, moveXy);
+  enqueueMicros_ += *context.clock.getMicros() - startMicros;
+  memcpy(binaryTargets_, targets, sizeof(binaryTargets_));
+  return true;
+}
+
+bool GcodeParser::readTargets(Clef::Util::ByteReader *const reader,
+                              const uint8_t flags,
+                              int32_t *const targets) const {
+  for (uint8_t i = 0; i < 4; ++i) {
+    targets[i] = binaryTargets_[i];
+    if (flags & (1 << i)) {
+      int32_t value;
+      if (!reader->readSignedVarint(&value)) {
+        return false;
+      }
+      targets[i] = flags & BINARY_ABSOLUTE_FLAG ? value : targets[i] + value;
+    }
+  }
+  return true;
+}
+
+bool GcodeParser::checkLineNumber(Context &context, const int32_t lineNumber,
+                                  const bool resetsLineNumber) {
+  if (!resetsLineNumber) {
+    if (lineNumber < nextLineNumber_) {
+      // Already executed; the host sent the line again because it has not seen
+      // the acknowledgement yet
+      acknowledge(context, true, lineNumber);
+      return false;
+    } else if (lineNumber > nextLineNumber_) {
+      requestResend(context);
+      return false;
     }
   }
+  nextLineNumber_ = lineNumber + 1;
+  resendRequested_ = false;
+  return true;
 }
 
-void GcodeParser::reset() {
-  head_ = buffer_;
-  *head_ = '\0';
-  commentMode_ = false;
-  memset(buckets_, 0, sizeof(buckets_));
-  memset(buffer_, 0, sizeof(buffer_));
+void GcodeParser::reportResult(Context &context, const bool success,
+                               const bool hasLineNumber,
+                               const int32_t lineNumber,
+                               const char *const errorBuffer) {
+  if (success) {
+    acknowledge(context, hasLineNumber, lineNumber);
+    return;
+  }
+  if (hasLineNumber &&
+      strcmp(errorBuffer, Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) == 0) {
+    // The line has not been consumed; drop the lines that follow it until the
+    // host sends it again
+    nextLineNumber_ = lineNumber;
+    resendRequested_ = true;
+  }
+  context.serial.writeLine(errorBuffer);
 }
 
-bool GcodeParser::append(const char newChar) {
-  if (head_ < (buffer_ + size_ - 1)) {
-    *(head_++) = newChar;
-    *head_ = '\0';
-    return true;
+void GcodeParser::acknowledge(Context &context, const bool hasLineNumber,
+                              const int32_t lineNumber) {
+  char buffer[48];
+  char *end = buffer + snprintf(buffer, sizeof(buffer), "%s", Str::OK);
+  if (hasLineNumber) {
+    end += snprintf(end, buffer + sizeof(buffer) - end, " N%ld",
+                    static_cast<long>(lineNumber));
   }
-  return false;
+  snprintf(end, buffer + sizeof(buffer) - end, " P%u Q%u B%u",
+           static_cast<unsigned>(context.actionQueue.getNumSpacesLeft()),
+           static_cast<unsigned>(context.xyePositionQueue.getNumSpacesLeft()),
+           static_cast<unsigned>(context.serial.getNumRxSpacesLeft()));
+  context.serial.writeLine(buffer);
 }
 
-bool GcodeParser::parse(const uint16_t errorBufferSize,
-                        char *const errorBuffer) {
-  memset(buckets_, 0, sizeof(buckets_));
-  char *pch = strtok(buffer_, " ");
-  while (pch) {
-    uint8_t letter = pch[0] - 'A';
-    if (letter >= 26) {
-      snprintf(errorBuffer, errorBufferSize, "%s: %c",
-               Str::INVALID_CODE_LETTER_ERROR, pch[0]);
+bool GcodeParser::checkFraming(int32_t *const lineNumber,
+                               bool *const hasLineNumber) const {
+  *hasLineNumber = presentSlots_ & (1UL << LINE_NUMBER_SLOT);
+  *lineNumber = 0;
+  if (hasChecksum_) {
+    if (expectedChecksum_ != checksum_) {
       return false;
     }
-    if (buckets_[letter]) {
-      snprintf(errorBuffer, errorBufferSize, "%s: %c",
-               Str::DUPLICATE_CODE_LETTER_ERROR, pch[0]);
+  } else if (*hasLineNumber) {
+    // Numbered lines must carry a checksum
+    return false;
+  }
+
+  if (*hasLineNumber) {
+    const Number &number = numbers_[LINE_NUMBER_SLOT];
+    if (!(definedSlots_ & (1UL << LINE_NUMBER_SLOT)) ||
+        (malformedSlots_ & (1UL << LINE_NUMBER_SLOT)) || number.decimals ||
+        number.mantissa < 0) {
       return false;
     }
-    buckets_[letter] = pch + 1;
-    pch = strtok(NULL, " ");
+    *lineNumber = number.mantissa;
   }
   return true;
 }
 
+void GcodeParser::requestResend(Context &context) {
+  if (!resendRequested_) {
+    char buffer[24];
+    snprintf(buffer, sizeof(buffer), "%s %ld", Str::RESEND,
+             static_cast<long>(nextLineNumber_));
+    context.serial.writeLine(buffer);
+    resendRequested_ = true;
+  }
+}
+
+bool GcodeParser::tokenize(const char c) {
+  if (tokenState_ == TokenState::COMMENT) {
+    return true;
+  } else if (c == ';') {
+    // If there is a semicolon, ignore everything until the next new line.
+    finishWord();
+    tokenState_ = TokenState::COMMENT;
+    return true;
+  } else if (lineLength_ >= size_ - 1) {
+    return false;
+  }
+  lineLength_++;
+
+  if (tokenState_ == TokenState::CHECKSUM) {
+    if ('0' <= c && c <= '9') {
+      if (expectedChecksum_ < 0) {
+        expectedChecksum_ = 0;
+      }
+      expectedChecksum_ = expectedChecksum_ * 10 + (c - '0');
+      if (expectedChecksum_ > 0xff) {
+        // Can never match; also prevents overflow
+        expectedChecksum_ = 0x100;
+      }
+    } else if (c != ' ' && c != '\t' && c != '\r') {
+      expectedChecksum_ = 0x100;
+    }
+    return true;
+  } else if (c == '*') {
+    finishWord();
+    hasChecksum_ = true;
+    tokenState_ = TokenState::CHECKSUM;
+    return true;
+  }
+
+  checksum_ ^= static_cast<uint8_t>(c);
+  if (c == ' ' || c == '\t' || c == '\r') {
+    finishWord();
+  } else if (tokenState_ == TokenState::SPACE) {
+    startWord(c);
+  } else {
+    accumulate(c);
+  }
+  return true;
+}
+
+void GcodeParser::startWord(const char code) {
+  tokenState_ = TokenState::WORD;
+  slot_ = NO_SLOT;
+  if (tokenError_) {
+    // Only the first error is reported
+    return;
+  }
+  uint8_t slot;
+  if (code == 'N' && !presentSlots_) {
+    slot = LINE_NUMBER_SLOT;
+  } else if ('A' <= code && code <= 'Z') {
+    slot = code - 'A';
+  } else {
+    setTokenError(Str::INVALID_CODE_LETTER_ERROR, code);
+    return;
+  }
+  if (presentSlots_ & (1UL << slot)) {
+    setTokenError(Str::DUPLICATE_CODE_LETTER_ERROR, code);
+    return;
+  }
+  presentSlots_ |= 1UL << slot;
+  numbers_[slot] = {0, 0};
+  slot_ = slot;
+  wordLength_ = 0;
+  negative_ = false;
+  hasPoint_ = false;
+  hasDigits_ = false;
+}
+
+void GcodeParser::accumulate(const char c) {
+  if (slot_ == NO_SLOT) {
+    return;
+  }
+  Number &number = numbers_[slot_];
+  const uint32_t bit = 1UL << slot_;
+  if ((c == '-' || c == '+') && wordLength_ == 0) {
+    negative_ = c == '-';
+  } else if (c == '.' && !hasPoint_) {
+    hasPoint_ = true;
+  } else if ('0' <= c && c <= '9') {
+    const int32_t digit = c - '0';
+    hasDigits_ = true;
+    if (number.mantissa > (INT32_MAX - digit) / 10) {
+      if (!hasPoint_) {
+        // The integer part does not fit
+        malformedSlots_ |= bit;
+      }
+    } else if (!hasPoint_ || number.decimals < MAX_DECIMALS) {
+      number.mantissa = number.mantissa * 10 + digit;
+      number.decimals += hasPoint_;
+    }
+  } else {
+    malformedSlots_ |= bit;
+  }
+  wordLength_++;
+}
+
+void GcodeParser::finishWord() {
+  if (tokenState_ != TokenState::WORD) {
+    return;
+  }
+  tokenState_ = TokenState::SPACE;
+  if (slot_ == NO_SLOT || wordLength_ == 0) {
+    // A code letter without a value is undefined rather than malformed
+    return;
+  }
+  const uint32_t bit = 1UL << slot_;
+  if (!hasDigits_) {
+    malformedSlots_ |= bit;
+  } else {
+    definedSlots_ |= bit;
+    if (negative_) {
+      numbers_[slot_].mantissa = -numbers_[slot_].mantissa;
+    }
+  }
+}
+
+void GcodeParser::resetLine() {
+  tokenState_ = TokenState::SPACE;
+  lineLength_ = 0;
+  presentSlots_ = 0;
+  definedSlots_ = 0;
+  malformedSlots_ = 0;
+  slot_ = NO_SLOT;
+  tokenError_ = nullptr;
+  tokenErrorCode_ = '\0';
+  checksum_ = 0;
+  hasChecksum_ = false;
+  expectedChecksum_ = -1;
+}
+
+void GcodeParser::setTokenError(const char *const error, const char code) {
+  tokenError_ = error;
+  tokenErrorCode_ = code;
+}
+
 bool GcodeParser::interpret(Context &context, const uint16_t errorBufferSize,
                             char *const errorBuffer) {
   // Check for a 'G' code
   int32_t gcode;
-  if (parseInt('G', &gcode, 0, nullptr)) {
+  if (hasValue('G')) {
+    if (!parseInt('G', &gcode, errorBufferSize, errorBuffer)) {
+      return false;
+    }
     switch (gcode) {
       case 0:
       case 1:
         return handleG1(context, errorBufferSize, errorBuffer);
+      case 2:
+      case 3:
+        return handleG2(context, gcode == 2, errorBufferSize, errorBuffer);
       default:
         snprintf(errorBuffer, errorBufferSize, "%s: %d",
                  Str::INVALID_G_CODE_ERROR, gcode);
         return false;
     }
   }
+
+  // Check for an 'M' code
+  int32_t mcode;
+  if (hasValue('M')) {
+    if (!parseInt('M', &mcode, errorBufferSize, errorBuffer)) {
+      return false;
+    }
+    switch (mcode) {
+      case 110:
+        return handleM110(context, errorBufferSize, errorBuffer);
+      case 880:
+        return handleM880(context, errorBufferSize, errorBuffer);
+      default:
+        snprintf(errorBuffer, errorBufferSize, "%s: %d",
+                 Str::INVALID_M_CODE_ERROR, mcode);
+        return false;
+    }
+  }
   snprintf(errorBuffer, errorBufferSize, "%s", Str::MISSING_COMMAND_CODE_ERROR);
   return false;
 }
 
 bool GcodeParser::hasCodeLetter(const char code) const {
-  return 'A' <= code && code <= 'Z' && buckets_[code - 'A'];
+  return 'A' <= code && code <= 'Z' && (presentSlots_ & (1UL << (code - 'A')));
 }
 
-bool GcodeParser::parseInt(const char code, int32_t *const result,
-                           const uint16_t errorBufferSize,
-                           char *const errorBuffer) const {
-  if ('A' <= code && code <= 'Z') {
-    const char *str = buckets_[code - 'A'];
-    if (str && str[0]) {
-      // TODO: check if the int is actually valid
-      *result = atol(str);
-      return true;
-    } else if (errorBuffer) {
+bool GcodeParser::hasValue(const char code) const {
+  return 'A' <= code && code <= 'Z' &&
+         ((definedSlots_ | malformedSlots_) & (1UL << (code - 'A')));
+}
+
+bool GcodeParser::getNumber(const char code, const char *const invalidError,
+                            int32_t *const mantissa, uint8_t *const decimals,
+                            const uint16_t errorBufferSize,
+                            char *const errorBuffer) const {
+  const uint32_t bit = 'A' <= code && code <= 'Z' ? 1UL << (code - 'A') : 0;
+  if (malformedSlots_ & bit) {
+    if (errorBuffer) {
+      snprintf(errorBuffer, errorBufferSize, "%s: %c", invalidError, code);
+    }
+    return false;
+  } else if (!(definedSlots_ & bit)) {
+    if (errorBuffer) {
       snprintf(errorBuffer, errorBufferSize, "%s: %c",
                Str::UNDEFINED_CODE_LETTER_ERROR, code);
     }
+    return false;
   }
+  *mantissa = numbers_[code - 'A'].mantissa;
+  *decimals = numbers_[code - 'A'].decimals;
+  return true;
+}
+
+bool GcodeParser::parseInt(const char code, int32_t *const result,
+                           const uint16_t errorBufferSize,
+                           char *const errorBuffer) const {
+  int32_t mantissa;
+  uint8_t decimals;
   *result = 0;
-  return false;
+  if (!getNumber(code, Str::INVALID_INT_ERROR, &mantissa, &decimals,
+                 errorBufferSize, errorBuffer)) {
+    return false;
+  }
+  // Accept trailing zeros after the decimal point, e.g. "G1.0"
+  for (; decimals > 0; --decimals) {
+    if (mantissa % 10) {
+      if (errorBuffer) {
+        snprintf(errorBuffer, errorBufferSize, "%s: %c",
+                 Str::INVALID_INT_ERROR, code);
+      }
+      return false;
+    }
+    mantissa /= 10;
+  }
+  *result = mantissa;
+  return true;
 }
 
 bool GcodeParser::parseFloat(const char code, float *const result,
                              const uint16_t errorBufferSize,
                              char *const errorBuffer) const {
-  if ('A' <= code && code <= 'Z') {
-    const char *str = buckets_[code - 'A'];
-    if (str && str[0]) {
-      // TODO: check if the float is actually valid
-      *result = atof(str);
-      return true;
-    } else if (errorBuffer) {
-      snprintf(errorBuffer, errorBufferSize, "%s: %c",
-               Str::UNDEFINED_CODE_LETTER_ERROR, code);
-    }
-  }
+  static const float scales[MAX_DECIMALS + 1] = {1e0f, 1e1f, 1e2f, 1e3f,
+                                                 1e4f, 1e5f, 1e6f};
+  int32_t mantissa;
+  uint8_t decimals;
   *result = 0;
-  return false;
+  if (!getNumber(code, Str::INVALID_FLOAT_ERROR, &mantissa, &decimals,
+                 errorBufferSize, errorBuffer)) {
+    return false;
+  }
+  *result = static_cast<float>(mantissa) / scales[decimals];
+  return true;
 }
 
 bool GcodeParser::handleG1(Context &context, const uint16_t errorBufferSize,
@@ -193,19 +667,131 @@ bool GcodeParser::handleG1(Context &context, const uint16_t errorBufferSize,
     return false;
   }
 
+  return enqueueMove(context, hasX ? &x : nullptr, hasY ? &y : nullptr,
+                     hasZ ? &z : nullptr, hasE ? &e : nullptr,
+                     hasF ? &f : nullptr, errorBufferSize, errorBuffer);
+}
+
+bool GcodeParser::handleG2(Context &context, const bool clockwise,
+                           const uint16_t errorBufferSize,
+                           char *const errorBuffer) {
+  float x, y, e, f, i = 0, j = 0, r;
+  bool hasX, hasY, hasE, hasF, hasR;
+  if (((hasX = hasCodeLetter('X')) &&
+       !parseFloat('X', &x, errorBufferSize, errorBuffer)) ||
+      ((hasY = hasCodeLetter('Y')) &&
+       !parseFloat('Y', &y, errorBufferSize, errorBuffer)) ||
+      ((hasE = hasCodeLetter('E')) &&
+       !parseFloat('E', &e, errorBufferSize, errorBuffer)) ||
+      ((hasF = hasCodeLetter('F')) &&
+       !parseFloat('F', &f, errorBufferSize, errorBuffer)) ||
+      (hasCodeLetter('I') &&
+       !parseFloat('I', &i, errorBufferSize, errorBuffer)) ||
+      (hasCodeLetter('J') &&
+       !parseFloat('J', &j, errorBufferSize, errorBuffer)) ||
+      ((hasR = hasCodeLetter('R')) &&
+       !parseFloat('R', &r, errorBufferSize, errorBuffer))) {
+    return false;
+  }
+
+  // Helical arcs are not supported
+  snprintf(errorBuffer, errorBufferSize, "%s", Str::INVALID_ARC_ERROR);
+  if (hasCodeLetter('Z') ||
+      hasR == (hasCodeLetter('I') || hasCodeLetter('J'))) {
+    return false;
+  }
+  const XYZEPosition start = context.actionQueue.getEndPosition();
+  const float endX = hasX ? x : *start.x;
+  const float endY = hasY ? y : *start.y;
+  const float endE = hasE ? e : *start.e;
+  if (hasR && !ArcInterpolator::getCenterOffset(*start.x, *start.y, endX,
+                                                endY, r, clockwise, &i, &j)) {
+    return false;
+  }
+
+  // The first point needs a new action, and so does the feedrate
+  const uint8_t numActions = 1 + static_cast<uint8_t>(hasF);
+  if (context.actionQueue.getNumSpacesLeft() < numActions ||
+      (hasE && context.xyePositionQueue.getNumSpacesLeft() == 0)) {
+    snprintf(errorBuffer, errorBufferSize, "%s",
+             Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR);
+    return false;
+  }
+  if (!arc_.begin(*start.x, *start.y, *start.e, endX, endY, endE, i, j,
+                  clockwise)) {
+    return false;
+  }
+  if (hasF) {
+    context.actionQueue.push(context, Action::SetFeedrate(start, f));
+  }
+  arcIsExtruding_ = endE != *start.e;
+  continueArc(context);
+  return true;
+}
+
+void GcodeParser::continueArc(Context &context) {
+  while (arc_.isActive()) {
+    float x, y, e;
+    arc_.getPoint(&x, &y, &e);
+    const Axes::XAxis::GcodePosition xMms(x);
+    const Axes::YAxis::GcodePosition yMms(y);
+    if (arcIsExtruding_) {
+      if (context.xyePositionQueue.getNumSpacesLeft() == 0) {
+        return;
+      }
+      const Axes::EAxis::GcodePosition eMms(e);
+      ActionQueue::Iterator lastAction = context.actionQueue.last();
+      if (lastAction && lastAction->getType() == Action::Type::MOVE_XYE &&
+          lastAction->get<Action::MoveXYE>().checkNewPointDirection(eMms)) {
+        lastAction->get<Action::MoveXYE>().pushPoint(context, &xMms, &yMms,
+                                                     eMms);
+      } else {
+        if (context.actionQueue.getNumSpacesLeft() == 0) {
+          return;
+        }
+        Action::MoveXYE moveXye(context.actionQueue.getEndPosition());
+        moveXye.pushPoint(context, &xMms, &yMms, eMms);
+        if (moveXye.getNumPointsPushed() > 0) {
+          context.actionQueue.push(context, moveXye);
+        }
+      }
+    } else {
+      if (context.actionQueue.getNumSpacesLeft() == 0) {
+        return;
+      }
+      context.actionQueue.push(
+          context,
+          Action::MoveXY(context.actionQueue.getEndPosition(), &xMms, &yMms));
+    }
+    arc_.advance();
+  }
+}
+
+bool GcodeParser::enqueueMove(Context &context, const float *const x,
+                              const float *const y, const float *const z,
+                              const float *const e, const float *const f,
+                              const uint16_t errorBufferSize,
+                              char *const errorBuffer) {
+  const uint64_t startMicros = *context.clock.getMicros();
+  const bool result =
+      pushMoveActions(context, x, y, z, e, f, errorBufferSize, errorBuffer);
+  enqueueMicros_ += *context.clock.getMicros() - startMicros;
+  return result;
+}
+
+bool GcodeParser::pushMoveActions(Context &context, const float *const x,
+                                  const float *const y, const float *const z,
+                                  const float *const e, const float *const f,
+                                  const uint16_t errorBufferSize,
+                                  char *const errorBuffer) {
+  const bool hasX = x, hasY = y, hasZ = z, hasE = e, hasF = f;
+
   // Determine number of action and xyePosition slots to allocate
   uint8_t numActions = static_cast<uint8_t>(hasF) + static_cast<uint8_t>(hasZ) +
                        static_cast<uint8_t>(hasX || hasY || hasZ);
   if (context.actionQueue.getNumSpacesLeft() < numActions ||
-      (hasZ && !context.actionQueue.hasCapacityFor(Action::Type::MOVE_E)) ||
-      (hasE && !context.actionQueue.hasCapacityFor(Action::Type::MOVE_E)) ||
-      (hasF &&
-       !context.actionQueue.hasCapacityFor(Action::Type::SET_FEEDRATE)) ||
-      (((hasX || hasY) && !hasE) &&
-       !context.actionQueue.hasCapacityFor(Action::Type::MOVE_XY)) ||
       (((hasX || hasY) && hasE) &&
-       (!context.actionQueue.hasCapacityFor(Action::Type::MOVE_XYE) ||
-        context.xyePositionQueue.getNumSpacesLeft() == 0))) {
+       context.xyePositionQueue.getNumSpacesLeft() == 0)) {
     snprintf(errorBuffer, errorBufferSize, "%s",
              Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR);
     return false;
@@ -214,28 +800,26 @@ bool GcodeParser::handleG1(Context &context, const uint16_t errorBufferSize,
   // Enqueue actions
   if (hasF) {
     context.actionQueue.push(
-        context, Action::SetFeedrate(context.actionQueue.getEndPosition(), f));
+        context, Action::SetFeedrate(context.actionQueue.getEndPosition(), *f));
   }
   if (hasZ) {
     context.actionQueue.push(
-        context, Action::MoveZ(context.actionQueue.getEndPosition(), z));
+        context, Action::MoveZ(context.actionQueue.getEndPosition(), *z));
   }
   if (hasX || hasY) {
-    Axes::XAxis::GcodePosition xMms(x);
-    Axes::YAxis::GcodePosition yMms(y);
+    Axes::XAxis::GcodePosition xMms(hasX ? *x : 0);
+    Axes::YAxis::GcodePosition yMms(hasY ? *y : 0);
     if (hasE) {
       ActionQueue::Iterator lastAction = context.actionQueue.last();
-      Axes::EAxis::GcodePosition eMms(e);
-      if (lastAction && (*lastAction)->getType() == Action::Type::MOVE_XYE &&
-          static_cast<Action::MoveXYE *>(*lastAction)
-              ->checkNewPointDirection(eMms)) {
+      Axes::EAxis::GcodePosition eMms(*e);
+      if (lastAction && lastAction->getType() == Action::Type::MOVE_XYE &&
+          lastAction->get<Action::MoveXYE>().checkNewPointDirection(eMms)) {
         // If the last action in the queue is MoveXYE and the extrusion
         // destination is in the same direction as the current extrusion,
         // coalesce
         context.serial.writeLine(";Push XYE point");
-        static_cast<Action::MoveXYE *>(*lastAction)
-            ->pushPoint(context, hasX ? &xMms : nullptr, hasY ? &yMms : nullptr,
-                        eMms);
+        lastAction->get<Action::MoveXYE>().pushPoint(
+            context, hasX ? &xMms : nullptr, hasY ? &yMms : nullptr, eMms);
       } else {
         // Otherwise, start a new MoveXYE
         context.serial.writeLine(";Push XYE fresh");
@@ -256,8 +840,35 @@ bool GcodeParser::handleG1(Context &context, const uint16_t errorBufferSize,
   } else if (hasE) {
     context.serial.writeLine(";Push E");
     context.actionQueue.push(
-        context, Action::MoveE(context.actionQueue.getEndPosition(), e));
+        context, Action::MoveE(context.actionQueue.getEndPosition(), *e));
   }
   return true;
 }
+
+bool GcodeParser::handleM110(Context &context, const uint16_t errorBufferSize,
+                             char *const errorBuffer) {
+  // Without an argument, the line number of this line (if any) is kept
+  if (hasCodeLetter('N')) {
+    int32_t lineNumber;
+    if (!parseInt('N', &lineNumber, errorBufferSize, errorBuffer)) {
+      return false;
+    }
+    nextLineNumber_ = lineNumber + 1;
+    resendRequested_ = false;
+  }
+  return true;
+}
+
+bool GcodeParser::handleM880(Context &context, const uint16_t errorBufferSize,
+                             char *const errorBuffer) {
+  // Relative coordinates in binary mode continue from the end of the queue
+  const XYZEPosition endPosition = context.actionQueue.getEndPosition();
+  binaryTargets_[0] = *Axes::XAxis::gcodePositionToStepper(endPosition.x);
+  binaryTargets_[1] = *Axes::YAxis::gcodePositionToStepper(endPosition.y);
+  binaryTargets_[2] = *Axes::ZAxis::gcodePositionToStepper(endPosition.z);
+  binaryTargets_[3] = *Axes::EAxis::gcodePositionToStepper(endPosition.e);
+  binaryMode_ = true;
+  binaryState_ = BinaryState::SYNC;
+  return true;
+}
 }  // namespace Clef::Fw
@@ -1,14 +1,21 @@
 // Copyright 2021 by Daniel Winkelman. All rights reserved.
 
+#pragma once
+
 #include <fw/Action.h>
+#include <fw/Arc.h>
 #include <if/Serial.h>
 #include <stdint.h>
+#include <util/Encoding.h>
 #include <util/Initialized.h>
 
 namespace Clef::Fw {
 namespace Str {
 extern const char
-    *const OK; /*!< The commmand was received and properly enqueued. */
+    *const OK; /*!< The commmand was received and properly enqueued. It is
+                  followed by the free capacity: "P" slots in the action
+                  queue, "Q" slots in the XYE position queue and "B" bytes
+                  in the serial receive buffer. */
 extern const char *const BUFFER_OVERFLOW_ERROR; /*!< The internal buffer in the
                                              G-code parser is full; the current
                                              line is dumped from the buffer. */
@@ -29,6 +36,18 @@ extern const char *const
     MISSING_COMMAND_CODE_ERROR; /*!< Neither a 'G' nor an 'M' code was given. */
 extern const char
     *const INVALID_G_CODE_ERROR; /*!< The requested G-code is not supported. */
+extern const char
+    *const INVALID_M_CODE_ERROR; /*!< The requested M-code is not supported. */
+extern const char
+    *const INVALID_ARC_ERROR; /*!< An arc was given neither or both of I/J and
+                                 R, its radius cannot reach the end, or it
+                                 has a Z move. */
+extern const char
+    *const INVALID_FRAME_ERROR; /*!< A binary frame had a valid checksum but
+                                   its contents could not be decoded. */
+extern const char *const RESEND; /*!< A numbered line was corrupted or out of
+                                    order; the host must send every line from
+                                    the given line number again. */
 extern const char
     *const INSUFFICIENT_QUEUE_CAPACITY_ERROR; /*!< There is not enough space in
                                            the queue to insert all the actions
@@ -37,13 +56,67 @@ extern const char
 
 /**
  * G-code parser. Characters are consumed through the ingest() function and
- * stored in a buffer. When a complete line is collected, it is parsed into
- * "buckets". Once a command type is detected (i.e. G or M code), other
- * arguments are parsed as needed and actions are enqueued for the firmware to
- * process.
+ * tokenized as they arrive, without copying the line: the value of each code
+ * letter is accumulated directly into a fixed-point number, and malformed
+ * values are remembered so that they can be reported if the value is used.
+ * When a complete line is collected, its framing is checked and, once a command
+ * type is detected (i.e. G or M code), other arguments are converted as needed
+ * and actions are enqueued for the firmware to process.
+ *
+ * Arcs (G2 clockwise, G3 counterclockwise) take the center as an offset from
+ * the start (I and J) or a radius (R, negative for more than 180 degrees). They
+ * are split into chords within ARC_TOLERANCE, which are pushed as XYE points
+ * (or XY moves if the arc does not extrude) whenever the queues have room. The
+ * line is acknowledged, and later lines are read, once the whole arc is queued.
+ *
+ * Lines may be framed as "N<line number> <command>*<checksum>", where the
+ * checksum is the XOR of every character before the '*'. Numbered lines must
+ * arrive in order and are acknowledged with "ok N<line number>", so the host
+ * can keep several lines in flight. A corrupted or out-of-order line is
+ * answered with "resend <line number>" and later lines are dropped until the
+ * requested line arrives; a line that is sent again after it was accepted is
+ * acknowledged without being executed. "M110 N<n>" sets the number of the last
+ * accepted line. Unnumbered lines are executed as they arrive.
+ *
+ * "M880" switches to binary mode, in which commands are sent as frames:
+ *
+ *   0xa5, length, body (length bytes), CRC-16/CCITT of length and body (MSB
+ *   first)
+ *
+ * The body starts with the line number as a varint and the frame type. A MOVE
+ * frame (equivalent to G1) continues with a flags byte (BINARY_X_FLAG etc.),
+ * then the target of each flagged axis in microsteps as a zigzag varint, which
+ * is relative to the previous target unless BINARY_ABSOLUTE_FLAG is set, then
+ * the feedrate in mm/min as a varint. A SEGMENT frame is an XY move which was
+ * planned on the host; it continues with flags and targets like a MOVE frame
+ * (only X, Y and BINARY_ABSOLUTE_FLAG are allowed), then the nominal speed and
+ * the maximum junction speed in um/s as varints, so that the firmware neither
+ * parses nor plans it. An ASCII frame switches back to G-code.
+ * Frames follow the same numbering, acknowledgement and resend rules as
+ * numbered lines, and nothing has to be parsed from text. Each frame should be
+ * followed by a '\n', which is ignored between frames, since a receiver that
+ * frames lines as they arrive only passes on complete lines.
  */
 class GcodeParser {
  public:
+  static const uint8_t BINARY_SYNC = 0xa5;
+  enum class FrameType : uint8_t { MOVE = 1, ASCII = 2, SEGMENT = 3 };
+  static const uint8_t BINARY_X_FLAG = 1 << 0;
+  static const uint8_t BINARY_Y_FLAG = 1 << 1;
+  static const uint8_t BINARY_Z_FLAG = 1 << 2;
+  static const uint8_t BINARY_E_FLAG = 1 << 3;
+  static const uint8_t BINARY_F_FLAG = 1 << 4;
+  static const uint8_t BINARY_ABSOLUTE_FLAG = 1 << 7;
+
+  /**
+   * Time spent parsing lines and frames, excluding the time taken to enqueue
+   * the actions they produce.
+   */
+  struct ParseStats {
+    uint32_t numLines;
+    uint32_t micros;
+  };
+
   GcodeParser();
 
   /**
@@ -52,23 +125,108 @@ class GcodeParser {
    */
   void ingest(Context &context);
 
+  /**
+   * Check whether the last line read is still being executed, i.e. an arc is
+   * being queued; later lines are not read until it is done.
+   */
+  bool isBusy() const;
+
+  const ParseStats &getParseStats() const;
+  void resetParseStats();
+
  private:
   /**
-   * Reset the buffer.
+   * Check the framing of a complete line, then parse and execute it.
+   */
+  void processLine(Context &context);
+
+  /**
+   * Advance the binary frame state machine by one byte.
+   */
+  void ingestBinary(Context &context, const uint8_t byte);
+
+  /**
+   * Decode and execute a binary frame whose checksum is valid.
+   */
+  void processFrame(Context &context);
+
+  bool decodeMove(Context &context, Clef::Util::ByteReader *const reader,
+                  const uint16_t errorBufferSize, char *const errorBuffer);
+  bool decodeSegment(Context &context, Clef::Util::ByteReader *const reader,
+                     const uint16_t errorBufferSize, char *const errorBuffer);
+
+  /**
+   * Read the target of every axis flagged in a MOVE or SEGMENT frame; targets
+   * of other axes are left as they were.
+   */
+  bool readTargets(Clef::Util::ByteReader *const reader, const uint8_t flags,
+                   int32_t *const targets) const;
+
+  /**
+   * Compare the number of a line or frame with the next expected one; returns
+   * false if it must not be executed, after acknowledging a duplicate or
+   * requesting a resend.
+   */
+  bool checkLineNumber(Context &context, const int32_t lineNumber,
+                       const bool resetsLineNumber);
+
+  /**
+   * Acknowledge a line that was executed or report its error. A numbered line
+   * which did not fit in the queue is not consumed.
+   */
+  void reportResult(Context &context, const bool success,
+                    const bool hasLineNumber, const int32_t lineNumber,
+                    const char *const errorBuffer);
+
+  /**
+   * Verify the line number and checksum of the tokenized line; returns false if
+   * the line is corrupted.
+   */
+  bool checkFraming(int32_t *const lineNumber, bool *const hasLineNumber) const;
+
+  /**
+   * Acknowledge a line and report how much more the host may send.
    */
-  void reset();
+  void acknowledge(Context &context, const bool hasLineNumber,
+                   const int32_t lineNumber);
 
   /**
-   * Try to add a character to the end of the buffer; returns false if there is
-   * not capacity to do so.
+   * Ask the host to send lines again from the next expected line number, unless
+   * a resend has already been requested.
    */
-  bool append(const char newChar);
+  void requestResend(Context &context);
 
   /**
-   * Break the stored buffer into ranges based on characters; returns false and
-   * writes a string to the supplied error buffer if there was an error.
+   * Advance the tokenizer by one character of a line, excluding the newline;
+   * returns false if the line is too long.
    */
-  bool parse(const uint16_t errorBufferSize, char *const errorBuffer);
+  bool tokenize(const char c);
+
+  /**
+   * Start the word beginning with a code letter.
+   */
+  void startWord(const char code);
+
+  /**
+   * Add a character to the value of the current word.
+   */
+  void accumulate(const char c);
+
+  /**
+   * Complete the value of the current word, if any.
+   */
+  void finishWord();
+
+  /**
+   * Prepare the tokenizer for the next line.
+   */
+  void resetLine();
+
+  /**
+   * Record the first error in the line, which is reported once the line is
+   * complete.
+   */
+  void setTokenError(const char *const error, const char code);
 
   /**
    * Interpret the arguments and perform and action.
@@ -82,15 +240,29 @@ class GcodeParser {
   bool hasCodeLetter(const char code) const;
 
   /**
-   * Interpret an integer from the buffer; returns false and writes a string to
-   * the supplied error buffer if there was an error.
+   * Check whether a code letter exists and was given a value, even if the value
+   * is malformed.
+   */
+  bool hasValue(const char code) const;
+
+  /**
+   * Get the value of a code letter; returns false and writes a string to the
+   * supplied error buffer (if any) if there was no valid value.
+   */
+  bool getNumber(const char code, const char *const invalidError,
+                 int32_t *const mantissa, uint8_t *const decimals,
+                 const uint16_t errorBufferSize, char *const errorBuffer) const;
+
+  /**
+   * Interpret an integer from the tokenized line; returns false and writes a
+   * string to the supplied error buffer if there was an error.
    */
   bool parseInt(const char code, int32_t *const result,
                 const uint16_t errorBufferSize, char *const errorBuffer) const;
 
   /**
-   * Interpret a float from the buffer; returns false and writes a string to the
-   * supplied error buffer if there was an error.
+   * Interpret a float from the tokenized line; returns false and writes a
+   * string to the supplied error buffer if there was an error.
    */
   bool parseFloat(const char code, float *const result,
                   const uint16_t errorBufferSize,
@@ -98,13 +270,87 @@ class GcodeParser {
 
   bool handleG1(Context &context, const uint16_t errorBufferSize,
                 char *const errorBuffer);
+  bool handleG2(Context &context, const bool clockwise,
+                const uint16_t errorBufferSize, char *const errorBuffer);
+  bool handleM110(Context &context, const uint16_t errorBufferSize,
+                  char *const errorBuffer);
+  bool handleM880(Context &context, const uint16_t errorBufferSize,
+                  char *const errorBuffer);
+
+  /**
+   * Enqueue the actions for a G1 move; each argument is nullptr if the axis (or
+   * feedrate) was not given. The time taken is not counted as parse time.
+   */
+  bool enqueueMove(Context &context, const float *const x,
+                   const float *const y, const float *const z,
+                   const float *const e, const float *const f,
+                   const uint16_t errorBufferSize, char *const errorBuffer);
+  /**
+   * Push as many points of the current arc as there is room for in the queues.
+   */
+  void continueArc(Context &context);
+
+  bool pushMoveActions(Context &context, const float *const x,
+                       const float *const y, const float *const z,
+                       const float *const e, const float *const f,
+                       const uint16_t errorBufferSize, char *const errorBuffer);
 
  private:
-  static const uint16_t size_ = 80; /*!< Static size instead of templating. */
-  char buffer_[size_]; /*!< Accumulate characters until a line is complete. */
-  char *head_; /*!< Points at the next available buffer_ char to fill. */
-  const char *buckets_[26]; /*!< Start locations of the contents of every
-                               detected code letter. */
-  bool commentMode_;        /*!< Whether a comment was detected in the line. */
+  static const uint16_t size_ = 80; /*!< Maximum length of a line, excluding
+                                       comments, and of a binary frame. */
+  char buffer_[size_]; /*!< Body of the current binary frame. */
+
+  /**
+   * Value of a code letter as a fixed-point number, mantissa / 10^decimals.
+   */
+  struct Number {
+    int32_t mantissa;
+    uint8_t decimals;
+  };
+  enum class TokenState : uint8_t { SPACE, WORD, CHECKSUM, COMMENT };
+  static const uint8_t LINE_NUMBER_SLOT = 26; /*!< Slot of a leading 'N'. */
+  static const uint8_t NO_SLOT = 0xff;
+  static const uint8_t MAX_DECIMALS = 6; /*!< Further digits are dropped. */
+  TokenState tokenState_;
+  uint8_t lineLength_;       /*!< Characters in the line outside comments. */
+  uint32_t presentSlots_;    /*!< Bit for every code letter in the line. */
+  uint32_t definedSlots_;    /*!< Code letters that were given a value. */
+  uint32_t malformedSlots_;  /*!< Code letters whose value is not a number. */
+  Number numbers_[27];       /*!< Values of the code letters and line number. */
+  uint8_t slot_;             /*!< Slot of the word being tokenized. */
+  uint8_t wordLength_;       /*!< Characters in the value of the word. */
+  bool negative_;            /*!< Whether the value has a '-' sign. */
+  bool hasPoint_;            /*!< Whether the value has a decimal point. */
+  bool hasDigits_;           /*!< Whether the value has any digits. */
+  const char *tokenError_;   /*!< First error in the line, or nullptr. */
+  char tokenErrorCode_;      /*!< Code letter the error refers to. */
+  uint8_t checksum_;         /*!< XOR of the characters before the '*'. */
+  bool hasChecksum_;         /*!< Whether a '*' was found. */
+  int16_t expectedChecksum_; /*!< Value after the '*', or -1 if invalid. */
+
+  ArcInterpolator arc_;
+  bool arcIsExtruding_;     /*!< Whether the arc is made of XYE points rather
+                               than XY moves. */
+  bool arcHasLineNumber_;   /*!< Numbering of the line with the arc, which is
+                               acknowledged once the whole arc is queued. */
+  int32_t arcLineNumber_;
+
+  ParseStats parseStats_;
+  uint32_t enqueueMicros_; /*!< Time spent enqueueing actions during the
+                              current call to ingest(). */
+
+  int32_t nextLineNumber_;  /*!< Number of the next numbered line to accept. */
+  bool resendRequested_;    /*!< Whether numbered lines are being dropped until
+                               nextLineNumber_ is sent again. */
+
+  enum class BinaryState : uint8_t { SYNC, LENGTH, BODY, CRC_HIGH, CRC_LOW };
+  bool binaryMode_;
+  BinaryState binaryState_;
+  uint8_t binaryLength_;   /*!< Length of the body of the current frame. */
+  uint8_t binaryReceived_; /*!< Bytes of the body received so far. */
+  uint16_t binaryCrc_;     /*!< CRC of the frame received so far. */
+  uint16_t binaryExpectedCrc_;
+  int32_t binaryTargets_[4]; /*!< Last target of each axis in usteps, which
+                                relative coordinates are added to. */
 };
 }  // namespace Clef::Fw
@@ -3,127 +3,546 @@
 #pragma once
 
 #include <if/Memory.h>
+#include <math.h>
 #include <string.h>
 #include <util/Matrix.h>
 
 namespace Clef::Fw {
-template <uint16_t Xsize, uint16_t Usize, uint16_t Zsize>
+/**
+ * Filters work in floats unless E is another element type, such as a
+ * Clef::Util::Fixed for a target without an FPU.
+ */
+template <uint16_t Xsize, uint16_t Usize, uint16_t Zsize, typename E = float>
 class KalmanFilter {
  public:
-  using XVector = Clef::Util::RamMatrix<Xsize, 1>;
-  using UVector = Clef::Util::RamMatrix<Usize, 1>;
-  using ZVector = Clef::Util::RamMatrix<Zsize, 1>;
+  using Scalar = E;
+  using XVector = Clef::Util::RamMatrix<Xsize, 1, E>;
+  using UVector = Clef::Util::RamMatrix<Usize, 1, E>;
+  using ZVector = Clef::Util::RamMatrix<Zsize, 1, E>;
 
   virtual void evolve(const UVector &uk, const ZVector &zk,
-                      const float deltat) = 0;
+                      const E deltat) = 0;
   virtual const XVector &getState() const = 0;
 };
 
-template <uint16_t Xsize, uint16_t Usize, uint16_t Zsize>
-class ExtendedKalmanFilter : public KalmanFilter<Xsize, Usize, Zsize> {
+/**
+ * What an ExtendedKalmanFilter keeps to freeze its gain; nothing unless the
+ * filter is built with SteadyState.
+ */
+template <uint16_t Xsize, uint16_t Zsize, typename E, bool Enabled>
+struct SteadyStateGain {
+  E tolerance;
+  E innovationGate;
+  uint16_t numSamples; /*!< 0 if the gain is never frozen. */
+  uint16_t numConvergedSamples;
+  bool isFrozen;
+  bool useFrozen;  /*!< Whether the evolution in progress is frozen. */
+  bool hasChanged; /*!< Since the start of the evolution in progress. */
+  E memKss[Zsize * Xsize]; /*!< Gain of each observation, row by row. */
+  E memS[Zsize];           /*!< Innovation variance of each observation. */
+  E memGate[Zsize];        /*!< Largest innovation for the frozen gain. */
+};
+
+template <uint16_t Xsize, uint16_t Zsize, typename E>
+struct SteadyStateGain<Xsize, Zsize, E, false> {};
+
+/**
+ * A filter built with SteadyState can freeze its gain once it has converged
+ * (see setSteadyState()); otherwise, it keeps none of the state for it.
+ */
+template <uint16_t Xsize, uint16_t Usize, uint16_t Zsize, typename E = float,
+          bool SteadyState = false>
+class ExtendedKalmanFilter : public KalmanFilter<Xsize, Usize, Zsize, E> {
  public:
-  using XVector = Clef::Util::RamMatrix<Xsize, 1>;
-  using UVector = Clef::Util::RamMatrix<Usize, 1>;
-  using ZVector = Clef::Util::RamMatrix<Zsize, 1>;
-  using PMatrix = Clef::Util::RamMatrix<Xsize, Xsize>;
-  using FMatrix = Clef::Util::RamMatrix<Xsize, Xsize>;
-  using QMatrix = Clef::If::RomDiagonalMatrix<Xsize>;
-  using WxMatrix = Clef::If::RomDiagonalMatrix<Xsize>;
-  using HMatrix = Clef::Util::RamMatrix<Zsize, Xsize>;
-  using RMatrix = Clef::If::RomDiagonalMatrix<Zsize>;
-
-  ExtendedKalmanFilter(QMatrix &Q, RMatrix &R, WxMatrix &Wx)
-      : x_(memX_), P_(memP_), Q_(Q), R_(R), Wx_(Wx) {
-    memset(memX_, 0, sizeof(memX_));
-    memset(memP_, 0, sizeof(memP_));
+  using Scalar = E;
+  using XVector = Clef::Util::RamMatrix<Xsize, 1, E>;
+  using UVector = Clef::Util::RamMatrix<Usize, 1, E>;
+  using ZVector = Clef::Util::RamMatrix<Zsize, 1, E>;
+  using PMatrix = Clef::Util::SymmetricRamMatrix<Xsize, E>;
+  using FMatrix = Clef::Util::RamMatrix<Xsize, Xsize, E>;
+  using QMatrix = Clef::If::RomDiagonalMatrix<Xsize, E>;
+  using WxMatrix = Clef::If::RomDiagonalMatrix<Xsize, E>;
+  using HMatrix = Clef::Util::RamMatrix<Zsize, Xsize, E>;
+  using RMatrix = Clef::If::RomDiagonalMatrix<Zsize, E>;
+  using StaticPMatrix = Clef::Util::StaticSymmetricMatrix<Xsize, E>;
+  using StaticXVector = Clef::Util::StaticRamMatrix<Xsize, 1, E>;
+  using StaticXXMatrix = Clef::Util::StaticRamMatrix<Xsize, Xsize, E>;
+  using StaticZXMatrix = Clef::Util::StaticRamMatrix<Zsize, Xsize, E>;
+
+  static constexpr uint8_t ALL_OBSERVATIONS = (1 << Zsize) - 1;
+
+  ExtendedKalmanFilter(const QMatrix &Q, const RMatrix &R,
+                       const WxMatrix &Wx)
+      : memX_(),
+        memP_(),
+        x_(memX_),
+        P_(memP_),
+        Q_(Q),
+        R_(R),
+        Wx_(Wx),
+        deltat_(0),
+        SkInv_(0),
+        observed_(0),
+        stage_(Stage::IDLE),
+        observation_(0),
+        gain_() {
+    static_assert(Zsize <= 8);
   }
 
   virtual void init() = 0;
 
   void evolve(const UVector &uk, const ZVector &zk,
-              const float deltat) override {
-    float scratch1[Xsize * Xsize], scratch2[Xsize * Xsize];
-
-    float xintMem[Xsize];
-    XVector xint(xintMem);
-    calculateStateTrans(this->x_, uk, deltat, xint);
-
-    float hxintMem[Zsize], ykMem[Zsize];
-    ZVector hxint(hxintMem);
-    ZVector yk(ykMem);
-    calculateObservationTrans(xint, hxint);
-    Clef::Util::Matrix::sub(zk, hxint, yk);
-
-    float HkMem[Zsize * Xsize];
-    HMatrix Hk(HkMem);
-    calculateObserationTransGradient(xint, Hk);
-
-    float PminusMem[Xsize * Xsize];
-    FMatrix Fk(PminusMem);
-    typename FMatrix::Transpose FkT = Fk.transpose();
-    PMatrix FkP(scratch1);
-    PMatrix FkPFkT(scratch2);
-    PMatrix Pminus(PminusMem);
-    calculateStateTransGradient(this->x_, uk, deltat, Fk);
-    Clef::Util::Matrix::dot(Fk, this->P_, FkP);
-    Clef::Util::Matrix::dot(FkP, FkT, FkPFkT);
-    Clef::Util::Matrix::add(FkPFkT, this->Q_, Pminus);
-
-    float KkMem[Xsize * Zsize];
-    typename HMatrix::Transpose HkT = Hk.transpose();
-    Clef::Util::RamMatrix<Xsize, Zsize> PminusHkT(scratch1);
-    Clef::Util::RamMatrix<Zsize, Zsize> HkPminusHkT(scratch2);
-    Clef::Util::RamMatrix<Zsize, Zsize> Sk(KkMem);
-    Clef::Util::RamMatrix<Zsize, Zsize> Skinv(scratch2);
-    Clef::Util::RamMatrix<Xsize, Zsize> Kk(KkMem);
-    Clef::Util::Matrix::dot(Pminus, HkT, PminusHkT);
-    Clef::Util::Matrix::dot(Hk, PminusHkT, HkPminusHkT);
-    Clef::Util::Matrix::add(HkPminusHkT, this->R_, Sk);
-    Clef::Util::Matrix::inverse(Sk, Skinv);
-    Clef::Util::Matrix::dot(PminusHkT, Skinv, Kk);
-
-    Clef::Util::RamMatrix<Xsize, Zsize> WxKk(scratch1);
-    XVector WxKkyk(scratch2);
-    Clef::Util::Matrix::dot(this->Wx_, Kk, WxKk);
-    Clef::Util::Matrix::dot(WxKk, yk, WxKkyk);
-    Clef::Util::Matrix::add(xint, WxKkyk, this->x_);
-
-    PMatrix KkHk(scratch1);
-    PMatrix eyeKkHk(scratch2);
-    PMatrix Pplus(scratch1);
-    PMatrix deltaP(scratch2);
-    PMatrix deltaPWx(PminusMem);
-    PMatrix WxdeltaPWx(scratch2);
-    Clef::Util::Matrix::dot(Kk, Hk, KkHk);
-    Clef::Util::Matrix::sub(Clef::Util::IdentityMatrix<Xsize>(), KkHk, eyeKkHk);
-    Clef::Util::Matrix::dot(eyeKkHk, Pminus, Pplus);
-    Clef::Util::Matrix::sub(Pminus, Pplus, deltaP);
-    Clef::Util::Matrix::dot(deltaP, this->Wx_, deltaPWx);
-    Clef::Util::Matrix::dot(this->Wx_, deltaPWx, WxdeltaPWx);
-    Clef::Util::Matrix::add(WxdeltaPWx, Pplus, this->P_);
+              const E deltat) override {
+    evolve(uk, zk, deltat, ALL_OBSERVATIONS);
+  }
+
+  /**
+   * Evolve using only the observations whose bits (1 << i for observation i)
+   * are set in observed; the rest of zk is ignored, so a sensor which has no
+   * new data can be left out. This runs every stage of begin() at once.
+   */
+  void evolve(const UVector &uk, const ZVector &zk, const E deltat,
+              const uint8_t observed) {
+    begin(uk, zk, deltat, observed);
+    while (!advance()) {
+    }
+  }
+
+  /**
+   * Start an evolution which is carried out a stage at a time by advance(),
+   * so that a caller with other work to do can spread it out. The inputs are
+   * copied, and the state only changes when the last stage finishes, so
+   * getState() gives the previous estimate until then. An evolution which is
+   * still running is abandoned.
+   *
+   * The model functions fill RamMatrix arguments, but all of the arithmetic
+   * is done on statically dispatched views of the same storage. The
+   * covariance is symmetric, so only its upper triangle is stored and
+   * propagated. Since R is diagonal, the observations are independent, and
+   * they are applied one scalar at a time; the innovation covariance is then
+   * a scalar and no matrix is inverted. The scalar updates are unweighted,
+   * which gives the joint update; the weights Wx are applied once to its
+   * correction at the end, as in
+   *   x = xint + Wx * K * y, P = Wx * (Pminus - Pplus) * Wx + Pplus
+   */
+  void begin(const UVector &uk, const ZVector &zk, const E deltat,
+             const uint8_t observed = ALL_OBSERVATIONS) {
+    memcpy(memU(), uk.getData(), Usize * sizeof(E));
+    memcpy(memZ(), zk.getData(), Zsize * sizeof(E));
+    deltat_ = deltat;
+    observed_ = observed;
+    if constexpr (SteadyState) {
+      gain_.hasChanged = false;
+    }
+    stage_ = Stage::PREDICT;
+  }
+
+  /**
+   * Run the next stage of the evolution started by begin(); returns true once
+   * the evolution is finished (or if there is none). The stages are, in
+   * order: predict the state, propagate the covariance, for each
+   * observation, calculate the gain and update the covariance, and then
+   * weight the correction.
+   */
+  bool advance() {
+    switch (stage_) {
+      case Stage::PREDICT:
+        predictState();
+        if constexpr (SteadyState) {
+          if (gain_.useFrozen) {
+            memcpy(memXNext(), memXint(), Xsize * sizeof(E));
+            observation_ = 0;
+            return nextObservation();
+          }
+        }
+        stage_ = Stage::PROPAGATE;
+        return false;
+      case Stage::PROPAGATE:
+        propagateCovariance();
+        observation_ = 0;
+        return nextObservation();
+      case Stage::GAIN:
+        if constexpr (SteadyState) {
+          if (gain_.useFrozen) {
+            applyFrozenGain();
+            ++observation_;
+            return nextObservation();
+          }
+        }
+        calculateGain();
+        stage_ = Stage::UPDATE;
+        return false;
+      case Stage::UPDATE:
+        updateCovariance();
+        ++observation_;
+        return nextObservation();
+      case Stage::WEIGHT:
+        return finish();
+      default:
+        return true;
+    }
+  }
+
+  bool isEvolving() const { return stage_ != Stage::IDLE; }
+
+  /**
+   * Abandon the evolution in progress, if any, leaving the state as it was.
+   */
+  void cancel() { stage_ = Stage::IDLE; }
+
+  /**
+   * Add delta to state variable i (as stored, i.e. scaled), such as to move
+   * the origin of a position. Only between evolutions.
+   */
+  void offsetState(const uint16_t i, const E delta) {
+    x_.set(i, 0, x_.get(i, 0) + delta);
+  }
+
+  /**
+   * Freeze the gain once it has converged, after which an evolution only
+   * corrects the state with the frozen gain, in O(Xsize * Zsize), and the
+   * covariance is left as it was. The gain has converged when, for
+   * numSamples evolutions in a row, no element of it has changed by more
+   * than tolerance times its largest element. Only evolutions with every
+   * observation count, since the gain of a partial evolution is different.
+   *
+   * The gain is thawed, and full evolutions resume from the covariance at the
+   * time it was frozen, when the innovation of any observation (taken before
+   * the update) is more than innovationGate standard deviations; evolutions
+   * with only some of the observations are always full. A numSamples of 0
+   * (the default) never freezes the gain.
+   */
+  void setSteadyState(const E tolerance, const uint16_t numSamples,
+                      const E innovationGate) {
+    static_assert(SteadyState, "The filter is built without SteadyState");
+    gain_.tolerance = tolerance;
+    gain_.numSamples = numSamples;
+    gain_.innovationGate = innovationGate;
+    resetGain();
+  }
+
+  /**
+   * Go back to full evolutions and wait for the gain to converge again. This
+   * should be done whenever the filter is initialized.
+   */
+  void resetGain() {
+    if constexpr (SteadyState) {
+      gain_.isFrozen = false;
+      gain_.numConvergedSamples = 0;
+    }
+  }
+
+  bool isGainFrozen() const {
+    if constexpr (SteadyState) {
+      return gain_.isFrozen;
+    }
+    return false;
   }
 
   const XVector &getState() const override { return x_; }
+  const PMatrix &getCovariance() const { return P_; }
+
+  /**
+   * The observations that the current state predicts, h(x).
+   */
+  void getObservation(ZVector &output) const {
+    calculateObservationTrans(x_, output);
+  }
 
  protected:
   virtual void calculateStateTrans(const XVector &xk, const UVector &uk,
-                                   const float deltat,
+                                   const E deltat,
                                    XVector &output) const = 0;
   virtual void calculateStateTransGradient(const XVector &xk, const UVector &uk,
-                                           const float deltat,
+                                           const E deltat,
                                            FMatrix &output) const = 0;
   virtual void calculateObservationTrans(const XVector &xk,
                                          ZVector &output) const = 0;
   virtual void calculateObserationTransGradient(const XVector &xk,
                                                 HMatrix &output) const = 0;
 
-  float memX_[Xsize];
-  float memP_[Xsize * Xsize];
+  /**
+   * Calculate Fk * P * Fk^T, using FkP for the intermediate product; output
+   * may be P, which is only read before output is written. Filters whose
+   * Jacobians are mostly zeros can override this (and
+   * calculateObservationCovariance) to skip the zeros; the sums must be taken
+   * in the same order as here so that the results do not change.
+   */
+  virtual void predictCovariance(const StaticXXMatrix &Fk,
+                                 const StaticPMatrix &P, StaticXXMatrix &FkP,
+                                 StaticPMatrix &output) const {
+    Clef::Util::Matrix::dot(Fk, P, FkP);
+    Clef::Util::Matrix::dotSymmetric(FkP, Fk.transpose(), output);
+  }
+
+  /**
+   * Calculate P * h^T for the row h of Hk which belongs to observation i, and
+   * return h * P * h^T.
+   */
+  virtual E calculateObservationCovariance(const StaticZXMatrix &Hk,
+                                           const StaticPMatrix &P,
+                                           const uint16_t i,
+                                           StaticXVector &PhT) const {
+    for (uint16_t r = 0; r < Xsize; ++r) {
+      E sum = 0;
+      for (uint16_t j = 0; j < Xsize; ++j) {
+        sum += P.get(r, j) * Hk.get(i, j);
+      }
+      PhT.set(r, 0, sum);
+    }
+    E hPhT = 0;
+    for (uint16_t j = 0; j < Xsize; ++j) {
+      hPhT += Hk.get(i, j) * PhT.get(j, 0);
+    }
+    return hPhT;
+  }
+
+  E memX_[Xsize];
+  E memP_[PMatrix::size];
 
   XVector x_;
   PMatrix P_;
   QMatrix Q_;
   RMatrix R_;
   WxMatrix Wx_;
+
+ private:
+  enum class Stage : uint8_t {
+    IDLE,
+    PREDICT,
+    PROPAGATE,
+    GAIN,
+    UPDATE,
+    WEIGHT
+  };
+
+  static E magnitude(const E value) { return value < E(0) ? -value : value; }
+
+  /**
+   * xint = f(x, u), and h(xint) and its Jacobian about xint.
+   */
+  void predictState() {
+    XVector xintRam(memXint());
+    calculateStateTrans(x_, UVector(memU()), deltat_, xintRam);
+    ZVector hxintRam(memHxint());
+    calculateObservationTrans(xintRam, hxintRam);
+    HMatrix HkRam(memHk());
+    calculateObserationTransGradient(xintRam, HkRam);
+
+    if constexpr (SteadyState) {
+      gain_.useFrozen = gain_.isFrozen && observed_ == ALL_OBSERVATIONS;
+      for (uint16_t i = 0; gain_.useFrozen && i < Zsize; ++i) {
+        const E yk = memZ()[i] - memHxint()[i];
+        if (magnitude(yk) > gain_.memGate[i]) {
+          resetGain();
+          gain_.useFrozen = false;
+        }
+      }
+    }
+  }
+
+  /**
+   * P = Fk * P * Fk^T + Q, with Fk taken about the previous state. The
+   * prediction overwrites P, and Q only changes the diagonal.
+   */
+  void propagateCovariance() {
+    StaticPMatrix P(memP_);
+    E FkMem[Xsize * Xsize], FkPMem[Xsize * Xsize];
+    FMatrix FkRam(FkMem);
+    calculateStateTransGradient(x_, UVector(memU()), deltat_, FkRam);
+    const StaticXXMatrix Fk(FkMem);
+    StaticXXMatrix FkP(FkPMem);
+    predictCovariance(Fk, P, FkP, P);
+    for (uint16_t i = 0; i < Xsize; ++i) {
+      P.set(i, i, P.get(i, i) + Q_.getDiagonal(i));
+    }
+    memcpy(memPminus(), memP_, sizeof(memP_));
+    memcpy(memXNext(), memXint(), Xsize * sizeof(E));
+  }
+
+  /**
+   * Skip to the next observation which is used, or go on to weighting the
+   * correction if there are none left.
+   */
+  bool nextObservation() {
+    while (observation_ < Zsize && !(observed_ & (1 << observation_))) {
+      ++observation_;
+    }
+    stage_ = observation_ < Zsize ? Stage::GAIN : Stage::WEIGHT;
+    return false;
+  }
+
+  /**
+   * Weight the correction of the state and covariance made by the
+   * observations, and finish the evolution:
+   *   x = xint + Wx * (xNext - xint)
+   *   P = Wx * (Pminus - Pplus) * Wx + Pplus
+   * A frozen gain leaves the covariance as it was.
+   */
+  bool finish() {
+    StaticXVector x(memXNext());
+    const StaticXVector xint(memXint());
+    for (uint16_t r = 0; r < Xsize; ++r) {
+      x.set(r, 0,
+            xint.get(r, 0) +
+                Wx_.getDiagonal(r) * (x.get(r, 0) - xint.get(r, 0)));
+    }
+    bool isFrozen = false;
+    if constexpr (SteadyState) {
+      isFrozen = gain_.useFrozen;
+    }
+    if (!isFrozen) {
+      StaticPMatrix P(memP_);
+      const StaticPMatrix Pminus(memPminus());
+      for (uint16_t r = 0; r < Xsize; ++r) {
+        for (uint16_t c = r; c < Xsize; ++c) {
+          const E deltaP = Pminus.get(r, c) - P.get(r, c);
+          P.set(r, c,
+                Wx_.getDiagonal(r) * deltaP * Wx_.getDiagonal(c) +
+                    P.get(r, c));
+        }
+      }
+    }
+    memcpy(memX_, memXNext(), sizeof(memX_));
+    stage_ = Stage::IDLE;
+
+    if constexpr (SteadyState) {
+      if (!gain_.useFrozen && gain_.numSamples > 0 &&
+          observed_ == ALL_OBSERVATIONS) {
+        gain_.numConvergedSamples =
+            gain_.hasChanged ? 0 : gain_.numConvergedSamples + 1;
+        if (gain_.numConvergedSamples >= gain_.numSamples) {
+          for (uint16_t i = 0; i < Zsize; ++i) {
+            gain_.memGate[i] = gain_.innovationGate * sqrt(gain_.memS[i]);
+          }
+          gain_.isFrozen = true;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Calculate the gain for the current observation and apply it to the
+   * estimate so far. The innovation is taken against that estimate, with h
+   * linearized about xint. The gain is K = P * h^T / Sk, so only P * h^T and
+   * 1 / Sk are kept for the update of the covariance.
+   */
+  void calculateGain() {
+    const uint16_t i = observation_;
+    StaticXVector x(memXNext());
+    const StaticXVector xint(memXint());
+    const StaticZXMatrix Hk(memHk());
+    const StaticPMatrix P(memP_);
+    StaticXVector PhT(memPhT());
+
+    E yk = memZ()[i] - memHxint()[i];
+    for (uint16_t j = 0; j < Xsize; ++j) {
+      yk -= Hk.get(i, j) * (x.get(j, 0) - xint.get(j, 0));
+    }
+    const E Sk =
+        calculateObservationCovariance(Hk, P, i, PhT) + R_.getDiagonal(i);
+    SkInv_ = E(1) / Sk;
+    for (uint16_t r = 0; r < Xsize; ++r) {
+      x.set(r, 0, x.get(r, 0) + (PhT.get(r, 0) * SkInv_) * yk);
+    }
+
+    // Keep the gain of full evolutions to see whether it has converged
+    if constexpr (SteadyState) {
+      if (gain_.numSamples > 0 && observed_ == ALL_OBSERVATIONS) {
+        E *const KssRow = gain_.memKss + i * Xsize;
+        E maxDelta = 0, maxK = 0;
+        for (uint16_t r = 0; r < Xsize; ++r) {
+          const E K = PhT.get(r, 0) * SkInv_;
+          const E delta = magnitude(K - KssRow[r]);
+          if (delta > maxDelta) {
+            maxDelta = delta;
+          }
+          if (magnitude(K) > maxK) {
+            maxK = magnitude(K);
+          }
+          KssRow[r] = K;
+        }
+        if (maxDelta > gain_.tolerance * maxK) {
+          gain_.hasChanged = true;
+        }
+        gain_.memS[i] = Sk;
+      }
+    }
+  }
+
+  /**
+   * Correct the estimate so far for the current observation with the frozen
+   * gain.
+   */
+  void applyFrozenGain() {
+    const uint16_t i = observation_;
+    StaticXVector x(memXNext());
+    const StaticXVector xint(memXint());
+    const StaticZXMatrix Hk(memHk());
+    const E *const KssRow = gain_.memKss + i * Xsize;
+
+    E yk = memZ()[i] - memHxint()[i];
+    for (uint16_t j = 0; j < Xsize; ++j) {
+      yk -= Hk.get(i, j) * (x.get(j, 0) - xint.get(j, 0));
+    }
+    for (uint16_t r = 0; r < Xsize; ++r) {
+      x.set(r, 0, x.get(r, 0) + KssRow[r] * yk);
+    }
+  }
+
+  /**
+   * Since P is symmetric, h * P = (P * h^T)^T, so
+   *   Pplus = (I - K * h) * P = P - K * (P * h^T)^T
+   * only needs the upper triangle of K * (P * h^T)^T.
+   */
+  void updateCovariance() {
+    StaticPMatrix P(memP_);
+    const StaticXVector PhT(memPhT());
+    for (uint16_t r = 0; r < Xsize; ++r) {
+      const E K = PhT.get(r, 0) * SkInv_;
+      for (uint16_t c = r; c < Xsize; ++c) {
+        P.set(r, c, P.get(r, c) - K * PhT.get(c, 0));
+      }
+    }
+  }
+
+  /**
+   * The inputs and intermediate results of the evolution in progress share
+   * one scratch area. u is only needed until the covariance is propagated
+   * and P * h^T only after, so they overlap. Pminus is the covariance before
+   * the observations, for weighting their correction.
+   */
+  static constexpr uint16_t SCRATCH_Z = 0;
+  static constexpr uint16_t SCRATCH_XINT = SCRATCH_Z + Zsize; /*!< f(x, u). */
+  static constexpr uint16_t SCRATCH_XNEXT =
+      SCRATCH_XINT + Xsize; /*!< Estimate so far; becomes x at the end. */
+  static constexpr uint16_t SCRATCH_HXINT =
+      SCRATCH_XNEXT + Xsize; /*!< h(xint). */
+  static constexpr uint16_t SCRATCH_HK = SCRATCH_HXINT + Zsize;
+  static constexpr uint16_t SCRATCH_U = SCRATCH_HK + Zsize * Xsize;
+  static constexpr uint16_t SCRATCH_PHT = SCRATCH_U;
+  static constexpr uint16_t SCRATCH_PMINUS =
+      SCRATCH_U + (Usize > Xsize ? Usize : Xsize);
+  static constexpr uint16_t SCRATCH_SIZE = SCRATCH_PMINUS + PMatrix::size;
+
+  E *memU() { return memScratch_ + SCRATCH_U; }
+  E *memZ() { return memScratch_ + SCRATCH_Z; }
+  E *memXint() { return memScratch_ + SCRATCH_XINT; }
+  E *memXNext() { return memScratch_ + SCRATCH_XNEXT; }
+  E *memHxint() { return memScratch_ + SCRATCH_HXINT; }
+  E *memHk() { return memScratch_ + SCRATCH_HK; }
+  E *memPhT() { return memScratch_ + SCRATCH_PHT; }
+  E *memPminus() { return memScratch_ + SCRATCH_PMINUS; }
+
+  E memScratch_[SCRATCH_SIZE];
+  E deltat_;
+  E SkInv_; /*!< 1 / Sk of the current observation. */
+  uint8_t observed_;
+
+  Stage stage_;
+  uint16_t observation_;
+
+  SteadyStateGain<Xsize, Zsize, E, SteadyState> gain_;
 };
 }  // namespace Clef::Fw
@@ -0,0 +1,67 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Clef::Fw::KalmanTuning {
+/**
+ * Parameters of a variable of a model, as in a ProcessVariable of kalman.py.
+ * Observation variables only use noise, and control variables none.
+ */
+struct Variable {
+  const char *name;
+  double initialValue;
+  double initialCovariance;
+  double noise;
+  double updateWeight;
+};
+
+/**
+ * Cost of the RMS difference between an output of the filter and an input,
+ * relative to the average magnitude of the input (addErrorMetric()).
+ */
+struct ErrorMetric {
+  const char *reference; /*!< Name of the input. */
+  const char *output;    /*!< Name of the state or observation variable. */
+  double weight;
+};
+
+/**
+ * Cost of the RMS difference between an output and a moving average of it,
+ * relative to the RMS of the output (addSmoothnessMetric()).
+ */
+struct SmoothnessMetric {
+  const char *output;
+  double weight;
+  double filterCoef; /*!< The average is over 1 / filterCoef samples. */
+};
+
+/**
+ * Cost of the RMS of the negative part of an output, relative to the RMS of
+ * the output (addNegativityMetric()).
+ */
+struct NegativityMetric {
+  const char *output;
+  double weight;
+};
+
+/**
+ * Everything that `kalman.py optimize` knows about a model, for tuning the
+ * generated filter on the host. Variables are in the order of the filter.
+ */
+struct Spec {
+  const Variable *xvars;
+  uint16_t numXvars;
+  const Variable *zvars;
+  uint16_t numZvars;
+  const Variable *uvars;
+  uint16_t numUvars;
+  const ErrorMetric *errorMetrics;
+  uint16_t numErrorMetrics;
+  const SmoothnessMetric *smoothnessMetrics;
+  uint16_t numSmoothnessMetrics;
+  const NegativityMetric *negativityMetrics;
+  uint16_t numNegativityMetrics;
+};
+}  // namespace Clef::Fw::KalmanTuning
@@ -0,0 +1,28 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "LoopTimer.h"
+
+namespace Clef::Fw {
+LoopTimer::LoopTimer(Clef::If::Clock &clock)
+    : clock_(clock), lapMicros_(0), isStarted_(false), loopStats_({0, 0, 0}) {}
+
+void LoopTimer::lap() {
+  const uint64_t micros = *clock_.getMicros();
+  if (isStarted_) {
+    const uint32_t lapMicros = micros - lapMicros_;
+    loopStats_.numIterations++;
+    loopStats_.totalMicros += lapMicros;
+    if (lapMicros > loopStats_.maxMicros) {
+      loopStats_.maxMicros = lapMicros;
+    }
+  }
+  lapMicros_ = micros;
+  isStarted_ = true;
+}
+
+const LoopTimer::LoopStats &LoopTimer::getLoopStats() const {
+  return loopStats_;
+}
+
+void LoopTimer::resetLoopStats() { loopStats_ = {0, 0, 0}; }
+}  // namespace Clef::Fw
@@ -0,0 +1,40 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <if/Clock.h>
+#include <stdint.h>
+
+namespace Clef::Fw {
+/**
+ * Measure how long each iteration of the main event loop takes. Anything that
+ * holds up one iteration also holds up serial input and the completion of
+ * actions, so the longest iteration is the worst-case latency of the
+ * firmware.
+ */
+class LoopTimer {
+ public:
+  struct LoopStats {
+    uint32_t numIterations;
+    uint32_t maxMicros;   /*!< Longest iteration. */
+    uint32_t totalMicros; /*!< Time spent in all iterations. */
+  };
+
+  LoopTimer(Clef::If::Clock &clock);
+
+  /**
+   * Mark the end of one iteration and the start of the next; the first call
+   * only starts the timer.
+   */
+  void lap();
+
+  const LoopStats &getLoopStats() const;
+  void resetLoopStats();
+
+ private:
+  Clef::If::Clock &clock_;
+  uint64_t lapMicros_;
+  bool isStarted_;
+  LoopStats loopStats_;
+};
+}  // namespace Clef::Fw
@@ -0,0 +1,187 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "Planner.h"
+
+#include <fw/Action.h>
+#include <math.h>
+
+namespace Clef::Fw {
+namespace {
+float min(const float a, const float b) { return a < b ? a : b; }
+
+/**
+ * Highest speed that can be reached (or, going backwards, from which the
+ * toolhead can come down to the given speed) over a distance.
+ */
+float getReachableSpeed(const float speed, const float acceleration,
+                        const float distance) {
+  return sqrt(speed * speed + 2 * acceleration * distance);
+}
+
+/**
+ * List the profiles of queued XY segments in order. Feedrate changes do not
+ * interrupt motion so they are skipped, but every other kind of action (or a
+ * degenerate XY segment) is listed as nullptr since motion stops there.
+ */
+uint16_t collectProfiles(ActionQueue &actionQueue, MotionProfile **profiles) {
+  uint16_t numProfiles = 0;
+  ActionQueue::Iterator it = actionQueue.first();
+  for (uint16_t i = 0; i < actionQueue.size(); ++i) {
+    if (i > 0) {
+      it = it.next();
+    }
+    switch (it->getType()) {
+      case Action::Type::MOVE_XY: {
+        MotionProfile &profile = it->get<Action::MoveXY>().getProfile();
+        profiles[numProfiles++] = profile.length > 0.0f ? &profile : nullptr;
+        break;
+      }
+      case Action::Type::SET_FEEDRATE:
+        break;
+      default:
+        profiles[numProfiles++] = nullptr;
+        break;
+    }
+  }
+  return numProfiles;
+}
+}  // namespace
+
+bool MotionProfile::setGeometry(const XYEPosition &startPosition,
+                                const XYEPosition &endPosition) {
+  const XYEPosition difference = endPosition - startPosition;
+  length = difference.getXyMagnitude();
+  if (length <= 0.0f) {
+    return false;
+  }
+  unitX = *difference.x / length;
+  unitY = *difference.y / length;
+
+  // The path acceleration is limited by whichever axis saturates first
+  acceleration = INFINITY;
+  if (unitX != 0.0f) {
+    acceleration = min(acceleration, MAX_ACCEL_X / fabs(unitX));
+  }
+  if (unitY != 0.0f) {
+    acceleration = min(acceleration, MAX_ACCEL_Y / fabs(unitY));
+  }
+  return true;
+}
+
+float MotionProfile::getSpeedAt(const float distance) const {
+  const float d =
+      distance < 0.0f ? 0.0f : distance > length ? length : distance;
+  float speed = nominalSpeed;
+  speed = min(speed, getReachableSpeed(entrySpeed, acceleration, d));
+  speed = min(speed, getReachableSpeed(exitSpeed, acceleration, length - d));
+  return speed < MIN_PLANNER_SPEED ? MIN_PLANNER_SPEED : speed;
+}
+
+float MotionProfile::getDuration() const {
+  if (length <= 0.0f) {
+    return 0.0f;
+  }
+  float peakSpeed = nominalSpeed;
+  const float accelDistance =
+      (peakSpeed * peakSpeed - entrySpeed * entrySpeed) / (2 * acceleration);
+  const float decelDistance =
+      (peakSpeed * peakSpeed - exitSpeed * exitSpeed) / (2 * acceleration);
+  float cruiseDistance = length - accelDistance - decelDistance;
+  if (cruiseDistance < 0.0f) {
+    // The nominal speed is never reached
+    peakSpeed = sqrt(acceleration * length +
+                     0.5f * (entrySpeed * entrySpeed + exitSpeed * exitSpeed));
+    cruiseDistance = 0.0f;
+  }
+  return (peakSpeed - entrySpeed) / acceleration +
+         (peakSpeed - exitSpeed) / acceleration + cruiseDistance / peakSpeed;
+}
+
+Planner::Planner() : feedrateMmPerMin_(1200.0f) {}
+
+void Planner::setFeedrate(const float feedrateMmPerMin) {
+  feedrateMmPerMin_ = feedrateMmPerMin;
+}
+
+float Planner::getFeedrate() const { return feedrateMmPerMin_; }
+
+void Planner::push(ActionQueue &actionQueue, MotionProfile &profile) const {
+  profile.nominalSpeed = feedrateMmPerMin_ / 60;
+  profile.entrySpeed = 0.0f;
+  profile.exitSpeed = 0.0f;
+  profile.locked = false;
+
+  // The entry speed is bounded by the junction with the preceding segment; if
+  // the preceding action is not an XY move, the toolhead has to start at rest
+  MotionProfile *profiles[ActionQueue::capacity];
+  const uint16_t numProfiles = collectProfiles(actionQueue, profiles);
+  const MotionProfile *previous =
+      numProfiles >= 2 ? profiles[numProfiles - 2] : nullptr;
+  profile.maxEntrySpeed =
+      previous ? calculateJunctionSpeed(*previous, profile) : 0.0f;
+  replan(actionQueue);
+}
+
+void Planner::replan(ActionQueue &actionQueue) const {
+  MotionProfile *profiles[ActionQueue::capacity];
+  const uint16_t numProfiles = collectProfiles(actionQueue, profiles);
+
+  // Reverse pass: the last segment must be able to stop, and every segment must
+  // be able to slow down to the entry speed of the segment after it
+  float nextEntrySpeed = 0.0f;
+  for (uint16_t i = numProfiles; i-- > 0;) {
+    MotionProfile *profile = profiles[i];
+    if (!profile) {
+      nextEntrySpeed = 0.0f;
+      continue;
+    }
+    if (!profile->locked) {
+      profile->exitSpeed = nextEntrySpeed;
+      profile->entrySpeed =
+          min(profile->maxEntrySpeed,
+              getReachableSpeed(profile->exitSpeed, profile->acceleration,
+                                profile->length));
+    }
+    nextEntrySpeed = profile->entrySpeed;
+  }
+
+  // Forward pass: no segment may be entered faster than the previous segment
+  // can accelerate to
+  float previousExitSpeed = 0.0f;
+  for (uint16_t i = 0; i < numProfiles; ++i) {
+    MotionProfile *profile = profiles[i];
+    if (!profile) {
+      previousExitSpeed = 0.0f;
+      continue;
+    }
+    if (!profile->locked) {
+      profile->entrySpeed = min(profile->entrySpeed, previousExitSpeed);
+      profile->exitSpeed =
+          min(profile->exitSpeed,
+              getReachableSpeed(profile->entrySpeed, profile->acceleration,
+                                profile->length));
+    }
+    previousExitSpeed = profile->exitSpeed;
+  }
+}
+
+float Planner::calculateJunctionSpeed(const MotionProfile &previous,
+                                      const MotionProfile &next) {
+  // Cosine of the angle between the two segments, measured such that a
+  // straight line is -1 and a full reversal is 1
+  const float cosTheta =
+      -(previous.unitX * next.unitX + previous.unitY * next.unitY);
+  if (cosTheta > 0.999999f) {
+    return 0.0f;
+  }
+  const float nominalSpeed = min(previous.nominalSpeed, next.nominalSpeed);
+  if (cosTheta < -0.999999f) {
+    return nominalSpeed;
+  }
+  const float acceleration = min(previous.acceleration, next.acceleration);
+  const float sinHalfTheta = sqrt(0.5f * (1.0f - cosTheta));
+  return min(nominalSpeed,
+             sqrt(acceleration * JUNCTION_DEVIATION * sinHalfTheta /
+                  (1.0f - sinHalfTheta)));
+}
+}  // namespace Clef::Fw
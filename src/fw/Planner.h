@@ -0,0 +1,92 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/Axes.h>
+#include <fw/Config.h>
+#include <stdint.h>
+
+namespace Clef::Fw {
+class ActionQueue;
+
+/**
+ * Kinematic description of a single XY segment as seen by the planner. Speeds
+ * are in mm/s along the path, distances are in mm, and acceleration is in
+ * mm/s^2 along the path.
+ */
+struct MotionProfile {
+  float length = 0.0f;
+  float unitX = 0.0f; /*!< X component of the direction of travel. */
+  float unitY = 0.0f; /*!< Y component of the direction of travel. */
+  float acceleration = 0.0f;
+  float nominalSpeed = 0.0f;  /*!< Cruise speed requested by the feedrate. */
+  float maxEntrySpeed = 0.0f; /*!< Limit imposed by the junction angle. */
+  float entrySpeed = 0.0f;
+  float exitSpeed = 0.0f;
+  bool locked = false; /*!< Set once the segment is handed to the step
+                          engine; the planner no longer changes a locked
+                          profile. */
+
+  /**
+   * Initialize the geometry of the segment; returns false if the segment has
+   * no XY component.
+   */
+  bool setGeometry(const XYEPosition &startPosition,
+                   const XYEPosition &endPosition);
+
+  /**
+   * Speed of the trapezoidal velocity profile after travelling the given
+   * distance into the segment. The result is never less than
+   * MIN_PLANNER_SPEED so that a segment starting from rest makes progress.
+   */
+  float getSpeedAt(const float distance) const;
+
+  /**
+   * Time in seconds to travel the segment, accelerating from the entry speed
+   * and decelerating to the exit speed, and cruising at the nominal speed if
+   * the segment is long enough to reach it.
+   */
+  float getDuration() const;
+};
+
+/**
+ * Lookahead motion planner. Every XY segment pushed to the action queue is
+ * registered with the planner, which then recomputes entry and exit speeds of
+ * all queued segments so that consecutive segments blend through their
+ * junctions instead of stopping at every vertex. Any non-XY motion in the queue
+ * forces the machine to come to rest.
+ */
+class Planner {
+ public:
+  Planner();
+
+  /**
+   * Set the feedrate (in raw mm/min) that applies to segments pushed from now
+   * on.
+   */
+  void setFeedrate(const float feedrateMmPerMin);
+  float getFeedrate() const;
+
+  /**
+   * Assign nominal speed and acceleration to a segment that was just pushed to
+   * the end of the queue, then replan the whole queue.
+   */
+  void push(ActionQueue &actionQueue, MotionProfile &profile) const;
+
+  /**
+   * Recompute entry and exit speeds of every unlocked segment in the queue.
+   * Locked segments are left as they are and bound their neighbours.
+   */
+  void replan(ActionQueue &actionQueue) const;
+
+  /**
+   * Maximum speed at which the toolhead may pass from one direction of travel
+   * to another, based on the junction deviation heuristic.
+   */
+  static float calculateJunctionSpeed(const MotionProfile &previous,
+                                      const MotionProfile &next);
+
+ private:
+  float feedrateMmPerMin_; /*!< Feedrate at the end of the queue. */
+};
+}  // namespace Clef::Fw
@@ -9,6 +9,21 @@
 #include <util/Units.h>
 
 namespace Clef::Fw {
+/**
+ * How a Sensor hands data from its writer (an interrupt handler) to its
+ * subscribers.
+ */
+enum class SensorPublication {
+  STAGED,  /*!< Every transition runs with interrupts disabled, and data that
+              arrives while the current data is checked out waits in a single
+              staging slot until it is released. */
+  SEQLOCK, /*!< The writer publishes into the staging slot between two
+              increments of a sequence counter and never blocks; checking out
+              copies the slot, and copies again if the writer got in the way.
+              Interrupts are never disabled, so every subscriber must run in
+              the same context (the main loop). */
+};
+
 template <typename DType>
 class Sensor {
  private:
@@ -35,11 +50,18 @@ class Sensor {
     DType data;
   };
 
-  Sensor(Clef::If::Clock &clock)
+  Sensor(Clef::If::Clock &clock,
+         const SensorPublication publication = SensorPublication::STAGED)
       : clock_(clock),
+        publication_(publication),
         state_(State::NO_DATA),
+        activeSubscribers_(0),
+        checkedOutSubscribers_(0),
+        releasedSubscribers_(0),
         current_({0, 0}),
-        staged_({0, 0}) {}
+        staged_({0, 0}),
+        sequence_(0),
+        loadedSequence_(0) {}
 
   /**
    * Register a subscriber. Return a token that can be used when checking out
@@ -57,6 +79,10 @@ class Sensor {
    */
   void inject(DType data) {
     DataPoint dataPoint({*clock_.getMicros(), data});
+    if (publication_ == SensorPublication::SEQLOCK) {
+      publish(dataPoint);
+      return;
+    }
     Clef::If::DisableInterrupts noInterrupts;
     switch (state_) {
       case State::NO_DATA:
@@ -82,6 +108,9 @@ class Sensor {
    * Transition the sensor to a state in which it is safe to read.
    */
   bool checkOut(const uint8_t token) {
+    if (publication_ == SensorPublication::SEQLOCK) {
+      return checkOutPublished(token);
+    }
     Clef::If::DisableInterrupts noInterrupts;
     switch (state_) {
       case State::NO_DATA:
@@ -114,6 +143,11 @@ class Sensor {
    * the readable data can be refreshed.
    */
   void release(const uint8_t token) {
+    if (publication_ == SensorPublication::SEQLOCK) {
+      // Newer data is loaded at the next checkout once nobody is reading
+      releasedSubscribers_ |= token;
+      return;
+    }
     Clef::If::DisableInterrupts noInterrupts;
     switch (state_) {
       case State::CHECKED_OUT:
@@ -145,7 +179,9 @@ class Sensor {
   }
 
   /**
-   * This function is called whenever current_ updates.
+   * This function is called whenever current_ updates: in the writer's context
+   * or on release when staged, and on checkout with a sequence counter, in
+   * which case it only sees the data points that are loaded.
    */
   virtual void onCurrentUpdate(const DataPoint dataPoint) {}
 
@@ -162,13 +198,62 @@ class Sensor {
     onCurrentUpdate(current_);
   }
 
+  /**
+   * Write a data point into the staging slot while the sequence counter is
+   * odd.
+   */
+  void publish(const DataPoint dataPoint) {
+    sequence_ = sequence_ + 1;
+    Clef::If::memoryBarrier();
+    staged_ = dataPoint;
+    Clef::If::memoryBarrier();
+    sequence_ = sequence_ + 1;
+  }
+
+  /**
+   * If nobody is reading current_, load the newest published data point into
+   * it, then check it out as in the staged mode. A copy is only kept if the
+   * sequence counter was even and did not move while it was taken.
+   */
+  bool checkOutPublished(const uint8_t token) {
+    if (checkedOutSubscribers_ == releasedSubscribers_) {
+      uint8_t sequence;
+      DataPoint dataPoint = current_;
+      do {
+        sequence = sequence_;
+        Clef::If::memoryBarrier();
+        dataPoint = staged_;
+        Clef::If::memoryBarrier();
+      } while ((sequence & 1) || sequence != sequence_);
+      if (sequence != loadedSequence_) {
+        loadedSequence_ = sequence;
+        current_ = dataPoint;
+        state_ = State::DATA_READY;
+        onNewDataLoad();
+      }
+    }
+    if (state_ == State::NO_DATA || (checkedOutSubscribers_ & token)) {
+      // Allow checkout only if this token has not already been used
+      return false;
+    }
+    checkedOutSubscribers_ |= token;
+    return true;
+  }
+
   Clef::If::Clock &clock_;
+  const SensorPublication publication_;
   State state_;
   uint8_t activeSubscribers_;
   uint8_t checkedOutSubscribers_;
   uint8_t releasedSubscribers_;
   DataPoint current_;
   DataPoint staged_;
+  volatile uint8_t sequence_; /*!< Odd while staged_ is being published; a
+                                 single byte, so that it is read and written
+                                 atomically on an 8-bit microcontroller. */
+  uint8_t loadedSequence_;    /*!< Of the data in current_. A reader that
+                                 misses a multiple of 128 data points in a row
+                                 only sees the one after. */
 };
 
 template <uint32_t SENSOR_USTEPS_PER_MM, uint32_t AXIS_USTEPS_PER_MM>
@@ -193,9 +278,10 @@ class DisplacementSensor
                            Clef::Util::TimeUnit::MIN, AXIS_USTEPS_PER_MM>;
   using DataPoint = typename SensorIf::DataPoint;
 
-  DisplacementSensor(Clef::If::Clock &clock,
-                     const float lowPassFilterCoefficient)
-      : SensorIf(clock),
+  DisplacementSensor(
+      Clef::If::Clock &clock, const float lowPassFilterCoefficient,
+      const SensorPublication publication = SensorPublication::STAGED)
+      : SensorIf(clock, publication),
         currentFeedrate_(0),
         lastDataPoint_({0, 0}),
         lowPassFilterCoefficient_(lowPassFilterCoefficient) {}
@@ -252,8 +338,10 @@ class DisplacementSensor
  */
 class PressureSensor : public Sensor<uint16_t> {
  public:
-  PressureSensor(Clef::If::Clock &clock, const float lowPassFilterCoefficient)
-      : Sensor<uint16_t>(clock),
+  PressureSensor(
+      Clef::If::Clock &clock, const float lowPassFilterCoefficient,
+      const SensorPublication publication = SensorPublication::STAGED)
+      : Sensor<uint16_t>(clock, publication),
         currentPressure_(0),
         lowPassFilterCoefficient_(lowPassFilterCoefficient) {}
 
@@ -0,0 +1,322 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "StepEngine.h"
+
+#include <if/Interrupts.h>
+#include <math.h>
+#include <stdlib.h>
+
+namespace Clef::Fw {
+namespace {
+/**
+ * Fill in the block entries for one axis and return the squared distance of
+ * the move along that axis in mm^2.
+ */
+template <typename AxisType>
+float setBlockAxis(StepEngine::StepBlock *block,
+                   const StepEngine::AxisIndex index,
+                   const typename AxisType::StepperPosition startPosition,
+                   const typename AxisType::GcodePosition endPosition) {
+  const typename AxisType::StepperPosition target =
+      AxisType::gcodePositionToStepper(endPosition);
+  block->targets[index] = *target;
+  block->steps[index] = abs(*target - *startPosition);
+  const float distance =
+      *(endPosition - AxisType::stepperPositionToGcode(startPosition));
+  return distance * distance;
+}
+}  // namespace
+
+void StepEngine::StepBlock::setSpeeds(const float entrySpeed,
+                                      const float nominalSpeed,
+                                      const float exitSpeed,
+                                      const float acceleration) {
+  nominalRate = speedToRate(nominalSpeed);
+  initialRate = speedToRate(entrySpeed);
+  finalRate = speedToRate(exitSpeed);
+  if (initialRate > nominalRate) {
+    initialRate = nominalRate;
+  }
+  if (finalRate > nominalRate) {
+    finalRate = nominalRate;
+  }
+
+  // Acceleration in step events/s^2
+  const float rateAcceleration =
+      length > 0.0f ? acceleration * stepEventCount / length : 0.0f;
+  if (!(rateAcceleration > 0.0f) || isinf(rateAcceleration)) {
+    rateDelta = nominalRate;
+    decelerateAfter = stepEventCount;
+    return;
+  }
+  const float delta = ceil(rateAcceleration / ACCELERATION_TICKS_PER_SECOND);
+  rateDelta = delta < 1.0f ? 1 : static_cast<uint32_t>(delta);
+
+  // Number of step events to accelerate and decelerate, from v^2 = u^2 + 2ad
+  const float nominal2 = static_cast<float>(nominalRate) * nominalRate;
+  const float initial2 = static_cast<float>(initialRate) * initialRate;
+  const float final2 = static_cast<float>(finalRate) * finalRate;
+  const float accelerateSteps = (nominal2 - initial2) / (2 * rateAcceleration);
+  const float decelerateSteps = (nominal2 - final2) / (2 * rateAcceleration);
+  if (accelerateSteps + decelerateSteps <= stepEventCount) {
+    decelerateAfter = stepEventCount - static_cast<int32_t>(decelerateSteps);
+  } else {
+    // The nominal rate is never reached; switch from accelerating to
+    // decelerating where the two ramps intersect
+    float intersection =
+        (2 * rateAcceleration * stepEventCount + final2 - initial2) /
+        (4 * rateAcceleration);
+    if (intersection < 0.0f) {
+      intersection = 0.0f;
+    } else if (intersection > stepEventCount) {
+      intersection = stepEventCount;
+    }
+    decelerateAfter = static_cast<int32_t>(intersection);
+  }
+}
+
+uint32_t StepEngine::StepBlock::speedToRate(const float speed) const {
+  if (length <= 0.0f) {
+    return 1;
+  }
+  float rate = (speed < MIN_PLANNER_SPEED ? MIN_PLANNER_SPEED : speed) *
+               stepEventCount / length;
+  if (rate > MAX_STEPPER_FREQ) {
+    rate = MAX_STEPPER_FREQ;
+  }
+  return rate < 1.0f ? 1 : static_cast<uint32_t>(rate);
+}
+
+StepEngine::StepEngine(Axes &axes, Clef::If::PwmTimer &pwmTimer)
+    : axes_(axes),
+      pwmTimer_(pwmTimer),
+      plannedTargets_{0, 0, 0, 0},
+      nextSequence_(1),
+      current_(nullptr),
+      counters_{0, 0, 0, 0},
+      stepEventsCompleted_(0),
+      rate_(1),
+      accelerationCounter_(0),
+      completedSequence_(0),
+      pulsedAxes_(0) {}
+
+bool StepEngine::init() {
+  pwmTimer_.init();
+  pwmTimer_.setRisingEdgeCallback(onRisingEdge, this);
+  pwmTimer_.setFallingEdgeCallback(onFallingEdge, this);
+  return true;
+}
+
+StepEngine::StepBlock StepEngine::makeBlock(const XYZEPosition &endPosition,
+                                            const uint8_t axisMask) {
+  if (!isBusy()) {
+    plannedTargets_[X] = *axes_.getX().getPosition();
+    plannedTargets_[Y] = *axes_.getY().getPosition();
+    plannedTargets_[Z] = *axes_.getZ().getPosition();
+    plannedTargets_[E] = *axes_.getE().getPosition();
+  }
+  StepBlock block = {{plannedTargets_[X], plannedTargets_[Y],
+                      plannedTargets_[Z], plannedTargets_[E]},
+                     {0, 0, 0, 0},
+                     0,
+                     1,
+                     1,
+                     1,
+                     1,
+                     0,
+                     0.0f,
+                     axisMask,
+                     0};
+  float squaredLength = 0.0f;
+  if (axisMask & X_MASK) {
+    squaredLength += setBlockAxis<Axes::XAxis>(&block, X, plannedTargets_[X],
+                                               endPosition.x);
+  }
+  if (axisMask & Y_MASK) {
+    squaredLength += setBlockAxis<Axes::YAxis>(&block, Y, plannedTargets_[Y],
+                                               endPosition.y);
+  }
+  if (axisMask & Z_MASK) {
+    squaredLength += setBlockAxis<Axes::ZAxis>(&block, Z, plannedTargets_[Z],
+                                               endPosition.z);
+  }
+  if (axisMask & E_MASK) {
+    squaredLength += setBlockAxis<Axes::EAxis>(&block, E, plannedTargets_[E],
+                                               endPosition.e);
+  }
+  for (uint8_t i = 0; i < NUM_AXES; ++i) {
+    if (block.steps[i] > block.stepEventCount) {
+      block.stepEventCount = block.steps[i];
+    }
+  }
+  block.length = sqrt(squaredLength);
+  block.decelerateAfter = block.stepEventCount;
+  return block;
+}
+
+bool StepEngine::push(StepBlock *block) {
+  Clef::If::DisableInterrupts noInterrupts;
+  if (blocks_.getNumSpacesLeft() == 0) {
+    return false;
+  }
+  block->sequence = nextSequence_++;
+  if (block->stepEventCount == 0) {
+    // Nothing to do, but the sequence number must still complete in order
+    if (!current_) {
+      completedSequence_ = block->sequence;
+      return true;
+    }
+  }
+  blocks_.push(*block);
+  for (uint8_t i = 0; i < NUM_AXES; ++i) {
+    if (block->axisMask & (1 << i)) {
+      plannedTargets_[i] = block->targets[i];
+    }
+  }
+  if (!current_) {
+    startBlock();
+  }
+  return true;
+}
+
+bool StepEngine::hasCapacity() const { return blocks_.getNumSpacesLeft() > 0; }
+
+bool StepEngine::isCompleted(const uint16_t sequence) const {
+  return static_cast<int16_t>(completedSequence_ - sequence) >= 0;
+}
+
+void StepEngine::setNominalSpeed(const float speed) {
+  Clef::If::DisableInterrupts noInterrupts;
+  if (!current_) {
+    return;
+  }
+  current_->nominalRate = current_->speedToRate(speed);
+  current_->finalRate = current_->nominalRate;
+
+  // The executing block is the first in the queue
+  Clef::Util::PooledQueue<StepBlock, STEP_BLOCK_QUEUE_SIZE>::Iterator it =
+      blocks_.first();
+  for (uint16_t i = 1; i < blocks_.size(); ++i) {
+    it = it.next();
+    it->nominalRate = it->speedToRate(speed);
+    it->initialRate = it->nominalRate;
+    it->finalRate = it->nominalRate;
+  }
+}
+
+bool StepEngine::isBusy() const { return current_; }
+
+void StepEngine::skipEmptyBlocks() {
+  // A block without steps would otherwise run for one event at its rate,
+  // which is the minimum rate since it has no length
+  Clef::Util::PooledQueue<StepBlock, STEP_BLOCK_QUEUE_SIZE>::Iterator it =
+      blocks_.first();
+  while (it && it->stepEventCount == 0) {
+    completedSequence_ = it->sequence;
+    blocks_.pop();
+    it = blocks_.first();
+  }
+}
+
+void StepEngine::startBlock() {
+  current_ = &*blocks_.first();
+  stepEventsCompleted_ = 0;
+  pulsedAxes_ = 0;
+  for (uint8_t i = 0; i < NUM_AXES; ++i) {
+    counters_[i] = -(current_->stepEventCount / 2);
+  }
+
+  // Every pulse moves exactly one microstep, so the steppers need to be at
+  // full resolution; setting the target also sets the direction
+  if (current_->axisMask & X_MASK) {
+    axes_.getX().setStepTarget(current_->targets[X]);
+  }
+  if (current_->axisMask & Y_MASK) {
+    axes_.getY().setStepTarget(current_->targets[Y]);
+  }
+  if (current_->axisMask & Z_MASK) {
+    axes_.getZ().setStepTarget(current_->targets[Z]);
+  }
+  if (current_->axisMask & E_MASK) {
+    axes_.getE().setStepTarget(current_->targets[E]);
+  }
+
+  rate_ = current_->initialRate;
+  accelerationCounter_ = 0;
+  pwmTimer_.setFrequency(static_cast<float>(rate_));
+  if (!pwmTimer_.isEnabled()) {
+    pwmTimer_.enable();
+  }
+}
+
+void StepEngine::onRisingEdge(void *arg) {
+  StepEngine *engine = reinterpret_cast<StepEngine *>(arg);
+  engine->pulsedAxes_ = 0;
+  if (!engine->current_) {
+    return;
+  }
+  engine->pulseAxis(engine->axes_.getX(), X);
+  engine->pulseAxis(engine->axes_.getY(), Y);
+  engine->pulseAxis(engine->axes_.getZ(), Z);
+  engine->pulseAxis(engine->axes_.getE(), E);
+}
+
+void StepEngine::onFallingEdge(void *arg) {
+  StepEngine *engine = reinterpret_cast<StepEngine *>(arg);
+  const uint8_t pulsedAxes = engine->pulsedAxes_;
+  if (pulsedAxes & X_MASK) {
+    engine->axes_.getX().unpulse();
+  }
+  if (pulsedAxes & Y_MASK) {
+    engine->axes_.getY().unpulse();
+  }
+  if (pulsedAxes & Z_MASK) {
+    engine->axes_.getZ().unpulse();
+  }
+  if (pulsedAxes & E_MASK) {
+    engine->axes_.getE().unpulse();
+  }
+  StepBlock *block = engine->current_;
+  if (!block) {
+    engine->pwmTimer_.disable();
+    return;
+  }
+
+  if (++engine->stepEventsCompleted_ >= block->stepEventCount) {
+    engine->completedSequence_ = block->sequence;
+    engine->blocks_.pop();
+    engine->skipEmptyBlocks();
+    if (engine->blocks_.first()) {
+      engine->startBlock();
+    } else {
+      engine->current_ = nullptr;
+      engine->pwmTimer_.disable();
+    }
+    return;
+  }
+
+  // Each step event takes 1/rate seconds, so adding the tick frequency on every
+  // event and comparing against the rate yields a fixed number of acceleration
+  // ticks per second
+  engine->accelerationCounter_ += ACCELERATION_TICKS_PER_SECOND;
+  if (engine->accelerationCounter_ >= engine->rate_) {
+    engine->accelerationCounter_ -= engine->rate_;
+    const uint32_t targetRate =
+        engine->stepEventsCompleted_ >= block->decelerateAfter
+            ? block->finalRate
+            : block->nominalRate;
+    uint32_t rate = engine->rate_;
+    if (rate < targetRate) {
+      rate = targetRate - rate > block->rateDelta ? rate + block->rateDelta
+                                                  : targetRate;
+    } else if (rate > targetRate) {
+      rate = rate - targetRate > block->rateDelta ? rate - block->rateDelta
+                                                  : targetRate;
+    }
+    if (rate != engine->rate_) {
+      engine->rate_ = rate;
+      engine->pwmTimer_.setFrequency(static_cast<float>(rate));
+    }
+  }
+}
+}  // namespace Clef::Fw
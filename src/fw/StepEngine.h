@@ -0,0 +1,157 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/Axes.h>
+#include <fw/Config.h>
+#include <if/PwmTimer.h>
+#include <stdint.h>
+#include <util/Initialized.h>
+#include <util/PooledQueue.h>
+
+namespace Clef::Fw {
+/**
+ * Generate steps for all axes from a single timer. Each step event of the timer
+ * advances a Bresenham accumulator per axis, so that the axis with the most
+ * steps in a block moves on every event and the others are distributed evenly
+ * between them. This keeps coordinated axes in sync and needs only one
+ * interrupt per step event no matter how many axes are moving.
+ *
+ * Blocks are computed in the main loop and queued; the interrupt handler moves
+ * on to the next block by itself, so motion timing does not depend on how long
+ * an iteration of the main loop takes.
+ */
+class StepEngine : public Clef::Util::Initialized {
+ public:
+  enum AxisIndex : uint8_t { X = 0, Y = 1, Z = 2, E = 3, NUM_AXES = 4 };
+
+  /**
+   * Masks for selecting which axes participate in a block.
+   */
+  static const uint8_t X_MASK = 1 << X;
+  static const uint8_t Y_MASK = 1 << Y;
+  static const uint8_t Z_MASK = 1 << Z;
+  static const uint8_t E_MASK = 1 << E;
+  static const uint8_t XY_MASK = X_MASK | Y_MASK;
+
+  /**
+   * Everything the interrupt handler needs to execute one straight-line move.
+   * Rates are in step events per second; the interrupt handler only ever adds
+   * and compares them.
+   */
+  struct StepBlock {
+    int32_t targets[NUM_AXES]; /*!< Absolute target of each axis in usteps. */
+    int32_t steps[NUM_AXES];   /*!< Number of usteps to take on each axis. */
+    int32_t stepEventCount;    /*!< Largest number of steps of any axis. */
+    uint32_t initialRate;
+    uint32_t nominalRate;
+    uint32_t finalRate;
+    uint32_t rateDelta;      /*!< Change in rate per acceleration tick. */
+    int32_t decelerateAfter; /*!< Step event at which to start slowing down to
+                                the final rate. */
+    float length;            /*!< Length of the move in mm. */
+    uint8_t axisMask;        /*!< Axes that participate in the move. */
+    uint16_t sequence;       /*!< Assigned when the block is pushed. */
+
+    /**
+     * Convert a speed profile along the path (mm/s and mm/s^2) into rates and
+     * find where the block must start decelerating.
+     */
+    void setSpeeds(const float entrySpeed, const float nominalSpeed,
+                   const float exitSpeed, const float acceleration);
+
+    /**
+     * Run the whole block at one speed (mm/s).
+     */
+    void setConstantSpeed(const float speed, const float acceleration) {
+      setSpeeds(speed, speed, speed, acceleration);
+    }
+
+    /**
+     * Step event rate that corresponds to a speed along the path.
+     */
+    uint32_t speedToRate(const float speed) const;
+  };
+
+  StepEngine(Axes &axes, Clef::If::PwmTimer &pwmTimer);
+
+  bool init() override;
+
+  /**
+   * Compute a block which moves the selected axes to the given position,
+   * starting from where the last queued block leaves them (or from the current
+   * position if the engine is idle). The block runs at the minimum rate until
+   * its speeds are set.
+   */
+  StepBlock makeBlock(const XYZEPosition &endPosition, const uint8_t axisMask);
+
+  /**
+   * Queue a block for execution and assign its sequence number; returns false
+   * if there is no room left in the queue.
+   */
+  bool push(StepBlock *block);
+
+  bool hasCapacity() const;
+
+  /**
+   * Check whether the block with the given sequence number has been executed.
+   */
+  bool isCompleted(const uint16_t sequence) const;
+
+  /**
+   * Change the cruising speed (in mm/s along the path) of the block that is
+   * executing, and the speed of the blocks queued behind it; the interrupt
+   * handler ramps to the new rate, and the queued blocks run at it from their
+   * start. This is meant for blocks which run at a constant speed.
+   */
+  void setNominalSpeed(const float speed);
+
+  /**
+   * Check whether the engine still has steps to take.
+   */
+  bool isBusy() const;
+
+ private:
+  template <typename AxisType>
+  inline void pulseAxis(AxisType &axis, const AxisIndex index) {
+    counters_[index] += current_->steps[index];
+    if (counters_[index] > 0) {
+      counters_[index] -= current_->stepEventCount;
+      axis.pulse();
+      pulsedAxes_ |= 1 << index;
+    }
+  }
+
+  /**
+   * Complete the blocks without steps at the front of the queue. Called with
+   * interrupts disabled.
+   */
+  void skipEmptyBlocks();
+
+  /**
+   * Load the block at the front of the queue. Called with interrupts disabled.
+   */
+  void startBlock();
+
+  static void onRisingEdge(void *arg);
+  static void onFallingEdge(void *arg);
+
+ private:
+  Axes &axes_;
+  Clef::If::PwmTimer &pwmTimer_;
+
+  Clef::Util::PooledQueue<StepBlock, STEP_BLOCK_QUEUE_SIZE> blocks_;
+  int32_t plannedTargets_[NUM_AXES]; /*!< Where the queued blocks end. */
+  uint16_t nextSequence_;
+
+  // State of the interrupt handler
+  StepBlock *volatile current_; /*!< Block being executed, or nullptr. */
+  int32_t counters_[NUM_AXES];  /*!< Bresenham error accumulators. */
+  int32_t stepEventsCompleted_;
+  uint32_t rate_;                /*!< Current step event rate. */
+  uint32_t accelerationCounter_; /*!< Counts towards the next acceleration
+                                    tick. */
+  volatile uint16_t completedSequence_;
+  uint8_t pulsedAxes_; /*!< Axes pulsed on the last rising edge. */
+};
+}  // namespace Clef::Fw
@@ -15,10 +15,65 @@ typename BaseDegenFilter::WxMatrix Wx(memWx);
 
 DegenFilter::DegenFilter() : BaseDegenFilter(Q, R, Wx) { init(); }
 
+DegenFilter::DegenFilter(const QMatrix &Q, const RMatrix &R, const WxMatrix &Wx)
+    : BaseDegenFilter(Q, R, Wx) {
+  init();
+}
+
+#ifndef TARGET_AVR
+namespace {
+const Clef::Fw::KalmanTuning::Variable xvars[] = {
+    {"xs", 0, 5.968012553968996, 0.6643913126888928, 0.08564907165804703},
+    {"dxsdt", 0, 20.40001728557575, 0.15709419193317814, 0.9679720676046717},
+    {"Ph", 0, 9.377230028352413, 0.8749943848809725, 0.761561536487039},
+    {"Ph0", 4903.592289799023, 105.10288025005443, 0.10558164266330698, 1},
+    {"Ps", 0, 10.814128153323214, 0.09164746424144346, 0.2903404040638757},
+    {"a1", 2.058031151135649, 1.0573914114763654, 0.2350069617854511, 0.20121356269619844},
+    {"a0", 0, 100.36085314595985, 10.051952236083185, 0.09910003513065686},
+    {"Chl", 10.147701815528546, 0.16893414298306883, 0.020650460931544275, 0.026411231117992318},
+    {"gamma", 0.0823852983375337, 0.049319423047475844, 0.0012055487723313366, 0.018612792192690863},
+};
+const Clef::Fw::KalmanTuning::Variable zvars[] = {
+    {"xs_in", 0, 0, 5, 1},
+    {"Ph_in", 0, 0, 1.910747935940628, 1},
+};
+const Clef::Fw::KalmanTuning::Variable uvars[] = {
+    {"xe", 0, 0, 0, 1},
+};
+const Clef::Fw::KalmanTuning::ErrorMetric errorMetrics[] = {
+    {"xs_in", "xs", 0.1},
+    {"dxsdt", "dxsdt", 5},
+    {"Ph_in", "Ph_in", 0.1},
+};
+const Clef::Fw::KalmanTuning::SmoothnessMetric smoothnessMetrics[] = {
+    {"xs", 0.1, 0.01},
+    {"Ph", 0.5, 0.01},
+    {"Ph0", 1, 0.001},
+    {"Ps", 0.5, 0.01},
+    {"a1", 1, 0.0005},
+    {"a0", 1, 0.0005},
+    {"Chl", 5, 0.0005},
+    {"gamma", 5, 0.0005},
+};
+const Clef::Fw::KalmanTuning::NegativityMetric negativityMetrics[] = {
+    {"a1", 4},
+    {"a0", 2},
+    {"Chl", 1},
+    {"gamma", 10},
+};
+}  // namespace
+
+const Clef::Fw::KalmanTuning::Spec DegenFilter::TUNING_SPEC = {
+    xvars, 9, zvars, 2, uvars, 1,
+    errorMetrics, 3, smoothnessMetrics, 8,
+    negativityMetrics, 4};
+#endif
+
 void DegenFilter::evolve(
     /* Control Variables */ const float xe,
     /* Observation Variables */ const float xs_in, const float Ph_in,
-    /* Time Step */ const float deltat) {
+    /* Time Step */ const float deltat,
+    /* Observations Present */ const uint8_t observed) {
   float uMem[1];
   typename BaseDegenFilter::UVector u(uMem);
   u.set(0, 0, xe);
@@ -26,7 +81,22 @@ void DegenFilter::evolve(
   typename BaseDegenFilter::ZVector z(zMem);
   z.set(0, 0, xs_in);
   z.set(1, 0, Ph_in);
-  BaseDegenFilter::evolve(u, z, deltat);
+  BaseDegenFilter::evolve(u, z, deltat, observed);
+}
+
+void DegenFilter::begin(
+    /* Control Variables */ const float xe,
+    /* Observation Variables */ const float xs_in, const float Ph_in,
+    /* Time Step */ const float deltat,
+    /* Observations Present */ const uint8_t observed) {
+  float uMem[1];
+  typename BaseDegenFilter::UVector u(uMem);
+  u.set(0, 0, xe);
+  float zMem[2];
+  typename BaseDegenFilter::ZVector z(zMem);
+  z.set(0, 0, xs_in);
+  z.set(1, 0, Ph_in);
+  BaseDegenFilter::begin(u, z, deltat, observed);
 }
 
 void DegenFilter::init() {
@@ -161,4 +231,70 @@ void DegenFilter::calculateObserationTransGradient(
   // dPh_in/dPh0(k) = 1
   output.set(1, 3, 1);
 }
+
+// Only the structural nonzeros of Fk and Hk are read
+void DegenFilter::predictCovariance(
+    const typename BaseDegenFilter::StaticXXMatrix &Fk,
+    const typename BaseDegenFilter::StaticPMatrix &P,
+    typename BaseDegenFilter::StaticXXMatrix &FkP,
+    typename BaseDegenFilter::StaticPMatrix &output) const {
+  for (uint16_t k = 0; k < 9; ++k) {
+    FkP.set(0, k, P.get(0, k) + Fk.get(0, 1) * P.get(1, k));
+    FkP.set(1, k, Fk.get(1, 4) * P.get(4, k) + Fk.get(1, 8) * P.get(8, k));
+    FkP.set(2, k, Fk.get(2, 0) * P.get(0, k) + Fk.get(2, 7) * P.get(7, k));
+    FkP.set(3, k, P.get(3, k));
+    FkP.set(4, k, Fk.get(4, 1) * P.get(1, k) + P.get(2, k) + Fk.get(4, 5) * P.get(5, k) - P.get(6, k));
+    FkP.set(5, k, P.get(5, k));
+    FkP.set(6, k, P.get(6, k));
+    FkP.set(7, k, P.get(7, k));
+    FkP.set(8, k, P.get(8, k));
+  }
+  for (uint16_t i = 0; i <= 0; ++i) {
+    output.set(i, 0, FkP.get(i, 0) + FkP.get(i, 1) * Fk.get(0, 1));
+  }
+  for (uint16_t i = 0; i <= 1; ++i) {
+    output.set(i, 1, FkP.get(i, 4) * Fk.get(1, 4) + FkP.get(i, 8) * Fk.get(1, 8));
+  }
+  for (uint16_t i = 0; i <= 2; ++i) {
+    output.set(i, 2, FkP.get(i, 0) * Fk.get(2, 0) + FkP.get(i, 7) * Fk.get(2, 7));
+  }
+  for (uint16_t i = 0; i <= 3; ++i) {
+    output.set(i, 3, FkP.get(i, 3));
+  }
+  for (uint16_t i = 0; i <= 4; ++i) {
+    output.set(i, 4, FkP.get(i, 1) * Fk.get(4, 1) + FkP.get(i, 2) + FkP.get(i, 5) * Fk.get(4, 5) - FkP.get(i, 6));
+  }
+  for (uint16_t i = 0; i <= 5; ++i) {
+    output.set(i, 5, FkP.get(i, 5));
+  }
+  for (uint16_t i = 0; i <= 6; ++i) {
+    output.set(i, 6, FkP.get(i, 6));
+  }
+  for (uint16_t i = 0; i <= 7; ++i) {
+    output.set(i, 7, FkP.get(i, 7));
+  }
+  for (uint16_t i = 0; i <= 8; ++i) {
+    output.set(i, 8, FkP.get(i, 8));
+  }
+}
+
+float DegenFilter::calculateObservationCovariance(
+    const typename BaseDegenFilter::StaticZXMatrix &Hk,
+    const typename BaseDegenFilter::StaticPMatrix &P, const uint16_t z,
+    typename BaseDegenFilter::StaticXVector &PhT) const {
+  switch (z) {
+    case 0:
+      for (uint16_t i = 0; i < 9; ++i) {
+        PhT.set(i, 0, P.get(i, 0));
+      }
+      return PhT.get(0, 0);
+    case 1:
+      for (uint16_t i = 0; i < 9; ++i) {
+        PhT.set(i, 0, P.get(i, 2) + P.get(i, 3));
+      }
+      return PhT.get(2, 0) + PhT.get(3, 0);
+    default:
+      return 0;
+  }
+}
 } // namespace Clef::Fw::Kalman
@@ -1,19 +1,45 @@
 // Copyright 2021 by Daniel Winkelman. All rights reserved.
 // This file is autogenerated by kalman.py.
 
+#pragma once
+
 #include <fw/KalmanFilter.h>
+#include <fw/KalmanTuning.h>
 
 namespace Clef::Fw::Kalman {
 using BaseDegenFilter = Clef::Fw::ExtendedKalmanFilter<9, 1, 2>;
 class DegenFilter : public BaseDegenFilter {
  public:
+  static constexpr uint8_t OBSERVE_XS_IN = 1 << 0;
+  static constexpr uint8_t OBSERVE_PH_IN = 1 << 1;
+
   DegenFilter();
   void evolve(
       /* Control Variables */ const float xe,
       /* Observation Variables */ const float xs_in, const float Ph_in,
-      /* Time Step */ const float deltat);
+      /* Time Step */ const float deltat,
+      /* Observations Present */ const uint8_t observed = ALL_OBSERVATIONS);
+  void begin(
+      /* Control Variables */ const float xe,
+      /* Observation Variables */ const float xs_in, const float Ph_in,
+      /* Time Step */ const float deltat,
+      /* Observations Present */ const uint8_t observed = ALL_OBSERVATIONS);
   void init() override;
 
+#ifndef TARGET_AVR
+  /**
+   * The variables and metrics of the model, for tuning the filter on the
+   * host.
+   */
+  static const Clef::Fw::KalmanTuning::Spec TUNING_SPEC;
+#endif
+
+ protected:
+  /**
+   * Use other noise covariances and update weights than the generated ones.
+   */
+  DegenFilter(const QMatrix &Q, const RMatrix &R, const WxMatrix &Wx);
+
  private:
   void calculateStateTrans(
       const typename BaseDegenFilter::XVector &xk,
@@ -29,5 +55,14 @@ class DegenFilter : public BaseDegenFilter {
   void calculateObserationTransGradient(
       const typename BaseDegenFilter::XVector &xk,
       typename BaseDegenFilter::HMatrix &output) const override;
+  void predictCovariance(
+      const typename BaseDegenFilter::StaticXXMatrix &Fk,
+      const typename BaseDegenFilter::StaticPMatrix &P,
+      typename BaseDegenFilter::StaticXXMatrix &FkP,
+      typename BaseDegenFilter::StaticPMatrix &output) const override;
+  float calculateObservationCovariance(
+      const typename BaseDegenFilter::StaticZXMatrix &Hk,
+      const typename BaseDegenFilter::StaticPMatrix &P, const uint16_t z,
+      typename BaseDegenFilter::StaticXVector &PhT) const override;
 };
 }  // namespace Clef::Fw::Kalman
@@ -0,0 +1,268 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+// This file is autogenerated by kalman.py.
+
+#include "DegenFixed.h"
+
+namespace Clef::Fw::Kalman {
+namespace {
+using Scalar = BaseDegenFixedFilter::Scalar;
+ARRAY(Scalar, memQ, {/* xs */ Scalar(0.6643913126888928), /* dxsdt */ Scalar(0.0006136491872389771), /* Ph */ Scalar(0.0034179468159412987), /* Ph0 */ Scalar(0.0004124282916535429), /* Ps */ Scalar(1.52587890625e-05), /* a1 */ Scalar(0.2350069617854511), /* a0 */ Scalar(0.6282470147551991), /* Chl */ Scalar(0.3304073749047084), /* gamma */ Scalar(0.30862048571682216)});
+ARRAY(Scalar, memR, {/* xs_in */ Scalar(5.0), /* Ph_in */ Scalar(0.0074638591247680785)});
+ARRAY(Scalar, memWx, {/* xs */ Scalar(0.08564907165804703), /* dxsdt */ Scalar(0.9679720676046717), /* Ph */ Scalar(0.761561536487039), /* Ph0 */ Scalar(1.0), /* Ps */ Scalar(0.2903404040638757), /* a1 */ Scalar(0.20121356269619844), /* a0 */ Scalar(0.09910003513065686), /* Chl */ Scalar(0.026411231117992318), /* gamma */ Scalar(0.018612792192690863)});
+typename BaseDegenFixedFilter::QMatrix Q(memQ);
+typename BaseDegenFixedFilter::RMatrix R(memR);
+typename BaseDegenFixedFilter::WxMatrix Wx(memWx);
+} // namespace
+
+DegenFixedFilter::DegenFixedFilter() : BaseDegenFixedFilter(Q, R, Wx) { init(); }
+
+void DegenFixedFilter::evolve(
+    /* Control Variables */ const Scalar xe,
+    /* Observation Variables */ const Scalar xs_in, const Scalar Ph_in,
+    /* Time Step */ const Scalar deltat,
+    /* Observations Present */ const uint8_t observed) {
+  Scalar uMem[1];
+  typename BaseDegenFixedFilter::UVector u(uMem);
+  u.set(0, 0, xe);
+  Scalar zMem[2];
+  typename BaseDegenFixedFilter::ZVector z(zMem);
+  z.set(0, 0, xs_in);
+  z.set(1, 0, Ph_in.shift(-4));
+  BaseDegenFixedFilter::evolve(u, z, deltat.shift(10), observed);
+}
+
+void DegenFixedFilter::begin(
+    /* Control Variables */ const Scalar xe,
+    /* Observation Variables */ const Scalar xs_in, const Scalar Ph_in,
+    /* Time Step */ const Scalar deltat,
+    /* Observations Present */ const uint8_t observed) {
+  Scalar uMem[1];
+  typename BaseDegenFixedFilter::UVector u(uMem);
+  u.set(0, 0, xe);
+  Scalar zMem[2];
+  typename BaseDegenFixedFilter::ZVector z(zMem);
+  z.set(0, 0, xs_in);
+  z.set(1, 0, Ph_in.shift(-4));
+  BaseDegenFixedFilter::begin(u, z, deltat.shift(10), observed);
+}
+
+void DegenFixedFilter::init() {
+  P_.fill(0);
+  x_.set(0, 0, Scalar(0.0));  // xs
+  x_.set(1, 0, Scalar(0.0));  // dxsdt
+  x_.set(2, 0, Scalar(0.0));  // Ph
+  x_.set(3, 0, Scalar(306.47451811243894));  // Ph0
+  x_.set(4, 0, Scalar(0.0));  // Ps
+  x_.set(5, 0, Scalar(2.058031151135649));  // a1
+  x_.set(6, 0, Scalar(0.0));  // a0
+  x_.set(7, 0, Scalar(40.59080726211418));  // Chl
+  x_.set(8, 0, Scalar(1.3181647734005393));  // gamma
+  P_.set(0, 0, Scalar(5.968012553968996));  // xs
+  P_.set(1, 1, Scalar(0.07968756752178027));  // dxsdt
+  P_.set(2, 2, Scalar(0.03662980479825161));  // Ph
+  P_.set(3, 3, Scalar(0.4105581259767751));  // Ph0
+  P_.set(4, 4, Scalar(0.0006600420015456063));  // Ps
+  P_.set(5, 5, Scalar(1.0573914114763654));  // a1
+  P_.set(6, 6, Scalar(6.272553321622491));  // a0
+  P_.set(7, 7, Scalar(2.7029462877291013));  // Chl
+  P_.set(8, 8, Scalar(12.625772300153816));  // gamma
+}
+
+DegenFixedFilter::Scalar DegenFixedFilter::getUnscaledState(const uint16_t i) const {
+  switch (i) {
+    case 1:
+      return x_.get(1, 0).shift(4);
+    case 2:
+      return x_.get(2, 0).shift(4);
+    case 3:
+      return x_.get(3, 0).shift(4);
+    case 4:
+      return x_.get(4, 0).shift(7);
+    case 6:
+      return x_.get(6, 0).shift(2);
+    case 7:
+      return x_.get(7, 0).shift(-2);
+    case 8:
+      return x_.get(8, 0).shift(-4);
+    default:
+      return x_.get(i, 0);
+  }
+}
+
+void DegenFixedFilter::calculateStateTrans(
+    const typename BaseDegenFixedFilter::XVector &xk,
+    const typename BaseDegenFixedFilter::UVector &uk,
+    const Scalar deltat,
+    typename BaseDegenFixedFilter::XVector &output) const {
+  // xs(k+1) = xs(k) + dxsdt(k) * deltat(k)
+  output.set(0, 0, xk.get(0, 0) + xk.get(1, 0).shift(-3) * deltat.shift(-3));
+
+  // dxsdt(k+1) = gamma(k) * Ps(k)
+  output.set(1, 0, xk.get(8, 0).shift(-1) * xk.get(4, 0));
+
+  // Ph(k+1) = Chl(k) * (xe(k) + -1 * xs(k))
+  output.set(2, 0, xk.get(7, 0).shift(-3) * (uk.get(0, 0).shift(-3) - xk.get(0, 0).shift(-3)));
+
+  // Ph0(k+1) = Ph0(k)
+  output.set(3, 0, xk.get(3, 0));
+
+  // Ps(k+1) = Ph(k) + -1 * a0(k) + -1 * a1(k) * dxsdt(k)
+  output.set(4, 0, xk.get(2, 0).shift(-3) - xk.get(6, 0).shift(-5) - xk.get(5, 0).shift(-2) * xk.get(1, 0).shift(-1));
+
+  // a1(k+1) = a1(k)
+  output.set(5, 0, xk.get(5, 0));
+
+  // a0(k+1) = a0(k)
+  output.set(6, 0, xk.get(6, 0));
+
+  // Chl(k+1) = Chl(k)
+  output.set(7, 0, xk.get(7, 0));
+
+  // gamma(k+1) = gamma(k)
+  output.set(8, 0, xk.get(8, 0));
+}
+
+void DegenFixedFilter::calculateStateTransGradient(
+    const typename BaseDegenFixedFilter::XVector &xk,
+    const typename BaseDegenFixedFilter::UVector &uk,
+    const Scalar deltat,
+    typename BaseDegenFixedFilter::FMatrix &output) const {
+  output.fill(0);
+
+  // dxs/dxs(k+1) = 1
+  output.set(0, 0, Scalar(1.0));
+
+  // dxs/ddxsdt(k+1) = deltat(k)
+  output.set(0, 1, deltat.shift(-6));
+
+  // ddxsdt/dPs(k+1) = gamma(k)
+  output.set(1, 4, xk.get(8, 0).shift(-1));
+
+  // ddxsdt/dgamma(k+1) = Ps(k)
+  output.set(1, 8, xk.get(4, 0).shift(-1));
+
+  // dPh/dxs(k+1) = -1 * Chl(k)
+  output.set(2, 0, -xk.get(7, 0).shift(-6));
+
+  // dPh/dChl(k+1) = xe(k) + -1 * xs(k)
+  output.set(2, 7, uk.get(0, 0).shift(-6) - xk.get(0, 0).shift(-6));
+
+  // dPh0/dPh0(k+1) = 1
+  output.set(3, 3, Scalar(1.0));
+
+  // dPs/ddxsdt(k+1) = a1(k) * -1
+  output.set(4, 1, -xk.get(5, 0).shift(-3));
+
+  // dPs/dPh(k+1) = 1
+  output.set(4, 2, Scalar(0.125));
+
+  // dPs/da1(k+1) = dxsdt(k) * -1
+  output.set(4, 5, -xk.get(1, 0).shift(-3));
+
+  // dPs/da0(k+1) = -1
+  output.set(4, 6, Scalar(-0.03125));
+
+  // da1/da1(k+1) = 1
+  output.set(5, 5, Scalar(1.0));
+
+  // da0/da0(k+1) = 1
+  output.set(6, 6, Scalar(1.0));
+
+  // dChl/dChl(k+1) = 1
+  output.set(7, 7, Scalar(1.0));
+
+  // dgamma/dgamma(k+1) = 1
+  output.set(8, 8, Scalar(1.0));
+}
+
+void DegenFixedFilter::calculateObservationTrans(
+    const typename BaseDegenFixedFilter::XVector &xk,
+    typename BaseDegenFixedFilter::ZVector &output) const {
+  // xs_in(k) = xs(k)
+  output.set(0, 0, xk.get(0, 0));
+
+  // Ph_in(k) = Ph(k) + Ph0(k)
+  output.set(1, 0, xk.get(2, 0) + xk.get(3, 0));
+}
+
+void DegenFixedFilter::calculateObserationTransGradient(
+    const typename BaseDegenFixedFilter::XVector &xk,
+    typename BaseDegenFixedFilter::HMatrix &output) const {
+  output.fill(0);
+
+  // dxs_in/dxs(k) = 1
+  output.set(0, 0, Scalar(1.0));
+
+  // dPh_in/dPh(k) = 1
+  output.set(1, 2, Scalar(1.0));
+
+  // dPh_in/dPh0(k) = 1
+  output.set(1, 3, Scalar(1.0));
+}
+
+// Only the structural nonzeros of Fk and Hk are read
+void DegenFixedFilter::predictCovariance(
+    const typename BaseDegenFixedFilter::StaticXXMatrix &Fk,
+    const typename BaseDegenFixedFilter::StaticPMatrix &P,
+    typename BaseDegenFixedFilter::StaticXXMatrix &FkP,
+    typename BaseDegenFixedFilter::StaticPMatrix &output) const {
+  for (uint16_t k = 0; k < 9; ++k) {
+    FkP.set(0, k, P.get(0, k) + Fk.get(0, 1) * P.get(1, k));
+    FkP.set(1, k, Fk.get(1, 4) * P.get(4, k) + Fk.get(1, 8) * P.get(8, k));
+    FkP.set(2, k, Fk.get(2, 0) * P.get(0, k) + Fk.get(2, 7) * P.get(7, k));
+    FkP.set(3, k, P.get(3, k));
+    FkP.set(4, k, Fk.get(4, 1) * P.get(1, k) + P.get(2, k).shift(-3) + Fk.get(4, 5) * P.get(5, k) - P.get(6, k).shift(-5));
+    FkP.set(5, k, P.get(5, k));
+    FkP.set(6, k, P.get(6, k));
+    FkP.set(7, k, P.get(7, k));
+    FkP.set(8, k, P.get(8, k));
+  }
+  for (uint16_t i = 0; i <= 0; ++i) {
+    output.set(i, 0, FkP.get(i, 0) + FkP.get(i, 1) * Fk.get(0, 1));
+  }
+  for (uint16_t i = 0; i <= 1; ++i) {
+    output.set(i, 1, FkP.get(i, 4) * Fk.get(1, 4) + FkP.get(i, 8) * Fk.get(1, 8));
+  }
+  for (uint16_t i = 0; i <= 2; ++i) {
+    output.set(i, 2, FkP.get(i, 0) * Fk.get(2, 0) + FkP.get(i, 7) * Fk.get(2, 7));
+  }
+  for (uint16_t i = 0; i <= 3; ++i) {
+    output.set(i, 3, FkP.get(i, 3));
+  }
+  for (uint16_t i = 0; i <= 4; ++i) {
+    output.set(i, 4, FkP.get(i, 1) * Fk.get(4, 1) + FkP.get(i, 2).shift(-3) + FkP.get(i, 5) * Fk.get(4, 5) - FkP.get(i, 6).shift(-5));
+  }
+  for (uint16_t i = 0; i <= 5; ++i) {
+    output.set(i, 5, FkP.get(i, 5));
+  }
+  for (uint16_t i = 0; i <= 6; ++i) {
+    output.set(i, 6, FkP.get(i, 6));
+  }
+  for (uint16_t i = 0; i <= 7; ++i) {
+    output.set(i, 7, FkP.get(i, 7));
+  }
+  for (uint16_t i = 0; i <= 8; ++i) {
+    output.set(i, 8, FkP.get(i, 8));
+  }
+}
+
+DegenFixedFilter::Scalar DegenFixedFilter::calculateObservationCovariance(
+    const typename BaseDegenFixedFilter::StaticZXMatrix &Hk,
+    const typename BaseDegenFixedFilter::StaticPMatrix &P, const uint16_t z,
+    typename BaseDegenFixedFilter::StaticXVector &PhT) const {
+  switch (z) {
+    case 0:
+      for (uint16_t i = 0; i < 9; ++i) {
+        PhT.set(i, 0, P.get(i, 0));
+      }
+      return PhT.get(0, 0);
+    case 1:
+      for (uint16_t i = 0; i < 9; ++i) {
+        PhT.set(i, 0, P.get(i, 2) + P.get(i, 3));
+      }
+      return PhT.get(2, 0) + PhT.get(3, 0);
+    default:
+      return 0;
+  }
+}
+} // namespace Clef::Fw::Kalman
@@ -0,0 +1,59 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+// This file is autogenerated by kalman.py.
+
+#pragma once
+
+#include <fw/KalmanFilter.h>
+
+namespace Clef::Fw::Kalman {
+using BaseDegenFixedFilter = Clef::Fw::ExtendedKalmanFilter<9, 1, 2, Clef::Util::Fixed<16>>;
+class DegenFixedFilter : public BaseDegenFixedFilter {
+ public:
+  static constexpr uint8_t OBSERVE_XS_IN = 1 << 0;
+  static constexpr uint8_t OBSERVE_PH_IN = 1 << 1;
+
+  DegenFixedFilter();
+  void evolve(
+      /* Control Variables */ const Scalar xe,
+      /* Observation Variables */ const Scalar xs_in, const Scalar Ph_in,
+      /* Time Step */ const Scalar deltat,
+      /* Observations Present */ const uint8_t observed = ALL_OBSERVATIONS);
+  void begin(
+      /* Control Variables */ const Scalar xe,
+      /* Observation Variables */ const Scalar xs_in, const Scalar Ph_in,
+      /* Time Step */ const Scalar deltat,
+      /* Observations Present */ const uint8_t observed = ALL_OBSERVATIONS);
+
+  /**
+   * State variable i without the scaling of the fixed-point filter.
+   */
+  Scalar getUnscaledState(const uint16_t i) const;
+
+  void init() override;
+
+ private:
+  void calculateStateTrans(
+      const typename BaseDegenFixedFilter::XVector &xk,
+      const typename BaseDegenFixedFilter::UVector &uk, const Scalar deltat,
+      typename BaseDegenFixedFilter::XVector &output) const override;
+  void calculateStateTransGradient(
+      const typename BaseDegenFixedFilter::XVector &xk,
+      const typename BaseDegenFixedFilter::UVector &uk, const Scalar deltat,
+      typename BaseDegenFixedFilter::FMatrix &output) const override;
+  void calculateObservationTrans(
+      const typename BaseDegenFixedFilter::XVector &xk,
+      typename BaseDegenFixedFilter::ZVector &output) const override;
+  void calculateObserationTransGradient(
+      const typename BaseDegenFixedFilter::XVector &xk,
+      typename BaseDegenFixedFilter::HMatrix &output) const override;
+  void predictCovariance(
+      const typename BaseDegenFixedFilter::StaticXXMatrix &Fk,
+      const typename BaseDegenFixedFilter::StaticPMatrix &P,
+      typename BaseDegenFixedFilter::StaticXXMatrix &FkP,
+      typename BaseDegenFixedFilter::StaticPMatrix &output) const override;
+  Scalar calculateObservationCovariance(
+      const typename BaseDegenFixedFilter::StaticZXMatrix &Hk,
+      const typename BaseDegenFixedFilter::StaticPMatrix &P, const uint16_t z,
+      typename BaseDegenFixedFilter::StaticXVector &PhT) const override;
+};
+}  // namespace Clef::Fw::Kalman
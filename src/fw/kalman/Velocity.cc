@@ -27,6 +27,7 @@ void VelocityFilter::evolve(const float xe, const float xs,
 }
 
 void VelocityFilter::init() {
+  resetGain();
   x_.set(0, 0, 0);
   x_.set(1, 0, 0);
   P_.set(0, 0, 5);
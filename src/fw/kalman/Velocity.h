@@ -3,7 +3,7 @@
 #include <fw/KalmanFilter.h>
 
 namespace Clef::Fw::Kalman {
-using BaseVelocityFilter = Clef::Fw::ExtendedKalmanFilter<2, 1, 1>;
+using BaseVelocityFilter = Clef::Fw::ExtendedKalmanFilter<2, 1, 1, float, true>;
 
 class VelocityFilter : public BaseVelocityFilter {
  public:
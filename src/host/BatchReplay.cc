@@ -0,0 +1,146 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "BatchReplay.h"
+
+#include <fw/kalman/Degen.h>
+#include <host/NpyFile.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <thread>
+
+namespace Clef::Host {
+namespace {
+const char *const INPUT_NAMES[] = {"xe-vs-t.npy", "xs-vs-t.npy",
+                                   "P-vs-t.npy"};
+
+bool isRun(const std::filesystem::path &dir) {
+  return std::filesystem::is_regular_file(dir / INPUT_NAMES[0]);
+}
+}  // namespace
+
+const char *const BatchReplay::OUTPUT_NAME = "replay-states.npy";
+
+std::vector<std::string> BatchReplay::findRuns(const std::string &root) {
+  std::vector<std::string> dirs;
+  std::error_code error;
+  if (isRun(root)) {
+    dirs.push_back(root);
+  } else if (std::filesystem::is_directory(root, error)) {
+    for (const std::filesystem::directory_entry &entry :
+         std::filesystem::directory_iterator(root, error)) {
+      if (entry.is_directory() && isRun(entry.path())) {
+        dirs.push_back(entry.path().string());
+      }
+    }
+    std::sort(dirs.begin(), dirs.end());
+  }
+  return dirs;
+}
+
+bool BatchReplay::load(const std::string &dir, Recording *const recording,
+                       std::string *const error) {
+  NpyFile xeFile, xsFile, PFile;
+  NpyFile *const files[] = {&xeFile, &xsFile, &PFile};
+  for (uint16_t i = 0; i < 3; ++i) {
+    const std::string path =
+        (std::filesystem::path(dir) / INPUT_NAMES[i]).string();
+    if (!files[i]->open(path, error)) {
+      return false;
+    }
+    if (files[i]->getNumColumns() != 2 ||
+        files[i]->getNumRows() != xeFile.getNumRows()) {
+      *error = path + ": expected as many (t, value) rows as xe";
+      return false;
+    }
+  }
+
+  *recording = Recording();
+  const double t0 = xeFile.getNumRows() > 0 ? xeFile.get(0, 0) : 0;
+  double xe0 = 0, xs0 = 0;
+  for (uint64_t i = 1; i < xeFile.getNumRows(); ++i) {
+    if (!(xeFile.get(i - 1, 0) < xeFile.get(i, 0))) {
+      continue;
+    }
+    if (xsFile.get(i, 0) != xeFile.get(i, 0) ||
+        PFile.get(i, 0) != xeFile.get(i, 0)) {
+      *error = dir + ": samples in row " + std::to_string(i) +
+               " have different times";
+      return false;
+    }
+    if (recording->t.empty()) {
+      xe0 = xeFile.get(i, 1);
+      xs0 = xsFile.get(i, 1);
+    }
+    recording->t.push_back((xeFile.get(i, 0) - t0) * 1e-6);
+    recording->xe.push_back(xeFile.get(i, 1) - xe0);
+    recording->xs.push_back(xsFile.get(i, 1) - xs0);
+    recording->P.push_back(PFile.get(i, 1));
+  }
+  return true;
+}
+
+BatchReplay::Run BatchReplay::replay(const std::string &dir) {
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  Run run = {dir, false, "", 0, 0};
+
+  Recording recording;
+  if (!load(dir, &recording, &run.error)) {
+    return run;
+  }
+  run.numSamples = recording.t.size();
+
+  Clef::Fw::Kalman::DegenFilter filter;
+  std::vector<double> output;
+  output.reserve(run.numSamples * NUM_OUTPUT_COLUMNS);
+  double tPrev = 0;
+  for (uint64_t i = 0; i < run.numSamples; ++i) {
+    filter.evolve(recording.xe[i], recording.xs[i], recording.P[i],
+                  recording.t[i] - tPrev);
+    tPrev = recording.t[i];
+
+    output.push_back(recording.t[i]);
+    for (uint16_t j = 0; j < NUM_STATES; ++j) {
+      output.push_back(filter.getState().get(j, 0));
+    }
+    for (uint16_t j = 0; j < NUM_STATES; ++j) {
+      output.push_back(filter.getCovariance().get(j, j));
+    }
+  }
+
+  const std::string outputPath =
+      (std::filesystem::path(dir) / OUTPUT_NAME).string();
+  if (!NpyFile::write(outputPath, output.data(), run.numSamples,
+                      NUM_OUTPUT_COLUMNS)) {
+    run.error = outputPath + ": cannot write";
+    return run;
+  }
+  run.success = true;
+  run.seconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  return run;
+}
+
+std::vector<BatchReplay::Run> BatchReplay::replayAll(
+    const std::vector<std::string> &dirs, const unsigned numThreads) {
+  // Each thread takes the next recording until there are none left
+  std::vector<Run> runs(dirs.size());
+  std::atomic<size_t> next(0);
+  std::vector<std::thread> threads;
+  for (unsigned i = 0; i < std::max(numThreads, 1u); ++i) {
+    threads.emplace_back([&dirs, &runs, &next]() {
+      for (size_t run; (run = next++) < dirs.size();) {
+        runs[run] = replay(dirs[run]);
+      }
+    });
+  }
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return runs;
+}
+}  // namespace Clef::Host
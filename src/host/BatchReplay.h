@@ -0,0 +1,74 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+/**
+ * Replay recordings of the extruder through the firmware's extrusion filter,
+ * as `kalman.py run` does with the Python model of the filter. A recording is
+ * a directory with xe-vs-t.npy, xs-vs-t.npy and P-vs-t.npy, as saved by
+ * tools/stream_data.py; it is prepared like utils.importDataFiles() and
+ * kalmanAnalysis() do (times after the first in seconds, rows whose time does
+ * not increase dropped, and positions relative to the first row kept). The
+ * trajectory of the filter is saved next to the recording.
+ */
+class BatchReplay {
+ public:
+  static constexpr uint16_t NUM_STATES = 9;
+
+  /**
+   * The trajectory has a row per sample with the time, then the state, then
+   * the diagonal of the covariance. Its name does not match the pattern of
+   * the recorded data, so the Python tools do not take it for input.
+   */
+  static constexpr uint16_t NUM_OUTPUT_COLUMNS = 1 + 2 * NUM_STATES;
+  static const char *const OUTPUT_NAME;
+
+  /**
+   * A recording as it is fed to the filter, with a row per sample.
+   */
+  struct Recording {
+    std::vector<double> t;  /*!< Seconds since the first row on disk. */
+    std::vector<double> xe; /*!< Relative to the first row. */
+    std::vector<double> xs; /*!< Relative to the first row. */
+    std::vector<double> P;
+  };
+
+  struct Run {
+    std::string dir;
+    bool success;
+    std::string error;
+    uint64_t numSamples;
+    double seconds; /*!< Time taken to replay. */
+  };
+
+  /**
+   * Get root if it is a recording, or else the recordings directly inside it,
+   * sorted by name.
+   */
+  static std::vector<std::string> findRuns(const std::string &root);
+
+  /**
+   * Read and prepare the recording in dir.
+   */
+  static bool load(const std::string &dir, Recording *const recording,
+                   std::string *const error);
+
+  /**
+   * Replay a single recording and save its trajectory.
+   */
+  static Run replay(const std::string &dir);
+
+  /**
+   * Replay recordings on numThreads threads at once; the results are in the
+   * same order as dirs.
+   */
+  static std::vector<Run> replayAll(const std::vector<std::string> &dirs,
+                                    const unsigned numThreads);
+};
+}  // namespace Clef::Host
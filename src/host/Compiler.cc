@@ -0,0 +1,265 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "Compiler.h"
+
+#include <math.h>
+#include <string.h>
+#include <util/Encoding.h>
+
+namespace Clef::Host {
+namespace {
+using Clef::Fw::Axes;
+using Clef::Fw::GcodeParser;
+using Clef::Fw::XYEPosition;
+using Clef::Fw::XYZEPosition;
+
+std::string encodeVarint(const uint32_t value) {
+  uint8_t buffer[5];
+  return std::string(reinterpret_cast<char *>(buffer),
+                     Clef::Util::encodeVarint(value, buffer));
+}
+
+/**
+ * Convert a speed in mm/s to the um/s of a SEGMENT frame.
+ */
+std::string encodeSpeed(const float speed) {
+  return encodeVarint(static_cast<uint32_t>(lround(speed * 1000)));
+}
+
+void getTargets(const XYZEPosition &position, int32_t *const targets) {
+  targets[0] = *Axes::XAxis::gcodePositionToStepper(position.x);
+  targets[1] = *Axes::YAxis::gcodePositionToStepper(position.y);
+  targets[2] = *Axes::ZAxis::gcodePositionToStepper(position.z);
+  targets[3] = *Axes::EAxis::gcodePositionToStepper(position.e);
+}
+
+XYZEPosition withXye(const XYZEPosition &position, const XYEPosition &xye) {
+  return {xye.x, xye.y, position.z, xye.e};
+}
+
+const uint8_t XY_FLAGS =
+    GcodeParser::BINARY_X_FLAG | GcodeParser::BINARY_Y_FLAG;
+const uint8_t XYE_FLAGS = XY_FLAGS | GcodeParser::BINARY_E_FLAG;
+
+/**
+ * Speed of a Z move in mm/s, as in Action::MoveZ.
+ */
+const float Z_SPEED = 10.0f;
+}  // namespace
+
+Compiler::Compiler()
+    : globalMutex_(std::make_shared<std::mutex>()),
+      clock_(),
+      serial_(globalMutex_),
+      actionQueue_(),
+      xyePositionQueue_(),
+      planner_(),
+      parser_(),
+      xAxisTimer_(),
+      yAxisTimer_(),
+      zAxisTimer_(),
+      eAxisTimer_(),
+      stepTimer_(),
+      displacementSensor_(clock_, 0.1),
+      pressureSensor_(clock_, 0.02),
+      extrusionPredictor_(0.2),
+      xAxis_(Clef::Impl::Emulator::xAxisStepper, xAxisTimer_),
+      yAxis_(Clef::Impl::Emulator::yAxisStepper, yAxisTimer_),
+      zAxis_(Clef::Impl::Emulator::zAxisStepper, zAxisTimer_),
+      eAxis_(Clef::Impl::Emulator::eAxisStepper, eAxisTimer_,
+             displacementSensor_, pressureSensor_, extrusionPredictor_),
+      axes_(xAxis_, yAxis_, zAxis_, eAxis_),
+      stepEngine_(axes_, stepTimer_),
+      context_({axes_, parser_, clock_, serial_, actionQueue_,
+                xyePositionQueue_, planner_, stepEngine_}),
+      nextLineNumber_(0),
+      targets_{0, 0, 0, 0},
+      knownAxes_(0),
+      feedrate_(planner_.getFeedrate()),
+      printTime_(0.0f) {
+  clock_.init();
+  serial_.init();
+  axes_.init();
+  stepEngine_.init();
+  emitLine("M110 N0");
+  emitLine("M880");
+}
+
+bool Compiler::compileLine(const char *const line, const size_t length,
+                           std::string *const error) {
+  // The stream is numbered and switched to binary mode by the compiler, so
+  // M-codes, line numbers and checksums cannot be passed through
+  const char *const comment =
+      static_cast<const char *>(memchr(line, ';', length));
+  const size_t codeLength = comment ? comment - line : length;
+  for (size_t i = 0; i < codeLength; ++i) {
+    if (line[i] == 'M' || line[i] == 'N' || line[i] == '*') {
+      *error = std::string("cannot compile '") + line[i] + "'";
+      return false;
+    }
+  }
+
+  serial_.inject(std::string(line, length) + "\n");
+  do {
+    makeRoom();
+    parser_.ingest(context_);
+  } while (serial_.isReadyToRead() || parser_.isBusy());
+  const std::string response = serial_.extract();
+  if (!response.empty() && response.compare(0, strlen(Clef::Fw::Str::OK),
+                                            Clef::Fw::Str::OK) != 0) {
+    *error = response.substr(0, response.find('\n'));
+    return false;
+  }
+  return true;
+}
+
+void Compiler::finish() {
+  while (actionQueue_.size() > 0) {
+    emitFront();
+  }
+  emitFrame(GcodeParser::FrameType::ASCII, "");
+}
+
+const std::string &Compiler::getOutput() const { return output_; }
+
+uint32_t Compiler::getNumRecords() const { return nextLineNumber_; }
+
+float Compiler::getPrintTime() const { return printTime_; }
+
+void Compiler::makeRoom() {
+  // A G1 needs up to three actions and one XYE point
+  while (actionQueue_.getNumSpacesLeft() < 3 ||
+         xyePositionQueue_.getNumSpacesLeft() < 1) {
+    emitFront();
+  }
+}
+
+void Compiler::emitFront() {
+  Clef::Fw::ActionQueue::Iterator it = actionQueue_.first();
+  const XYZEPosition startPosition = actionQueue_.getStartPosition();
+  int32_t startTargets[4], endTargets[4];
+  getTargets(startPosition, startTargets);
+  getTargets(it->getEndPosition(), endTargets);
+  switch (it->getType()) {
+    case Clef::Fw::Action::Type::MOVE_XY: {
+      // The entry and exit speeds are final since the action has gone through
+      // the whole lookahead window
+      const Clef::Fw::MotionProfile &profile =
+          it->get<Clef::Fw::Action::MoveXY>().getProfile();
+      if (emitTargets(GcodeParser::FrameType::SEGMENT, startTargets,
+                      endTargets, XY_FLAGS, 0,
+                      encodeSpeed(profile.nominalSpeed) +
+                          encodeSpeed(profile.maxEntrySpeed))) {
+        printTime_ += profile.getDuration();
+      }
+      break;
+    }
+    case Clef::Fw::Action::Type::MOVE_XYE: {
+      XYEPosition previous = startPosition.asXyePosition();
+      const uint32_t numPoints =
+          it->get<Clef::Fw::Action::MoveXYE>().getNumPointsPushed();
+      for (uint32_t i = 0; i < numPoints; ++i) {
+        const XYEPosition point = *xyePositionQueue_.first();
+        xyePositionQueue_.pop();
+        getTargets(withXye(startPosition, point), endTargets);
+
+        // The printer needs E and at least one of X and Y to queue the point
+        // as part of an extruding move
+        uint8_t requiredFlags = GcodeParser::BINARY_E_FLAG;
+        if (endTargets[0] == startTargets[0] &&
+            endTargets[1] == startTargets[1]) {
+          requiredFlags |= GcodeParser::BINARY_X_FLAG;
+        }
+        emitTargets(GcodeParser::FrameType::MOVE, startTargets, endTargets,
+                    XYE_FLAGS, requiredFlags, "");
+        memcpy(startTargets, endTargets, sizeof(startTargets));
+        printTime_ += (point - previous).getXyMagnitude() / (feedrate_ / 60);
+        previous = point;
+      }
+      break;
+    }
+    case Clef::Fw::Action::Type::MOVE_E:
+      // Extruder-only moves run at a tenth of the feedrate, as in MoveE
+      if (emitTargets(GcodeParser::FrameType::MOVE, startTargets, endTargets,
+                      GcodeParser::BINARY_E_FLAG, 0, "")) {
+        printTime_ += fabs(*it->getEndPosition().e - *startPosition.e) /
+                      (feedrate_ / 10 / 60);
+      }
+      break;
+    case Clef::Fw::Action::Type::MOVE_Z:
+      if (emitTargets(GcodeParser::FrameType::MOVE, startTargets, endTargets,
+                      GcodeParser::BINARY_Z_FLAG, 0, "")) {
+        printTime_ +=
+            fabs(*it->getEndPosition().z - *startPosition.z) / Z_SPEED;
+      }
+      break;
+    case Clef::Fw::Action::Type::SET_FEEDRATE:
+      feedrate_ = it->get<Clef::Fw::Action::SetFeedrate>().getFeedrate();
+      emitFrame(GcodeParser::FrameType::MOVE,
+                std::string(1, GcodeParser::BINARY_F_FLAG) +
+                    encodeVarint(static_cast<uint32_t>(lround(feedrate_))));
+      break;
+  }
+  actionQueue_.pop(context_);
+}
+
+bool Compiler::emitTargets(const GcodeParser::FrameType type,
+                           const int32_t *const startTargets,
+                           const int32_t *const endTargets,
+                           const uint8_t axisMask,
+                           const uint8_t requiredFlags,
+                           const std::string &suffix) {
+  // Only axes that move are sent, so that an axis which the G-code never
+  // mentions stays wherever the printer has it
+  uint8_t flags = requiredFlags;
+  for (uint8_t i = 0; i < 4; ++i) {
+    if ((axisMask & (1 << i)) && endTargets[i] != startTargets[i]) {
+      flags |= 1 << i;
+    }
+  }
+  if (!flags) {
+    return false;
+  }
+
+  // The printer's targets are only known once they have been sent absolutely
+  const bool absolute = flags & ~knownAxes_;
+  std::string arguments(
+      1, flags | (absolute ? GcodeParser::BINARY_ABSOLUTE_FLAG : 0));
+  for (uint8_t i = 0; i < 4; ++i) {
+    if (flags & (1 << i)) {
+      arguments += encodeVarint(Clef::Util::encodeZigzag(
+          absolute ? endTargets[i] : endTargets[i] - targets_[i]));
+      targets_[i] = endTargets[i];
+    }
+  }
+  knownAxes_ |= flags;
+  emitFrame(type, arguments + suffix);
+  return true;
+}
+
+void Compiler::emitFrame(const GcodeParser::FrameType type,
+                         const std::string &arguments) {
+  const std::string body = encodeVarint(nextLineNumber_++) +
+                           static_cast<char>(type) + arguments;
+  uint16_t crc = Clef::Util::crc16Update(Clef::Util::CRC16_INIT, body.size());
+  for (const char c : body) {
+    crc = Clef::Util::crc16Update(crc, c);
+  }
+  output_ += static_cast<char>(GcodeParser::BINARY_SYNC);
+  output_ += static_cast<char>(body.size());
+  output_ += body;
+  output_ += static_cast<char>(crc >> 8);
+  output_ += static_cast<char>(crc & 0xff);
+  output_ += '\n';
+}
+
+void Compiler::emitLine(const std::string &command) {
+  const std::string line =
+      "N" + std::to_string(nextLineNumber_++) + " " + command;
+  uint8_t checksum = 0;
+  for (const char c : line) {
+    checksum ^= static_cast<uint8_t>(c);
+  }
+  output_ += line + "*" + std::to_string(checksum) + "\n";
+}
+}  // namespace Clef::Host
@@ -0,0 +1,123 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/GcodeParser.h>
+#include <impl/emulator/Clock.h>
+#include <impl/emulator/PwmTimer.h>
+#include <impl/emulator/Serial.h>
+#include <impl/emulator/Stepper.h>
+#include <stdint.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace Clef::Host {
+/**
+ * Translate G-code into a stream which the firmware can execute without
+ * parsing or planning it. Every line is fed to the firmware's own G-code
+ * parser and planner running against emulated hardware; as actions leave the
+ * end of the queue (with the same lookahead as on the printer), they are
+ * written out as binary frames in microsteps:
+ *
+ *  - XY moves become SEGMENT frames carrying the planned nominal and junction
+ *    speeds;
+ *  - every point of an extruding move, and every Z, E and feedrate change,
+ *    becomes a MOVE frame.
+ *
+ * The output is a sequence of records, each ending in '\n', which are sent to
+ * the printer as they are: "M110 N0" and "M880" as numbered lines, then the
+ * frames numbered from 2, then an ASCII frame to return to G-code.
+ */
+class Compiler {
+ public:
+  Compiler();
+
+  /**
+   * Compile a line of G-code (without the newline); returns false and sets the
+   * error if the firmware would not accept it.
+   */
+  bool compileLine(const char *const line, const size_t length,
+                   std::string *const error);
+
+  /**
+   * Write out every action that is still queued and end the stream.
+   */
+  void finish();
+
+  /**
+   * Records written so far.
+   */
+  const std::string &getOutput() const;
+
+  /**
+   * Number of records (numbered lines and frames) written so far.
+   */
+  uint32_t getNumRecords() const;
+
+  /**
+   * Planned print time in seconds. Extruding moves are counted at the
+   * programmed feedrate, although the printer may slow them down to keep up
+   * with the extruder.
+   */
+  float getPrintTime() const;
+
+ private:
+  /**
+   * Write out actions until the queues have room for any line.
+   */
+  void makeRoom();
+
+  /**
+   * Write out the action at the front of the queue and remove it.
+   */
+  void emitFront();
+
+  /**
+   * Write a MOVE or SEGMENT frame with the target in usteps of every axis in
+   * the mask that moves, and of every required axis, followed by the rest of
+   * the arguments; returns false if there was nothing to send.
+   */
+  bool emitTargets(const Clef::Fw::GcodeParser::FrameType type,
+                   const int32_t *const startTargets,
+                   const int32_t *const endTargets, const uint8_t axisMask,
+                   const uint8_t requiredFlags, const std::string &suffix);
+
+  void emitFrame(const Clef::Fw::GcodeParser::FrameType type,
+                 const std::string &arguments);
+  void emitLine(const std::string &command);
+
+ private:
+  std::shared_ptr<std::mutex> globalMutex_;
+  Clef::Impl::Emulator::Clock clock_;
+  Clef::Impl::Emulator::Serial serial_;
+  Clef::Fw::ActionQueue actionQueue_;
+  Clef::Fw::XYEPositionQueue xyePositionQueue_;
+  Clef::Fw::Planner planner_;
+  Clef::Fw::GcodeParser parser_;
+  Clef::Impl::Emulator::GenericTimer xAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer yAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer zAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer eAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer stepTimer_;
+  Clef::Fw::DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E>
+      displacementSensor_;
+  Clef::Fw::PressureSensor pressureSensor_;
+  Clef::Fw::LinearExtrusionPredictor extrusionPredictor_;
+  Clef::Fw::Axes::XAxis xAxis_;
+  Clef::Fw::Axes::YAxis yAxis_;
+  Clef::Fw::Axes::ZAxis zAxis_;
+  Clef::Fw::Axes::EAxis eAxis_;
+  Clef::Fw::Axes axes_;
+  Clef::Fw::StepEngine stepEngine_;
+  Clef::Fw::Context context_;
+
+  std::string output_;
+  uint32_t nextLineNumber_;
+  int32_t targets_[4]; /*!< Last target of each axis in usteps. */
+  uint8_t knownAxes_;  /*!< Axes whose target the printer has been sent. */
+  float feedrate_;     /*!< Feedrate in raw mm/min. */
+  float printTime_;    /*!< Seconds. */
+};
+}  // namespace Clef::Host
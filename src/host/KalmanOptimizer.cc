@@ -0,0 +1,554 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "KalmanOptimizer.h"
+
+#include <fw/kalman/Degen.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <filesystem>
+
+namespace Clef::Host {
+namespace {
+using Clef::Fw::Kalman::DegenFilter;
+using Clef::Fw::KalmanTuning::Variable;
+
+constexpr uint16_t NUM_X = DegenFilter::StaticXVector::rows;
+constexpr uint16_t NUM_Z = DegenFilter::StaticZXMatrix::rows;
+
+/**
+ * The extrusion filter with the parameters of a candidate instead of the
+ * generated ones.
+ */
+class TunableDegenFilter : public DegenFilter {
+ public:
+  explicit TunableDegenFilter(const KalmanOptimizer::Params &params)
+      : DegenFilter(QMatrix(memQ_), RMatrix(memR_), WxMatrix(memWx_)),
+        params_(params) {
+    for (uint16_t i = 0; i < NUM_X; ++i) {
+      memQ_[i] = params.xvars[i].noise;
+      memWx_[i] = params.xvars[i].updateWeight;
+    }
+    for (uint16_t i = 0; i < NUM_Z; ++i) {
+      memR_[i] = params.zvars[i].noise;
+    }
+    init();
+  }
+
+  void init() override {
+    DegenFilter::init();
+    for (uint16_t i = 0; i < NUM_X; ++i) {
+      x_.set(i, 0, params_.xvars[i].initialValue);
+      P_.set(i, i, params_.xvars[i].initialCovariance);
+    }
+  }
+
+ private:
+  const KalmanOptimizer::Params &params_;
+  float memQ_[NUM_X];
+  float memR_[NUM_Z];
+  float memWx_[NUM_X];
+};
+
+// The metrics of tools/analysis/utils.py
+
+/**
+ * Moving average over int(1 / a) samples, as calculateLowpass().
+ */
+std::vector<double> lowpass(const std::vector<double> &data, const double a) {
+  const size_t halfKernel = static_cast<size_t>(1 / a) / 2;
+  std::vector<double> sums(data.size() + 1, 0);
+  for (size_t i = 0; i < data.size(); ++i) {
+    sums[i + 1] = sums[i] + data[i];
+  }
+  std::vector<double> output(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    const size_t begin = i > halfKernel ? i - halfKernel : 0;
+    const size_t end = std::min(data.size(), i + halfKernel);
+    output[i] = (sums[end] - sums[begin]) / (end - begin);
+  }
+  return output;
+}
+
+/**
+ * As calculateDerivative(), which gives 0 for the first sample.
+ */
+std::vector<double> derivative(const std::vector<double> &t,
+                               const std::vector<double> &data) {
+  std::vector<double> output(data.size(), 0);
+  for (size_t i = 1; i < data.size(); ++i) {
+    output[i] = (data[i] - data[i - 1]) / (t[i] - t[i - 1]);
+  }
+  return output;
+}
+
+double rms(const std::vector<double> &data) {
+  double sum = 0;
+  for (const double value : data) {
+    sum += value * value;
+  }
+  return sqrt(sum / data.size());
+}
+
+double averageAbs(const std::vector<double> &data) {
+  double sum = 0;
+  for (const double value : data) {
+    sum += fabs(value);
+  }
+  return sum / data.size();
+}
+
+std::vector<double> difference(const std::vector<double> &a,
+                               const std::vector<double> &b) {
+  std::vector<double> output(a.size());
+  for (size_t i = 0; i < a.size(); ++i) {
+    output[i] = a[i] - b[i];
+  }
+  return output;
+}
+
+std::vector<double> negativePart(const std::vector<double> &data) {
+  std::vector<double> output(data.size());
+  for (size_t i = 0; i < data.size(); ++i) {
+    output[i] = std::min(data[i], 0.0);
+  }
+  return output;
+}
+
+/**
+ * Find a series by name, or nullptr.
+ */
+const std::vector<double> *findSeries(
+    const std::map<std::string, const std::vector<double> *> &series,
+    const char *const name) {
+  const auto it = series.find(name);
+  return it != series.end() ? it->second : nullptr;
+}
+
+// The search of `kalman.py optimize`
+
+enum Param : uint16_t {
+  INITIAL_VALUE,
+  INITIAL_COVARIANCE,
+  NOISE,
+  UPDATE_WEIGHT,
+  NUM_PARAMS
+};
+
+const char *const PARAM_NAMES[NUM_PARAMS] = {
+    "initialValue", "initialCovariance", "noise", "updateWeight"};
+
+struct Change {
+  bool isZvar;
+  uint16_t index;
+  Param param;
+  double factor; /*!< The parameter is multiplied by 1 + factor. */
+};
+
+double &paramOf(Variable &var, const Param param) {
+  switch (param) {
+    case INITIAL_VALUE:
+      return var.initialValue;
+    case INITIAL_COVARIANCE:
+      return var.initialCovariance;
+    case NOISE:
+      return var.noise;
+    default:
+      return var.updateWeight;
+  }
+}
+
+/**
+ * Apply a change like manipulateKalmanSpec(), or return false if the
+ * parameter cannot change so: observation variables only have noise, zeros
+ * stay zero, and update weights stay between 0 and 1.
+ */
+bool applyChange(KalmanOptimizer::Params *const params, const Change &change) {
+  if (change.isZvar && change.param != NOISE) {
+    return false;
+  }
+  double &value = paramOf(
+      (change.isZvar ? params->zvars : params->xvars)[change.index],
+      change.param);
+  const double newValue = value * (1 + change.factor);
+  if (value == 0 ||
+      (change.param == UPDATE_WEIGHT && (newValue > 1 || newValue < 0))) {
+    return false;
+  }
+  value = newValue;
+  return true;
+}
+
+std::string labelOf(const KalmanOptimizer::Params &params,
+                    const Change &change) {
+  return std::string(
+             (change.isZvar ? params.zvars : params.xvars)[change.index]
+                 .name) +
+         "-" + PARAM_NAMES[change.param] + "-" +
+         (change.factor < 0 ? "dec" : "inc");
+}
+
+// Formatting like json.dump(indent=4, sort_keys=True)
+
+/**
+ * The shortest representation that reads back as the same double, in the
+ * notation of Python's repr().
+ */
+std::string formatNumber(const double value) {
+  if (isnan(value)) {
+    return "NaN";
+  } else if (isinf(value)) {
+    return value > 0 ? "Infinity" : "-Infinity";
+  }
+  char buffer[32];
+  for (int precision = 0; precision < 17; ++precision) {
+    snprintf(buffer, sizeof(buffer), "%.*e", precision, value);
+    if (strtod(buffer, nullptr) == value) {
+      break;
+    }
+  }
+
+  // Split "-d.ddde+XX" into its sign, digits and exponent
+  const char *const e = strchr(buffer, 'e');
+  const int exponent = atoi(e + 1);
+  const bool isNegative = buffer[0] == '-';
+  std::string digits;
+  for (const char *c = buffer + isNegative; c < e; ++c) {
+    if (*c != '.') {
+      digits += *c;
+    }
+  }
+
+  std::string output = isNegative ? "-" : "";
+  if (exponent >= 16 || exponent < -4) {
+    output += digits.substr(0, 1);
+    if (digits.size() > 1) {
+      output += "." + digits.substr(1);
+    }
+    snprintf(buffer, sizeof(buffer), "e%c%02d", exponent < 0 ? '-' : '+',
+             abs(exponent));
+    output += buffer;
+  } else if (exponent >= 0) {
+    if (digits.size() <= static_cast<size_t>(exponent) + 1) {
+      output += digits + std::string(exponent + 1 - digits.size(), '0') + ".0";
+    } else {
+      output += digits.substr(0, exponent + 1) + "." +
+                digits.substr(exponent + 1);
+    }
+  } else {
+    output += "0." + std::string(-exponent - 1, '0') + digits;
+  }
+  return output;
+}
+
+/**
+ * An object whose members are already formatted, at the given depth of
+ * nesting.
+ */
+std::string formatObject(const std::map<std::string, std::string> &members,
+                         const unsigned depth) {
+  if (members.empty()) {
+    return "{}";
+  }
+  const std::string indent(4 * (depth + 1), ' ');
+  std::string output = "{";
+  for (auto it = members.begin(); it != members.end(); ++it) {
+    output += (it == members.begin() ? "\n" : ",\n") + indent + "\"" +
+              it->first + "\": " + it->second;
+  }
+  return output + "\n" + std::string(4 * depth, ' ') + "}";
+}
+
+std::string formatCosts(const std::map<std::string, double> &costs,
+                        const unsigned depth) {
+  std::map<std::string, std::string> members;
+  for (const auto &[name, cost] : costs) {
+    members[name] = formatNumber(cost);
+  }
+  return formatObject(members, depth);
+}
+}  // namespace
+
+KalmanOptimizer::KalmanOptimizer(const unsigned numThreads)
+    : pool_(numThreads) {}
+
+KalmanOptimizer::Params KalmanOptimizer::getDefaultParams() {
+  const Clef::Fw::KalmanTuning::Spec &spec = DegenFilter::TUNING_SPEC;
+  return {{spec.xvars, spec.xvars + spec.numXvars},
+          {spec.zvars, spec.zvars + spec.numZvars}};
+}
+
+bool KalmanOptimizer::addDataset(const std::string &dir,
+                                 std::string *const error) {
+  Dataset dataset;
+  if (!BatchReplay::load(dir, &dataset.recording, error)) {
+    return false;
+  }
+  if (dataset.recording.t.empty()) {
+    *error = dir + ": no samples";
+    return false;
+  }
+  dataset.dxsdt = derivative(dataset.recording.t,
+                             lowpass(dataset.recording.xs, 0.1));
+  datasets_.push_back(std::move(dataset));
+  return true;
+}
+
+size_t KalmanOptimizer::getNumDatasets() const { return datasets_.size(); }
+
+KalmanOptimizer::Costs KalmanOptimizer::evaluate(const Params &params,
+                                                 const size_t index) const {
+  const Dataset &dataset = datasets_[index];
+  const BatchReplay::Recording &recording = dataset.recording;
+  const size_t numSamples = recording.t.size();
+
+  // The trajectory of every state and observation variable
+  TunableDegenFilter filter(params);
+  std::vector<std::vector<double>> trajectories(
+      NUM_X + NUM_Z, std::vector<double>(numSamples));
+  float zMem[NUM_Z];
+  DegenFilter::ZVector z(zMem);
+  double tPrev = 0;
+  for (size_t i = 0; i < numSamples; ++i) {
+    filter.evolve(recording.xe[i], recording.xs[i], recording.P[i],
+                  recording.t[i] - tPrev);
+    tPrev = recording.t[i];
+    for (uint16_t j = 0; j < NUM_X; ++j) {
+      trajectories[j][i] = filter.getState().get(j, 0);
+    }
+    filter.getObservation(z);
+    for (uint16_t j = 0; j < NUM_Z; ++j) {
+      trajectories[NUM_X + j][i] = z.get(j, 0);
+    }
+  }
+
+  // Must match the inputs of kalmanAnalysis()
+  const std::map<std::string, const std::vector<double> *> inputs = {
+      {"xe", &recording.xe},
+      {"xs_in", &recording.xs},
+      {"Ph_in", &recording.P},
+      {"dxsdt", &dataset.dxsdt}};
+  std::map<std::string, const std::vector<double> *> outputs;
+  for (uint16_t j = 0; j < NUM_X; ++j) {
+    outputs[params.xvars[j].name] = &trajectories[j];
+  }
+  for (uint16_t j = 0; j < NUM_Z; ++j) {
+    outputs[params.zvars[j].name] = &trajectories[NUM_X + j];
+  }
+
+  // A metric of a variable that does not exist costs NaN
+  const Clef::Fw::KalmanTuning::Spec &spec = DegenFilter::TUNING_SPEC;
+  Costs costs = {{}, {}, {}, 0};
+  for (uint16_t i = 0; i < spec.numErrorMetrics; ++i) {
+    const Clef::Fw::KalmanTuning::ErrorMetric &metric = spec.errorMetrics[i];
+    const std::vector<double> *const reference =
+        findSeries(inputs, metric.reference);
+    const std::vector<double> *const output =
+        findSeries(outputs, metric.output);
+    const double cost = reference && output
+                            ? metric.weight *
+                                  rms(difference(*reference, *output)) /
+                                  averageAbs(*reference)
+                            : NAN;
+    costs.error[metric.output] = cost;
+    costs.total += cost;
+  }
+  for (uint16_t i = 0; i < spec.numSmoothnessMetrics; ++i) {
+    const Clef::Fw::KalmanTuning::SmoothnessMetric &metric =
+        spec.smoothnessMetrics[i];
+    const std::vector<double> *const output =
+        findSeries(outputs, metric.output);
+    const double cost =
+        output ? metric.weight *
+                     rms(difference(*output,
+                                    lowpass(*output, metric.filterCoef))) /
+                     rms(*output)
+               : NAN;
+    costs.smoothness[metric.output] = cost;
+    costs.total += cost;
+  }
+  for (uint16_t i = 0; i < spec.numNegativityMetrics; ++i) {
+    const Clef::Fw::KalmanTuning::NegativityMetric &metric =
+        spec.negativityMetrics[i];
+    const std::vector<double> *const output =
+        findSeries(outputs, metric.output);
+    const double cost =
+        output ? metric.weight * rms(negativePart(*output)) / rms(*output)
+               : NAN;
+    costs.negativity[metric.output] = cost;
+    costs.total += cost;
+  }
+  return costs;
+}
+
+KalmanOptimizer::Costs KalmanOptimizer::evaluate(const Params &params) {
+  return evaluateAll({params})[0];
+}
+
+std::vector<KalmanOptimizer::Costs> KalmanOptimizer::evaluateAll(
+    const std::vector<Params> &candidates) {
+  std::vector<std::vector<Costs>> results(
+      candidates.size(), std::vector<Costs>(datasets_.size()));
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    for (size_t j = 0; j < datasets_.size(); ++j) {
+      pool_.submit([this, &candidates, &results, i, j]() {
+        results[i][j] = evaluate(candidates[i], j);
+      });
+    }
+  }
+  pool_.wait();
+
+  // Average with the number of samples as weights; NaN if any is NaN
+  double totalWeight = 0;
+  for (const Dataset &dataset : datasets_) {
+    totalWeight += dataset.recording.t.size();
+  }
+  std::vector<Costs> output(candidates.size(), Costs{{}, {}, {}, 0});
+  for (size_t i = 0; i < candidates.size(); ++i) {
+    for (size_t j = 0; j < datasets_.size(); ++j) {
+      const double weight = datasets_[j].recording.t.size() / totalWeight;
+      const Costs &costs = results[i][j];
+      for (const auto &[name, cost] : costs.error) {
+        output[i].error[name] += weight * cost;
+      }
+      for (const auto &[name, cost] : costs.smoothness) {
+        output[i].smoothness[name] += weight * cost;
+      }
+      for (const auto &[name, cost] : costs.negativity) {
+        output[i].negativity[name] += weight * cost;
+      }
+      output[i].total += weight * costs.total;
+    }
+    if (datasets_.empty()) {
+      output[i].total = NAN;
+    }
+  }
+  return output;
+}
+
+KalmanOptimizer::Params KalmanOptimizer::optimize(
+    const Params &initial, const double stepSize, const unsigned maxRounds,
+    const std::string &outputDir, FILE *const log) {
+  Params params = initial;
+  Costs best = evaluate(params);
+  for (unsigned n = 0; n < maxRounds; ++n) {
+    if (log) {
+      fprintf(log, "==== Round %u ====\nReference cost is %g\n", n,
+              best.total);
+    }
+
+    // Try every parameter up and down at once
+    const double step = stepSize * exp(-static_cast<double>(n) / 20);
+    std::vector<Change> changes;
+    std::vector<Params> candidates;
+    for (const bool isZvar : {false, true}) {
+      const uint16_t numVars = (isZvar ? params.zvars : params.xvars).size();
+      for (uint16_t index = 0; index < numVars; ++index) {
+        for (uint16_t param = 0; param < NUM_PARAMS; ++param) {
+          for (const double factor : {-step, step}) {
+            const Change change = {isZvar, index, static_cast<Param>(param),
+                                   factor};
+            Params candidate = params;
+            if (applyChange(&candidate, change)) {
+              changes.push_back(change);
+              candidates.push_back(std::move(candidate));
+            }
+          }
+        }
+      }
+    }
+    const std::vector<Costs> costs = evaluateAll(candidates);
+    std::vector<size_t> order;
+    for (size_t i = 0; i < costs.size(); ++i) {
+      if (!isnan(costs[i].total)) {
+        order.push_back(i);
+      }
+    }
+    std::stable_sort(order.begin(), order.end(), [&costs](size_t a, size_t b) {
+      return costs[a].total < costs[b].total;
+    });
+
+    // Apply the changes from the cheapest while they keep lowering the cost;
+    // the first one has already been evaluated on its own
+    bool hasImproved = false;
+    for (size_t i = 0; i < order.size(); ++i) {
+      Params next = params;
+      if (!applyChange(&next, changes[order[i]])) {
+        break;
+      }
+      const Costs nextCosts = i == 0 ? costs[order[i]] : evaluate(next);
+      if (isnan(nextCosts.total) ||
+          !(isnan(best.total) || nextCosts.total < best.total)) {
+        break;
+      }
+      params = std::move(next);
+      best = nextCosts;
+      hasImproved = true;
+      if (log) {
+        fprintf(log, "Applying %s optimizes down to %g\n",
+                labelOf(params, changes[order[i]]).c_str(), best.total);
+      }
+    }
+
+    writeSummary((std::filesystem::path(outputDir) /
+                  ("opt" + std::to_string(n)) / "summary.json")
+                     .string(),
+                 params, best);
+    if (!hasImproved) {
+      break;
+    }
+  }
+  writeSummary((std::filesystem::path(outputDir) / "summary.json").string(),
+               params, best);
+  return params;
+}
+
+std::string KalmanOptimizer::formatSummary(const Params &params,
+                                           const Costs &costs) {
+  const Clef::Fw::KalmanTuning::Spec &spec = DegenFilter::TUNING_SPEC;
+  std::map<std::string, std::string> vars;
+  for (const Variable &var : params.xvars) {
+    vars[var.name] = formatObject(
+        {{"initialCovariance", formatNumber(var.initialCovariance)},
+         {"initialValue", formatNumber(var.initialValue)},
+         {"mode", "\"xvar\""},
+         {"noise", formatNumber(var.noise)},
+         {"updateWeight", formatNumber(var.updateWeight)}},
+        2);
+  }
+  for (const Variable &var : params.zvars) {
+    vars[var.name] = formatObject(
+        {{"mode", "\"zvar\""}, {"noise", formatNumber(var.noise)}}, 2);
+  }
+  for (uint16_t i = 0; i < spec.numUvars; ++i) {
+    vars[spec.uvars[i].name] = formatObject({{"mode", "\"uvar\""}}, 2);
+  }
+  return formatObject(
+      {{"cost", formatNumber(costs.total)},
+       {"metrics", formatObject({{"error", formatCosts(costs.error, 2)},
+                                 {"negativity",
+                                  formatCosts(costs.negativity, 2)},
+                                 {"smoothness",
+                                  formatCosts(costs.smoothness, 2)}},
+                                1)},
+       {"vars", formatObject(vars, 1)}},
+      0);
+}
+
+bool KalmanOptimizer::writeSummary(const std::string &path,
+                                   const Params &params, const Costs &costs) {
+  std::error_code error;
+  std::filesystem::create_directories(
+      std::filesystem::path(path).parent_path(), error);
+  FILE *const output = fopen(path.c_str(), "w");
+  if (!output) {
+    return false;
+  }
+  const std::string summary = formatSummary(params, costs);
+  const bool success =
+      fwrite(summary.data(), 1, summary.size(), output) == summary.size();
+  return fclose(output) == 0 && success;
+}
+}  // namespace Clef::Host
@@ -0,0 +1,103 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/KalmanTuning.h>
+#include <host/BatchReplay.h>
+#include <host/WorkStealingPool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+/**
+ * Tune the noise, update weights and initial state of the firmware's
+ * extrusion filter on recordings of the extruder, as `kalman.py optimize`
+ * does with the Python model of the filter. Costs are the error, smoothness
+ * and negativity metrics of the model (DegenFilter::TUNING_SPEC) and are
+ * averaged over the recordings like analyzeBatch() does. Every pair of
+ * candidate parameters and recording is a task for a WorkStealingPool.
+ */
+class KalmanOptimizer {
+ public:
+  /**
+   * Parameters of the filter, in the order of the variables of the spec.
+   */
+  struct Params {
+    std::vector<Clef::Fw::KalmanTuning::Variable> xvars;
+    std::vector<Clef::Fw::KalmanTuning::Variable> zvars;
+  };
+
+  /**
+   * The cost of each metric by the name of its output variable, and the sum
+   * of all of them. The total is NaN if the filter diverges.
+   */
+  struct Costs {
+    std::map<std::string, double> error;
+    std::map<std::string, double> smoothness;
+    std::map<std::string, double> negativity;
+    double total;
+  };
+
+  explicit KalmanOptimizer(const unsigned numThreads);
+
+  /**
+   * The parameters that the filter was generated with.
+   */
+  static Params getDefaultParams();
+
+  /**
+   * Load a recording (see BatchReplay) to tune on.
+   */
+  bool addDataset(const std::string &dir, std::string *const error);
+  size_t getNumDatasets() const;
+
+  /**
+   * Costs of one recording.
+   */
+  Costs evaluate(const Params &params, const size_t dataset) const;
+
+  /**
+   * Costs of every recording, weighted by their numbers of samples.
+   */
+  Costs evaluate(const Params &params);
+
+  /**
+   * Run rounds of the search of `kalman.py optimize` from initial: try
+   * scaling each parameter up and down by stepSize * exp(-n / 20) in round
+   * n, then apply the changes from the cheapest up for as long as each one
+   * lowers the cost. Stops after a round that does not lower the cost or
+   * after maxRounds. Writes opt<n>/summary.json after each round and
+   * summary.json at the end to outputDir, and progress to log if there is
+   * one. Returns the best parameters.
+   */
+  Params optimize(const Params &initial, const double stepSize,
+                  const unsigned maxRounds, const std::string &outputDir,
+                  FILE *const log = nullptr);
+
+  /**
+   * Format parameters and their costs like the summary.json of
+   * kalmanAnalysis(), which `kalman.py --override-params` reads.
+   */
+  static std::string formatSummary(const Params &params, const Costs &costs);
+  static bool writeSummary(const std::string &path, const Params &params,
+                           const Costs &costs);
+
+ private:
+  struct Dataset {
+    BatchReplay::Recording recording;
+    std::vector<double> dxsdt; /*!< Derivative of the smoothed xs. */
+  };
+
+  /**
+   * Costs of many sets of parameters over every recording at once.
+   */
+  std::vector<Costs> evaluateAll(const std::vector<Params> &candidates);
+
+  std::vector<Dataset> datasets_;
+  WorkStealingPool pool_;
+};
+}  // namespace Clef::Host
@@ -0,0 +1,97 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "KalmanReplay.h"
+
+#include <fw/ExtrusionPredictor.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace Clef::Host {
+namespace {
+using Scalar = Clef::Fw::Kalman::DegenFixedFilter::Scalar;
+}  // namespace
+
+KalmanReplay::KalmanReplay()
+    : floatFilter_(), fixedFilter_(), numSamples_(0), first_(), t_(0),
+      origin_(0) {
+  memset(maxErrors_, 0, sizeof(maxErrors_));
+  memset(sumSquaredErrors_, 0, sizeof(sumSquaredErrors_));
+  memset(maxMagnitudes_, 0, sizeof(maxMagnitudes_));
+}
+
+bool KalmanReplay::parseSample(const char *const line, Sample *const sample) {
+  double t;
+  int length = 0;
+  if (sscanf(line, ";t=%lf,xe=%f,xs=%f,P=%f%n", &t, &sample->xe, &sample->xs,
+             &sample->P, &length) != 4 ||
+      (line[length] != '\0' && line[length] != '\r' && line[length] != '\n')) {
+    return false;
+  }
+  sample->t = t / 1000000;
+  return true;
+}
+
+void KalmanReplay::evolve(const Sample &sample) {
+  // The first sample resets both filters, as a reset of the predictor would
+  if (numSamples_++ == 0) {
+    first_ = sample;
+    t_ = sample.t;
+    floatFilter_.init();
+    fixedFilter_.init();
+    origin_ = 0;
+  }
+  const float xe = sample.xe - first_.xe;
+  const float xs = sample.xs - first_.xs;
+  const float deltat = sample.t - t_;
+  t_ = sample.t;
+  const float distance = xe - origin_;
+  if (fabs(distance) >
+      Clef::Fw::FixedPointKalmanFilterExtrusionPredictor::REBASE_DISTANCE) {
+    const float offset = static_cast<int32_t>(distance);
+    origin_ += offset;
+    fixedFilter_.offsetState(0, Scalar(static_cast<double>(-offset)));
+  }
+  floatFilter_.evolve(xe, xs, sample.P, deltat);
+  fixedFilter_.evolve(Scalar(static_cast<double>(xe - origin_)),
+                      Scalar(static_cast<double>(xs - origin_)),
+                      Scalar(static_cast<double>(sample.P)),
+                      Scalar(static_cast<double>(deltat)));
+
+  for (uint16_t i = 0; i < NUM_STATES; ++i) {
+    const float expected = floatFilter_.getState().get(i, 0);
+    const float error = fabs(fixedFilter_.getUnscaledState(i).toFloat() +
+                             (i == 0 ? origin_ : 0) - expected);
+    if (error > maxErrors_[i] || isnan(error)) {
+      maxErrors_[i] = error;
+    }
+    sumSquaredErrors_[i] += static_cast<double>(error) * error;
+    if (fabs(expected) > maxMagnitudes_[i]) {
+      maxMagnitudes_[i] = fabs(expected);
+    }
+  }
+}
+
+uint32_t KalmanReplay::getNumSamples() const { return numSamples_; }
+
+const Clef::Fw::Kalman::DegenFilter &KalmanReplay::getFloatFilter() const {
+  return floatFilter_;
+}
+
+const Clef::Fw::Kalman::DegenFixedFilter &KalmanReplay::getFixedFilter()
+    const {
+  return fixedFilter_;
+}
+
+float KalmanReplay::getMaxError(const uint16_t i) const {
+  return maxErrors_[i];
+}
+
+float KalmanReplay::getRmsError(const uint16_t i) const {
+  return numSamples_ > 0 ? sqrt(sumSquaredErrors_[i] / numSamples_) : 0;
+}
+
+float KalmanReplay::getRelativeError(const uint16_t i) const {
+  return maxErrors_[i] / (maxMagnitudes_[i] > 1 ? maxMagnitudes_[i] : 1);
+}
+}  // namespace Clef::Host
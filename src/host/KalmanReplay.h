@@ -0,0 +1,69 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/kalman/Degen.h>
+#include <fw/kalman/DegenFixed.h>
+#include <stdint.h>
+
+namespace Clef::Host {
+/**
+ * Replay samples of the extruder (as logged by the firmware) through the
+ * float and the fixed-point extrusion filters side by side, and measure how
+ * far the state of the fixed-point filter strays from the float one. Both
+ * filters are fed like the extrusion predictors: positions relative to the
+ * first sample (and for the fixed-point filter, to an origin that follows the
+ * extruder, as in the FixedPointKalmanFilterExtrusionPredictor) and the time
+ * since the previous sample.
+ */
+class KalmanReplay {
+ public:
+  static constexpr uint16_t NUM_STATES = 9;
+
+  struct Sample {
+    double t; /*!< Seconds. */
+    float xe; /*!< Extruder position in usteps. */
+    float xs; /*!< Sensor position in usteps. */
+    float P;  /*!< Pressure in Pa. */
+  };
+
+  KalmanReplay();
+
+  /**
+   * Parse a line such as ";t=<usec>,xe=<usteps>,xs=<usteps>,P=<Pa>"; returns
+   * false if the line is not a complete sample.
+   */
+  static bool parseSample(const char *const line, Sample *const sample);
+
+  void evolve(const Sample &sample);
+
+  uint32_t getNumSamples() const;
+
+  const Clef::Fw::Kalman::DegenFilter &getFloatFilter() const;
+  const Clef::Fw::Kalman::DegenFixedFilter &getFixedFilter() const;
+
+  /**
+   * Largest and root-mean-square absolute difference between the filters in
+   * state variable i over every sample so far.
+   */
+  float getMaxError(const uint16_t i) const;
+  float getRmsError(const uint16_t i) const;
+
+  /**
+   * Largest absolute difference in state variable i relative to the largest
+   * magnitude (but at least 1) that the float filter gave it.
+   */
+  float getRelativeError(const uint16_t i) const;
+
+ private:
+  Clef::Fw::Kalman::DegenFilter floatFilter_;
+  Clef::Fw::Kalman::DegenFixedFilter fixedFilter_;
+  uint32_t numSamples_;
+  Sample first_;
+  double t_;
+  float origin_; /*!< Origin of the fixed-point filter relative to first_. */
+  float maxErrors_[NUM_STATES];
+  double sumSquaredErrors_[NUM_STATES];
+  float maxMagnitudes_[NUM_STATES];
+};
+}  // namespace Clef::Host
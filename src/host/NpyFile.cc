@@ -0,0 +1,229 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "NpyFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Clef::Host {
+namespace {
+const char MAGIC[] = "\x93NUMPY";
+const size_t MAGIC_LENGTH = 6;
+
+/**
+ * Find the value of a key in the header dictionary, skipping whitespace.
+ */
+const char *findValue(const std::string &header, const char *const key) {
+  const size_t position = header.find(key);
+  if (position == std::string::npos) {
+    return nullptr;
+  }
+  const char *value = header.c_str() + position + strlen(key);
+  while (*value == ' ' || *value == ':') {
+    value++;
+  }
+  return value;
+}
+}  // namespace
+
+NpyFile::NpyFile()
+    : map_(nullptr),
+      mapSize_(0),
+      data_(nullptr),
+      elementType_(ElementType::FLOAT64),
+      elementSize_(8),
+      numRows_(0),
+      numColumns_(0) {}
+
+NpyFile::~NpyFile() { close(); }
+
+bool NpyFile::open(const std::string &path, std::string *const error) {
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) < 0) {
+    *error = path + ": " + strerror(errno);
+    if (fd >= 0) {
+      ::close(fd);
+    }
+    return false;
+  }
+  mapSize_ = fileStat.st_size;
+  map_ = mapSize_ > 0
+             ? mmap(nullptr, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0)
+             : MAP_FAILED;
+  ::close(fd);
+  if (map_ == MAP_FAILED) {
+    map_ = nullptr;
+    *error = path + ": cannot map file";
+    return false;
+  }
+
+  // Version 1 has a 2-byte header length, later versions a 4-byte one
+  const uint8_t *const bytes = static_cast<const uint8_t *>(map_);
+  if (mapSize_ < MAGIC_LENGTH + 6 ||
+      memcmp(bytes, MAGIC, MAGIC_LENGTH) != 0) {
+    *error = path + ": not a .npy file";
+    close();
+    return false;
+  }
+  const bool isVersion1 = bytes[MAGIC_LENGTH] == 1;
+  const size_t headerStart = MAGIC_LENGTH + (isVersion1 ? 4 : 6);
+  const size_t headerLength =
+      bytes[8] | (bytes[9] << 8) |
+      (isVersion1 ? 0
+                  : (bytes[10] << 16) | (static_cast<size_t>(bytes[11]) << 24));
+  if (headerStart + headerLength > mapSize_) {
+    *error = path + ": truncated header";
+    close();
+    return false;
+  }
+  std::string headerError;
+  if (!parseHeader(std::string(reinterpret_cast<const char *>(bytes) +
+                                   headerStart,
+                               headerLength),
+                   &headerError)) {
+    *error = path + ": " + headerError;
+    close();
+    return false;
+  }
+  data_ = bytes + headerStart + headerLength;
+  if (numRows_ * numColumns_ * elementSize_ >
+      mapSize_ - headerStart - headerLength) {
+    *error = path + ": truncated data";
+    close();
+    return false;
+  }
+  return true;
+}
+
+void NpyFile::close() {
+  if (map_) {
+    munmap(map_, mapSize_);
+  }
+  map_ = nullptr;
+  mapSize_ = 0;
+  data_ = nullptr;
+  numRows_ = 0;
+  numColumns_ = 0;
+}
+
+uint64_t NpyFile::getNumRows() const { return numRows_; }
+
+uint64_t NpyFile::getNumColumns() const { return numColumns_; }
+
+double NpyFile::get(const uint64_t row, const uint64_t column) const {
+  const uint8_t *const element =
+      data_ + (row * numColumns_ + column) * elementSize_;
+  switch (elementType_) {
+    case ElementType::INT32: {
+      int32_t value;
+      memcpy(&value, element, sizeof(value));
+      return value;
+    }
+    case ElementType::INT64: {
+      int64_t value;
+      memcpy(&value, element, sizeof(value));
+      return value;
+    }
+    case ElementType::FLOAT32: {
+      float value;
+      memcpy(&value, element, sizeof(value));
+      return value;
+    }
+    default: {
+      double value;
+      memcpy(&value, element, sizeof(value));
+      return value;
+    }
+  }
+}
+
+bool NpyFile::write(const std::string &path, const double *const data,
+                    const uint64_t numRows, const uint64_t numColumns) {
+  // The header is padded with spaces so that the data is 64-byte aligned
+  char dict[128];
+  const int dictLength = snprintf(
+      dict, sizeof(dict),
+      "{'descr': '<f8', 'fortran_order': False, 'shape': (%llu, %llu), }",
+      static_cast<unsigned long long>(numRows),
+      static_cast<unsigned long long>(numColumns));
+  std::string header(MAGIC, MAGIC_LENGTH);
+  header += '\x01';
+  header += '\x00';
+  const size_t headerLength =
+      (MAGIC_LENGTH + 4 + dictLength + 1 + 63) / 64 * 64 - MAGIC_LENGTH - 4;
+  header += static_cast<char>(headerLength & 0xff);
+  header += static_cast<char>(headerLength >> 8);
+  header += dict;
+  header.append(headerLength - dictLength - 1, ' ');
+  header += '\n';
+
+  FILE *const output = fopen(path.c_str(), "wb");
+  if (!output) {
+    return false;
+  }
+  const size_t numElements = numRows * numColumns;
+  const bool success =
+      fwrite(header.data(), 1, header.size(), output) == header.size() &&
+      fwrite(data, sizeof(double), numElements, output) == numElements;
+  return fclose(output) == 0 && success;
+}
+
+bool NpyFile::parseHeader(const std::string &header,
+                          std::string *const error) {
+  const char *const descr = findValue(header, "'descr'");
+  const char *const fortranOrder = findValue(header, "'fortran_order'");
+  const char *const shape = findValue(header, "'shape'");
+  if (!descr || !fortranOrder || !shape) {
+    *error = "invalid header";
+    return false;
+  }
+
+  if (strncmp(descr, "'<i4'", 5) == 0) {
+    elementType_ = ElementType::INT32;
+    elementSize_ = 4;
+  } else if (strncmp(descr, "'<i8'", 5) == 0) {
+    elementType_ = ElementType::INT64;
+    elementSize_ = 8;
+  } else if (strncmp(descr, "'<f4'", 5) == 0) {
+    elementType_ = ElementType::FLOAT32;
+    elementSize_ = 4;
+  } else if (strncmp(descr, "'<f8'", 5) == 0) {
+    elementType_ = ElementType::FLOAT64;
+    elementSize_ = 8;
+  } else {
+    *error = "unsupported element type";
+    return false;
+  }
+  if (strncmp(fortranOrder, "False", 5) != 0) {
+    *error = "unsupported Fortran order";
+    return false;
+  }
+
+  // The shape is (rows,) or (rows, columns)
+  char *end;
+  if (*shape != '(') {
+    *error = "invalid shape";
+    return false;
+  }
+  numRows_ = strtoull(shape + 1, &end, 10);
+  numColumns_ = 1;
+  if (*end == ',' && end[1] == ' ' && end[2] != ')') {
+    numColumns_ = strtoull(end + 2, &end, 10);
+  } else if (*end == ',') {
+    end++;
+  }
+  if (*end != ')') {
+    *error = "unsupported shape";
+    return false;
+  }
+  return true;
+}
+}  // namespace Clef::Host
@@ -0,0 +1,64 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+namespace Clef::Host {
+/**
+ * Read-only view of a two-dimensional array saved by numpy.save(), such as the
+ * "<name>-vs-t.npy" files written by tools/stream_data.py. The file is
+ * memory-mapped rather than read, so only the rows which are used are paged
+ * in. Little-endian integers and floats of 4 or 8 bytes in C order are
+ * supported; a one-dimensional array has a single column.
+ */
+class NpyFile {
+ public:
+  NpyFile();
+  ~NpyFile();
+  NpyFile(const NpyFile &) = delete;
+  NpyFile &operator=(const NpyFile &) = delete;
+
+  /**
+   * Map a file, replacing any file already open; returns false and sets the
+   * error if the file cannot be read or is not a supported array.
+   */
+  bool open(const std::string &path, std::string *const error);
+  void close();
+
+  uint64_t getNumRows() const;
+  uint64_t getNumColumns() const;
+
+  /**
+   * Element converted to a double.
+   */
+  double get(const uint64_t row, const uint64_t column) const;
+
+  /**
+   * Save numRows * numColumns doubles in row-major order as a float64 array in
+   * the format of numpy.save().
+   */
+  static bool write(const std::string &path, const double *const data,
+                    const uint64_t numRows, const uint64_t numColumns);
+
+ private:
+  enum class ElementType : uint8_t { INT32, INT64, FLOAT32, FLOAT64 };
+
+  /**
+   * Parse the header dictionary, e.g.
+   *   {'descr': '<i8', 'fortran_order': False, 'shape': (1234, 2), }
+   */
+  bool parseHeader(const std::string &header, std::string *const error);
+
+  void *map_;
+  size_t mapSize_;
+  const uint8_t *data_;
+  ElementType elementType_;
+  uint8_t elementSize_;
+  uint64_t numRows_;
+  uint64_t numColumns_;
+};
+}  // namespace Clef::Host
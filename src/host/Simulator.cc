@@ -0,0 +1,318 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "Simulator.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+namespace Clef::Host {
+namespace {
+using HostClock = std::chrono::steady_clock;
+
+double secondsSince(const HostClock::time_point start) {
+  return std::chrono::duration<double>(HostClock::now() - start).count();
+}
+
+/**
+ * Number a command and append its checksum, as tools/print.py does.
+ */
+std::string frameLine(const uint32_t lineNumber, const std::string &command) {
+  const std::string line = "N" + std::to_string(lineNumber) + " " + command;
+  uint8_t checksum = 0;
+  for (const char c : line) {
+    checksum ^= static_cast<uint8_t>(c);
+  }
+  return line + "*" + std::to_string(checksum) + "\n";
+}
+
+Clef::Fw::ExtrusionPredictor *makePredictor(
+    const Simulator::Predictor predictor) {
+  switch (predictor) {
+    case Simulator::Predictor::LINEAR:
+      return new Clef::Fw::LinearExtrusionPredictor(0.2);
+    case Simulator::Predictor::FIXED_POINT_KALMAN:
+      return new Clef::Fw::FixedPointKalmanFilterExtrusionPredictor();
+    case Simulator::Predictor::KALMAN:
+    default:
+      return new Clef::Fw::KalmanFilterExtrusionPredictor();
+  }
+}
+}  // namespace
+
+const Simulator::Options Simulator::DEFAULT_OPTIONS = {
+    Predictor::KALMAN,
+    200,
+    57600,
+    8,
+    10000,
+    86400000000ULL,
+    250.0f,
+    100.0f,
+    Clef::Impl::Emulator::SyringePlant::DEGEN_PARAMS,
+    0,
+};
+
+Simulator::Simulator(const Options &options)
+    : options_(options),
+      globalMutex_(std::make_shared<std::mutex>()),
+      clock_(),
+      scheduler_(clock_),
+      serial_(globalMutex_),
+      spi_(),
+      plant_(options.plant, options.seed),
+      actionQueue_(),
+      xyePositionQueue_(),
+      planner_(),
+      parser_(),
+      xyAxisTimer_(),
+      zeAxisTimer_(),
+      stepTimer_(),
+      caliperTimer_(),
+      pressureTimer_(),
+      displacementSensorInput_(),
+      displacementSensor_(clock_, 0.1, Clef::Fw::SensorPublication::SEQLOCK),
+      pressureSensor_(clock_, 1, Clef::Fw::SensorPublication::SEQLOCK),
+      extrusionPredictor_(makePredictor(options.predictor)),
+      xAxis_(Clef::Impl::Emulator::xAxisStepper, xyAxisTimer_),
+      yAxis_(Clef::Impl::Emulator::yAxisStepper, xyAxisTimer_),
+      zAxis_(Clef::Impl::Emulator::zAxisStepper, zeAxisTimer_),
+      eAxis_(Clef::Impl::Emulator::eAxisStepper, zeAxisTimer_,
+             displacementSensor_, pressureSensor_, *extrusionPredictor_),
+      axes_(xAxis_, yAxis_, zAxis_, eAxis_),
+      stepEngine_(axes_, stepTimer_),
+      context_({axes_, parser_, clock_, serial_, actionQueue_,
+                xyePositionQueue_, planner_, stepEngine_}),
+      isExtruderInitialized_(false),
+      action_(actionQueue_.first()),
+      numAcked_(0),
+      numSent_(0),
+      holdUntilNanos_(0),
+      stats_() {
+  // The steppers of the emulator are global, so they start from the origin
+  Clef::Impl::Emulator::xAxisStepper = Clef::Impl::Emulator::XAxisStepper();
+  Clef::Impl::Emulator::yAxisStepper = Clef::Impl::Emulator::YAxisStepper();
+  Clef::Impl::Emulator::zAxisStepper = Clef::Impl::Emulator::ZAxisStepper();
+  Clef::Impl::Emulator::eAxisStepper = Clef::Impl::Emulator::EAxisStepper();
+  clock_.init();
+  serial_.init();
+  axes_.init();
+  stepEngine_.init();
+
+  displacementSensorInput_.init();
+  displacementSensorInput_.setConversionCallback(
+      Clef::Fw::DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT,
+                                   USTEPS_PER_MM_E>::injectWrapper,
+      &displacementSensor_);
+  displacementSensorToken_ = displacementSensor_.subscribe();
+  pressureSensorToken_ = pressureSensor_.subscribe();
+
+  caliperTimer_.init();
+  caliperTimer_.setFrequency(options_.caliperFrequency);
+  caliperTimer_.setRisingEdgeCallback(sampleCaliper, this);
+  caliperTimer_.enable();
+  spi_.init();
+  spi_.setDeviceCallback(
+      Clef::Impl::Emulator::SyringePlant::samplePressureWrapper, &plant_);
+  spi_.setReadCompleteCallback(Clef::Fw::PressureSensor::injectWrapper,
+                               &pressureSensor_);
+  pressureTimer_.init();
+  pressureTimer_.setFrequency(options_.pressureFrequency);
+  pressureTimer_.setFallingEdgeCallback(startPressureRead, this);
+  pressureTimer_.enable();
+
+  scheduler_.addTimer(stepTimer_);
+  scheduler_.addTimer(xyAxisTimer_);
+  scheduler_.addTimer(zeAxisTimer_);
+  scheduler_.addTimer(caliperTimer_);
+  scheduler_.addTimer(pressureTimer_);
+}
+
+bool Simulator::run(const std::vector<std::string> &commands,
+                    std::string *const error) {
+  error->clear();
+  // Line 0 resets the line number so that commands are numbered from 1
+  lines_.clear();
+  lines_.push_back(frameLine(0, "M110 N0"));
+  for (const std::string &command : commands) {
+    lines_.push_back(frameLine(lines_.size(), command));
+  }
+  numAcked_ = 0;
+  numSent_ = 0;
+  const uint64_t loopNanos = static_cast<uint64_t>(options_.loopMicros) * 1000;
+  const uint64_t maxNanos = options_.maxMicros * 1000;
+  const uint64_t startNanos = clock_.getNanos();
+  const uint64_t startEdges = scheduler_.getNumEdges();
+  const HostClock::time_point start = HostClock::now();
+
+  while (true) {
+    while (!transfers_.empty() &&
+           transfers_.front().arrivalNanos <= clock_.getNanos()) {
+      serial_.inject(transfers_.front().line);
+      transfers_.pop_front();
+    }
+    loop();
+    if (!handleResponses(error)) {
+      break;
+    }
+    if (numAcked_ == lines_.size() && actionQueue_.size() == 0 &&
+        !parser_.isBusy()) {
+      break;
+    }
+    stream();
+
+    const HostClock::time_point timersStart = HostClock::now();
+    scheduler_.runFor(loopNanos);
+    updatePlant();
+    addTime(&stats_.timers, secondsSince(timersStart));
+    if (clock_.getNanos() - startNanos > maxNanos) {
+      *error = "Timed out at line " + std::to_string(numAcked_);
+      break;
+    }
+  }
+
+  stats_.numEdges = scheduler_.getNumEdges() - startEdges;
+  stats_.virtualMicros = (clock_.getNanos() - startNanos) / 1000;
+  stats_.hostSeconds = secondsSince(start);
+  stats_.numLines = numAcked_;
+  return error->empty();
+}
+
+const Simulator::Stats &Simulator::getStats() const { return stats_; }
+
+const std::vector<Simulator::Sample> &Simulator::getTelemetry() const {
+  return telemetry_;
+}
+
+void Simulator::loop() {
+  const HostClock::time_point parseStart = HostClock::now();
+  parser_.ingest(context_);
+  const HostClock::time_point actionsStart = HostClock::now();
+  addTime(&stats_.parse,
+          std::chrono::duration<double>(actionsStart - parseStart).count());
+
+  checkSensors();
+  if (action_) {
+    action_->onLoop(context_);
+    if (action_->isFinished(context_)) {
+      actionQueue_.pop(context_);
+      if ((action_ = actionQueue_.first())) {
+        action_->onStart(context_);
+      }
+    }
+  } else if ((action_ = actionQueue_.first())) {
+    action_->onStart(context_);
+  }
+  addTime(&stats_.actions, secondsSince(actionsStart));
+
+  if (actionQueue_.size() > stats_.maxActionQueueSize) {
+    stats_.maxActionQueueSize = actionQueue_.size();
+  }
+  stats_.numLoops++;
+}
+
+void Simulator::checkSensors() {
+  if (displacementSensor_.checkOut(displacementSensorToken_)) {
+    if (!isExtruderInitialized_) {
+      isExtruderInitialized_ =
+          eAxis_.calibrateDisplacementSensor(displacementSensor_.readPosition());
+    }
+    if (pressureSensor_.checkOut(pressureSensorToken_)) {
+      telemetry_.push_back(
+          {*displacementSensor_.getMeasurementTime(),
+           static_cast<float>(*xAxis_.getPosition()),
+           static_cast<float>(*yAxis_.getPosition()),
+           static_cast<float>(*zAxis_.getPosition()),
+           static_cast<float>(*eAxis_.getPosition()),
+           *displacementSensor_.readPosition(), pressureSensor_.readPressure()});
+      pressureSensor_.release(pressureSensorToken_);
+    }
+    displacementSensor_.release(displacementSensorToken_);
+  }
+}
+
+void Simulator::stream() {
+  if (clock_.getNanos() < holdUntilNanos_) {
+    return;
+  }
+  uint16_t numBytesInFlight = 0;
+  for (uint32_t i = numAcked_; i < numSent_; ++i) {
+    numBytesInFlight += lines_[i].size();
+  }
+  while (numSent_ < lines_.size() && numSent_ - numAcked_ < options_.window &&
+         (numSent_ == numAcked_ ||
+          numBytesInFlight + lines_[numSent_].size() <=
+              Clef::Impl::Emulator::Serial::rxBufferSize)) {
+    const std::string &line = lines_[numSent_];
+    const uint64_t sendNanos = transfers_.empty()
+                                   ? clock_.getNanos()
+                                   : transfers_.back().arrivalNanos;
+    transfers_.push_back(
+        {sendNanos + line.size() * 10000000000ULL / options_.baud, line});
+    numBytesInFlight += line.size();
+    numSent_++;
+    stats_.numLinesSent++;
+  }
+}
+
+bool Simulator::handleResponses(std::string *const error) {
+  responses_ += serial_.extract();
+  size_t start = 0;
+  for (size_t end; (end = responses_.find('\n', start)) != std::string::npos;
+       start = end + 1) {
+    const std::string response = responses_.substr(start, end - start);
+    if (response.compare(0, 2, Clef::Fw::Str::OK) == 0) {
+      const size_t numberStart = response.find(" N");
+      if (numberStart != std::string::npos) {
+        const uint32_t lineNumber =
+            strtoul(response.c_str() + numberStart + 2, nullptr, 10);
+        if (lineNumber + 1 > numAcked_) {
+          numAcked_ = lineNumber + 1;
+        }
+      }
+    } else if (response.compare(0, 6, Clef::Fw::Str::RESEND) == 0) {
+      stats_.numResends++;
+      numAcked_ = strtoul(response.c_str() + 6, nullptr, 10);
+      numSent_ = numAcked_;
+    } else if (response == Clef::Fw::Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) {
+      // The line was not consumed and the ones behind it are dropped
+      stats_.numAllocErrors++;
+      numSent_ = numAcked_;
+      holdUntilNanos_ =
+          clock_.getNanos() + static_cast<uint64_t>(options_.pollMicros) * 1000;
+    } else {
+      *error = "Line " + std::to_string(numAcked_) + ": " + response;
+      responses_.erase(0, end + 1);
+      return false;
+    }
+  }
+  responses_.erase(0, start);
+  return true;
+}
+
+void Simulator::updatePlant() {
+  plant_.update(clock_.getNanos() / 1e9,
+                static_cast<float>(*eAxis_.getPosition()));
+}
+
+void Simulator::sampleCaliper(void *arg) {
+  Simulator *simulator = reinterpret_cast<Simulator *>(arg);
+  simulator->updatePlant();
+  simulator->plant_.sampleDisplacement(simulator->displacementSensorInput_);
+}
+
+void Simulator::startPressureRead(void *arg) {
+  // As in main.atmega2560.cc; the emulated read completes at once
+  Simulator *simulator = reinterpret_cast<Simulator *>(arg);
+  simulator->updatePlant();
+  simulator->spi_.initRead(4, 20);
+}
+
+void Simulator::addTime(PhaseStats *const stats, const double seconds) {
+  stats->totalSeconds += seconds;
+  if (seconds > stats->maxSeconds) {
+    stats->maxSeconds = seconds;
+  }
+}
+}  // namespace Clef::Host
@@ -0,0 +1,194 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/GcodeParser.h>
+#include <impl/emulator/Clock.h>
+#include <impl/emulator/PwmTimer.h>
+#include <impl/emulator/Scheduler.h>
+#include <impl/emulator/SensorInput.h>
+#include <impl/emulator/Serial.h>
+#include <impl/emulator/Stepper.h>
+#include <impl/emulator/SyringePlant.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+/**
+ * Run the firmware on emulated peripherals under a virtual clock, as it runs on
+ * the printer: the Context is built as in main.atmega2560.cc and the main event
+ * loop is the same. Each iteration of the loop is taken to last a fixed amount
+ * of virtual time, during which the scheduler fires the edges of the step
+ * timers, the caliper and the pressure sampling, so a print runs reproducibly
+ * and much faster than on the printer. The sensors read a SyringePlant which
+ * is driven by the E axis.
+ *
+ * Commands are streamed to the emulated serial port like tools/print.py does:
+ * "M110 N0", then numbered lines with checksums, with a window of lines in
+ * flight that fit in the receive buffer. Each line arrives after the time it
+ * takes to send at the configured baud rate. After an "alloc_error", streaming
+ * restarts from the first unacknowledged line once the poll interval has
+ * passed; after "resend <n>", it restarts from line n.
+ */
+class Simulator {
+ public:
+  enum class Predictor { LINEAR, KALMAN, FIXED_POINT_KALMAN };
+
+  struct Options {
+    Predictor predictor;
+    uint32_t loopMicros;    /*!< Virtual time taken by a main loop iteration. */
+    uint32_t baud;          /*!< Of the serial port; 10 bits per character. */
+    uint16_t window;        /*!< Maximum number of lines in flight. */
+    uint32_t pollMicros;    /*!< Wait after an alloc_error. */
+    uint64_t maxMicros;     /*!< Virtual time after which the run stops. */
+    float caliperFrequency; /*!< Of displacement sensor samples. */
+    float pressureFrequency;
+    Clef::Impl::Emulator::SyringePlant::Params plant;
+    uint32_t seed; /*!< Of the noise of the sensors. */
+  };
+
+  /**
+   * The printer's predictor and timings, and the host's defaults.
+   */
+  static const Options DEFAULT_OPTIONS;
+
+  /**
+   * A row of telemetry, recorded whenever there is a new pair of sensor
+   * samples, as the firmware reports on its second serial port.
+   */
+  struct Sample {
+    uint64_t micros;
+    float x; /*!< Positions in usteps. */
+    float y;
+    float z;
+    float e;
+    float xs; /*!< Displacement sensor reading in E usteps. */
+    float P;
+  };
+
+  /**
+   * Host time taken by each part of the main loop.
+   */
+  struct PhaseStats {
+    double totalSeconds;
+    double maxSeconds;
+  };
+
+  struct Stats {
+    uint64_t numLoops;
+    uint64_t numEdges;      /*!< Timer edges fired. */
+    uint64_t virtualMicros; /*!< Time taken by the print. */
+    double hostSeconds;
+    uint32_t numLines;      /*!< Lines acknowledged. */
+    uint32_t numLinesSent;  /*!< Including lines that were sent again. */
+    uint32_t numResends;    /*!< Resend requests. */
+    uint32_t numAllocErrors;
+    uint32_t maxActionQueueSize;
+    PhaseStats parse;   /*!< GcodeParser::ingest(). */
+    PhaseStats actions; /*!< Starting, running and finishing actions. */
+    PhaseStats timers;  /*!< Interrupts between loop iterations. */
+  };
+
+  Simulator(const Options &options);
+
+  /**
+   * Stream commands (without newlines) to the firmware and run the main loop
+   * until every one has been acknowledged and the action queue is empty.
+   * Returns false and sets the error if the firmware rejects a command or the
+   * run takes longer than the maximum time.
+   */
+  bool run(const std::vector<std::string> &commands, std::string *const error);
+
+  const Stats &getStats() const;
+  const std::vector<Sample> &getTelemetry() const;
+
+ private:
+  /**
+   * One iteration of the main event loop, as in main.atmega2560.cc.
+   */
+  void loop();
+
+  /**
+   * Record a row of telemetry if both sensors have a new sample.
+   */
+  void checkSensors();
+
+  /**
+   * Send lines while the window and the receive buffer allow.
+   */
+  void stream();
+
+  /**
+   * Handle the responses of the firmware; returns false and sets the error if
+   * a line was rejected.
+   */
+  bool handleResponses(std::string *const error);
+
+  /**
+   * Bring the plant up to the clock and the position of the E axis.
+   */
+  void updatePlant();
+
+  static void sampleCaliper(void *arg);
+  static void startPressureRead(void *arg);
+
+  static void addTime(PhaseStats *const stats, const double seconds);
+
+  /**
+   * A line sent to the firmware which has not arrived yet.
+   */
+  struct Transfer {
+    uint64_t arrivalNanos;
+    std::string line;
+  };
+
+  Options options_;
+  std::shared_ptr<std::mutex> globalMutex_;
+  Clef::Impl::Emulator::VirtualClock clock_;
+  Clef::Impl::Emulator::Scheduler scheduler_;
+  Clef::Impl::Emulator::Serial serial_;
+  Clef::Impl::Emulator::Spi spi_;
+  Clef::Impl::Emulator::SyringePlant plant_;
+  Clef::Fw::ActionQueue actionQueue_;
+  Clef::Fw::XYEPositionQueue xyePositionQueue_;
+  Clef::Fw::Planner planner_;
+  Clef::Fw::GcodeParser parser_;
+  Clef::Impl::Emulator::GenericTimer xyAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer zeAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer stepTimer_;
+  Clef::Impl::Emulator::GenericTimer caliperTimer_;
+  Clef::Impl::Emulator::GenericTimer pressureTimer_;
+  Clef::Impl::Emulator::DisplacementSensorInput displacementSensorInput_;
+  Clef::Fw::DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E>
+      displacementSensor_;
+  Clef::Fw::PressureSensor pressureSensor_;
+  std::unique_ptr<Clef::Fw::ExtrusionPredictor> extrusionPredictor_;
+  Clef::Fw::Axes::XAxis xAxis_;
+  Clef::Fw::Axes::YAxis yAxis_;
+  Clef::Fw::Axes::ZAxis zAxis_;
+  Clef::Fw::Axes::EAxis eAxis_;
+  Clef::Fw::Axes axes_;
+  Clef::Fw::StepEngine stepEngine_;
+  Clef::Fw::Context context_;
+
+  uint8_t displacementSensorToken_;
+  uint8_t pressureSensorToken_;
+  bool isExtruderInitialized_;
+  Clef::Fw::ActionQueue::Iterator action_;
+
+  std::vector<std::string> lines_; /*!< Framed, with newlines. */
+  uint32_t numAcked_;
+  uint32_t numSent_;
+  uint64_t holdUntilNanos_; /*!< No lines are sent before this time. */
+  std::deque<Transfer> transfers_;
+  std::string responses_; /*!< Incomplete response from the firmware. */
+
+  Stats stats_;
+  std::vector<Sample> telemetry_;
+};
+}  // namespace Clef::Host
@@ -0,0 +1,118 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "WorkStealingPool.h"
+
+#include <algorithm>
+
+namespace Clef::Host {
+namespace {
+/**
+ * The pool and the index of the thread that is running, so that a task can
+ * submit to its own queue.
+ */
+thread_local const WorkStealingPool *currentPool = nullptr;
+thread_local unsigned currentIndex = 0;
+}  // namespace
+
+WorkStealingPool::WorkStealingPool(const unsigned numThreads)
+    : numQueued_(0), numPending_(0), nextQueue_(0), isStopping_(false) {
+  const unsigned numQueues = std::max(numThreads, 1u);
+  for (unsigned i = 0; i < numQueues; ++i) {
+    queues_.push_back(std::make_unique<Queue>());
+  }
+  for (unsigned i = 0; i < numQueues; ++i) {
+    threads_.emplace_back(&WorkStealingPool::work, this, i);
+  }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isStopping_ = true;
+  }
+  hasTasks_.notify_all();
+  for (std::thread &thread : threads_) {
+    thread.join();
+  }
+}
+
+void WorkStealingPool::submit(Task task) {
+  unsigned index;
+  if (currentPool == this) {
+    index = currentIndex;
+  } else {
+    std::lock_guard<std::mutex> lock(mutex_);
+    index = nextQueue_;
+    nextQueue_ = (nextQueue_ + 1) % queues_.size();
+  }
+  {
+    std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+    queues_[index]->tasks.push_back(std::move(task));
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++numQueued_;
+    ++numPending_;
+  }
+  hasTasks_.notify_one();
+}
+
+void WorkStealingPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  isIdle_.wait(lock, [this]() { return numPending_ == 0; });
+}
+
+unsigned WorkStealingPool::getNumThreads() const { return threads_.size(); }
+
+bool WorkStealingPool::take(const unsigned index, Task *const task) {
+  // The newest task of its own queue, or else the oldest of another
+  for (unsigned i = 0; i < queues_.size(); ++i) {
+    Queue &queue = *queues_[(index + i) % queues_.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.tasks.empty()) {
+      if (i == 0) {
+        *task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+      } else {
+        *task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::work(const unsigned index) {
+  currentPool = this;
+  currentIndex = index;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      hasTasks_.wait(lock, [this]() { return isStopping_ || numQueued_ > 0; });
+      if (numQueued_ == 0) {
+        return;
+      }
+    }
+
+    // Another thread may get to the task first
+    Task task;
+    if (!take(index, &task)) {
+      continue;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --numQueued_;
+    }
+    task();
+    bool isIdle;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      isIdle = --numPending_ == 0;
+    }
+    if (isIdle) {
+      isIdle_.notify_all();
+    }
+  }
+}
+}  // namespace Clef::Host
@@ -0,0 +1,65 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Clef::Host {
+/**
+ * Threads which each take tasks from the back of their own queue, and steal
+ * from the front of the others' when theirs is empty, so that uneven tasks
+ * (such as recordings of very different lengths) keep every thread busy.
+ * Tasks submitted from outside the pool are dealt out to the queues in turn;
+ * tasks submitted by a task go on the queue of its thread.
+ */
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  explicit WorkStealingPool(const unsigned numThreads);
+  ~WorkStealingPool();
+
+  WorkStealingPool(const WorkStealingPool &) = delete;
+  WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+  void submit(Task task);
+
+  /**
+   * Block until every task submitted so far (and every task that they
+   * submit) has run. Must not be called from a task.
+   */
+  void wait();
+
+  unsigned getNumThreads() const;
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  /**
+   * Take a task for the thread with the given index, stealing one if its
+   * queue is empty.
+   */
+  bool take(const unsigned index, Task *const task);
+
+  void work(const unsigned index);
+
+  std::vector<std::unique_ptr<Queue>> queues_;
+  std::vector<std::thread> threads_;
+  std::mutex mutex_;
+  std::condition_variable hasTasks_; /*!< Signalled when a task is queued. */
+  std::condition_variable isIdle_;   /*!< Signalled when none are pending. */
+  size_t numQueued_;  /*!< Tasks in the queues; guarded by mutex_. */
+  size_t numPending_; /*!< Tasks which have not finished; ditto. */
+  unsigned nextQueue_;
+  bool isStopping_;
+};
+}  // namespace Clef::Host
@@ -7,6 +7,13 @@ bool areInterruptsEnabled();
 void enableInterrupts();
 void disableInterrupts();
 
+/**
+ * Keep the compiler (and the processor, where it reorders) from moving memory
+ * accesses across this point, for data shared with an interrupt handler while
+ * interrupts stay enabled.
+ */
+void memoryBarrier();
+
 /**
  * Create an instance of this object to disable interrupts (regardless of
  * current interrupts state) for the lifetime of this object; it restores
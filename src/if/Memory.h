@@ -2,6 +2,7 @@
 
 #pragma once
 
+#include <util/FixedPoint.h>
 #include <util/Matrix.h>
 
 #ifdef TARGET_AVR
@@ -21,20 +22,43 @@
 #endif
 
 namespace Clef::If {
-template <uint16_t N>
-class RomDiagonalMatrix : public Clef::Util::BaseDiagonalMatrix<N> {
- public:
-  RomDiagonalMatrix(const float *const data) : data_(data) {}
-
- private:
-  float readData(const uint16_t index) const override {
+/**
+ * Read an element of an array defined with ARRAY().
+ */
 #ifdef TARGET_AVR
-    return pgm_read_float(data_ + index);
+inline float readRom(const float *const address) {
+  return pgm_read_float(address);
+}
+
+template <uint8_t F>
+inline Clef::Util::Fixed<F> readRom(const Clef::Util::Fixed<F> *const address) {
+  return Clef::Util::Fixed<F>::fromRaw(
+      static_cast<int32_t>(pgm_read_dword(address)));
+}
 #else
-    return data_[index];
+template <typename E>
+inline E readRom(const E *const address) {
+  return *address;
+}
 #endif
+
+template <uint16_t N, typename E = float>
+class RomDiagonalMatrix : public Clef::Util::BaseDiagonalMatrix<N, E> {
+ public:
+  using Element = E;
+
+  RomDiagonalMatrix(const E *const data) : data_(data) {}
+
+  /**
+   * Element on the diagonal, without virtual dispatch.
+   */
+  E getDiagonal(const uint16_t index) const { return readRom(data_ + index); }
+
+ private:
+  E readData(const uint16_t index) const override {
+    return getDiagonal(index);
   }
 
-  const float *data_;
+  const E *data_;
 };
 }  // namespace Clef::If
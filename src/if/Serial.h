@@ -14,6 +14,12 @@ class RSerial : public Clef::Util::Initialized {
  public:
   virtual bool isReadyToRead() const = 0;
   virtual bool read(char *const c) = 0;
+
+  /**
+   * Number of bytes that can still be received before the receive buffer
+   * overflows.
+   */
+  virtual uint16_t getNumRxSpacesLeft() const = 0;
 };
 
 /**
@@ -14,3 +14,7 @@
 // Choose a low-ish frequency because there is something weird with the library
 // that causes it to drop bits while receiving.
 #define SERIAL_BAUDRATE 57600
+
+// Bytes of G-code which can be received while the main loop is busy; lines are
+// stored back to back, so this must hold a few lines of up to 80 characters
+#define SERIAL_RX_BUFFER_SIZE 256
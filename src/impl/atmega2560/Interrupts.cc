@@ -10,4 +10,6 @@ bool areInterruptsEnabled() { return (SREG >> 7) & 1; }
 void disableInterrupts() { cli(); }
 
 void enableInterrupts() { sei(); }
+
+void memoryBarrier() { asm volatile("" ::: "memory"); }
 }  // namespace Clef::If
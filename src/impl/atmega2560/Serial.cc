@@ -10,6 +10,37 @@ namespace Clef::Impl::Atmega2560 {
 Usart0 serial;
 Usart1 serial1;
 
+bool Usart0::init() {
+  if (Clef::Util::Initialized::init()) {
+    uart0_init(BAUD_CALC(SERIAL_BAUDRATE));
+    // The library only enables the transmitter since it does not handle RX0
+    UCSR0B |= (1 << RXEN0) | (1 << RXCIE0);
+    return true;
+  }
+  return false;
+}
+
+bool Usart0::isReadyToRead() const { return receiver_.isLineReady(); }
+
+bool Usart0::read(char *const c) {
+  if (receiver_.read(c)) {
+    return true;
+  }
+  *c = '\0';
+  return false;
+}
+
+uint16_t Usart0::getNumRxSpacesLeft() const {
+  return receiver_.getNumSpacesLeft();
+}
+
+uint16_t Usart0::getNumRxOverflows() const {
+  Clef::If::DisableInterrupts noInterrupts;
+  return receiver_.getNumOverflows();
+}
+
+ISR(USART0_RX_vect) { serial.onByteReceived(UDR0); }
+
 namespace {
 class WPinSS W_REGISTER_BOOL(B, 0, true);    /*!< Pin 53. */
 class WPinSCK W_REGISTER_BOOL(B, 1, false);  /*!< Pin 52. */
@@ -6,6 +6,7 @@
 #include <impl/atmega2560/AvrUtils.h>
 #include <impl/atmega2560/Config.h>
 #include <stdint.h>
+#include <util/LineReceiver.h>
 
 extern "C" {
 #define USE_USART0
@@ -38,40 +39,75 @@ class UsartPartial : public Clef::If::RWSerial {
   }
 };
 
-#define USART(N)                                                        \
- public                                                                 \
-  UsartPartial {                                                        \
-   public:                                                              \
-    bool init() override {                                              \
-      if (Clef::Util::Initialized::init()) {                            \
-        REG3(uart, N, _init)(BAUD_CALC(SERIAL_BAUDRATE));               \
-        return true;                                                    \
-      }                                                                 \
-      return false;                                                     \
-    }                                                                   \
-    bool isReadyToRead() const override {                               \
-      return REG3(uart, N, _AvailableBytes)() > 0;                      \
-    };                                                                  \
-    bool read(char *const c) override {                                 \
-      if (isReadyToRead()) {                                            \
-        *c = REG3(uart, N, _getc)();                                    \
-        return true;                                                    \
-      } else {                                                          \
-        *c = '\0';                                                      \
-        return false;                                                   \
-      }                                                                 \
-    };                                                                  \
-    void writeChar(const char c) override { REG3(uart, N, _putc)(c); }; \
-    void writeStr(const char *str) override {                           \
-      REG3(uart, N, _putstr)(const_cast<char *>(str));                  \
-    };                                                                  \
-    void writeLine(const char *line) override {                         \
-      writeStr(line);                                                   \
-      writeChar('\n');                                                  \
-    }                                                                   \
+#define USART_TX(N)                                                   \
+  void writeChar(const char c) override { REG3(uart, N, _putc)(c); }; \
+  void writeStr(const char *str) override {                           \
+    REG3(uart, N, _putstr)(const_cast<char *>(str));                  \
+  };                                                                  \
+  void writeLine(const char *line) override {                         \
+    writeStr(line);                                                   \
+    writeChar('\n');                                                  \
   }
 
-class Usart0 : USART(0);
+#define USART(N)                                                   \
+ public                                                            \
+  UsartPartial {                                                   \
+   public:                                                         \
+    bool init() override {                                         \
+      if (Clef::Util::Initialized::init()) {                       \
+        REG3(uart, N, _init)(BAUD_CALC(SERIAL_BAUDRATE));          \
+        return true;                                               \
+      }                                                            \
+      return false;                                                \
+    }                                                              \
+    bool isReadyToRead() const override {                          \
+      return REG3(uart, N, _AvailableBytes)() > 0;                 \
+    };                                                             \
+    bool read(char *const c) override {                            \
+      if (isReadyToRead()) {                                       \
+        *c = REG3(uart, N, _getc)();                               \
+        return true;                                               \
+      } else {                                                     \
+        *c = '\0';                                                 \
+        return false;                                              \
+      }                                                            \
+    };                                                             \
+    uint16_t getNumRxSpacesLeft() const override {                 \
+      return REG3(RX, N, _BUFFER_SIZE) - 1 -                       \
+             REG3(uart, N, _AvailableBytes)();                     \
+    }                                                              \
+    USART_TX(N)                                                    \
+  }
+
+/**
+ * USART0 carries G-code from the host, so its receive interrupt (see
+ * NO_RX0_INTERRUPT in usart_config.h) frames lines as they arrive. The main
+ * loop only reads complete lines, and a line that arrives while the buffer is
+ * full is dropped as a whole rather than corrupting the lines around it.
+ */
+class Usart0 : public UsartPartial {
+ public:
+  bool init() override;
+  bool isReadyToRead() const override;
+  bool read(char *const c) override;
+  uint16_t getNumRxSpacesLeft() const override;
+  USART_TX(0)
+
+  /**
+   * Number of received lines which were dropped because the receive buffer was
+   * full.
+   */
+  uint16_t getNumRxOverflows() const;
+
+  /**
+   * Called from the receive interrupt.
+   */
+  void onByteReceived(const char c) { receiver_.push(c); }
+
+ private:
+  Clef::Util::LineReceiver<SERIAL_RX_BUFFER_SIZE> receiver_;
+};
+
 extern Usart0 serial;
 
 class Usart1 : USART(1);
@@ -70,7 +70,8 @@
 //#define RX3_BUFFER_SIZE 128
 //#define TX3_BUFFER_SIZE 64
 
-//#define NO_RX0_INTERRUPT // removes whole receive code (including ISR) and frees RX0 pin // combining with NO_USART_RX is not necessary
+#define NO_RX0_INTERRUPT // removes whole receive code (including ISR) and frees RX0 pin // combining with NO_USART_RX is not necessary
+// USART0 receive is handled by Clef::Impl::Atmega2560::Usart0, which frames lines in its own ISR
 //#define NO_RX1_INTERRUPT // removes whole receive code (including ISR) and frees RX1 pin
 //#define NO_RX2_INTERRUPT // removes whole receive code (including ISR) and frees RX2 pin
 //#define NO_RX3_INTERRUPT // removes whole receive code (including ISR) and frees RX3 pin
@@ -15,3 +15,23 @@ Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC> Clock::getMicros()
       std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
 }
 };  // namespace Clef::Impl::Emulator
+
+namespace Clef::Impl::Emulator {
+bool VirtualClock::init() {
+  nanos_ = 0;
+  return true;
+}
+
+Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC> VirtualClock::getMicros()
+    const {
+  return Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC>(nanos_ / 1000);
+}
+
+uint64_t VirtualClock::getNanos() const { return nanos_; }
+
+void VirtualClock::advanceTo(const uint64_t nanos) {
+  if (nanos > nanos_) {
+    nanos_ = nanos;
+  }
+}
+}  // namespace Clef::Impl::Emulator
@@ -16,4 +16,26 @@ class Clock : public Clef::If::Clock {
  private:
   std::chrono::time_point<std::chrono::high_resolution_clock> t0_;
 };
+
+/**
+ * Clock which only moves when it is advanced, usually by a Scheduler, so that
+ * an emulated print does not depend on how fast the host runs. Time is kept in
+ * nanoseconds so that the edges of fast timers do not drift by rounding.
+ */
+class VirtualClock : public Clef::If::Clock {
+ public:
+  bool init() override;
+  Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC> getMicros()
+      const override;
+
+  uint64_t getNanos() const;
+
+  /**
+   * Move the clock forwards to the given time; the clock never goes back.
+   */
+  void advanceTo(const uint64_t nanos);
+
+ private:
+  uint64_t nanos_ = 0;
+};
 }  // namespace Clef::Impl::Emulator
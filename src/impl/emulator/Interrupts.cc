@@ -2,6 +2,7 @@
 
 #include <if/Interrupts.h>
 
+#include <atomic>
 #include <mutex>
 
 namespace Clef::If {
@@ -13,4 +14,6 @@ bool areInterruptsEnabled() { return !globalLock_.owns_lock(); }
 void disableInterrupts() { globalLock_.lock(); }
 
 void enableInterrupts() { globalLock_.unlock(); }
+
+void memoryBarrier() { std::atomic_thread_fence(std::memory_order_seq_cst); }
 }  // namespace Clef::If
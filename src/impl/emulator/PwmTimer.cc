@@ -8,7 +8,10 @@ GenericTimer::GenericTimer() {}
 
 bool GenericTimer::init() { return true; }
 
-void GenericTimer::enable() { enabled_ = true; }
+void GenericTimer::enable() {
+  enabled_ = true;
+  ++numEnables_;
+}
 
 void GenericTimer::disable() { enabled_ = false; }
 
@@ -36,6 +39,20 @@ Clef::Util::Frequency<float> GenericTimer::getFrequency() const {
   return frequency_;
 }
 
+uint32_t GenericTimer::getNumEnables() const { return numEnables_; }
+
+void GenericTimer::pulseRisingEdge() const {
+  if (enabled_ && risingEdgeCallback_) {
+    risingEdgeCallback_(risingEdgeCallbackData_);
+  }
+}
+
+void GenericTimer::pulseFallingEdge() const {
+  if (enabled_ && fallingEdgeCallback_) {
+    fallingEdgeCallback_(fallingEdgeCallbackData_);
+  }
+}
+
 void GenericTimer::pulseOnce() const {
   if (enabled_) {
     if (risingEdgeCallback_) {
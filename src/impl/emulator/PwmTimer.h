@@ -25,6 +25,19 @@ class GenericTimer : public Clef::If::PwmTimer {
                               void *data) override;
 
   Clef::Util::Frequency<float> getFrequency() const;
+
+  /**
+   * Number of times that the timer has been enabled, so that a Scheduler can
+   * tell when the timer has restarted its count.
+   */
+  uint32_t getNumEnables() const;
+
+  /**
+   * Run the callback of one edge, if the timer is enabled.
+   */
+  void pulseRisingEdge() const;
+  void pulseFallingEdge() const;
+
   void pulseOnce() const;
   void pulseWhile(const std::function<bool(void)> &predicate) const;
 
@@ -35,5 +48,6 @@ class GenericTimer : public Clef::If::PwmTimer {
   void *fallingEdgeCallbackData_ = nullptr;
   Clef::Util::Frequency<float> frequency_ = 1.0f;
   bool enabled_ = false;
+  uint32_t numEnables_ = 0;
 };
 }  // namespace Clef::Impl::Emulator
@@ -0,0 +1,94 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "Scheduler.h"
+
+namespace Clef::Impl::Emulator {
+Scheduler::Scheduler(VirtualClock &clock) : clock_(clock), numEdges_(0) {}
+
+void Scheduler::addTimer(GenericTimer &timer) {
+  TimerState state = {&timer, timer.getNumEnables(), *timer.getFrequency(),
+                      clock_.getNanos(), NEVER, true};
+  if (timer.isEnabled()) {
+    scheduleRising(state);
+  }
+  timers_.push_back(state);
+}
+
+bool Scheduler::runNext(const uint64_t untilNanos) {
+  TimerState *earliest = nullptr;
+  for (TimerState &state : timers_) {
+    sync(state);
+    if (state.next != NEVER && state.next <= untilNanos &&
+        (!earliest || state.next < earliest->next)) {
+      earliest = &state;
+    }
+  }
+  if (!earliest) {
+    return false;
+  }
+
+  clock_.advanceTo(earliest->next);
+  ++numEdges_;
+  if (earliest->isNextRising) {
+    earliest->lastRising = earliest->next;
+    earliest->next += getPeriodNanos(earliest->frequency) / 2;
+    earliest->isNextRising = false;
+    earliest->timer->pulseRisingEdge();
+  } else {
+    scheduleRising(*earliest);
+    earliest->timer->pulseFallingEdge();
+  }
+  return true;
+}
+
+uint64_t Scheduler::runUntil(const uint64_t nanos) {
+  uint64_t numEdges = 0;
+  while (runNext(nanos)) {
+    ++numEdges;
+  }
+  clock_.advanceTo(nanos);
+  return numEdges;
+}
+
+uint64_t Scheduler::runFor(const uint64_t nanos) {
+  return runUntil(clock_.getNanos() + nanos);
+}
+
+uint64_t Scheduler::getNumEdges() const { return numEdges_; }
+
+uint64_t Scheduler::getPeriodNanos(const float frequency) {
+  return frequency > 0 ? static_cast<uint64_t>(1e9 / frequency) : NEVER;
+}
+
+void Scheduler::sync(TimerState &state) {
+  const GenericTimer &timer = *state.timer;
+  if (!timer.isEnabled()) {
+    state.next = NEVER;
+    return;
+  }
+  if (timer.getNumEnables() != state.numEnables) {
+    // Enabling restarts the count
+    state.numEnables = timer.getNumEnables();
+    state.frequency = *timer.getFrequency();
+    state.lastRising = clock_.getNanos();
+    scheduleRising(state);
+  } else if (*timer.getFrequency() != state.frequency ||
+             state.next == NEVER) {
+    state.frequency = *timer.getFrequency();
+    if (state.isNextRising) {
+      scheduleRising(state);
+    }
+  }
+}
+
+void Scheduler::scheduleRising(TimerState &state) {
+  state.isNextRising = true;
+  const uint64_t period = getPeriodNanos(state.frequency);
+  if (period == NEVER) {
+    state.next = NEVER;
+    return;
+  }
+  const uint64_t now = clock_.getNanos();
+  state.next = state.lastRising + period > now ? state.lastRising + period : now;
+}
+}  // namespace Clef::Impl::Emulator
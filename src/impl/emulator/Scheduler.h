@@ -0,0 +1,78 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <impl/emulator/Clock.h>
+#include <impl/emulator/PwmTimer.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace Clef::Impl::Emulator {
+/**
+ * Discrete-event simulation of the timers of the emulator on a virtual clock.
+ * Each enabled timer has a rising edge every period since it was last enabled
+ * and a falling edge half a period after that; the scheduler fires the edges in
+ * order of time, moving the clock to each one before running its callback. A
+ * frequency set while a timer runs applies from its last rising edge, as does a
+ * new compare value on the hardware timers. Edges due at the same time fire in
+ * the order in which their timers were added.
+ *
+ * Periodic sources such as the caliper and the SPI sampling can be emulated by
+ * a GenericTimer whose rising edge injects a sample.
+ */
+class Scheduler {
+ public:
+  Scheduler(VirtualClock &clock);
+
+  void addTimer(GenericTimer &timer);
+
+  /**
+   * Fire the earliest edge that is due no later than the given time. The clock
+   * is moved to the edge; return false (and leave the clock alone) if there is
+   * none.
+   */
+  bool runNext(const uint64_t untilNanos);
+
+  /**
+   * Fire every edge that is due no later than the given time, then move the
+   * clock to that time. Return the number of edges fired.
+   */
+  uint64_t runUntil(const uint64_t nanos);
+
+  /**
+   * Same as runUntil() with a time relative to the clock.
+   */
+  uint64_t runFor(const uint64_t nanos);
+
+  uint64_t getNumEdges() const;
+
+ private:
+  static constexpr uint64_t NEVER = UINT64_MAX;
+
+  struct TimerState {
+    GenericTimer *timer;
+    uint32_t numEnables;    /*!< Value of the timer's count at the last sync. */
+    float frequency;        /*!< Frequency from which the edges were set. */
+    uint64_t lastRising;    /*!< Time of the last rising edge (or enable). */
+    uint64_t next;          /*!< Time of the next edge, or NEVER. */
+    bool isNextRising;
+  };
+
+  static uint64_t getPeriodNanos(const float frequency);
+
+  /**
+   * Bring the next edge of a timer up to date with its settings.
+   */
+  void sync(TimerState &state);
+
+  /**
+   * Set the next rising edge of a timer from its last one.
+   */
+  void scheduleRising(TimerState &state);
+
+  VirtualClock &clock_;
+  std::vector<TimerState> timers_;
+  uint64_t numEdges_;
+};
+}  // namespace Clef::Impl::Emulator
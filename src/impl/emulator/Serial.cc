@@ -28,6 +28,12 @@ bool Serial::read(char *const c) {
   }
 }
 
+uint16_t Serial::getNumRxSpacesLeft() const {
+  std::unique_lock<std::mutex> lock(*globalMutex_);
+  return inputStream_.size() < rxBufferSize ? rxBufferSize - inputStream_.size()
+                                            : 0;
+}
+
 void Serial::writeChar(const char c) {
   std::unique_lock<std::mutex> lock(*globalMutex_);
   outputStream_.push(c);
@@ -68,11 +74,44 @@ std::string Serial::extract() {
       while (outputStream_.size() > 0 && outputStream_.front() != '\n') {
         outputStream_.pop();
       }
-      outputStream_.pop();
+      if (outputStream_.size() > 0) {
+        outputStream_.pop();
+      }
+      continue;
     }
     output.push_back(outputStream_.front());
     outputStream_.pop();
   }
   return output;
 }
+
+Spi::Spi()
+    : Clef::If::RSpi::RSpi(),
+      deviceCallback_(nullptr),
+      deviceCallbackData_(nullptr) {}
+
+bool Spi::init() { return true; }
+
+bool Spi::initRead(
+    const uint16_t size,
+    const Clef::Util::Time<uint16_t, Clef::Util::TimeUnit::USEC> delay) {
+  if (size > maxSize_) {
+    return false;
+  }
+  for (uint16_t i = 0; i < size; ++i) {
+    buffer_[i] = static_cast<char>(0xff);
+  }
+  if (deviceCallback_) {
+    deviceCallback_(size, buffer_, deviceCallbackData_);
+  }
+  if (readCompleteCallback_) {
+    readCompleteCallback_(size, buffer_, readCompleteCallbackData_);
+  }
+  return true;
+}
+
+void Spi::setDeviceCallback(const DeviceCallback callback, void *data) {
+  deviceCallback_ = callback;
+  deviceCallbackData_ = data;
+}
 }  // namespace Clef::Impl::Emulator
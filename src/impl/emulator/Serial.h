@@ -13,11 +13,16 @@
 namespace Clef::Impl::Emulator {
 class Serial : public Clef::If::RWSerial {
  public:
+  static const uint16_t rxBufferSize = 64; /*!< Size reported for the receive
+                                              buffer; injected characters are
+                                              never dropped. */
+
   Serial(std::shared_ptr<std::mutex> globalMutex);
 
   bool init() override;
   bool isReadyToRead() const override;
   bool read(char *const c) override;
+  uint16_t getNumRxSpacesLeft() const override;
   void writeChar(const char c) override;
   void writeStr(const char *str) override;
   void writeLine(const char *line) override;
@@ -38,4 +43,30 @@ class Serial : public Clef::If::RWSerial {
   std::queue<char> inputStream_;
   std::queue<char> outputStream_;
 };
+
+/**
+ * SPI connection whose reads complete at once, with bytes supplied by an
+ * emulated device.
+ */
+class Spi : public Clef::If::RSpi {
+ public:
+  /**
+   * Fill a buffer with the given number of bytes.
+   */
+  using DeviceCallback = void (*)(const uint16_t, char *const, void *);
+
+  Spi();
+  bool init() override;
+  bool initRead(const uint16_t size,
+                const Clef::Util::Time<uint16_t, Clef::Util::TimeUnit::USEC>
+                    delay) override;
+
+  void setDeviceCallback(const DeviceCallback callback, void *data);
+
+ private:
+  static const uint16_t maxSize_ = 8;
+  char buffer_[maxSize_];
+  DeviceCallback deviceCallback_;
+  void *deviceCallbackData_;
+};
 }  // namespace Clef::Impl::Emulator
@@ -0,0 +1,130 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include "SyringePlant.h"
+
+#include <math.h>
+
+namespace Clef::Impl::Emulator {
+const SyringePlant::Params SyringePlant::DEGEN_PARAMS = {
+    Model::DEGEN,
+    12.0f,    // Chl
+    0.0f,     // Csl
+    1.0f,     // AhAs
+    0.0f,     // a0
+    3.0f,     // a1
+    0.5f,     // gamma
+    1.0f,     // m
+    4000.0f,  // Ph0
+    1.0f,     // xsNoise
+    2.0f,     // PNoise
+};
+
+const SyringePlant::Params SyringePlant::GEL_PARAMS = {
+    Model::GEL,
+    1.2f,                           // Chl
+    2.5f,                           // Csl
+    (0.5f / 0.7f) * (0.5f / 0.7f),  // AhAs
+    300.0f,                         // a0
+    3.0f,                           // a1
+    6.0f,                           // gamma
+    0.56f,                          // m
+    2500.0f,                        // Ph0
+    1.0f,                           // xsNoise
+    2.0f,                           // PNoise
+};
+
+SyringePlant::SyringePlant(const Params &params, const uint32_t seed)
+    : params_(params), generator_(seed), noise_(0.0f, 1.0f) {
+  reset(0, 0);
+}
+
+void SyringePlant::reset(const double t, const float xe) {
+  t_ = t;
+  xe_ = xe;
+  xs_ = xe;
+  xn_ = xe;
+}
+
+void SyringePlant::update(const double t, const float xe) {
+  if (t > t_) {
+    const uint32_t numSteps = static_cast<uint32_t>(ceil((t - t_) / STEP));
+    const float dt = (t - t_) / numSteps;
+    for (uint32_t i = 1; i <= numSteps; ++i) {
+      step(dt, xe_ + (xe - xe_) * i / numSteps);
+    }
+    t_ = t;
+  }
+  xe_ = xe;
+}
+
+float SyringePlant::getDisplacement() const { return xs_; }
+
+float SyringePlant::getHeadPressure() const {
+  return params_.Chl * (xe_ - xs_);
+}
+
+void SyringePlant::sampleDisplacement(DisplacementSensorInput &input) {
+  const float xs = roundf(xs_ + params_.xsNoise * noise_(generator_));
+  input.inject(Clef::Util::Position<float, Clef::Util::PositionUnit::MM,
+                                    USTEPS_PER_MM_DISPLACEMENT>(
+      xs / USTEPS_PER_MM_DISPLACEMENT));
+}
+
+void SyringePlant::samplePressure(const uint16_t size, char *const buffer) {
+  float reading = roundf(getHeadPressure() + params_.Ph0 +
+                         params_.PNoise * noise_(generator_));
+  reading = reading < 0 ? 0 : reading > 0x3fff ? 0x3fff : reading;
+  const uint16_t raw = static_cast<uint16_t>(reading);
+  if (size >= 2) {
+    buffer[0] = static_cast<char>(raw >> 8);
+    buffer[1] = static_cast<char>(raw & 0xff);
+  }
+}
+
+void SyringePlant::samplePressureWrapper(const uint16_t size,
+                                         char *const buffer, void *arg) {
+  reinterpret_cast<SyringePlant *>(arg)->samplePressure(size, buffer);
+}
+
+void SyringePlant::step(const float dt, const float xe) {
+  const float Ph = params_.Chl * (xe - xs_);
+  if (params_.model == Model::DEGEN) {
+    // Solve dxs/dt = gamma * (Ph - a0 - a1 * dxs/dt)^m, whose right side falls
+    // as the left side rises
+    const float drive = Ph - params_.a0;
+    float rate = 0;
+    if (drive > 0) {
+      if (params_.m == 1) {
+        rate = params_.gamma * drive / (1 + params_.gamma * params_.a1);
+      } else {
+        float low = 0;
+        float high = params_.a1 > 0 ? drive / params_.a1 : getFlowRate(drive);
+        for (uint8_t i = 0; i < 24; ++i) {
+          rate = (low + high) / 2;
+          if (rate < getFlowRate(drive - params_.a1 * rate)) {
+            low = rate;
+          } else {
+            high = rate;
+          }
+        }
+      }
+    }
+    xs_ += rate * dt;
+  } else {
+    const float Ps = params_.Csl * (xs_ - xn_);
+    const float plungerRate =
+        (params_.AhAs * Ph - Ps - params_.a0) / params_.a1;
+    if (plungerRate > 0) {
+      xs_ += plungerRate * dt;
+    }
+    xn_ += getFlowRate(Ps) * dt;
+    if (xn_ > xs_) {
+      xn_ = xs_;
+    }
+  }
+}
+
+float SyringePlant::getFlowRate(const float pressure) const {
+  return pressure > 0 ? params_.gamma * powf(pressure, params_.m) : 0;
+}
+}  // namespace Clef::Impl::Emulator
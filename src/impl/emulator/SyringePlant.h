@@ -0,0 +1,110 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <fw/Config.h>
+#include <impl/emulator/SensorInput.h>
+#include <stdint.h>
+
+#include <random>
+
+namespace Clef::Impl::Emulator {
+/**
+ * Physics of the syringe and the gel that it pushes, as modelled in
+ * tools/analysis/models, so that the displacement sensor and the pressure
+ * sensor of the emulator react to the extruder. Positions are in usteps of the
+ * E axis and pressures in counts of the pressure sensor.
+ *
+ * The head pressure comes from compressing the material between the extruder
+ * and the plunger that the displacement sensor follows, Ph = Chl * (xe - xs),
+ * and the sensor reads Ph + Ph0. In the DEGEN model (degen.py), the pressure
+ * left after friction, Ps = Ph - a0 - a1 * dxs/dt, drives the flow,
+ * dxs/dt = gamma * Ps^m, which is solved for dxs/dt at every step. In the GEL
+ * model (gel_c1f1st1.py), the plunger also compresses the gel ahead of it,
+ * Ps = Csl * (xs - xn), which balances the head pressure through the piston
+ * areas and friction, AhAs * Ph = Ps + a0 + a1 * dxs/dt, and the gel flows
+ * out at dxn/dt = gamma * Ps^m. Nothing flows backwards.
+ *
+ * The plant is integrated in steps of at most STEP seconds, with the extruder
+ * moving linearly between updates. Each sample has Gaussian noise from a
+ * seeded generator, so that emulations are reproducible, and is quantized
+ * like the real sensor's.
+ */
+class SyringePlant {
+ public:
+  enum class Model { DEGEN, GEL };
+
+  struct Params {
+    Model model;
+    float Chl;   /*!< Head capacitance, counts/ustep. */
+    float Csl;   /*!< Gel capacitance, counts/ustep (GEL). */
+    float AhAs;  /*!< Ratio of piston areas (GEL). */
+    float a0;    /*!< Static friction, counts. */
+    float a1;    /*!< Viscous friction, counts/(ustep/s). */
+    float gamma; /*!< Flow coefficient, (usteps/s)/counts^m. */
+    float m;     /*!< Shear-thinning exponent; 1 for a Newtonian fluid. */
+    float Ph0;   /*!< Reading of the pressure sensor at rest. */
+    float xsNoise; /*!< Standard deviations of the samples. */
+    float PNoise;
+  };
+
+  /**
+   * Initial values of the parameters in the Python models.
+   */
+  static const Params DEGEN_PARAMS;
+  static const Params GEL_PARAMS;
+
+  static constexpr float STEP = 0.0005f;
+
+  SyringePlant(const Params &params, const uint32_t seed);
+
+  /**
+   * Start over at rest with the extruder at the given position.
+   */
+  void reset(const double t, const float xe);
+
+  /**
+   * Integrate up to time t (in seconds), at which the extruder is at xe.
+   */
+  void update(const double t, const float xe);
+
+  float getDisplacement() const;
+  float getHeadPressure() const;
+
+  /**
+   * Pass a noisy sample of the plunger position to the displacement sensor.
+   */
+  void sampleDisplacement(DisplacementSensorInput &input);
+
+  /**
+   * Fill an SPI buffer like the pressure sensor does: a status bit (always
+   * clear) and a 14-bit reading in the first two bytes, MSB first.
+   */
+  void samplePressure(const uint16_t size, char *const buffer);
+
+  /**
+   * Adapter for Spi::setDeviceCallback().
+   */
+  static void samplePressureWrapper(const uint16_t size, char *const buffer,
+                                    void *arg);
+
+ private:
+  /**
+   * Advance the state by dt seconds with the extruder at xe.
+   */
+  void step(const float dt, const float xe);
+
+  /**
+   * Flow rate driven by a pressure, gamma * P^m.
+   */
+  float getFlowRate(const float pressure) const;
+
+  Params params_;
+  std::mt19937 generator_;
+  std::normal_distribution<float> noise_;
+  double t_;
+  float xe_;
+  float xs_;
+  float xn_; /*!< Position of the gel flowing out (GEL). */
+};
+}  // namespace Clef::Impl::Emulator
@@ -2,6 +2,7 @@
 
 #include <fw/Action.h>
 #include <fw/GcodeParser.h>
+#include <fw/LoopTimer.h>
 #include <if/Interrupts.h>
 #include <impl/atmega2560/Clock.h>
 #include <impl/atmega2560/LimitSwitch.h>
@@ -13,15 +14,26 @@
 #include <stdio.h>
 
 Clef::Impl::Atmega2560::Clock clock(Clef::Impl::Atmega2560::clockTimer);
+// Sensor samples are published without disabling interrupts, so that they
+// never delay the step timers
 Clef::Fw::DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E>
-    displacementSensor(clock, 0.1);
-Clef::Fw::PressureSensor pressureSensor(clock, 1);
+    displacementSensor(clock, 0.1, Clef::Fw::SensorPublication::SEQLOCK);
+Clef::Fw::PressureSensor pressureSensor(clock, 1,
+                                        Clef::Fw::SensorPublication::SEQLOCK);
 Clef::Fw::ActionQueue actionQueue;
 Clef::Fw::XYEPositionQueue xyePositionQueue;
+Clef::Fw::Planner planner;
 Clef::Fw::GcodeParser gcodeParser;
+Clef::Fw::LoopTimer loopTimer(clock);
+// The fixed-point filter is much cheaper without an FPU, but stays off until
+// its timing on the AVR and its agreement with the float filter on replayed
+// recordings from the printer have been measured; in long, fast extrusions the
+// covariance of Ps also grows past the range of Q16.16
 Clef::Fw::KalmanFilterExtrusionPredictor extrusionPredictor;
+// Coordinated motion is generated by the step engine on xAxisTimer; X and Y
+// share a timer (like Z and E) for when an axis is driven on its own
 Clef::Fw::Axes::XAxis xAxis(Clef::Impl::Atmega2560::xAxisStepper,
-                            Clef::Impl::Atmega2560::xAxisTimer);
+                            Clef::Impl::Atmega2560::yAxisTimer);
 Clef::Fw::Axes::YAxis yAxis(Clef::Impl::Atmega2560::yAxisStepper,
                             Clef::Impl::Atmega2560::yAxisTimer);
 Clef::Fw::Axes::ZAxis zAxis(Clef::Impl::Atmega2560::zAxisStepper,
@@ -31,9 +43,10 @@ Clef::Fw::Axes::EAxis eAxis(Clef::Impl::Atmega2560::eAxisStepper,
                             displacementSensor, pressureSensor,
                             extrusionPredictor);
 Clef::Fw::Axes axes(xAxis, yAxis, zAxis, eAxis);
+Clef::Fw::StepEngine stepEngine(axes, Clef::Impl::Atmega2560::xAxisTimer);
 Clef::Fw::Context context({axes, gcodeParser, clock,
                            Clef::Impl::Atmega2560::serial, actionQueue,
-                           xyePositionQueue});
+                           xyePositionQueue, planner, stepEngine});
 
 void status(void *arg) {
   static int counter = 0;
@@ -68,8 +81,8 @@ void checkSensors(const uint8_t displacementSensorToken,
   if (displacementSensor.checkOut(displacementSensorToken)) {
     static bool initializedExtruder = false;
     if (!initializedExtruder) {
-      eAxis.setDisplacementSensorOffset(displacementSensor.readPosition());
-      initializedExtruder = true;
+      initializedExtruder =
+          eAxis.calibrateDisplacementSensor(displacementSensor.readPosition());
     }
     if (pressureSensor.checkOut(pressureSensorToken)) {
       typename Clef::Fw::Axes::EAxis::StepperPosition extruderPosition =
@@ -113,7 +126,14 @@ int main() {
     Clef::Impl::Atmega2560::serial1.writeLine(";;;;;;;;");
   }
   Clef::Impl::Atmega2560::serial1.writeLine(";power_on");
+  {
+    char buffer[64];
+    sprintf(buffer, ";Action queue = %d x %d bytes", ACTION_QUEUE_SIZE,
+            Clef::Fw::ActionQueue::bytesPerAction);
+    Clef::Impl::Atmega2560::serial.writeLine(buffer);
+  }
   axes.init();
+  stepEngine.init();
 
   Clef::Impl::Atmega2560::limitSwitches.init();
   Clef::Impl::Atmega2560::limitSwitches.getX().setTriggerCallback(
@@ -146,20 +166,22 @@ int main() {
 
   Clef::Fw::ActionQueue::Iterator it = actionQueue.first();
   int currentQueueSize = actionQueue.size();
+  uint16_t numRxOverflows = 0;
   while (1) {
+    loopTimer.lap();
     gcodeParser.ingest(context);
     checkSensors(displacementSensorToken, pressureSensorToken);
     if (it) {
-      (*it)->onLoop(context);
-      if ((*it)->isFinished(context)) {
+      it->onLoop(context);
+      if (it->isFinished(context)) {
         context.actionQueue.pop(context);
         if ((it = actionQueue.first())) {
-          (*it)->onStart(context);
+          it->onStart(context);
         }
       }
     } else {
       if ((it = actionQueue.first())) {
-        (*it)->onStart(context);
+        it->onStart(context);
       }
     }
     int newQueueSize = actionQueue.size();
@@ -169,5 +191,33 @@ int main() {
       Clef::Impl::Atmega2560::serial.writeLine(buffer);
       currentQueueSize = newQueueSize;
     }
+    const uint16_t newNumRxOverflows =
+        Clef::Impl::Atmega2560::serial.getNumRxOverflows();
+    if (newNumRxOverflows != numRxOverflows) {
+      char buffer[64];
+      sprintf(buffer, ";Dropped lines = %u", newNumRxOverflows);
+      Clef::Impl::Atmega2560::serial.writeLine(buffer);
+      numRxOverflows = newNumRxOverflows;
+    }
+    const Clef::Fw::GcodeParser::ParseStats &parseStats =
+        gcodeParser.getParseStats();
+    if (parseStats.numLines >= 100) {
+      char buffer[64];
+      sprintf(buffer, ";Parse time = %lu us / %lu lines",
+              static_cast<unsigned long>(parseStats.micros),
+              static_cast<unsigned long>(parseStats.numLines));
+      Clef::Impl::Atmega2560::serial.writeLine(buffer);
+      gcodeParser.resetParseStats();
+    }
+    const Clef::Fw::LoopTimer::LoopStats &loopStats = loopTimer.getLoopStats();
+    if (loopStats.numIterations >= 10000) {
+      char buffer[64];
+      sprintf(buffer, ";Loop time = max %lu us / %lu us / %lu iterations",
+              static_cast<unsigned long>(loopStats.maxMicros),
+              static_cast<unsigned long>(loopStats.totalMicros),
+              static_cast<unsigned long>(loopStats.numIterations));
+      Clef::Impl::Atmega2560::serial.writeLine(buffer);
+      loopTimer.resetLoopStats();
+    }
   }
 }
@@ -0,0 +1,70 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <host/BatchReplay.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Replay recordings of the extruder through the firmware's extrusion filter:
+ *
+ *   clef-batch-replay [-j <threads>] <dir>...
+ *
+ * Each dir is either a recording made with tools/stream_data.py or a
+ * directory of them; every recording is replayed, on as many threads as there
+ * are cores unless -j says otherwise, and its trajectory is saved to
+ * replay-states.npy in the recording.
+ */
+int main(int argc, char **argv) {
+  unsigned numThreads = std::thread::hardware_concurrency();
+  int firstDir = 1;
+  if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    numThreads = atoi(argv[2]);
+    firstDir = 3;
+  }
+  if (firstDir >= argc || numThreads == 0) {
+    fprintf(stderr, "Usage: %s [-j <threads>] <dir>...\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> dirs;
+  for (int i = firstDir; i < argc; ++i) {
+    const std::vector<std::string> runs =
+        Clef::Host::BatchReplay::findRuns(argv[i]);
+    if (runs.empty()) {
+      fprintf(stderr, "%s: no recordings\n", argv[i]);
+      return 1;
+    }
+    dirs.insert(dirs.end(), runs.begin(), runs.end());
+  }
+
+  const std::chrono::steady_clock::time_point start =
+      std::chrono::steady_clock::now();
+  const std::vector<Clef::Host::BatchReplay::Run> runs =
+      Clef::Host::BatchReplay::replayAll(dirs, numThreads);
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+          .count();
+
+  bool pass = true;
+  uint64_t numSamples = 0;
+  for (const Clef::Host::BatchReplay::Run &run : runs) {
+    if (run.success) {
+      printf("%s: %llu samples in %.3f s\n", run.dir.c_str(),
+             static_cast<unsigned long long>(run.numSamples), run.seconds);
+      numSamples += run.numSamples;
+    } else {
+      fprintf(stderr, "%s\n", run.error.c_str());
+      pass = false;
+    }
+  }
+  printf("Replayed %zu recordings (%llu samples) in %.3f s on %u threads\n",
+         runs.size(), static_cast<unsigned long long>(numSamples), seconds,
+         numThreads);
+  return pass ? 0 : 1;
+}
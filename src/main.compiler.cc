@@ -0,0 +1,82 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fcntl.h>
+#include <host/Compiler.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Compile a G-code file into a stream of pre-planned frames for the printer:
+ *
+ *   clef-compiler <input.gcode> <output>
+ *
+ * The output can be sent with tools/print.py --compiled.
+ */
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <input.gcode> <output>\n", argv[0]);
+    return 1;
+  }
+
+  const int fd = open(argv[1], O_RDONLY);
+  struct stat fileStat;
+  if (fd < 0 || fstat(fd, &fileStat) < 0) {
+    perror(argv[1]);
+    return 1;
+  }
+  const size_t size = fileStat.st_size;
+  const char *const data =
+      size > 0 ? static_cast<const char *>(
+                     mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0))
+               : nullptr;
+  if (data == MAP_FAILED) {
+    perror(argv[1]);
+    close(fd);
+    return 1;
+  }
+
+  Clef::Host::Compiler compiler;
+  uint32_t numLines = 0;
+  for (size_t start = 0; start < size;) {
+    const char *const newline =
+        static_cast<const char *>(memchr(data + start, '\n', size - start));
+    size_t end = newline ? newline - data : size;
+    const size_t next = end + 1;
+    if (end > start && data[end - 1] == '\r') {
+      end--;
+    }
+    numLines++;
+    std::string error;
+    if (!compiler.compileLine(data + start, end - start, &error)) {
+      fprintf(stderr, "%s:%u: %s\n", argv[1], numLines, error.c_str());
+      return 1;
+    }
+    start = next;
+  }
+  compiler.finish();
+  if (data) {
+    munmap(const_cast<char *>(data), size);
+  }
+  close(fd);
+
+  FILE *const output = fopen(argv[2], "wb");
+  const std::string &records = compiler.getOutput();
+  if (!output ||
+      fwrite(records.data(), 1, records.size(), output) != records.size() ||
+      fclose(output) != 0) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  const float printTime = compiler.getPrintTime();
+  printf("Compiled %u lines into %u records (%zu bytes)\n", numLines,
+         compiler.getNumRecords(), records.size());
+  printf("Planned print time: %u:%02u:%05.2f\n",
+         static_cast<unsigned>(printTime / 3600),
+         static_cast<unsigned>(printTime / 60) % 60, fmod(printTime, 60));
+  return 0;
+}
@@ -0,0 +1,85 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <host/BatchReplay.h>
+#include <host/KalmanOptimizer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+const double DEFAULT_STEP_SIZE = 0.2;
+const unsigned DEFAULT_MAX_ROUNDS = 100;
+const char *const DEFAULT_OUTPUT_DIR = "kalman-optimize";
+}  // namespace
+
+/**
+ * Tune the firmware's extrusion filter on recordings of the extruder, as
+ * `kalman.py optimize` does with the Python model:
+ *
+ *   clef-kalman-optimize [-j <threads>] [-s <step size>] [-n <rounds>]
+ *                        [-o <output dir>] <dir>...
+ *
+ * Each dir is either a recording made with tools/stream_data.py or a
+ * directory of them. The parameters and costs after each round are saved to
+ * <output dir>/opt<n>/summary.json and the best ones to
+ * <output dir>/summary.json, which `kalman.py generate --override-params`
+ * turns back into a filter.
+ */
+int main(int argc, char **argv) {
+  unsigned numThreads = std::thread::hardware_concurrency();
+  double stepSize = DEFAULT_STEP_SIZE;
+  unsigned maxRounds = DEFAULT_MAX_ROUNDS;
+  std::string outputDir = DEFAULT_OUTPUT_DIR;
+  int firstDir = 1;
+  for (; firstDir + 1 < argc && argv[firstDir][0] == '-'; firstDir += 2) {
+    const char *const value = argv[firstDir + 1];
+    if (strcmp(argv[firstDir], "-j") == 0) {
+      numThreads = atoi(value);
+    } else if (strcmp(argv[firstDir], "-s") == 0) {
+      stepSize = atof(value);
+    } else if (strcmp(argv[firstDir], "-n") == 0) {
+      maxRounds = atoi(value);
+    } else if (strcmp(argv[firstDir], "-o") == 0) {
+      outputDir = value;
+    } else {
+      break;
+    }
+  }
+  if (firstDir >= argc || argv[firstDir][0] == '-' || numThreads == 0 ||
+      !(stepSize > 0)) {
+    fprintf(stderr,
+            "Usage: %s [-j <threads>] [-s <step size>] [-n <rounds>] "
+            "[-o <output dir>] <dir>...\n",
+            argv[0]);
+    return 1;
+  }
+
+  Clef::Host::KalmanOptimizer optimizer(numThreads);
+  for (int i = firstDir; i < argc; ++i) {
+    const std::vector<std::string> runs =
+        Clef::Host::BatchReplay::findRuns(argv[i]);
+    if (runs.empty()) {
+      fprintf(stderr, "%s: no recordings\n", argv[i]);
+      return 1;
+    }
+    for (const std::string &run : runs) {
+      std::string error;
+      if (!optimizer.addDataset(run, &error)) {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+      }
+      printf("Loaded %s\n", run.c_str());
+    }
+  }
+
+  const Clef::Host::KalmanOptimizer::Params params = optimizer.optimize(
+      Clef::Host::KalmanOptimizer::getDefaultParams(), stepSize, maxRounds,
+      outputDir, stdout);
+  printf("Final cost is %g; saved to %s/summary.json\n",
+         optimizer.evaluate(params).total, outputDir.c_str());
+  return 0;
+}
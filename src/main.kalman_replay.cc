@@ -0,0 +1,71 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <host/KalmanReplay.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace {
+/**
+ * Must match the order of xvars in tools/analysis/models/degen.py.
+ */
+const char *const STATE_NAMES[Clef::Host::KalmanReplay::NUM_STATES] = {
+    "xs", "dxsdt", "Ph", "Ph0", "Ps", "a1", "a0", "Chl", "gamma"};
+
+const float DEFAULT_TOLERANCE = 0.01f;
+}  // namespace
+
+/**
+ * Check the fixed-point extrusion filter against the float one on a log of
+ * the extruder, such as one captured with tools/stream_data.py:
+ *
+ *   clef-kalman-replay <log> [tolerance]
+ *
+ * Lines other than ";t=<usec>,xe=<usteps>,xs=<usteps>,P=<Pa>" are skipped.
+ * Fails if the largest error of any state variable, relative to the largest
+ * magnitude of that variable, is above the tolerance.
+ */
+int main(int argc, char **argv) {
+  if (argc != 2 && argc != 3) {
+    fprintf(stderr, "Usage: %s <log> [tolerance]\n", argv[0]);
+    return 1;
+  }
+  const float tolerance = argc == 3 ? atof(argv[2]) : DEFAULT_TOLERANCE;
+
+  FILE *const input = fopen(argv[1], "r");
+  if (!input) {
+    perror(argv[1]);
+    return 1;
+  }
+  Clef::Host::KalmanReplay replay;
+  char line[256];
+  while (fgets(line, sizeof(line), input)) {
+    Clef::Host::KalmanReplay::Sample sample;
+    if (Clef::Host::KalmanReplay::parseSample(line, &sample)) {
+      replay.evolve(sample);
+    }
+  }
+  fclose(input);
+  if (replay.getNumSamples() == 0) {
+    fprintf(stderr, "%s: no samples\n", argv[1]);
+    return 1;
+  }
+
+  printf("Replayed %u samples\n", replay.getNumSamples());
+  printf("%-8s %12s %12s %12s\n", "state", "max error", "rms error",
+         "relative");
+  bool pass = true;
+  for (uint16_t i = 0; i < Clef::Host::KalmanReplay::NUM_STATES; ++i) {
+    const float relativeError = replay.getRelativeError(i);
+    printf("%-8s %12.6g %12.6g %12.6g\n", STATE_NAMES[i],
+           replay.getMaxError(i), replay.getRmsError(i), relativeError);
+    if (!(relativeError <= tolerance)) {
+      pass = false;
+    }
+  }
+  if (!pass) {
+    printf("Fixed-point filter diverges by more than %g\n", tolerance);
+    return 1;
+  }
+  return 0;
+}
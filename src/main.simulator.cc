@@ -0,0 +1,155 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <host/Simulator.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+/**
+ * Print the host time taken by a part of the main loop.
+ */
+void printPhase(const char *const name,
+                const Clef::Host::Simulator::PhaseStats &phase,
+                const uint64_t numLoops) {
+  printf("  %-8s %10.3f s total, %8.3f us mean, %10.3f us max\n", name,
+         phase.totalSeconds,
+         numLoops > 0 ? phase.totalSeconds * 1e6 / numLoops : 0.0,
+         phase.maxSeconds * 1e6);
+}
+}  // namespace
+
+/**
+ * Run the firmware against emulated hardware on a G-code file:
+ *
+ *   clef-simulator [-p linear|kalman|fixed] [-g degen|gel] [-s <seed>]
+ *                  [-l <loop us>] [-b <baud>] [-w <window>]
+ *                  [-m <max seconds>] [-t <telemetry.csv>] <input.gcode>
+ *
+ * The file is streamed like tools/print.py does, and the main loop runs under
+ * a virtual clock, taking <loop us> per iteration, until it finishes or the
+ * printer's time reaches <max seconds>. The sensors read a model of the
+ * syringe filled with a degenerate fluid or a gel, with noise from <seed>.
+ * Timing statistics are printed at the end; the telemetry that the firmware
+ * would report (positions in usteps, sensor readings) is written to the CSV
+ * file if one is given.
+ */
+int main(int argc, char **argv) {
+  Clef::Host::Simulator::Options options =
+      Clef::Host::Simulator::DEFAULT_OPTIONS;
+  const char *telemetryFile = nullptr;
+  int firstArg = 1;
+  for (; firstArg + 1 < argc && argv[firstArg][0] == '-'; firstArg += 2) {
+    const char *const value = argv[firstArg + 1];
+    if (strcmp(argv[firstArg], "-p") == 0) {
+      if (strcmp(value, "linear") == 0) {
+        options.predictor = Clef::Host::Simulator::Predictor::LINEAR;
+      } else if (strcmp(value, "kalman") == 0) {
+        options.predictor = Clef::Host::Simulator::Predictor::KALMAN;
+      } else if (strcmp(value, "fixed") == 0) {
+        options.predictor =
+            Clef::Host::Simulator::Predictor::FIXED_POINT_KALMAN;
+      } else {
+        break;
+      }
+    } else if (strcmp(argv[firstArg], "-g") == 0) {
+      if (strcmp(value, "degen") == 0) {
+        options.plant = Clef::Impl::Emulator::SyringePlant::DEGEN_PARAMS;
+      } else if (strcmp(value, "gel") == 0) {
+        options.plant = Clef::Impl::Emulator::SyringePlant::GEL_PARAMS;
+      } else {
+        break;
+      }
+    } else if (strcmp(argv[firstArg], "-s") == 0) {
+      options.seed = strtoul(value, nullptr, 10);
+    } else if (strcmp(argv[firstArg], "-l") == 0) {
+      options.loopMicros = atoi(value);
+    } else if (strcmp(argv[firstArg], "-b") == 0) {
+      options.baud = atoi(value);
+    } else if (strcmp(argv[firstArg], "-w") == 0) {
+      options.window = atoi(value);
+    } else if (strcmp(argv[firstArg], "-m") == 0) {
+      options.maxMicros = static_cast<uint64_t>(atof(value) * 1e6);
+    } else if (strcmp(argv[firstArg], "-t") == 0) {
+      telemetryFile = value;
+    } else {
+      break;
+    }
+  }
+  if (firstArg + 1 != argc || argv[firstArg][0] == '-' ||
+      options.loopMicros == 0 || options.baud == 0 || options.window == 0) {
+    fprintf(stderr,
+            "Usage: %s [-p linear|kalman|fixed] [-g degen|gel] [-s <seed>] "
+            "[-l <loop us>] [-b <baud>] [-w <window>] [-m <max seconds>] "
+            "[-t <telemetry.csv>] <input.gcode>\n",
+            argv[0]);
+    return 1;
+  }
+
+  // Comments and blank lines are not sent
+  std::ifstream input(argv[firstArg]);
+  if (!input) {
+    perror(argv[firstArg]);
+    return 1;
+  }
+  std::vector<std::string> commands;
+  for (std::string line; std::getline(input, line);) {
+    line = line.substr(0, line.find(';'));
+    const size_t start = line.find_first_not_of(" \t\r");
+    if (start != std::string::npos) {
+      commands.push_back(
+          line.substr(start, line.find_last_not_of(" \t\r") + 1 - start));
+    }
+  }
+
+  Clef::Host::Simulator simulator(options);
+  std::string error;
+  const bool success = simulator.run(commands, &error);
+  if (!success) {
+    fprintf(stderr, "%s: %s\n", argv[firstArg], error.c_str());
+  }
+
+  if (telemetryFile) {
+    FILE *const output = fopen(telemetryFile, "w");
+    if (!output) {
+      perror(telemetryFile);
+      return 1;
+    }
+    fprintf(output, "t,x,y,z,xe,xs,P\n");
+    for (const Clef::Host::Simulator::Sample &sample :
+         simulator.getTelemetry()) {
+      fprintf(output, "%llu,%.0f,%.0f,%.0f,%.0f,%.1f,%.1f\n",
+              static_cast<unsigned long long>(sample.micros), sample.x,
+              sample.y, sample.z, sample.e, sample.xs, sample.P);
+    }
+    if (fclose(output) != 0) {
+      perror(telemetryFile);
+      return 1;
+    }
+  }
+
+  const Clef::Host::Simulator::Stats &stats = simulator.getStats();
+  const double printSeconds = stats.virtualMicros / 1e6;
+  printf("Printed %u of %zu lines (%u sent, %u resends, %u alloc errors)\n",
+         stats.numLines > 0 ? stats.numLines - 1 : 0, commands.size(),
+         stats.numLinesSent, stats.numResends, stats.numAllocErrors);
+  printf("Print time: %u:%02u:%06.3f in %.3f s (%.1fx real time)\n",
+         static_cast<unsigned>(printSeconds / 3600),
+         static_cast<unsigned>(printSeconds / 60) % 60,
+         printSeconds - 60 * static_cast<unsigned>(printSeconds / 60),
+         stats.hostSeconds,
+         stats.hostSeconds > 0 ? printSeconds / stats.hostSeconds : 0.0);
+  printf("%llu loop iterations, %llu timer edges, up to %u queued actions\n",
+         static_cast<unsigned long long>(stats.numLoops),
+         static_cast<unsigned long long>(stats.numEdges),
+         stats.maxActionQueueSize);
+  printf("Host time per loop iteration:\n");
+  printPhase("parse", stats.parse, stats.numLoops);
+  printPhase("actions", stats.actions, stats.numLoops);
+  printPhase("timers", stats.timers, stats.numLoops);
+  return success ? 0 : 1;
+}
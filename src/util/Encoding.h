@@ -0,0 +1,97 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Clef::Util {
+static const uint16_t CRC16_INIT = 0xffff;
+
+/**
+ * Add a byte to a CRC-16/CCITT (polynomial 0x1021, initial value CRC16_INIT).
+ */
+inline uint16_t crc16Update(uint16_t crc, const uint8_t byte) {
+  crc ^= static_cast<uint16_t>(byte) << 8;
+  for (uint8_t i = 0; i < 8; ++i) {
+    crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+/**
+ * Map signed integers to unsigned ones so that values close to zero have short
+ * varint encodings (0, -1, 1, -2, ... become 0, 1, 2, 3, ...).
+ */
+inline uint32_t encodeZigzag(const int32_t value) {
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+inline int32_t decodeZigzag(const uint32_t value) {
+  return static_cast<int32_t>(value >> 1) ^ -static_cast<int32_t>(value & 1);
+}
+
+/**
+ * Write an unsigned integer in little-endian base 128, with the high bit of
+ * each byte set if more bytes follow; returns the number of bytes written (at
+ * most 5).
+ */
+inline uint8_t encodeVarint(uint32_t value, uint8_t *const output) {
+  uint8_t size = 0;
+  while (value >= 0x80) {
+    output[size++] = static_cast<uint8_t>(value) | 0x80;
+    value >>= 7;
+  }
+  output[size++] = static_cast<uint8_t>(value);
+  return size;
+}
+
+/**
+ * Read fields from a byte buffer without running past its end. Every read
+ * returns false if the buffer is exhausted or the field is malformed.
+ */
+class ByteReader {
+ public:
+  ByteReader(const uint8_t *const data, const uint16_t size)
+      : data_(data), size_(size), position_(0) {}
+
+  bool readByte(uint8_t *const result) {
+    if (position_ >= size_) {
+      return false;
+    }
+    *result = data_[position_++];
+    return true;
+  }
+
+  bool readVarint(uint32_t *const result) {
+    *result = 0;
+    for (uint8_t shift = 0; shift < 35; shift += 7) {
+      uint8_t byte;
+      if (!readByte(&byte)) {
+        return false;
+      }
+      *result |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readSignedVarint(int32_t *const result) {
+    uint32_t value;
+    if (!readVarint(&value)) {
+      return false;
+    }
+    *result = decodeZigzag(value);
+    return true;
+  }
+
+  bool isAtEnd() const { return position_ == size_; }
+
+ private:
+  const uint8_t *const data_;
+  const uint16_t size_;
+  uint16_t position_;
+};
+}  // namespace Clef::Util
@@ -0,0 +1,150 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifndef TARGET_AVR
+#include <iostream>
+#endif
+
+namespace Clef::Util {
+/**
+ * Signed fixed-point number in 32 bits with F fractional bits (Q(31-F).F), for
+ * arithmetic on targets without an FPU. Products and quotients are calculated
+ * in 64 bits and rounded to nearest. Results out of range saturate at
+ * +/-MAX_RAW rather than wrapping, as does division by zero (by the sign of the
+ * dividend); scaling by powers of two with shift() is exact apart from the bits
+ * shifted out.
+ */
+template <uint8_t F>
+class Fixed {
+ public:
+  static constexpr int32_t ONE = static_cast<int32_t>(1) << F;
+  static constexpr int32_t MAX_RAW = 0x7FFFFFFF;
+
+  constexpr Fixed() : raw_(0) {}
+  constexpr Fixed(const int value)
+      : raw_(clamp(static_cast<int64_t>(value) * ONE)) {}
+  explicit constexpr Fixed(const double value)
+      : raw_(value * ONE >= MAX_RAW    ? MAX_RAW
+             : value * ONE <= -MAX_RAW ? -MAX_RAW
+                                       : static_cast<int32_t>(
+                                             value * ONE +
+                                             (value < 0 ? -0.5 : 0.5))) {}
+
+  static constexpr Fixed fromRaw(const int32_t raw) {
+    Fixed output;
+    output.raw_ = raw;
+    return output;
+  }
+
+  inline constexpr int32_t getRaw() const { return raw_; }
+  inline constexpr float toFloat() const {
+    return static_cast<float>(raw_) / ONE;
+  }
+
+  /**
+   * Multiply by 2^n.
+   */
+  inline constexpr Fixed shift(const int8_t n) const {
+    return n >= 0 ? saturate(static_cast<int64_t>(raw_) *
+                             (static_cast<int64_t>(1) << n))
+                  : fromRaw(static_cast<int32_t>(
+                        (static_cast<int64_t>(raw_) +
+                         (static_cast<int64_t>(1) << (-n - 1))) >>
+                        -n));
+  }
+
+  inline constexpr Fixed operator-() const {
+    return saturate(-static_cast<int64_t>(raw_));
+  }
+  inline constexpr Fixed operator+(const Fixed &other) const {
+    return saturate(static_cast<int64_t>(raw_) + other.raw_);
+  }
+  inline constexpr Fixed operator-(const Fixed &other) const {
+    return saturate(static_cast<int64_t>(raw_) - other.raw_);
+  }
+  inline constexpr Fixed operator*(const Fixed &other) const {
+    return saturate((static_cast<int64_t>(raw_) * other.raw_ + (ONE >> 1)) >>
+                    F);
+  }
+  inline constexpr Fixed operator/(const Fixed &other) const {
+    return other.raw_ == 0
+               ? saturate(raw_ < 0 ? -static_cast<int64_t>(MAX_RAW)
+                                   : raw_ > 0 ? MAX_RAW : 0)
+               : saturate((static_cast<int64_t>(raw_) * ONE +
+                           ((raw_ < 0) == (other.raw_ < 0) ? other.raw_ / 2
+                                                            : -other.raw_ / 2)) /
+                          other.raw_);
+  }
+  inline Fixed &operator+=(const Fixed &other) { return *this = *this + other; }
+  inline Fixed &operator-=(const Fixed &other) { return *this = *this - other; }
+  inline Fixed &operator*=(const Fixed &other) { return *this = *this * other; }
+
+  inline constexpr bool operator==(const Fixed &other) const {
+    return raw_ == other.raw_;
+  }
+  inline constexpr bool operator!=(const Fixed &other) const {
+    return raw_ != other.raw_;
+  }
+  inline constexpr bool operator<(const Fixed &other) const {
+    return raw_ < other.raw_;
+  }
+  inline constexpr bool operator>(const Fixed &other) const {
+    return raw_ > other.raw_;
+  }
+  inline constexpr bool operator<=(const Fixed &other) const {
+    return raw_ <= other.raw_;
+  }
+  inline constexpr bool operator>=(const Fixed &other) const {
+    return raw_ >= other.raw_;
+  }
+
+ private:
+  static constexpr int32_t clamp(const int64_t raw) {
+    return raw > MAX_RAW    ? MAX_RAW
+           : raw < -MAX_RAW ? -MAX_RAW
+                            : static_cast<int32_t>(raw);
+  }
+  static constexpr Fixed saturate(const int64_t raw) {
+    return fromRaw(clamp(raw));
+  }
+
+  int32_t raw_;
+};
+
+/**
+ * Square root, rounded down; 0 for negative numbers.
+ */
+template <uint8_t F>
+Fixed<F> sqrt(const Fixed<F> value) {
+  if (value.getRaw() <= 0) {
+    return Fixed<F>();
+  }
+  // The root of raw * 2^F, one bit at a time
+  uint64_t remainder = static_cast<uint64_t>(value.getRaw()) << F;
+  uint64_t root = 0;
+  uint64_t bit = static_cast<uint64_t>(1) << 62;
+  while (bit > remainder) {
+    bit >>= 2;
+  }
+  while (bit != 0) {
+    if (remainder >= root + bit) {
+      remainder -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return Fixed<F>::fromRaw(static_cast<int32_t>(root));
+}
+
+#ifndef TARGET_AVR
+template <uint8_t F>
+std::ostream &operator<<(std::ostream &os, const Fixed<F> &value) {
+  return os << value.toFloat();
+}
+#endif
+}  // namespace Clef::Util
@@ -0,0 +1,109 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#pragma once
+
+#include <stdint.h>
+
+namespace Clef::Util {
+/**
+ * Receive buffer which frames lines as bytes arrive, so that the reader only
+ * ever sees complete lines. Bytes are pushed by a single writer (the receive
+ * interrupt) and read by a single reader (the main loop); lines are stored back
+ * to back in a ring buffer of N bytes, of which N - 1 can be used.
+ *
+ * If a line does not fit, the part of it that was already stored is discarded
+ * along with the rest of the line, and the overflow is counted. The reader
+ * never sees a partial line, and the host finds out about the lost line when
+ * the next line number does not match.
+ *
+ * Every index shared between the writer and the reader is a single byte, so
+ * that it is read and written atomically on an 8-bit microcontroller.
+ */
+template <uint16_t N>
+class LineReceiver {
+ public:
+  static constexpr uint16_t capacity = N - 1; /*!< Maximum number of bytes. */
+
+  LineReceiver()
+      : head_(0),
+        lineStart_(0),
+        tail_(0),
+        numLinesReceived_(0),
+        numLinesRead_(0),
+        numOverflows_(0),
+        discarding_(false) {
+    static_assert(N > 1 && N <= 256 && (N & (N - 1)) == 0);
+  }
+
+  /**
+   * Add a received byte; called by the writer.
+   */
+  void push(const char c) {
+    if (discarding_) {
+      discarding_ = c != '\n';
+      return;
+    }
+    const uint8_t next = (head_ + 1) & (N - 1);
+    if (next == tail_) {
+      // Roll back the line that does not fit and drop the rest of it
+      head_ = lineStart_;
+      numOverflows_++;
+      discarding_ = c != '\n';
+      return;
+    }
+    data_[head_] = c;
+    head_ = next;
+    if (c == '\n') {
+      lineStart_ = head_;
+      numLinesReceived_++;
+    }
+  }
+
+  /**
+   * Check whether a complete line can be read.
+   */
+  bool isLineReady() const {
+    return static_cast<uint8_t>(numLinesReceived_ - numLinesRead_) > 0;
+  }
+
+  /**
+   * Read the next byte of a complete line; returns false if no complete line
+   * has been received. Called by the reader.
+   */
+  bool read(char *const c) {
+    if (!isLineReady()) {
+      return false;
+    }
+    *c = data_[tail_];
+    tail_ = (tail_ + 1) & (N - 1);
+    if (*c == '\n') {
+      numLinesRead_++;
+    }
+    return true;
+  }
+
+  /**
+   * Number of bytes that can be received before the buffer overflows.
+   */
+  uint16_t getNumSpacesLeft() const {
+    return (static_cast<uint16_t>(tail_) + N - 1 - head_) & (N - 1);
+  }
+
+  /**
+   * Number of lines which have been discarded because they did not fit. The
+   * writer updates the counter, so an 8-bit reader must not be interrupted
+   * while reading it.
+   */
+  uint16_t getNumOverflows() const { return numOverflows_; }
+
+ private:
+  char data_[N];
+  volatile uint8_t head_;      /*!< Next byte to write; owned by the writer. */
+  volatile uint8_t lineStart_; /*!< Start of the line being received. */
+  volatile uint8_t tail_;      /*!< Next byte to read; owned by the reader. */
+  volatile uint8_t numLinesReceived_; /*!< Complete lines written (mod 256). */
+  volatile uint8_t numLinesRead_;     /*!< Complete lines read (mod 256). */
+  volatile uint16_t numOverflows_;
+  bool discarding_; /*!< Whether the rest of the line is being dropped. */
+};
+}  // namespace Clef::Util
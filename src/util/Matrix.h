@@ -12,17 +12,21 @@
 #endif
 
 namespace Clef::Util {
-template <uint16_t R, uint16_t C, bool T>
+/**
+ * Matrices are of floats unless the element type E says otherwise (such as a
+ * Clef::Util::Fixed).
+ */
+template <uint16_t R, uint16_t C, bool T, typename E = float>
 class BaseMatrix {
  public:
-  virtual float get(const uint16_t r, const uint16_t c) const {
+  virtual E get(const uint16_t r, const uint16_t c) const {
     return readData(calculateIndex(r, c));
   }
 
 #ifndef TARGET_AVR
-  template <uint16_t R_, uint16_t C_, bool T_>
+  template <uint16_t R_, uint16_t C_, bool T_, typename E_>
   friend std::ostream &operator<<(std::ostream &os,
-                                  const BaseMatrix<R_, C_, T_> &mat);
+                                  const BaseMatrix<R_, C_, T_, E_> &mat);
 #endif
 
  protected:
@@ -33,12 +37,12 @@ class BaseMatrix {
 #endif
     return T ? c * R + r : r * C + c;
   }
-  virtual float readData(const uint16_t index) const = 0;
+  virtual E readData(const uint16_t index) const = 0;
 };
 
 #ifndef TARGET_AVR
-template <uint16_t R, uint16_t C, bool T>
-std::ostream &operator<<(std::ostream &os, const BaseMatrix<R, C, T> &mat) {
+template <uint16_t R, uint16_t C, bool T, typename E>
+std::ostream &operator<<(std::ostream &os, const BaseMatrix<R, C, T, E> &mat) {
   os << std::fixed << std::setprecision(6);
   for (unsigned int r = 0; r < R; ++r) {
     for (unsigned int c = 0; c < C; ++c) {
@@ -50,10 +54,10 @@ std::ostream &operator<<(std::ostream &os, const BaseMatrix<R, C, T> &mat) {
 }
 #endif
 
-template <uint16_t N>
-class BaseDiagonalMatrix : public BaseMatrix<N, N, false> {
+template <uint16_t N, typename E = float>
+class BaseDiagonalMatrix : public BaseMatrix<N, N, false, E> {
  public:
-  virtual float get(const uint16_t r, const uint16_t c) const override {
+  virtual E get(const uint16_t r, const uint16_t c) const override {
 #ifndef TARGET_AVR
     assert(r < N);
     assert(c < N);
@@ -62,12 +66,12 @@ class BaseDiagonalMatrix : public BaseMatrix<N, N, false> {
   }
 };
 
-template <uint16_t N>
-class IdentityMatrix : public BaseDiagonalMatrix<N> {
+template <uint16_t N, typename E = float>
+class IdentityMatrix : public BaseDiagonalMatrix<N, E> {
  public:
   IdentityMatrix() {}
 
-  float get(const uint16_t r, const uint16_t c) const override {
+  E get(const uint16_t r, const uint16_t c) const override {
 #ifndef TARGET_AVR
     assert(r < N);
     assert(c < N);
@@ -76,17 +80,17 @@ class IdentityMatrix : public BaseDiagonalMatrix<N> {
   }
 
  private:
-  float readData(const uint16_t index) const override { return 0; }
+  E readData(const uint16_t index) const override { return 0; }
 };
 
-template <uint16_t R, uint16_t C, bool T>
-class BaseWritableMatrix : public BaseMatrix<R, C, T> {
+template <uint16_t R, uint16_t C, bool T, typename E = float>
+class BaseWritableMatrix : public BaseMatrix<R, C, T, E> {
  public:
-  void set(const uint16_t r, const uint16_t c, const float value) {
+  void set(const uint16_t r, const uint16_t c, const E value) {
     writeData(this->calculateIndex(r, c), value);
   }
 
-  virtual void fill(const float value) {
+  virtual void fill(const E value) {
     for (unsigned int r = 0; r < R; ++r) {
       for (unsigned int c = 0; c < C; ++c) {
         set(r, c, value);
@@ -95,61 +99,243 @@ class BaseWritableMatrix : public BaseMatrix<R, C, T> {
   }
 
  protected:
-  virtual void writeData(const uint16_t index, const float value) = 0;
+  virtual void writeData(const uint16_t index, const E value) = 0;
 };
 
-template <uint16_t R, uint16_t C, bool T>
-class BaseRamMatrix : public BaseWritableMatrix<R, C, T> {
-  friend class BaseRamMatrix<C, R, !T>;
+template <uint16_t R, uint16_t C, bool T, typename E = float>
+class BaseRamMatrix : public BaseWritableMatrix<R, C, T, E> {
+  friend class BaseRamMatrix<C, R, !T, E>;
 
  public:
-  BaseRamMatrix(float *data) : data_(data) {}
+  BaseRamMatrix(E *data) : data_(data) {}
   BaseRamMatrix(const BaseRamMatrix &other) : data_(other.data_) {}
-  BaseRamMatrix(const BaseRamMatrix<C, R, !T> &other) : data_(other.data_) {}
+  BaseRamMatrix(const BaseRamMatrix<C, R, !T, E> &other)
+      : data_(other.data_) {}
+
+  BaseRamMatrix<C, R, !T, E> transpose() const {
+    return BaseRamMatrix<C, R, !T, E>(*this);
+  }
+
+  /**
+   * Underlying storage, which is row-major unless T is set.
+   */
+  E *getData() const { return data_; }
+
+  void fill(const E value) override {
+    for (uint16_t i = 0; i < R * C; ++i) {
+      data_[i] = value;
+    }
+  }
+
+ protected:
+  E readData(const uint16_t index) const override { return data_[index]; }
 
-  BaseRamMatrix<C, R, !T> transpose() const {
-    return BaseRamMatrix<C, R, !T>(*this);
+  virtual void writeData(const uint16_t index, const E value) override {
+    data_[index] = value;
   }
 
-  void fill(const float value) override {
-    if (value == 0) {
-      memset(data_, 0, R * C * sizeof(float));
-    } else {
-      BaseWritableMatrix<R, C, T>::fill(value);
+ private:
+  E *data_;
+};
+
+template <uint16_t R, uint16_t C, typename E = float>
+class WriteableMatrix : public BaseWritableMatrix<R, C, false, E> {
+ public:
+  using Transpose = BaseWritableMatrix<C, R, true, E>;
+};
+
+template <uint16_t R, uint16_t C, typename E = float>
+class RamMatrix : public BaseRamMatrix<R, C, false, E> {
+ public:
+  using Transpose = BaseRamMatrix<C, R, true, E>;
+  RamMatrix(E *data) : BaseRamMatrix<R, C, false, E>(data) {}
+};
+
+/**
+ * Index of an element of an N x N symmetric matrix whose upper triangle is
+ * packed row by row; either of a pair of mirrored elements gives the same
+ * index.
+ */
+template <uint16_t N>
+uint16_t packedSymmetricIndex(const uint16_t r, const uint16_t c) {
+#ifndef TARGET_AVR
+  assert(r < N);
+  assert(c < N);
+#endif
+  return r <= c ? r * N - r * (r + 1) / 2 + c : c * N - c * (c + 1) / 2 + r;
+}
+
+/**
+ * Symmetric matrix which only stores its N * (N + 1) / 2 unique elements, so
+ * that setting an element also sets its mirror image.
+ */
+template <uint16_t N, typename E = float>
+class SymmetricRamMatrix : public BaseWritableMatrix<N, N, false, E> {
+ public:
+  static constexpr uint16_t size = N * (N + 1) / 2; /*!< Number of elements. */
+
+  SymmetricRamMatrix(E *data) : data_(data) {}
+
+  E *getData() const { return data_; }
+
+  void fill(const E value) override {
+    for (uint16_t i = 0; i < size; ++i) {
+      data_[i] = value;
     }
   }
 
  protected:
-  float readData(const uint16_t index) const override { return data_[index]; }
+  uint16_t calculateIndex(const uint16_t r, const uint16_t c) const override {
+    return packedSymmetricIndex<N>(r, c);
+  }
 
-  virtual void writeData(const uint16_t index, const float value) override {
+  E readData(const uint16_t index) const override { return data_[index]; }
+
+  void writeData(const uint16_t index, const E value) override {
     data_[index] = value;
   }
 
  private:
-  float *data_;
+  E *data_;
+};
+
+/**
+ * Statically dispatched counterpart of BaseMatrix. D is the concrete type,
+ * which provides get(r, c) (and set(r, c, value) if it is writable) without
+ * any virtual functions, so that the kernels in Matrix:: can be inlined and
+ * their loops unrolled for sizes known at compile time. D also names its
+ * element type as D::Element. Views are cheap to copy and do not own their
+ * storage.
+ */
+template <typename D, uint16_t R, uint16_t C>
+class StaticMatrix {
+ public:
+  static constexpr uint16_t rows = R;
+  static constexpr uint16_t columns = C;
+
+  const D &derived() const { return static_cast<const D &>(*this); }
+  D &derived() { return static_cast<D &>(*this); }
+};
+
+/**
+ * Transpose of another static matrix, resolved at compile time.
+ */
+template <typename M>
+class StaticTranspose
+    : public StaticMatrix<StaticTranspose<M>, M::columns, M::rows> {
+ public:
+  using Element = typename M::Element;
+
+  explicit StaticTranspose(const M &matrix) : matrix_(matrix) {}
+
+  Element get(const uint16_t r, const uint16_t c) const {
+    return matrix_.get(c, r);
+  }
+
+ private:
+  const M matrix_;
+};
+
+/**
+ * Matrix in contiguous row-major storage.
+ */
+template <uint16_t R, uint16_t C, typename E = float>
+class StaticRamMatrix : public StaticMatrix<StaticRamMatrix<R, C, E>, R, C> {
+ public:
+  using Element = E;
+
+  explicit StaticRamMatrix(E *const data) : data_(data) {}
+
+  E get(const uint16_t r, const uint16_t c) const {
+#ifndef TARGET_AVR
+    assert(r < R);
+    assert(c < C);
+#endif
+    return data_[r * C + c];
+  }
+
+  void set(const uint16_t r, const uint16_t c, const E value) {
+#ifndef TARGET_AVR
+    assert(r < R);
+    assert(c < C);
+#endif
+    data_[r * C + c] = value;
+  }
+
+  StaticTranspose<StaticRamMatrix> transpose() const {
+    return StaticTranspose<StaticRamMatrix>(*this);
+  }
+
+ private:
+  E *const data_;
+};
+
+/**
+ * Diagonal matrix whose elements are read from any source that provides
+ * getDiagonal(i) and names its Element type, such as a
+ * Clef::If::RomDiagonalMatrix.
+ */
+template <typename S, uint16_t N>
+class StaticDiagonalMatrix
+    : public StaticMatrix<StaticDiagonalMatrix<S, N>, N, N> {
+ public:
+  using Element = typename S::Element;
+
+  explicit StaticDiagonalMatrix(const S &source) : source_(source) {}
+
+  Element get(const uint16_t r, const uint16_t c) const {
+    return r == c ? source_.getDiagonal(r) : 0;
+  }
+
+  Element getDiagonal(const uint16_t i) const {
+    return source_.getDiagonal(i);
+  }
+
+ private:
+  const S &source_;
 };
 
-template <uint16_t R, uint16_t C>
-class WriteableMatrix : public BaseWritableMatrix<R, C, false> {
+/**
+ * Static view of the packed storage of a SymmetricRamMatrix.
+ */
+template <uint16_t N, typename E = float>
+class StaticSymmetricMatrix
+    : public StaticMatrix<StaticSymmetricMatrix<N, E>, N, N> {
  public:
-  using Transpose = BaseWritableMatrix<C, R, true>;
+  using Element = E;
+  static constexpr uint16_t size = SymmetricRamMatrix<N, E>::size;
+
+  explicit StaticSymmetricMatrix(E *const data) : data_(data) {}
+
+  E get(const uint16_t r, const uint16_t c) const {
+    return data_[packedSymmetricIndex<N>(r, c)];
+  }
+
+  void set(const uint16_t r, const uint16_t c, const E value) {
+    data_[packedSymmetricIndex<N>(r, c)] = value;
+  }
+
+ private:
+  E *const data_;
 };
 
-template <uint16_t R, uint16_t C>
-class RamMatrix : public BaseRamMatrix<R, C, false> {
+template <uint16_t N, typename E = float>
+class StaticIdentityMatrix
+    : public StaticMatrix<StaticIdentityMatrix<N, E>, N, N> {
  public:
-  using Transpose = BaseRamMatrix<C, R, true>;
-  RamMatrix(float *data) : BaseRamMatrix<R, C, false>(data) {}
+  using Element = E;
+
+  E get(const uint16_t r, const uint16_t c) const { return r == c ? 1 : 0; }
 };
 
 namespace Matrix {
-template <uint16_t K, uint16_t M, uint16_t N, bool T1, bool T2>
-void dot(const BaseMatrix<K, M, T1> &left, const BaseMatrix<M, N, T2> &right,
-         BaseWritableMatrix<K, N, false> &output) {
+template <uint16_t K, uint16_t M, uint16_t N, bool T1, bool T2, typename E>
+void dot(const BaseMatrix<K, M, T1, E> &left,
+         const BaseMatrix<M, N, T2, E> &right,
+         BaseWritableMatrix<K, N, false, E> &output) {
   for (unsigned int r = 0; r < K; ++r) {
     for (unsigned int c = 0; c < N; ++c) {
-      float sum = 0;
+      E sum = 0;
       for (unsigned int j = 0; j < M; ++j) {
         sum += left.get(r, j) * right.get(j, c);
       }
@@ -158,9 +344,10 @@ void dot(const BaseMatrix<K, M, T1> &left, const BaseMatrix<M, N, T2> &right,
   }
 }
 
-template <uint16_t M, uint16_t N, bool T>
-void dot(const BaseDiagonalMatrix<M> &left, const BaseMatrix<M, N, T> &right,
-         BaseWritableMatrix<M, N, false> &output) {
+template <uint16_t M, uint16_t N, bool T, typename E>
+void dot(const BaseDiagonalMatrix<M, E> &left,
+         const BaseMatrix<M, N, T, E> &right,
+         BaseWritableMatrix<M, N, false, E> &output) {
   for (unsigned int r = 0; r < M; ++r) {
     for (unsigned int c = 0; c < N; ++c) {
       output.set(r, c, left.get(r, r) * right.get(r, c));
@@ -168,9 +355,9 @@ void dot(const BaseDiagonalMatrix<M> &left, const BaseMatrix<M, N, T> &right,
   }
 }
 
-template <uint16_t M, uint16_t N, bool T>
-void dot(const BaseMatrix<M, N, T> &left, BaseDiagonalMatrix<N> &right,
-         BaseWritableMatrix<M, N, false> &output) {
+template <uint16_t M, uint16_t N, bool T, typename E>
+void dot(const BaseMatrix<M, N, T, E> &left, BaseDiagonalMatrix<N, E> &right,
+         BaseWritableMatrix<M, N, false, E> &output) {
   for (unsigned int r = 0; r < M; ++r) {
     for (unsigned int c = 0; c < N; ++c) {
       output.set(r, c, left.get(r, c) * right.get(c, c));
@@ -178,9 +365,10 @@ void dot(const BaseMatrix<M, N, T> &left, BaseDiagonalMatrix<N> &right,
   }
 }
 
-template <uint16_t M, uint16_t N, bool T1, bool T2>
-void add(const BaseMatrix<M, N, T1> &left, const BaseMatrix<M, N, T2> &right,
-         BaseWritableMatrix<M, N, false> &output) {
+template <uint16_t M, uint16_t N, bool T1, bool T2, typename E>
+void add(const BaseMatrix<M, N, T1, E> &left,
+         const BaseMatrix<M, N, T2, E> &right,
+         BaseWritableMatrix<M, N, false, E> &output) {
   for (unsigned int r = 0; r < M; ++r) {
     for (unsigned int c = 0; c < N; ++c) {
       output.set(r, c, left.get(r, c) + right.get(r, c));
@@ -188,9 +376,10 @@ void add(const BaseMatrix<M, N, T1> &left, const BaseMatrix<M, N, T2> &right,
   }
 }
 
-template <uint16_t M, uint16_t N, bool T1, bool T2>
-void sub(const BaseMatrix<M, N, T1> &left, const BaseMatrix<M, N, T2> &right,
-         BaseWritableMatrix<M, N, false> &output) {
+template <uint16_t M, uint16_t N, bool T1, bool T2, typename E>
+void sub(const BaseMatrix<M, N, T1, E> &left,
+         const BaseMatrix<M, N, T2, E> &right,
+         BaseWritableMatrix<M, N, false, E> &output) {
   for (unsigned int r = 0; r < M; ++r) {
     for (unsigned int c = 0; c < N; ++c) {
       output.set(r, c, left.get(r, c) - right.get(r, c));
@@ -198,6 +387,85 @@ void sub(const BaseMatrix<M, N, T1> &left, const BaseMatrix<M, N, T2> &right,
   }
 }
 
+template <typename L, typename Rt, typename O, uint16_t K, uint16_t M,
+          uint16_t N>
+void dot(const StaticMatrix<L, K, M> &left, const StaticMatrix<Rt, M, N> &right,
+         StaticMatrix<O, K, N> &output) {
+  for (uint16_t r = 0; r < K; ++r) {
+    for (uint16_t c = 0; c < N; ++c) {
+      typename O::Element sum = 0;
+      for (uint16_t j = 0; j < M; ++j) {
+        sum += left.derived().get(r, j) * right.derived().get(j, c);
+      }
+      output.derived().set(r, c, sum);
+    }
+  }
+}
+
+/**
+ * Product which the caller knows to be symmetric, such as F * P * F^T; only
+ * the upper triangle is calculated.
+ */
+template <typename L, typename Rt, uint16_t M, uint16_t N, typename E>
+void dotSymmetric(const StaticMatrix<L, N, M> &left,
+                  const StaticMatrix<Rt, M, N> &right,
+                  StaticSymmetricMatrix<N, E> &output) {
+  for (uint16_t r = 0; r < N; ++r) {
+    for (uint16_t c = r; c < N; ++c) {
+      E sum = 0;
+      for (uint16_t j = 0; j < M; ++j) {
+        sum += left.derived().get(r, j) * right.derived().get(j, c);
+      }
+      output.set(r, c, sum);
+    }
+  }
+}
+
+template <typename S, typename Rt, typename O, uint16_t M, uint16_t N>
+void dot(const StaticDiagonalMatrix<S, M> &left,
+         const StaticMatrix<Rt, M, N> &right, StaticMatrix<O, M, N> &output) {
+  for (uint16_t r = 0; r < M; ++r) {
+    const auto factor = left.getDiagonal(r);
+    for (uint16_t c = 0; c < N; ++c) {
+      output.derived().set(r, c, factor * right.derived().get(r, c));
+    }
+  }
+}
+
+template <typename L, typename S, typename O, uint16_t M, uint16_t N>
+void dot(const StaticMatrix<L, M, N> &left,
+         const StaticDiagonalMatrix<S, N> &right,
+         StaticMatrix<O, M, N> &output) {
+  for (uint16_t r = 0; r < M; ++r) {
+    for (uint16_t c = 0; c < N; ++c) {
+      output.derived().set(r, c,
+                           left.derived().get(r, c) * right.getDiagonal(c));
+    }
+  }
+}
+
+template <typename L, typename Rt, typename O, uint16_t M, uint16_t N>
+void add(const StaticMatrix<L, M, N> &left, const StaticMatrix<Rt, M, N> &right,
+         StaticMatrix<O, M, N> &output) {
+  for (uint16_t r = 0; r < M; ++r) {
+    for (uint16_t c = 0; c < N; ++c) {
+      output.derived().set(
+          r, c, left.derived().get(r, c) + right.derived().get(r, c));
+    }
+  }
+}
+
+template <typename L, typename Rt, typename O, uint16_t M, uint16_t N>
+void sub(const StaticMatrix<L, M, N> &left, const StaticMatrix<Rt, M, N> &right,
+         StaticMatrix<O, M, N> &output) {
+  for (uint16_t r = 0; r < M; ++r) {
+    for (uint16_t c = 0; c < N; ++c) {
+      output.derived().set(
+          r, c, left.derived().get(r, c) - right.derived().get(r, c));
+    }
+  }
+}
+
 namespace {
 /**
  * @brief Substep in Gauss-Jordan elimination inverse matrix algorithm. Scratch
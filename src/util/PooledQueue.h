@@ -74,6 +74,8 @@ class PooledQueue {
   };
 
  public:
+  static constexpr uint16_t capacity = N - 1; /*!< Maximum number of items. */
+
   PooledQueue() { static_assert(N > 1); }
 
   inline Iterator first() const {
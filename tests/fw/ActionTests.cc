@@ -2,6 +2,7 @@
 
 #include <fw/Action.h>
 
+#include <algorithm>
 #include <iostream>
 
 #include "IntegrationFixture.h"
@@ -24,11 +25,45 @@ TEST_F(ActionTest, MoveXYE) {
   while (!action.isFinished(context_)) {
     displacementSensor_.inject(displacement++);
     pressureSensor_.inject(0);
-    xAxisTimer_.pulseOnce();
+    stepTimer_.pulseOnce();
     eAxisTimer_.pulseOnce();
     action.onLoop(context_);
   }
   ASSERT_EQ(*axes_.getX().getPosition(), 10 * USTEPS_PER_MM_X);
   ASSERT_EQ(context_.xyePositionQueue.size(), 0);
 }
+
+TEST_F(ActionTest, AnyAction) {
+  Action::AnyAction action = Action::MoveZ({0, 0, 0, 0}, 3);
+  ASSERT_EQ(action.getType(), Action::Type::MOVE_Z);
+  ASSERT_EQ(*action.getEndPosition().z, 3);
+  action = Action::SetFeedrate({1, 2, 3, 4}, 600);
+  ASSERT_EQ(action.getType(), Action::Type::SET_FEEDRATE);
+  ASSERT_EQ(action.getEndPosition(), (XYZEPosition{1, 2, 3, 4}));
+  ASSERT_TRUE(action.isFinished(context_));
+  ASSERT_EQ(ActionQueue::bytesPerAction, sizeof(Action::AnyAction));
+
+  // A slot is only as large as the largest action plus the tag
+  const size_t largest = std::max(
+      {sizeof(Action::MoveXY), sizeof(Action::MoveXYE), sizeof(Action::MoveE),
+       sizeof(Action::MoveZ), sizeof(Action::SetFeedrate)});
+  ASSERT_LE(ActionQueue::bytesPerAction, largest + alignof(Action::AnyAction));
+}
+
+TEST_F(ActionTest, QueueOfOneType) {
+  // Any slot can hold any type of action, so the whole queue can be filled with
+  // actions of one type
+  for (uint16_t i = 0; i < ActionQueue::capacity; ++i) {
+    ASSERT_TRUE(actionQueue_.push(
+        context_, Action::MoveE(actionQueue_.getEndPosition(), i + 1)));
+  }
+  ASSERT_EQ(actionQueue_.size(), ACTION_QUEUE_SIZE - 1);
+  ASSERT_FALSE(actionQueue_.push(
+      context_, Action::MoveE(actionQueue_.getEndPosition(), 100)));
+  ASSERT_EQ(*actionQueue_.getEndPosition().e, ActionQueue::capacity);
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+  ASSERT_EQ(*actionQueue_.getStartPosition().e, ActionQueue::capacity);
+}
 }  // namespace Clef::Fw
@@ -0,0 +1,113 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/Arc.h>
+#include <gtest/gtest.h>
+#include <math.h>
+
+#include <vector>
+
+namespace Clef::Fw {
+namespace {
+struct Point {
+  float x;
+  float y;
+  float e;
+};
+
+std::vector<Point> collect(ArcInterpolator *arc) {
+  std::vector<Point> points;
+  while (arc->isActive()) {
+    Point point;
+    arc->getPoint(&point.x, &point.y, &point.e);
+    points.push_back(point);
+    arc->advance();
+  }
+  return points;
+}
+}  // namespace
+
+TEST(ArcTest, QuarterCircle) {
+  // Counterclockwise from (10, 0) to (0, 10) around the origin
+  ArcInterpolator arc;
+  ASSERT_TRUE(arc.begin(10, 0, 0, 0, 10, 2, -10, 0, false, 0.01));
+  const std::vector<Point> points = collect(&arc);
+  ASSERT_EQ(points.size(), arc.getNumSegments());
+
+  // 2 * acos(1 - 0.01 / 10) per chord
+  ASSERT_EQ(points.size(), 18);
+  float lastX = 10, lastY = 0, lastE = 0;
+  for (const Point &point : points) {
+    ASSERT_NEAR(hypotf(point.x, point.y), 10, 1e-4);
+    ASSERT_LT(point.x, lastX);
+    ASSERT_GT(point.y, lastY);
+    ASSERT_GT(point.e, lastE);
+
+    // The middle of the chord is within the tolerance of the arc
+    const float midX = (point.x + lastX) / 2, midY = (point.y + lastY) / 2;
+    ASSERT_LE(10 - hypotf(midX, midY), 0.01 + 1e-4);
+    lastX = point.x;
+    lastY = point.y;
+    lastE = point.e;
+  }
+  ASSERT_EQ(points.back().x, 0);
+  ASSERT_EQ(points.back().y, 10);
+  ASSERT_EQ(points.back().e, 2);
+}
+
+TEST(ArcTest, FullCircle) {
+  // Clockwise around (5, 5) back to the start, with enough chords for the
+  // position to be corrected
+  ArcInterpolator arc;
+  ASSERT_TRUE(arc.begin(0, 5, 0, 0, 5, 0, 5, 0, true, 0.001));
+  const std::vector<Point> points = collect(&arc);
+  ASSERT_GT(points.size(), 4 * ARC_CORRECTION_SEGMENTS);
+  for (const Point &point : points) {
+    ASSERT_NEAR(hypotf(point.x - 5, point.y - 5), 5, 1e-4);
+  }
+
+  // Clockwise from the left of the center passes above it first
+  ASSERT_GT(points[0].y, 5);
+  ASSERT_EQ(points.back().x, 0);
+  ASSERT_EQ(points.back().y, 5);
+  ASSERT_FALSE(arc.begin(0, 5, 0, 0, 5, 0, 0, 0, true));
+  ASSERT_FALSE(arc.isActive());
+}
+
+TEST(ArcTest, Radius) {
+  float i, j;
+
+  // Clockwise from (0, 0) to (10, 0) with radius 5 is centered at (5, 0)
+  ASSERT_TRUE(ArcInterpolator::getCenterOffset(0, 0, 10, 0, 5, true, &i, &j));
+  ASSERT_NEAR(i, 5, 1e-5);
+  ASSERT_NEAR(j, 0, 1e-5);
+
+  // The short way from (0, 0) to (10, 0) with radius 10 is centered below the
+  // chord when clockwise and above it when counterclockwise; a negative radius
+  // takes the long way
+  const float h = sqrtf(100 - 25);
+  ASSERT_TRUE(ArcInterpolator::getCenterOffset(0, 0, 10, 0, 10, true, &i, &j));
+  ASSERT_NEAR(i, 5, 1e-5);
+  ASSERT_NEAR(j, -h, 1e-5);
+  ASSERT_TRUE(
+      ArcInterpolator::getCenterOffset(0, 0, 10, 0, 10, false, &i, &j));
+  ASSERT_NEAR(j, h, 1e-5);
+  ASSERT_TRUE(
+      ArcInterpolator::getCenterOffset(0, 0, 10, 0, -10, true, &i, &j));
+  ASSERT_NEAR(j, h, 1e-5);
+
+  // The short way is less than half a circle
+  ArcInterpolator shortArc, longArc;
+  ASSERT_TRUE(ArcInterpolator::getCenterOffset(0, 0, 10, 0, 10, true, &i, &j));
+  shortArc.begin(0, 0, 0, 10, 0, 0, i, j, true);
+  ASSERT_TRUE(
+      ArcInterpolator::getCenterOffset(0, 0, 10, 0, -10, true, &i, &j));
+  longArc.begin(0, 0, 0, 10, 0, 0, i, j, true);
+  ASSERT_LT(shortArc.getNumSegments(), longArc.getNumSegments());
+  ASSERT_GT(collect(&shortArc)[0].y, 0);
+  ASSERT_GT(collect(&longArc)[0].y, 0);
+
+  // Too small a radius, or an arc to the start
+  ASSERT_FALSE(ArcInterpolator::getCenterOffset(0, 0, 10, 0, 4, true, &i, &j));
+  ASSERT_FALSE(ArcInterpolator::getCenterOffset(0, 0, 0, 0, 4, true, &i, &j));
+}
+}  // namespace Clef::Fw
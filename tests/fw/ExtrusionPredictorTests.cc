@@ -0,0 +1,53 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/ExtrusionPredictor.h>
+#include <gtest/gtest.h>
+#include <math.h>
+
+namespace Clef::Fw {
+namespace {
+/**
+ * Feed the predictor samples at the 250 Hz rate of the calipers from an
+ * extruder which runs at the given rate (in usteps/s) from xe0, with the
+ * filament following the pressure built up behind it as in the model. Returns
+ * the number of samples until the predictor is beyond its endpoint, or 0 if it
+ * never is.
+ */
+uint32_t samplesToEndpoint(ExtrusionPredictor &predictor, const float xe0,
+                           const float rate, const float endpoint,
+                           const uint32_t numSamples) {
+  const float Chl = 10, gamma = 0.08, a1 = 2, Ph0 = 4900;
+  float xe = xe0, xs = xe0;
+  predictor.reset(0, xe0, xs);
+  predictor.setEndpoint(xe0 + endpoint);
+  for (uint32_t i = 1; i <= numSamples; ++i) {
+    xe += rate * 0.004f;
+    const float Ph = Chl * (xe - xs);
+    xs += gamma * Ph / (1 + gamma * a1) * 0.004f;
+    predictor.evolve(i * 0.004f, roundf(xe), roundf(xs), Ph0 + Ph);
+    while (!predictor.advance()) {
+    }
+    if (predictor.isBeyondEndpoint()) {
+      return i;
+    }
+  }
+  return 0;
+}
+}  // namespace
+
+TEST(ExtrusionPredictorTest, FixedPointLongExtrusion) {
+  // Far more than the 32768 usteps that fit in Q16.16, from a position which
+  // is far from 0 as well. The extrusion is slow, because the covariance of
+  // Ps grows with the square of the rate for as long as it is steady (in the
+  // float filter too) and would leave the range of the fixed-point filter
+  // first
+  KalmanFilterExtrusionPredictor floatPredictor;
+  FixedPointKalmanFilterExtrusionPredictor fixedPredictor;
+  const uint32_t floatSamples =
+      samplesToEndpoint(floatPredictor, 200000, 400, 50000, 40000);
+  const uint32_t fixedSamples =
+      samplesToEndpoint(fixedPredictor, 200000, 400, 50000, 40000);
+  ASSERT_GT(floatSamples, 30000);
+  ASSERT_NEAR(fixedSamples, floatSamples, 2);
+}
+}  // namespace Clef::Fw
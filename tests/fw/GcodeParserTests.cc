@@ -21,18 +21,112 @@ class GcodeParserTest : public IntegrationFixture {
    * Perform checks and cleanup for doBasic().
    */
   void checkBasic(XYZEPosition origStartPosition) {
-    ASSERT_EQ(serial_.extract(), "ok\n");
+    ASSERT_EQ(serial_.extract(), ok());
     ASSERT_EQ(actionQueue_.size(), 1);
-    ASSERT_TRUE(actionQueue_.checkConservation());
     ActionQueue::Iterator it = actionQueue_.first();
-    ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XY);
-    XYZEPosition endPosition = (*it)->getEndPosition();
+    ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+    XYZEPosition endPosition = it->getEndPosition();
     ASSERT_EQ(*endPosition.x, 80);
     ASSERT_EQ(endPosition.y, origStartPosition.y);
     ASSERT_EQ(endPosition.z, origStartPosition.z);
     ASSERT_EQ(endPosition.e, origStartPosition.e);
     actionQueue_.pop(context_);
-    ASSERT_TRUE(actionQueue_.checkConservation());
+  }
+
+  /**
+   * Expected acknowledgement when the queues have the given number of free
+   * slots and the given number of bytes are still unread.
+   */
+  static std::string ok(const uint16_t actionSpaces, const uint16_t xyeSpaces,
+                        const uint16_t unreadBytes,
+                        const int32_t lineNumber = -1) {
+    std::string result = Str::OK;
+    if (lineNumber >= 0) {
+      result += " N" + std::to_string(lineNumber);
+    }
+    const uint16_t rxSpaces =
+        unreadBytes < Impl::Emulator::Serial::rxBufferSize
+            ? Impl::Emulator::Serial::rxBufferSize - unreadBytes
+            : 0;
+    return result + " P" + std::to_string(actionSpaces) + " Q" +
+           std::to_string(xyeSpaces) + " B" + std::to_string(rxSpaces) + "\n";
+  }
+
+  /**
+   * Expected acknowledgement for the current state of the queues, when all
+   * input has been read.
+   */
+  std::string ok(const int32_t lineNumber = -1) const {
+    return ok(actionQueue_.getNumSpacesLeft(),
+              xyePositionQueue_.getNumSpacesLeft(), 0, lineNumber);
+  }
+
+  /**
+   * Encode a binary frame with the given line number, type and arguments.
+   */
+  static std::string binaryFrame(const uint32_t lineNumber,
+                                 const GcodeParser::FrameType type,
+                                 const std::string &arguments) {
+    uint8_t header[6];
+    uint8_t headerSize = Util::encodeVarint(lineNumber, header);
+    header[headerSize++] = static_cast<uint8_t>(type);
+    const std::string body =
+        std::string(reinterpret_cast<char *>(header), headerSize) + arguments;
+    uint16_t crc = Util::crc16Update(Util::CRC16_INIT, body.size());
+    for (const char c : body) {
+      crc = Util::crc16Update(crc, c);
+    }
+    return std::string(1, GcodeParser::BINARY_SYNC) +
+           static_cast<char>(body.size()) + body +
+           static_cast<char>(crc >> 8) + static_cast<char>(crc & 0xff);
+  }
+
+  /**
+   * Encode the arguments of a binary MOVE frame.
+   */
+  static std::string binaryMove(const uint8_t flags,
+                                const std::vector<int32_t> &values,
+                                const uint32_t feedrate = 0) {
+    std::string result(1, flags);
+    uint8_t buffer[5];
+    for (const int32_t value : values) {
+      result.append(reinterpret_cast<char *>(buffer),
+                    Util::encodeVarint(Util::encodeZigzag(value), buffer));
+    }
+    if (flags & GcodeParser::BINARY_F_FLAG) {
+      result.append(reinterpret_cast<char *>(buffer),
+                    Util::encodeVarint(feedrate, buffer));
+    }
+    return result;
+  }
+
+  /**
+   * Encode the arguments of a binary SEGMENT frame; speeds are in um/s.
+   */
+  static std::string binarySegment(const uint8_t flags,
+                                   const std::vector<int32_t> &values,
+                                   const uint32_t nominalSpeed,
+                                   const uint32_t maxEntrySpeed) {
+    std::string result = binaryMove(flags, values);
+    uint8_t buffer[5];
+    result.append(reinterpret_cast<char *>(buffer),
+                  Util::encodeVarint(nominalSpeed, buffer));
+    result.append(reinterpret_cast<char *>(buffer),
+                  Util::encodeVarint(maxEntrySpeed, buffer));
+    return result;
+  }
+
+  /**
+   * Add a line number and checksum to a command.
+   */
+  static std::string frame(const int32_t lineNumber,
+                           const std::string &command) {
+    const std::string line = "N" + std::to_string(lineNumber) + " " + command;
+    uint8_t checksum = 0;
+    for (const char c : line) {
+      checksum ^= static_cast<uint8_t>(c);
+    }
+    return line + "*" + std::to_string(checksum) + "\n";
   }
 };
 
@@ -59,7 +153,7 @@ TEST_F(GcodeParserTest, Comments) {
 
 TEST_F(GcodeParserTest, BufferOverflow) {
   for (char c = 'A'; c < 'Z'; ++c) {
-    serial_.inject(&c);
+    serial_.inject(std::string(1, c));
     serial_.inject("32689 ");
   }
   parser_.ingest(context_);
@@ -94,21 +188,81 @@ TEST_F(GcodeParserTest, InvalidGCode) {
 TEST_F(GcodeParserTest, ParseFloat) {
   serial_.inject("G1 X80.5\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ActionQueue::Iterator it = actionQueue_.first();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XY);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_FLOAT_EQ(*endPosition.x, 80.5);
   actionQueue_.pop(context_);
 }
 
+TEST_F(GcodeParserTest, NumberForms) {
+  serial_.inject("G1.0 X-.5 Y+2. Z0.1234567 E-1\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok());
+  ASSERT_EQ(actionQueue_.size(), 2);
+  ActionQueue::Iterator it = actionQueue_.last();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XYE);
+  XYZEPosition endPosition = it->getEndPosition();
+  ASSERT_FLOAT_EQ(*endPosition.x, -0.5);
+  ASSERT_FLOAT_EQ(*endPosition.y, 2);
+  ASSERT_FLOAT_EQ(*endPosition.z, 0.123456);
+  ASSERT_FLOAT_EQ(*endPosition.e, -1);
+  actionQueue_.pop(context_);
+  actionQueue_.pop(context_);
+  xyePositionQueue_.pop();
+}
+
+TEST_F(GcodeParserTest, InvalidNumbers) {
+  const std::pair<std::string, std::string> cases[] = {
+      {"G1 X1.2.3\n", std::string(Str::INVALID_FLOAT_ERROR) + ": X\n"},
+      {"G1 Y-\n", std::string(Str::INVALID_FLOAT_ERROR) + ": Y\n"},
+      {"G1 Z.\n", std::string(Str::INVALID_FLOAT_ERROR) + ": Z\n"},
+      {"G1 E1a\n", std::string(Str::INVALID_FLOAT_ERROR) + ": E\n"},
+      {"G1 F1-2\n", std::string(Str::INVALID_FLOAT_ERROR) + ": F\n"},
+      {"G1 X99999999999\n", std::string(Str::INVALID_FLOAT_ERROR) + ": X\n"},
+      {"G1.5 X1\n", std::string(Str::INVALID_INT_ERROR) + ": G\n"},
+      {"Gx X1\n", std::string(Str::INVALID_INT_ERROR) + ": G\n"},
+      {"M1e2\n", std::string(Str::INVALID_INT_ERROR) + ": M\n"},
+  };
+  for (const auto &c : cases) {
+    serial_.inject(c.first.c_str());
+    parser_.ingest(context_);
+    ASSERT_EQ(serial_.extract(), c.second) << c.first;
+    ASSERT_EQ(actionQueue_.size(), 0);
+  }
+
+  // Malformed values are only reported if they are used
+  XYZEPosition startPosition = actionQueue_.getEndPosition();
+  serial_.inject("G1 X80 I1.2.3\n");
+  parser_.ingest(context_);
+  checkBasic(startPosition);
+}
+
+TEST_F(GcodeParserTest, ParseStats) {
+  parser_.resetParseStats();
+  serial_.inject(";comment\n\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(parser_.getParseStats().numLines, 0);
+  for (int i = 0; i < 100; ++i) {
+    serial_.inject("G1 X80 ; comment\n");
+    parser_.ingest(context_);
+    ASSERT_EQ(serial_.extract(), ok());
+    actionQueue_.pop(context_);
+  }
+  ASSERT_EQ(parser_.getParseStats().numLines, 100);
+  parser_.resetParseStats();
+  ASSERT_EQ(parser_.getParseStats().numLines, 0);
+  ASSERT_EQ(parser_.getParseStats().micros, 0);
+}
+
 TEST_F(GcodeParserTest, G1_XY) {
   serial_.inject("G1 X40 Y30\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ActionQueue::Iterator it = actionQueue_.first();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XY);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 40);
   ASSERT_EQ(*endPosition.y, 30);
   actionQueue_.pop(context_);
@@ -118,15 +272,15 @@ TEST_F(GcodeParserTest, G1_XYE) {
   // Send a first XYE point
   serial_.inject("G1 X40 E2\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ASSERT_EQ(actionQueue_.size(), 1);
   ActionQueue::Iterator it = actionQueue_.last();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XYE);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XYE);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 40);
   ASSERT_EQ(*endPosition.y, 0);
   ASSERT_EQ(*endPosition.e, 2);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it)->getNumPointsPushed(), 1);
+  ASSERT_EQ(it->get<Action::MoveXYE>().getNumPointsPushed(), 1);
   ASSERT_EQ(context_.xyePositionQueue.size(), 1);
   XYEPosition xyePosition1 = *context_.xyePositionQueue.last();
   ASSERT_EQ(*xyePosition1.x, 40);
@@ -136,13 +290,13 @@ TEST_F(GcodeParserTest, G1_XYE) {
   // Send a second XYE point (the E coordinates are very close together)
   serial_.inject("G1 X80 Y60 E2.00002\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ASSERT_EQ(actionQueue_.size(), 1);
-  endPosition = (*it)->getEndPosition();
+  endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 80);
   ASSERT_EQ(*endPosition.y, 60);
   ASSERT_FLOAT_EQ(*endPosition.e, 2.00002);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it)->getNumPointsPushed(), 2);
+  ASSERT_EQ(it->get<Action::MoveXYE>().getNumPointsPushed(), 2);
   ASSERT_EQ(context_.xyePositionQueue.size(), 2);
   XYEPosition xyePosition2 = *context_.xyePositionQueue.last();
   ASSERT_EQ(*xyePosition2.x, 80);
@@ -152,11 +306,11 @@ TEST_F(GcodeParserTest, G1_XYE) {
   // Send a non-XYE point
   serial_.inject("G1 X33 Y44\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ASSERT_EQ(actionQueue_.size(), 2);
   it = actionQueue_.last();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XY);
-  endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 33);
   ASSERT_EQ(*endPosition.y, 44);
   ASSERT_FLOAT_EQ(*endPosition.e, 2.00002);
@@ -165,15 +319,15 @@ TEST_F(GcodeParserTest, G1_XYE) {
   // Send a third XYE point in a different segment
   serial_.inject("G1 X30 Y30 E6\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   it = actionQueue_.last();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XYE);
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XYE);
   ASSERT_EQ(actionQueue_.size(), 3);
-  endPosition = (*it)->getEndPosition();
+  endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 30);
   ASSERT_EQ(*endPosition.y, 30);
   ASSERT_EQ(*endPosition.e, 6);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it)->getNumPointsPushed(), 1);
+  ASSERT_EQ(it->get<Action::MoveXYE>().getNumPointsPushed(), 1);
   ASSERT_EQ(context_.xyePositionQueue.size(), 3);
   XYEPosition xyePosition3 = *context_.xyePositionQueue.last();
   ASSERT_EQ(*xyePosition3.x, 30);
@@ -199,15 +353,20 @@ TEST_F(GcodeParserTest, G1_XYE_Aliasing) {
   serial_.inject("G1 X40 Y30 E2\n");
   serial_.inject("G1 X40 Y30 E2\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\nok\n");
+
+  // The first line is acknowledged before the second one is read
+  ASSERT_EQ(serial_.extract(),
+            ok(ActionQueue::capacity - 1, XYEPositionQueue::capacity - 1,
+               14) +
+                ok());
   ASSERT_EQ(actionQueue_.size(), 1);
   ActionQueue::Iterator it = actionQueue_.last();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_XYE);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XYE);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.x, 40);
   ASSERT_EQ(*endPosition.y, 30);
   ASSERT_EQ(*endPosition.e, 2);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it)->getNumPointsPushed(), 1);
+  ASSERT_EQ(it->get<Action::MoveXYE>().getNumPointsPushed(), 1);
   ASSERT_EQ(context_.xyePositionQueue.size(), 1);
   XYEPosition xyePosition1 = *context_.xyePositionQueue.last();
   ASSERT_EQ(*xyePosition1.x, 40);
@@ -221,36 +380,44 @@ TEST_F(GcodeParserTest, G1_XYE_Direction) {
   serial_.inject("G1 X40 Y30 E2\n");
   serial_.inject("G1 X40 Y30 E3\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\nok\nok\nok\n");
+  ASSERT_EQ(serial_.extract(),
+            ok(ActionQueue::capacity - 1, XYEPositionQueue::capacity - 1,
+               42) +
+                ok(ActionQueue::capacity - 1, XYEPositionQueue::capacity - 2,
+                   28) +
+                ok(ActionQueue::capacity - 2, XYEPositionQueue::capacity - 3,
+                   14) +
+                ok(ActionQueue::capacity - 3, XYEPositionQueue::capacity - 4,
+                   0));
   ASSERT_EQ(actionQueue_.size(), 3);
   ActionQueue::Iterator it1 = actionQueue_.first();
-  ASSERT_EQ((*it1)->getType(), Action::Type::MOVE_XYE);
-  XYZEPosition endPosition = (*it1)->getEndPosition();
+  ASSERT_EQ(it1->getType(), Action::Type::MOVE_XYE);
+  XYZEPosition endPosition = it1->getEndPosition();
   ASSERT_EQ(*endPosition.x, 40);
   ASSERT_EQ(*endPosition.y, 30);
   ASSERT_EQ(*endPosition.e, 3);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it1)->getNumPointsPushed(), 2);
+  ASSERT_EQ(it1->get<Action::MoveXYE>().getNumPointsPushed(), 2);
   ActionQueue::Iterator it2 = actionQueue_.first().next();
-  ASSERT_EQ((*it2)->getType(), Action::Type::MOVE_XYE);
-  endPosition = (*it2)->getEndPosition();
+  ASSERT_EQ(it2->getType(), Action::Type::MOVE_XYE);
+  endPosition = it2->getEndPosition();
   ASSERT_EQ(*endPosition.x, 40);
   ASSERT_EQ(*endPosition.y, 30);
   ASSERT_EQ(*endPosition.e, 2);
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it2)->getNumPointsPushed(), 1);
+  ASSERT_EQ(it2->get<Action::MoveXYE>().getNumPointsPushed(), 1);
   ActionQueue::Iterator it3 = actionQueue_.first().next().next();
-  ASSERT_EQ((*it3)->getType(), Action::Type::MOVE_XYE);
-  ASSERT_EQ((*it3)->getEndPosition(), (*it1)->getEndPosition());
-  ASSERT_EQ(dynamic_cast<Action::MoveXYE *>(*it3)->getNumPointsPushed(), 1);
+  ASSERT_EQ(it3->getType(), Action::Type::MOVE_XYE);
+  ASSERT_EQ(it3->getEndPosition(), it1->getEndPosition());
+  ASSERT_EQ(it3->get<Action::MoveXYE>().getNumPointsPushed(), 1);
   ASSERT_EQ(context_.xyePositionQueue.size(), 4);
 }
 
 TEST_F(GcodeParserTest, G1_E) {
   serial_.inject("G1 E5\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ActionQueue::Iterator it = actionQueue_.first();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_E);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_E);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.e, 5);
   actionQueue_.pop(context_);
 }
@@ -258,10 +425,10 @@ TEST_F(GcodeParserTest, G1_E) {
 TEST_F(GcodeParserTest, G1_Z) {
   serial_.inject("G1 Z-10\n");
   parser_.ingest(context_);
-  ASSERT_EQ(serial_.extract(), "ok\n");
+  ASSERT_EQ(serial_.extract(), ok());
   ActionQueue::Iterator it = actionQueue_.first();
-  ASSERT_EQ((*it)->getType(), Action::Type::MOVE_Z);
-  XYZEPosition endPosition = (*it)->getEndPosition();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_Z);
+  XYZEPosition endPosition = it->getEndPosition();
   ASSERT_EQ(*endPosition.z, -10);
   actionQueue_.pop(context_);
 }
@@ -269,11 +436,102 @@ TEST_F(GcodeParserTest, G1_Z) {
 TEST_F(GcodeParserTest, G1_F) {
   serial_.inject("G1 X80 F3000\n");
   parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok());
   ActionQueue::Iterator it = actionQueue_.first();
-  ASSERT_EQ((*it)->getType(), Action::Type::SET_FEEDRATE);
-  ASSERT_EQ((*it)->getEndPosition(), (XYZEPosition{0, 0, 0, 0}));
+  ASSERT_EQ(it->getType(), Action::Type::SET_FEEDRATE);
+  ASSERT_EQ(it->getEndPosition(), (XYZEPosition{0, 0, 0, 0}));
+  it = it.next();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  ASSERT_EQ(*it->getEndPosition().x, 80);
   actionQueue_.pop(context_);
-  checkBasic(XYZEPosition{0, 0, 0, 0});
+  actionQueue_.pop(context_);
+}
+
+TEST_F(GcodeParserTest, G2_XY) {
+  // A clockwise half circle without extrusion becomes XY moves
+  const XYZEPosition start = actionQueue_.getEndPosition();
+  serial_.inject(("G2 X" + std::to_string(*start.x + 2) + " Y" +
+                  std::to_string(*start.y) + " I1 J0\n")
+                     .c_str());
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok());
+  ArcInterpolator arc;
+  arc.begin(0, 0, 0, 2, 0, 0, 1, 0, true);
+  ASSERT_EQ(actionQueue_.size(), arc.getNumSegments());
+  for (ActionQueue::Iterator it = actionQueue_.first(); it; it = it.next()) {
+    ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+    ASSERT_GE(*it->getEndPosition().y, *start.y);
+    if (it == actionQueue_.last()) {
+      break;
+    }
+  }
+  ASSERT_FLOAT_EQ(*actionQueue_.getEndPosition().x, *start.x + 2);
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+}
+
+TEST_F(GcodeParserTest, G3_Lazy) {
+  // A full circle with more points than the XYE queue can hold
+  const XYZEPosition start = actionQueue_.getEndPosition();
+  serial_.inject("G3 I50 E10 F600\n");
+  serial_.inject("G1 X80\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), "");
+  ASSERT_EQ(actionQueue_.size(), 2);
+  ASSERT_EQ(actionQueue_.first()->getType(), Action::Type::SET_FEEDRATE);
+  ASSERT_EQ(actionQueue_.last()->getType(), Action::Type::MOVE_XYE);
+  ASSERT_EQ(xyePositionQueue_.getNumSpacesLeft(), 0);
+
+  // More points are pushed as the queue drains, and the following line is
+  // only read once the arc is complete
+  ArcInterpolator arc;
+  arc.begin(0, 0, 0, 0, 0, 10, 50, 0, false);
+  ASSERT_GT(arc.getNumSegments(), XYEPositionQueue::capacity);
+  uint16_t numPopped = 0;
+  while (actionQueue_.size() == 2) {
+    ASSERT_EQ(serial_.extract(), "");
+    for (int i = 0; i < 16 && xyePositionQueue_.size() > 0; ++i) {
+      xyePositionQueue_.pop();
+      numPopped++;
+    }
+    parser_.ingest(context_);
+  }
+  ASSERT_EQ(serial_.extract(),
+            ok(ActionQueue::capacity - 2, xyePositionQueue_.getNumSpacesLeft(),
+               7) +
+                ok());
+  ASSERT_EQ(numPopped + xyePositionQueue_.size(), arc.getNumSegments());
+  ActionQueue::Iterator it = actionQueue_.first().next();
+  ASSERT_EQ(it->get<Action::MoveXYE>().getNumPointsPushed(),
+            arc.getNumSegments());
+  ASSERT_EQ(it->getEndPosition(),
+            (XYZEPosition{start.x, start.y, start.z, *start.e + 10}));
+  ASSERT_EQ(actionQueue_.last()->getType(), Action::Type::MOVE_XY);
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+  while (xyePositionQueue_.size() > 0) {
+    xyePositionQueue_.pop();
+  }
+}
+
+TEST_F(GcodeParserTest, InvalidArc) {
+  const std::string cases[] = {
+      "G2 X1 Y1\n",       // No center
+      "G2 X1 I1 R1\n",    // Both forms
+      "G2 I1 Z1\n",       // Helical
+      "G2 R1\n",          // Full circle with a radius
+      "G3 X10 R1\n",      // Radius too small
+      "G3 X10 I0 J0\n"};  // Zero radius
+  for (const std::string &line : cases) {
+    serial_.inject(line.c_str());
+    parser_.ingest(context_);
+    ASSERT_EQ(serial_.extract(), std::string(Str::INVALID_ARC_ERROR) + "\n")
+        << line;
+    ASSERT_EQ(actionQueue_.size(), 0);
+  }
+  doBasic();
 }
 
 TEST_F(GcodeParserTest, UndefinedCodeLetter) {
@@ -291,7 +549,7 @@ TEST_F(GcodeParserTest, InsufficientQueueCapacity) {
     serial_.inject("G1 X80\n");
     parser_.ingest(context_);
     std::string result = serial_.extract();
-    if (result != "ok\n") {
+    if (result != ok()) {
       ASSERT_EQ(result,
                 std::string(Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) + "\n");
       broken = true;
@@ -309,7 +567,7 @@ TEST_F(GcodeParserTest, InsufficientQueueCapacity) {
     serial_.inject("G1 X80 E" + std::to_string(i) + "\n");
     parser_.ingest(context_);
     std::string result = serial_.extract();
-    if (result != "ok\n") {
+    if (result != ok()) {
       ASSERT_EQ(result,
                 std::string(Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) + "\n");
       broken = true;
@@ -322,4 +580,289 @@ TEST_F(GcodeParserTest, InsufficientQueueCapacity) {
   actionQueue_.pop(context_);
   ASSERT_TRUE(broken);
 }
+
+TEST_F(GcodeParserTest, LineNumbers) {
+  serial_.inject(frame(0, "M110 N0"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+  serial_.inject(frame(1, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(1));
+  actionQueue_.pop(context_);
+
+  // A line that was already executed is acknowledged but not executed again
+  serial_.inject(frame(1, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(1));
+  ASSERT_EQ(actionQueue_.size(), 0);
+
+  // Numbered lines without a checksum are rejected
+  serial_.inject("N2 G1 X80\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), std::string(Str::RESEND) + " 2\n");
+  serial_.inject(frame(2, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(2));
+  actionQueue_.pop(context_);
+
+  // An unnumbered M110 only reports the free capacity
+  serial_.inject("M110\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok());
+  serial_.inject(frame(3, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(3));
+  actionQueue_.pop(context_);
+
+  // Unnumbered lines are still accepted
+  doBasic();
+}
+
+TEST_F(GcodeParserTest, Resend) {
+  serial_.inject(frame(0, "M110 N9"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+
+  // Corrupt line 10 while lines 11 and 12 are in flight behind it; only one
+  // resend is requested and the lines behind it are dropped
+  std::string corrupted = frame(10, "G1 X80");
+  corrupted[corrupted.find('X') + 1] = '9';
+  serial_.inject(corrupted);
+  serial_.inject(frame(11, "G1 X20"));
+  serial_.inject(frame(12, "G1 X30"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), std::string(Str::RESEND) + " 10\n");
+  ASSERT_EQ(actionQueue_.size(), 0);
+
+  // The host sends everything again from line 10
+  const std::string line11 = frame(11, "G1 X20");
+  const std::string line12 = frame(12, "G1 X30");
+  serial_.inject(frame(10, "G1 X80") + line11 + line12);
+  parser_.ingest(context_);
+  const uint16_t xyeSpaces = XYEPositionQueue::capacity;
+  ASSERT_EQ(serial_.extract(),
+            ok(ActionQueue::capacity - 1, xyeSpaces,
+               line11.size() + line12.size(), 10) +
+                ok(ActionQueue::capacity - 2, xyeSpaces, line12.size(), 11) +
+                ok(ActionQueue::capacity - 3, xyeSpaces, 0, 12));
+  ASSERT_EQ(actionQueue_.size(), 3);
+  ASSERT_EQ(*actionQueue_.last()->getEndPosition().x, 30);
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+
+  // A skipped line also triggers a resend
+  serial_.inject(frame(14, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), std::string(Str::RESEND) + " 13\n");
+  serial_.inject(frame(13, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(13));
+  actionQueue_.pop(context_);
+}
+
+TEST_F(GcodeParserTest, NumberedInsufficientQueueCapacity) {
+  serial_.inject(frame(0, "M110 N0"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+
+  // Fill the queue; the line that does not fit must be sent again, and the
+  // lines behind it are dropped so that they do not execute out of order
+  int32_t lineNumber = 1;
+  for (; lineNumber <= ActionQueue::capacity; ++lineNumber) {
+    serial_.inject(frame(lineNumber, "G1 X80"));
+    parser_.ingest(context_);
+    ASSERT_EQ(serial_.extract(), ok(lineNumber));
+  }
+  ASSERT_EQ(actionQueue_.getNumSpacesLeft(), 0);
+  serial_.inject(frame(lineNumber, "G1 X80"));
+  serial_.inject(frame(lineNumber + 1, "G1 X80"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            std::string(Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) + "\n");
+  ASSERT_EQ(actionQueue_.size(), ActionQueue::capacity);
+
+  actionQueue_.pop(context_);
+  const std::string nextLine = frame(lineNumber + 1, "G1 X80");
+  serial_.inject(frame(lineNumber, "G1 X80") + nextLine);
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            ok(0, XYEPositionQueue::capacity, nextLine.size(), lineNumber) +
+                std::string(Str::INSUFFICIENT_QUEUE_CAPACITY_ERROR) + "\n");
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+}
+
+TEST_F(GcodeParserTest, InvalidMCode) {
+  serial_.inject("M999\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            std::string(Str::INVALID_M_CODE_ERROR) + ": 999\n");
+  doBasic();
+}
+
+TEST_F(GcodeParserTest, Binary) {
+  serial_.inject(frame(0, "M110 N0"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+  serial_.inject(frame(1, "M880"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(1));
+
+  // Absolute X and Y, then relative X with a feedrate
+  const uint8_t xy = GcodeParser::BINARY_X_FLAG | GcodeParser::BINARY_Y_FLAG;
+  serial_.inject(binaryFrame(2, GcodeParser::FrameType::MOVE,
+                             binaryMove(xy | GcodeParser::BINARY_ABSOLUTE_FLAG,
+                                        {10 * USTEPS_PER_MM_X,
+                                         20 * USTEPS_PER_MM_Y})));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(2));
+  serial_.inject(binaryFrame(
+      3, GcodeParser::FrameType::MOVE,
+      binaryMove(GcodeParser::BINARY_X_FLAG | GcodeParser::BINARY_F_FLAG,
+                 {-USTEPS_PER_MM_X / 2}, 1200)));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(3));
+  ASSERT_EQ(actionQueue_.size(), 3);
+  ActionQueue::Iterator it = actionQueue_.first();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  ASSERT_EQ(*it->getEndPosition().x, 10);
+  ASSERT_EQ(*it->getEndPosition().y, 20);
+  it = it.next();
+  ASSERT_EQ(it->getType(), Action::Type::SET_FEEDRATE);
+  it = it.next();
+  ASSERT_EQ(it->getType(), Action::Type::MOVE_XY);
+  ASSERT_FLOAT_EQ(*it->getEndPosition().x, 9.5);
+  ASSERT_EQ(*it->getEndPosition().y, 20);
+
+  // An extruding move
+  serial_.inject(binaryFrame(
+      4, GcodeParser::FrameType::MOVE,
+      binaryMove(xy | GcodeParser::BINARY_E_FLAG,
+                 {USTEPS_PER_MM_X, USTEPS_PER_MM_Y, USTEPS_PER_MM_E})));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(4));
+  ASSERT_EQ(actionQueue_.last()->getType(), Action::Type::MOVE_XYE);
+  ASSERT_EQ(actionQueue_.last()->getEndPosition(),
+            (XYZEPosition{10.5, 21, 0, 1}));
+
+  // A corrupted frame is sent again, and the frames behind it are dropped
+  std::string corrupted = binaryFrame(
+      5, GcodeParser::FrameType::MOVE,
+      binaryMove(GcodeParser::BINARY_Z_FLAG, {USTEPS_PER_MM_Z}));
+  corrupted[4] ^= 0x10;
+  serial_.inject(corrupted);
+  serial_.inject(binaryFrame(6, GcodeParser::FrameType::ASCII, ""));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), std::string(Str::RESEND) + " 5\n");
+  serial_.inject(binaryFrame(
+      5, GcodeParser::FrameType::MOVE,
+      binaryMove(GcodeParser::BINARY_Z_FLAG, {USTEPS_PER_MM_Z})));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(5));
+  ASSERT_EQ(*actionQueue_.last()->getEndPosition().z, 1);
+
+  // Frames that cannot be decoded are rejected
+  serial_.inject(binaryFrame(6, GcodeParser::FrameType::MOVE, "") + "\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            std::string(Str::INVALID_FRAME_ERROR) + "\n");
+
+  // Switch back to G-code; a newline after a frame is ignored
+  serial_.inject(binaryFrame(7, GcodeParser::FrameType::ASCII, "") + "\n");
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(actionQueue_.getNumSpacesLeft(),
+                                  xyePositionQueue_.getNumSpacesLeft(), 1, 7));
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+  while (xyePositionQueue_.size() > 0) {
+    xyePositionQueue_.pop();
+  }
+  doBasic();
+}
+
+TEST_F(GcodeParserTest, BinaryLargeTargets) {
+  serial_.inject(frame(0, "M110 N0"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+  serial_.inject(frame(1, "M880"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(1));
+
+  // Targets too far from 0 for their position in mm to be exact as a float
+  // come back to the same usteps
+  const uint8_t ze = GcodeParser::BINARY_Z_FLAG | GcodeParser::BINARY_E_FLAG |
+                     GcodeParser::BINARY_ABSOLUTE_FLAG;
+  uint32_t lineNumber = 2;
+  for (const int32_t target :
+       {131071, 131073, 199993, 199995, 1000001, 4194303, -1000001}) {
+    serial_.inject(binaryFrame(lineNumber, GcodeParser::FrameType::MOVE,
+                               binaryMove(ze, {target, target})));
+    parser_.ingest(context_);
+    ASSERT_EQ(serial_.extract(), ok(lineNumber)) << target;
+    const XYZEPosition endPosition = actionQueue_.last()->getEndPosition();
+    ASSERT_EQ(*Axes::ZAxis::gcodePositionToStepper(endPosition.z), target);
+    ASSERT_EQ(*Axes::EAxis::gcodePositionToStepper(endPosition.e), target);
+    while (actionQueue_.size() > 0) {
+      actionQueue_.pop(context_);
+    }
+    ++lineNumber;
+  }
+}
+
+TEST_F(GcodeParserTest, Segment) {
+  serial_.inject(frame(0, "M110 N0"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(0));
+  serial_.inject(frame(1, "M880"));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(1));
+
+  // Segments carry their own speeds, which are not planned again
+  const uint8_t xy = GcodeParser::BINARY_X_FLAG | GcodeParser::BINARY_Y_FLAG;
+  serial_.inject(binaryFrame(
+      2, GcodeParser::FrameType::SEGMENT,
+      binarySegment(xy | GcodeParser::BINARY_ABSOLUTE_FLAG,
+                    {10 * USTEPS_PER_MM_X, 20 * USTEPS_PER_MM_Y}, 40000, 0)));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(2));
+  serial_.inject(binaryFrame(
+      3, GcodeParser::FrameType::SEGMENT,
+      binarySegment(GcodeParser::BINARY_X_FLAG, {10 * USTEPS_PER_MM_X}, 25000,
+                    25000)));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(), ok(3));
+  ASSERT_EQ(actionQueue_.size(), 2);
+  const MotionProfile &first =
+      actionQueue_.first()->get<Action::MoveXY>().getProfile();
+  const MotionProfile &second =
+      actionQueue_.last()->get<Action::MoveXY>().getProfile();
+  ASSERT_EQ(actionQueue_.last()->getEndPosition(),
+            (XYZEPosition{20, 20, 0, 0}));
+  ASSERT_FLOAT_EQ(first.nominalSpeed, 40);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 25);
+  ASSERT_FLOAT_EQ(second.nominalSpeed, 25);
+  ASSERT_FLOAT_EQ(second.entrySpeed, 25);
+  ASSERT_FLOAT_EQ(second.exitSpeed, 0);
+
+  // Only X and Y can be given, and a speed is required
+  serial_.inject(binaryFrame(
+      4, GcodeParser::FrameType::SEGMENT,
+      binarySegment(GcodeParser::BINARY_E_FLAG, {USTEPS_PER_MM_E}, 1000, 0)));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            std::string(Str::INVALID_FRAME_ERROR) + "\n");
+  serial_.inject(binaryFrame(
+      5, GcodeParser::FrameType::SEGMENT,
+      binarySegment(GcodeParser::BINARY_X_FLAG, {USTEPS_PER_MM_X}, 0, 0)));
+  parser_.ingest(context_);
+  ASSERT_EQ(serial_.extract(),
+            std::string(Str::INVALID_FRAME_ERROR) + "\n");
+  ASSERT_EQ(actionQueue_.size(), 2);
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+}
 }  // namespace Clef::Fw
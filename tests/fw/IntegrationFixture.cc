@@ -9,11 +9,13 @@ IntegrationFixture::IntegrationFixture()
       serial_(globalMutex_),
       actionQueue_(),
       xyePositionQueue_(),
+      planner_(),
       parser_(),
       xAxisTimer_(),
       yAxisTimer_(),
       zAxisTimer_(),
       eAxisTimer_(),
+      stepTimer_(),
       displacementSensorInput_(),
       displacementSensor_(clock_, 0.1),
       pressureSensor_(clock_, 0.02),
@@ -24,11 +26,13 @@ IntegrationFixture::IntegrationFixture()
       eAxis_(Clef::Impl::Emulator::eAxisStepper, eAxisTimer_,
              displacementSensor_, pressureSensor_, extrusionPredictor_),
       axes_(xAxis_, yAxis_, zAxis_, eAxis_),
-      context_(
-          {axes_, parser_, clock_, serial_, actionQueue_, xyePositionQueue_}) {
+      stepEngine_(axes_, stepTimer_),
+      context_({axes_, parser_, clock_, serial_, actionQueue_,
+                xyePositionQueue_, planner_, stepEngine_}) {
   clock_.init();
   serial_.init();
   axes_.init();
+  stepEngine_.init();
   displacementSensorInput_.setConversionCallback(
       DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT,
                          USTEPS_PER_MM_E>::injectWrapper,
@@ -19,11 +19,13 @@ class IntegrationFixture : public testing::Test {
   Clef::Impl::Emulator::Serial serial_;
   ActionQueue actionQueue_;
   XYEPositionQueue xyePositionQueue_;
+  Planner planner_;
   GcodeParser parser_;
   Clef::Impl::Emulator::GenericTimer xAxisTimer_;
   Clef::Impl::Emulator::GenericTimer yAxisTimer_;
   Clef::Impl::Emulator::GenericTimer zAxisTimer_;
   Clef::Impl::Emulator::GenericTimer eAxisTimer_;
+  Clef::Impl::Emulator::GenericTimer stepTimer_;
   Clef::Impl::Emulator::DisplacementSensorInput displacementSensorInput_;
   DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E>
       displacementSensor_;
@@ -34,6 +36,7 @@ class IntegrationFixture : public testing::Test {
   Axes::ZAxis zAxis_;
   Axes::EAxis eAxis_;
   Axes axes_;
+  StepEngine stepEngine_;
   Context context_;
 };
 }  // namespace Clef::Fw
@@ -1,5 +1,6 @@
 // Copyright 2021 by Daniel Winkelman. All rights reserved.
 
+#include <fw/kalman/Degen.h>
 #include <fw/kalman/Velocity.h>
 #include <gtest/gtest.h>
 #include <math.h>
@@ -21,4 +22,243 @@ TEST_F(KalmanTest, VelocityEvolution) {
               << ", vhat: " << filter_.getState().get(1, 0) << std::endl;
   }
 }
+
+namespace {
+/**
+ * The generated filter with the dense covariance products of the base class.
+ */
+class DenseDegenFilter : public Kalman::DegenFilter {
+ private:
+  void predictCovariance(
+      const typename Kalman::BaseDegenFilter::StaticXXMatrix &Fk,
+      const typename Kalman::BaseDegenFilter::StaticPMatrix &P,
+      typename Kalman::BaseDegenFilter::StaticXXMatrix &FkP,
+      typename Kalman::BaseDegenFilter::StaticPMatrix &output)
+      const override {
+    Kalman::BaseDegenFilter::predictCovariance(Fk, P, FkP, output);
+  }
+  float calculateObservationCovariance(
+      const typename Kalman::BaseDegenFilter::StaticZXMatrix &Hk,
+      const typename Kalman::BaseDegenFilter::StaticPMatrix &P,
+      const uint16_t z,
+      typename Kalman::BaseDegenFilter::StaticXVector &PhT) const override {
+    return Kalman::BaseDegenFilter::calculateObservationCovariance(Hk, P, z,
+                                                                   PhT);
+  }
+};
+
+/**
+ * The generated filter, whose estimate can be set to that of another one.
+ */
+class SettableDegenFilter : public Kalman::DegenFilter {
+ public:
+  void setEstimate(const Kalman::DegenFilter &other) {
+    for (uint16_t r = 0; r < 9; ++r) {
+      x_.set(r, 0, other.getState().get(r, 0));
+      for (uint16_t c = r; c < 9; ++c) {
+        P_.set(r, c, other.getCovariance().get(r, c));
+      }
+    }
+  }
+};
+}  // namespace
+
+TEST(KalmanSequentialTest, DegenMatchesJointUpdate) {
+  // The scalar updates with the tuned Wx of the Degen filter must give the
+  // joint update that kalman.py runs,
+  //   x = xint + Wx * K * y, P = Wx * (Pminus - Pplus) * Wx + Pplus
+  // computed here densely from the prediction of the same filter
+  const KalmanTuning::Spec &spec = Kalman::DegenFilter::TUNING_SPEC;
+  Kalman::DegenFilter filter;
+  SettableDegenFilter prior;
+  for (int i = 0; i < 50; ++i) {
+    const float xe = 10 * i;
+    const float z[2] = {8 * i + 5 * sinf(i / 5.0f),
+                        4900 + 20 * cosf(i / 7.0f)};
+    prior.setEstimate(filter);
+    prior.evolve(xe, z[0], z[1], 0.001, 0);
+    filter.evolve(xe, z[0], z[1], 0.001);
+
+    // h(x) = (xs, Ph + Ph0)
+    double xint[9], Pminus[9][9];
+    for (uint16_t r = 0; r < 9; ++r) {
+      xint[r] = prior.getState().get(r, 0);
+      for (uint16_t c = 0; c < 9; ++c) {
+        Pminus[r][c] = prior.getCovariance().get(r, c);
+      }
+    }
+    double PhT[9][2];
+    for (uint16_t r = 0; r < 9; ++r) {
+      PhT[r][0] = Pminus[r][0];
+      PhT[r][1] = Pminus[r][2] + Pminus[r][3];
+    }
+    const double S[2][2] = {
+        {PhT[0][0] + spec.zvars[0].noise, PhT[0][1]},
+        {PhT[2][0] + PhT[3][0], PhT[2][1] + PhT[3][1] + spec.zvars[1].noise}};
+    const double det = S[0][0] * S[1][1] - S[0][1] * S[1][0];
+    const double SInv[2][2] = {{S[1][1] / det, -S[0][1] / det},
+                               {-S[1][0] / det, S[0][0] / det}};
+    const double y[2] = {z[0] - xint[0], z[1] - (xint[2] + xint[3])};
+    double K[9][2];
+    for (uint16_t r = 0; r < 9; ++r) {
+      for (uint16_t j = 0; j < 2; ++j) {
+        K[r][j] = PhT[r][0] * SInv[0][j] + PhT[r][1] * SInv[1][j];
+      }
+    }
+
+    for (uint16_t r = 0; r < 9; ++r) {
+      const double wr = spec.xvars[r].updateWeight;
+      const double x = xint[r] + wr * (K[r][0] * y[0] + K[r][1] * y[1]);
+      ASSERT_NEAR(filter.getState().get(r, 0), x, 1e-4 * (1 + fabs(x)))
+          << "step " << i << ", state " << r;
+      for (uint16_t c = r; c < 9; ++c) {
+        // K * h * P = K * (P * h^T)^T
+        const double deltaP = K[r][0] * PhT[c][0] + K[r][1] * PhT[c][1];
+        const double P = wr * deltaP * spec.xvars[c].updateWeight +
+                         (Pminus[r][c] - deltaP);
+        ASSERT_NEAR(filter.getCovariance().get(r, c), P, 1e-3 * (1 + fabs(P)))
+            << "step " << i << ", covariance " << r << ", " << c;
+      }
+    }
+  }
+}
+
+TEST(KalmanSparseTest, DegenMatchesDense) {
+  Kalman::DegenFilter sparse;
+  DenseDegenFilter dense;
+  for (int i = 0; i < 50; ++i) {
+    const float xe = 10 * i;
+    const float xs = 8 * i + 5 * sin(i / 5.0f);
+    const float Ph = 4900 + 20 * cos(i / 7.0f);
+    sparse.evolve(xe, xs, Ph, 0.001);
+    dense.evolve(xe, xs, Ph, 0.001);
+    for (uint16_t j = 0; j < 9; ++j) {
+      ASSERT_TRUE(isfinite(dense.getState().get(j, 0)));
+      ASSERT_FLOAT_EQ(sparse.getState().get(j, 0), dense.getState().get(j, 0))
+          << "step " << i << ", state " << j;
+    }
+  }
+}
+
+TEST(KalmanSparseTest, DegenPartialObservations) {
+  // An observation which is left out must not matter, but the ones which
+  // are given must
+  Kalman::DegenFilter full, xsOnly, xsOnlyGarbage, none;
+  for (int i = 0; i < 20; ++i) {
+    const float xe = 10 * i;
+    const float xs = 8 * i + 5 * sin(i / 5.0f);
+    const float Ph = 4900 + 20 * cos(i / 7.0f);
+    full.evolve(xe, xs, Ph, 0.001);
+    xsOnly.evolve(xe, xs, Ph, 0.001, Kalman::DegenFilter::OBSERVE_XS_IN);
+    xsOnlyGarbage.evolve(xe, xs, -1e6, 0.001,
+                         Kalman::DegenFilter::OBSERVE_XS_IN);
+    none.evolve(xe, xs, Ph, 0.001, 0);
+    for (uint16_t j = 0; j < 9; ++j) {
+      ASSERT_EQ(xsOnly.getState().get(j, 0),
+                xsOnlyGarbage.getState().get(j, 0));
+    }
+  }
+
+  // Ph0 is only seen through Ph_in, and nothing is seen without observations
+  ASSERT_NE(full.getState().get(3, 0), xsOnly.getState().get(3, 0));
+  ASSERT_NE(full.getState().get(0, 0), none.getState().get(0, 0));
+  ASSERT_NE(xsOnly.getState().get(0, 0), none.getState().get(0, 0));
+  ASSERT_EQ(none.getState().get(3, 0),
+            Kalman::DegenFilter().getState().get(3, 0));
+}
+
+TEST(KalmanStagedTest, DegenMatchesEvolve) {
+  // Evolving a stage at a time must give exactly what evolve() gives, and
+  // the state must not change until the last stage
+  Kalman::DegenFilter staged, oneShot;
+  for (int i = 0; i < 20; ++i) {
+    const float xe = 10 * i;
+    const float xs = 8 * i + 5 * sin(i / 5.0f);
+    const float Ph = 4900 + 20 * cos(i / 7.0f);
+    const uint8_t observed = i % 3 == 0
+                                 ? Kalman::DegenFilter::OBSERVE_XS_IN
+                                 : Kalman::DegenFilter::ALL_OBSERVATIONS;
+    oneShot.evolve(xe, xs, Ph, 0.001, observed);
+    const float xsBefore = staged.getState().get(0, 0);
+    staged.begin(xe, xs, Ph, 0.001, observed);
+    uint16_t numStages = 1;
+    while (!staged.advance()) {
+      ASSERT_TRUE(staged.isEvolving());
+      ASSERT_EQ(staged.getState().get(0, 0), xsBefore);
+      ++numStages;
+    }
+    ASSERT_FALSE(staged.isEvolving());
+    ASSERT_EQ(numStages, observed == Kalman::DegenFilter::OBSERVE_XS_IN ? 5
+                                                                        : 7);
+    for (uint16_t j = 0; j < 9; ++j) {
+      ASSERT_EQ(staged.getState().get(j, 0), oneShot.getState().get(j, 0))
+          << "step " << i << ", state " << j;
+    }
+  }
+
+  // Nothing is left to do, and a cancelled evolution changes nothing
+  ASSERT_TRUE(staged.advance());
+  const float xsBefore = staged.getState().get(0, 0);
+  staged.begin(1000, 1000, 4900, 0.001);
+  ASSERT_FALSE(staged.advance());
+  staged.cancel();
+  ASSERT_FALSE(staged.isEvolving());
+  ASSERT_TRUE(staged.advance());
+  ASSERT_EQ(staged.getState().get(0, 0), xsBefore);
+}
+
+TEST(KalmanSteadyStateTest, VelocityFreezesAndThaws) {
+  // The velocity filter is linear, so its gain converges; until then, the
+  // frozen filter must be the same as a normal one, and afterwards it must
+  // still follow the observations
+  Kalman::VelocityFilter full, frozen;
+  frozen.setSteadyState(0.001, 10, 4);
+  int frozenAt = -1;
+  for (int i = 0; i < 200; ++i) {
+    const float xs = 5 * i + 0.5f * sin(i);
+    full.evolve(xs, xs, 0.1);
+    frozen.evolve(xs, xs, 0.1);
+    if (frozen.isGainFrozen() && frozenAt < 0) {
+      frozenAt = i;
+    }
+    if (frozenAt < 0) {
+      ASSERT_EQ(frozen.getState().get(0, 0), full.getState().get(0, 0));
+      ASSERT_EQ(frozen.getState().get(1, 0), full.getState().get(1, 0));
+    } else {
+      ASSERT_NEAR(frozen.getState().get(0, 0), xs, 2) << "step " << i;
+    }
+  }
+  ASSERT_GT(frozenAt, 10);
+  ASSERT_LT(frozenAt, 100);
+  ASSERT_TRUE(frozen.isGainFrozen());
+
+  // A jump in the observation is an outlier for the frozen gain, which is
+  // then recalculated
+  frozen.evolve(1200, 1200, 0.1);
+  ASSERT_FALSE(frozen.isGainFrozen());
+
+  // Partial evolutions, here with no observations, do not count towards
+  // convergence
+  Kalman::VelocityFilter partial;
+  partial.setSteadyState(1, 1, 4);
+  float uMem[1] = {0};
+  float zMem[1] = {0};
+  const Kalman::BaseVelocityFilter::UVector u(uMem);
+  const Kalman::BaseVelocityFilter::ZVector z(zMem);
+  for (int i = 0; i < 10; ++i) {
+    partial.Kalman::BaseVelocityFilter::evolve(u, z, 0.1, 0);
+    ASSERT_FALSE(partial.isGainFrozen());
+  }
+  partial.evolve(0, 0, 0.1);
+  ASSERT_TRUE(partial.isGainFrozen());
+  partial.resetGain();
+  ASSERT_FALSE(partial.isGainFrozen());
+}
+
+TEST(KalmanSteadyStateTest, OnlyWhenBuiltWithIt) {
+  // A filter built without SteadyState keeps none of the state of the gain
+  ASSERT_FALSE(Kalman::DegenFilter().isGainFrozen());
+  ASSERT_GE(sizeof(ExtendedKalmanFilter<9, 1, 2, float, true>),
+            sizeof(ExtendedKalmanFilter<9, 1, 2>) + 22 * sizeof(float));
+}
 }  // namespace Clef::Fw
@@ -0,0 +1,52 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/LoopTimer.h>
+#include <gtest/gtest.h>
+
+namespace Clef::Fw {
+namespace {
+/**
+ * Clock which only moves when told to.
+ */
+class ManualClock : public Clef::If::Clock {
+ public:
+  Clef::Util::Time<uint64_t, Clef::Util::TimeUnit::USEC> getMicros()
+      const override {
+    return micros_;
+  }
+
+  void advance(const uint64_t micros) { micros_ += micros; }
+
+ private:
+  uint64_t micros_ = 0;
+};
+}  // namespace
+
+TEST(LoopTimerTest, Basic) {
+  ManualClock clock;
+  LoopTimer loopTimer(clock);
+
+  // The first lap only starts the timer
+  clock.advance(1000);
+  loopTimer.lap();
+  ASSERT_EQ(loopTimer.getLoopStats().numIterations, 0);
+
+  const uint64_t laps[] = {20, 300, 50, 40};
+  for (const uint64_t micros : laps) {
+    clock.advance(micros);
+    loopTimer.lap();
+  }
+  ASSERT_EQ(loopTimer.getLoopStats().numIterations, 4);
+  ASSERT_EQ(loopTimer.getLoopStats().maxMicros, 300);
+  ASSERT_EQ(loopTimer.getLoopStats().totalMicros, 410);
+
+  // The timer keeps running through a reset
+  clock.advance(70);
+  loopTimer.resetLoopStats();
+  ASSERT_EQ(loopTimer.getLoopStats().numIterations, 0);
+  ASSERT_EQ(loopTimer.getLoopStats().maxMicros, 0);
+  loopTimer.lap();
+  ASSERT_EQ(loopTimer.getLoopStats().numIterations, 1);
+  ASSERT_EQ(loopTimer.getLoopStats().maxMicros, 70);
+}
+}  // namespace Clef::Fw
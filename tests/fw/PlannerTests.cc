@@ -0,0 +1,165 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/Planner.h>
+
+#include "IntegrationFixture.h"
+
+namespace Clef::Fw {
+class PlannerTest : public IntegrationFixture {
+ public:
+  /**
+   * Push an XY move from the end of the queue and return its profile.
+   */
+  const MotionProfile &pushMove(const float x, const float y) {
+    Axes::XAxis::GcodePosition xPos(x);
+    Axes::YAxis::GcodePosition yPos(y);
+    EXPECT_TRUE(actionQueue_.push(
+        context_,
+        Action::MoveXY(actionQueue_.getEndPosition(), &xPos, &yPos)));
+    return actionQueue_.last()->get<Action::MoveXY>().getProfile();
+  }
+};
+
+TEST_F(PlannerTest, Collinear) {
+  actionQueue_.push(context_,
+                    Action::SetFeedrate(actionQueue_.getEndPosition(), 3000));
+  const MotionProfile &first = pushMove(10, 0);
+  ASSERT_FLOAT_EQ(first.nominalSpeed, 50);
+  ASSERT_FLOAT_EQ(first.entrySpeed, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 0);
+
+  // A second segment in the same direction lets the first one cruise through
+  const MotionProfile &second = pushMove(20, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 50);
+  ASSERT_FLOAT_EQ(second.entrySpeed, 50);
+  ASSERT_FLOAT_EQ(second.exitSpeed, 0);
+
+  // The profile accelerates from rest, cruises, and decelerates to rest
+  ASSERT_FLOAT_EQ(first.getSpeedAt(0), MIN_PLANNER_SPEED);
+  ASSERT_FLOAT_EQ(first.getSpeedAt(1), sqrt(2 * MAX_ACCEL_X * 1));
+  ASSERT_FLOAT_EQ(first.getSpeedAt(5), 50);
+  ASSERT_FLOAT_EQ(second.getSpeedAt(9), sqrt(2 * MAX_ACCEL_X * 1));
+}
+
+TEST_F(PlannerTest, Corner) {
+  actionQueue_.push(context_,
+                    Action::SetFeedrate(actionQueue_.getEndPosition(), 3000));
+  const MotionProfile &first = pushMove(10, 0);
+  const MotionProfile &second = pushMove(10, 10);
+  const float junctionSpeed = Planner::calculateJunctionSpeed(first, second);
+  ASSERT_GT(junctionSpeed, 0);
+  ASSERT_LT(junctionSpeed, 50);
+  ASSERT_FLOAT_EQ(first.exitSpeed, junctionSpeed);
+  ASSERT_FLOAT_EQ(second.entrySpeed, junctionSpeed);
+
+  // Reversing direction requires a full stop
+  const MotionProfile &third = pushMove(10, 0);
+  ASSERT_FLOAT_EQ(second.exitSpeed, 0);
+  ASSERT_FLOAT_EQ(third.entrySpeed, 0);
+}
+
+TEST_F(PlannerTest, ShortSegments) {
+  // Segments are too short to reach the nominal speed, so the junction speeds
+  // are limited by the acceleration over the remaining path
+  actionQueue_.push(context_,
+                    Action::SetFeedrate(actionQueue_.getEndPosition(), 6000));
+  const MotionProfile &first = pushMove(0.5, 0);
+  const MotionProfile &second = pushMove(1, 0);
+  const MotionProfile &third = pushMove(1.5, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, sqrt(2 * MAX_ACCEL_X * 0.5));
+  ASSERT_FLOAT_EQ(second.exitSpeed, sqrt(2 * MAX_ACCEL_X * 0.5));
+  ASSERT_FLOAT_EQ(third.entrySpeed, sqrt(2 * MAX_ACCEL_X * 0.5));
+  ASSERT_FLOAT_EQ(third.exitSpeed, 0);
+}
+
+TEST_F(PlannerTest, StopAtOtherActions) {
+  const MotionProfile &first = pushMove(10, 0);
+  actionQueue_.push(context_, Action::MoveZ(actionQueue_.getEndPosition(), 1));
+  const MotionProfile &second = pushMove(20, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 0);
+  ASSERT_FLOAT_EQ(second.entrySpeed, 0);
+}
+
+TEST_F(PlannerTest, Locked) {
+  // Once a segment is handed to the step engine, its profile is final and the
+  // following segment has to start from its exit speed
+  const MotionProfile &first = pushMove(10, 0);
+  actionQueue_.first()->onStart(context_);
+  ASSERT_TRUE(first.locked);
+  const MotionProfile &second = pushMove(20, 0);
+  ASSERT_FLOAT_EQ(first.entrySpeed, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 0);
+  ASSERT_FLOAT_EQ(second.entrySpeed, 0);
+
+  // Segments that are not locked yet are still replanned
+  const MotionProfile &third = pushMove(30, 0);
+  ASSERT_GT(second.exitSpeed, 0);
+  ASSERT_FLOAT_EQ(third.entrySpeed, second.exitSpeed);
+}
+
+TEST_F(PlannerTest, Planned) {
+  // Planned speeds replace the feedrate and the junction limit, but the entry
+  // and exit speeds still depend on the rest of the queue
+  actionQueue_.push(context_,
+                    Action::SetFeedrate(actionQueue_.getEndPosition(), 600));
+  Axes::XAxis::GcodePosition xPos(10);
+  Axes::YAxis::GcodePosition yPos(0);
+  Action::MoveXY moveXy(actionQueue_.getEndPosition(), &xPos, &yPos);
+  moveXy.setPlannedSpeeds(50, 20);
+  actionQueue_.push(context_, moveXy);
+  const MotionProfile &first =
+      actionQueue_.last()->get<Action::MoveXY>().getProfile();
+  ASSERT_FLOAT_EQ(first.nominalSpeed, 50);
+  ASSERT_FLOAT_EQ(first.maxEntrySpeed, 20);
+  ASSERT_FLOAT_EQ(first.entrySpeed, 0);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 0);
+  const MotionProfile &second = pushMove(20, 0);
+  ASSERT_FLOAT_EQ(second.nominalSpeed, 10);
+  ASSERT_FLOAT_EQ(first.exitSpeed, 10);
+}
+
+TEST_F(PlannerTest, Duration) {
+  MotionProfile profile;
+  profile.length = 10;
+  profile.acceleration = 1000;
+  profile.nominalSpeed = 50;
+  profile.entrySpeed = 0;
+  profile.exitSpeed = 0;
+  ASSERT_FLOAT_EQ(profile.getDuration(), 0.05 + 7.5 / 50 + 0.05);
+
+  // Too short to reach the nominal speed
+  profile.length = 1;
+  ASSERT_FLOAT_EQ(profile.getDuration(), 2 * sqrt(1000.0f) / 1000);
+  profile.entrySpeed = 10;
+  profile.exitSpeed = 10;
+  ASSERT_FLOAT_EQ(profile.getDuration(), 2 * (sqrt(1100.0f) - 10) / 1000);
+}
+
+TEST_F(PlannerTest, Execute) {
+  // Consecutive segments run back to back in the step engine without stopping
+  // at the junction between them
+  const XYZEPosition startPosition = axes_.getCurrentPosition();
+  const MotionProfile &first =
+      pushMove(*startPosition.x + 10, *startPosition.y + 5);
+  pushMove(*startPosition.x + 20, *startPosition.y + 8);
+  ASSERT_GT(first.exitSpeed, 0);
+  ActionQueue::Iterator it = actionQueue_.first();
+  it->onStart(context_);
+  it->onLoop(context_);
+  while (!it->isFinished(context_)) {
+    stepTimer_.pulseOnce();
+  }
+  ASSERT_TRUE(stepTimer_.isEnabled());
+  actionQueue_.pop(context_);
+  it = actionQueue_.first();
+  it->onStart(context_);
+  while (!it->isFinished(context_)) {
+    stepTimer_.pulseOnce();
+    it->onLoop(context_);
+  }
+  ASSERT_EQ(*axes_.getX().getPosition(),
+            *Axes::XAxis::gcodePositionToStepper(startPosition.x + 20));
+  ASSERT_EQ(*axes_.getY().getPosition(),
+            *Axes::YAxis::gcodePositionToStepper(startPosition.y + 8));
+}
+}  // namespace Clef::Fw
@@ -4,6 +4,7 @@
 #include <gtest/gtest.h>
 #include <impl/emulator/Clock.h>
 
+#include <functional>
 #include <thread>
 
 namespace Clef::Fw {
@@ -173,6 +174,127 @@ TEST_F(SensorTest, MultipleSubscribers) {
   ASSERT_FALSE(checkOut(token1));
 }
 
+class SeqlockSensorTest : public testing::Test, public Sensor<float> {
+ public:
+  SeqlockSensorTest()
+      : testing::Test(),
+        Sensor<float>(clock, SensorPublication::SEQLOCK),
+        numUpdates_(0) {
+    clock.init();
+  }
+
+  void onCurrentUpdate(const DataPoint dataPoint) override { numUpdates_++; }
+
+ protected:
+  uint32_t numUpdates_;
+};
+
+TEST_F(SeqlockSensorTest, SingleSubscriber) {
+  uint8_t token = subscribe();
+  ASSERT_FALSE(checkOut(token));
+
+  // Data is loaded when it is checked out, not when it is injected
+  inject(1.0f);
+  ASSERT_EQ(numUpdates_, 0);
+  ASSERT_TRUE(checkOut(token));
+  ASSERT_EQ(numUpdates_, 1);
+  ASSERT_EQ(read().data, 1.0f);
+  release(token);
+  ASSERT_FALSE(checkOut(token));
+
+  // Only the newest data point is loaded
+  inject(-10.0f);
+  inject(2.0f);
+  ASSERT_TRUE(checkOut(token));
+  ASSERT_EQ(numUpdates_, 2);
+  ASSERT_EQ(read().data, 2.0f);
+
+  // Data injected while checked out waits for the next checkout
+  inject(3.0f);
+  ASSERT_EQ(read().data, 2.0f);
+  release(token);
+  ASSERT_TRUE(checkOut(token));
+  ASSERT_EQ(read().data, 3.0f);
+  release(token);
+  ASSERT_FALSE(checkOut(token));
+  ASSERT_EQ(numUpdates_, 3);
+}
+
+TEST_F(SeqlockSensorTest, MultipleSubscribers) {
+  uint8_t token1 = subscribe();
+  uint8_t token2 = subscribe();
+
+  inject(1.0f);
+  ASSERT_TRUE(checkOut(token1));
+  release(token1);
+  ASSERT_FALSE(checkOut(token1));
+  ASSERT_TRUE(checkOut(token2));
+  ASSERT_EQ(read().data, 1.0f);
+  release(token2);
+
+  // New data is not loaded while another subscriber is reading
+  inject(2.0f);
+  ASSERT_TRUE(checkOut(token1));
+  inject(3.0f);
+  ASSERT_TRUE(checkOut(token2));
+  ASSERT_EQ(read().data, 2.0f);
+  release(token1);
+  ASSERT_FALSE(checkOut(token1));
+  release(token2);
+
+  // Once nobody is reading, the next checkout loads it
+  ASSERT_TRUE(checkOut(token2));
+  ASSERT_EQ(read().data, 3.0f);
+  ASSERT_TRUE(checkOut(token1));
+  release(token1);
+  release(token2);
+  ASSERT_EQ(numUpdates_, 3);
+}
+
+namespace {
+/**
+ * Data which lets the writer interrupt a copy halfway through, as an interrupt
+ * handler could interrupt the main loop.
+ */
+struct Block {
+  Block(const uint32_t value = 0) : words{value, value} {}
+  Block(const Block &other) = default;
+
+  Block &operator=(const Block &other) {
+    words[0] = other.words[0];
+    if (interrupt) {
+      std::function<void()> handler = interrupt;
+      interrupt = nullptr;
+      handler();
+    }
+    words[1] = other.words[1];
+    return *this;
+  }
+
+  uint32_t words[2];
+  static std::function<void()> interrupt;
+};
+
+std::function<void()> Block::interrupt;
+}  // namespace
+
+TEST(SeqlockSensorInterruptTest, TornRead) {
+  Sensor<Block> sensor(clock, SensorPublication::SEQLOCK);
+  clock.init();
+  uint8_t token = sensor.subscribe();
+  sensor.inject(Block(1));
+
+  // The writer publishes while the reader is copying, so the copy is taken
+  // again
+  Block::interrupt = [&sensor]() { sensor.inject(Block(2)); };
+  ASSERT_TRUE(sensor.checkOut(token));
+  ASSERT_EQ(Block::interrupt, nullptr);
+  ASSERT_EQ(sensor.read().data.words[0], 2);
+  ASSERT_EQ(sensor.read().data.words[1], 2);
+  sensor.release(token);
+  ASSERT_FALSE(sensor.checkOut(token));
+}
+
 class DisplacementSensorTest
     : public testing::Test,
       public DisplacementSensor<USTEPS_PER_MM_DISPLACEMENT, USTEPS_PER_MM_E> {
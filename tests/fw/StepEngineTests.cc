@@ -0,0 +1,213 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/StepEngine.h>
+
+#include "IntegrationFixture.h"
+
+namespace Clef::Fw {
+class StepEngineTest : public IntegrationFixture {};
+
+TEST_F(StepEngineTest, Diagonal) {
+  const int32_t startX = *axes_.getX().getPosition();
+  const int32_t startY = *axes_.getY().getPosition();
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  endPosition.x = endPosition.x + 10;
+  endPosition.y = endPosition.y - 4;
+  StepEngine::StepBlock block =
+      stepEngine_.makeBlock(endPosition, StepEngine::XY_MASK);
+  ASSERT_EQ(block.steps[StepEngine::X], 10 * USTEPS_PER_MM_X);
+  ASSERT_EQ(block.steps[StepEngine::Y], 4 * USTEPS_PER_MM_Y);
+  ASSERT_EQ(block.steps[StepEngine::Z], 0);
+  ASSERT_EQ(block.stepEventCount, 10 * USTEPS_PER_MM_X);
+  ASSERT_FLOAT_EQ(block.length, sqrt(10 * 10 + 4 * 4));
+
+  // Frequency is chosen so that the path is travelled at the given speed
+  block.setConstantSpeed(5, MAX_ACCEL_X);
+  ASSERT_TRUE(stepEngine_.push(&block));
+  ASSERT_TRUE(stepEngine_.isBusy());
+  ASSERT_FALSE(stepEngine_.isCompleted(block.sequence));
+  ASSERT_EQ(*stepTimer_.getFrequency(),
+            static_cast<uint32_t>(block.stepEventCount * 5 / block.length));
+
+  // Y lags X by at most one step at every point along the path
+  while (stepEngine_.isBusy()) {
+    stepTimer_.pulseOnce();
+    const int32_t dx = *axes_.getX().getPosition() - startX;
+    const int32_t dy = startY - *axes_.getY().getPosition();
+    const float expectedY = static_cast<float>(dx) *
+                            block.steps[StepEngine::Y] /
+                            block.steps[StepEngine::X];
+    ASSERT_LE(fabs(dy - expectedY), 1.0f);
+  }
+  ASSERT_TRUE(stepEngine_.isCompleted(block.sequence));
+  ASSERT_FALSE(stepTimer_.isEnabled());
+  ASSERT_EQ(*axes_.getX().getPosition(), startX + 10 * USTEPS_PER_MM_X);
+  ASSERT_EQ(*axes_.getY().getPosition(), startY - 4 * USTEPS_PER_MM_Y);
+}
+
+TEST_F(StepEngineTest, MaskedAxes) {
+  const int32_t startZ = *axes_.getZ().getPosition();
+  const int32_t startE = *axes_.getE().getPosition();
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  endPosition.z = endPosition.z + 1;
+  endPosition.e = endPosition.e + 1;
+  StepEngine::StepBlock block =
+      stepEngine_.makeBlock(endPosition, StepEngine::Z_MASK);
+  block.setConstantSpeed(1, 0);
+  ASSERT_TRUE(stepEngine_.push(&block));
+  stepTimer_.pulseWhile([this]() { return stepEngine_.isBusy(); });
+  ASSERT_EQ(*axes_.getZ().getPosition(), startZ + USTEPS_PER_MM_Z);
+  ASSERT_EQ(*axes_.getE().getPosition(), startE);
+}
+
+TEST_F(StepEngineTest, MaxFrequency) {
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  endPosition.x = endPosition.x + 1;
+  StepEngine::StepBlock block =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  block.setConstantSpeed(1000, 0);
+  ASSERT_EQ(block.nominalRate, static_cast<uint32_t>(MAX_STEPPER_FREQ));
+  ASSERT_TRUE(stepEngine_.push(&block));
+  ASSERT_FLOAT_EQ(*stepTimer_.getFrequency(), MAX_STEPPER_FREQ);
+  stepTimer_.pulseWhile([this]() { return stepEngine_.isBusy(); });
+}
+
+TEST_F(StepEngineTest, Queue) {
+  // Blocks continue from where the previous queued block ends, and the
+  // interrupt handler moves on to the next block by itself
+  const XYZEPosition startPosition = axes_.getCurrentPosition();
+  XYZEPosition endPosition = startPosition;
+  StepEngine::StepBlock blocks[3];
+  for (int i = 0; i < 3; ++i) {
+    endPosition.x = endPosition.x + 1;
+    endPosition.y = endPosition.y + (i % 2 ? 1 : -1);
+    blocks[i] = stepEngine_.makeBlock(endPosition, StepEngine::XY_MASK);
+    ASSERT_EQ(blocks[i].steps[StepEngine::X], USTEPS_PER_MM_X);
+    ASSERT_EQ(blocks[i].steps[StepEngine::Y], USTEPS_PER_MM_Y);
+    blocks[i].setConstantSpeed(10, MAX_ACCEL_X);
+    ASSERT_TRUE(stepEngine_.push(&blocks[i]));
+  }
+  ASSERT_EQ(blocks[1].sequence, blocks[0].sequence + 1);
+  ASSERT_EQ(blocks[2].sequence, blocks[1].sequence + 1);
+  stepTimer_.pulseWhile([this]() { return stepEngine_.isBusy(); });
+  for (int i = 0; i < 3; ++i) {
+    ASSERT_TRUE(stepEngine_.isCompleted(blocks[i].sequence));
+  }
+  ASSERT_EQ(axes_.getX().getPosition(),
+            Axes::XAxis::gcodePositionToStepper(endPosition.x));
+  ASSERT_EQ(axes_.getY().getPosition(),
+            Axes::YAxis::gcodePositionToStepper(endPosition.y));
+}
+
+TEST_F(StepEngineTest, NominalSpeed) {
+  // A change of speed applies to the executing block and to the blocks queued
+  // behind it, which start at the new speed
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  StepEngine::StepBlock blocks[2];
+  for (int i = 0; i < 2; ++i) {
+    endPosition.x = endPosition.x + 1;
+    blocks[i] = stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+    blocks[i].setConstantSpeed(1, MAX_ACCEL_X);
+    ASSERT_TRUE(stepEngine_.push(&blocks[i]));
+  }
+  stepEngine_.setNominalSpeed(10);
+  while (!stepEngine_.isCompleted(blocks[0].sequence)) {
+    stepTimer_.pulseOnce();
+  }
+  ASSERT_EQ(*stepTimer_.getFrequency(), 10 * USTEPS_PER_MM_X);
+  stepTimer_.pulseWhile([this]() { return stepEngine_.isBusy(); });
+}
+
+TEST_F(StepEngineTest, EmptyBlockBehindRunningBlock) {
+  // A block without steps completes as soon as the block ahead of it does,
+  // and the next block starts straight away
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  endPosition.x = endPosition.x + 1;
+  StepEngine::StepBlock first =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  first.setConstantSpeed(10, 0);
+  ASSERT_TRUE(stepEngine_.push(&first));
+  StepEngine::StepBlock empty =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  ASSERT_EQ(empty.stepEventCount, 0);
+  ASSERT_TRUE(stepEngine_.push(&empty));
+  endPosition.x = endPosition.x + 1;
+  StepEngine::StepBlock last =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  last.setConstantSpeed(20, 0);
+  ASSERT_TRUE(stepEngine_.push(&last));
+
+  for (int32_t i = 0; i < first.stepEventCount; ++i) {
+    ASSERT_FALSE(stepEngine_.isCompleted(empty.sequence));
+    stepTimer_.pulseOnce();
+  }
+  ASSERT_TRUE(stepEngine_.isCompleted(empty.sequence));
+  ASSERT_FALSE(stepEngine_.isCompleted(last.sequence));
+  ASSERT_EQ(*stepTimer_.getFrequency(), last.initialRate);
+
+  int32_t numEvents = 0;
+  while (stepEngine_.isBusy()) {
+    stepTimer_.pulseOnce();
+    numEvents++;
+  }
+  ASSERT_EQ(numEvents, last.stepEventCount);
+  ASSERT_TRUE(stepEngine_.isCompleted(last.sequence));
+}
+
+TEST_F(StepEngineTest, Capacity) {
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  for (int i = 0; i < STEP_BLOCK_QUEUE_SIZE - 1; ++i) {
+    endPosition.x = endPosition.x + 1;
+    StepEngine::StepBlock block =
+        stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+    ASSERT_TRUE(stepEngine_.push(&block));
+  }
+  ASSERT_FALSE(stepEngine_.hasCapacity());
+  StepEngine::StepBlock block =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  ASSERT_FALSE(stepEngine_.push(&block));
+  stepTimer_.pulseWhile([this]() { return stepEngine_.isBusy(); });
+  ASSERT_TRUE(stepEngine_.hasCapacity());
+}
+
+TEST_F(StepEngineTest, Trapezoid) {
+  XYZEPosition endPosition = axes_.getCurrentPosition();
+  endPosition.x = endPosition.x + 10;
+  StepEngine::StepBlock block =
+      stepEngine_.makeBlock(endPosition, StepEngine::X_MASK);
+  block.setSpeeds(0, 50, 0, MAX_ACCEL_X);
+  ASSERT_EQ(block.initialRate, MIN_PLANNER_SPEED * USTEPS_PER_MM_X);
+  ASSERT_EQ(block.nominalRate, 50 * USTEPS_PER_MM_X);
+
+  // Accelerating to 50 mm/s at MAX_ACCEL_X takes 3.125 mm
+  ASSERT_NEAR(block.decelerateAfter,
+              block.stepEventCount -
+                  50.0f * 50.0f / (2 * MAX_ACCEL_X) * USTEPS_PER_MM_X,
+              1);
+  ASSERT_TRUE(stepEngine_.push(&block));
+
+  // The rate rises monotonically to the nominal rate, cruises, then falls
+  float maxFrequency = *stepTimer_.getFrequency();
+  int32_t numEvents = 0;
+  int32_t maxReachedAt = -1;
+  while (stepEngine_.isBusy()) {
+    const float frequency = *stepTimer_.getFrequency();
+    if (numEvents < block.stepEventCount / 2) {
+      ASSERT_GE(frequency, maxFrequency);
+    }
+    if (frequency > maxFrequency) {
+      maxFrequency = frequency;
+    }
+    if (maxReachedAt < 0 && frequency == block.nominalRate) {
+      maxReachedAt = numEvents;
+    }
+    stepTimer_.pulseOnce();
+    numEvents++;
+  }
+  ASSERT_EQ(numEvents, block.stepEventCount);
+  ASSERT_FLOAT_EQ(maxFrequency, block.nominalRate);
+  ASSERT_GT(maxReachedAt, 0);
+  ASSERT_LT(maxReachedAt, block.decelerateAfter);
+  ASSERT_LT(*stepTimer_.getFrequency(), block.nominalRate / 2);
+}
+}  // namespace Clef::Fw
@@ -0,0 +1,113 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/kalman/Degen.h>
+#include <gtest/gtest.h>
+#include <host/BatchReplay.h>
+#include <host/NpyFile.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+namespace {
+/**
+ * Save a recording of numSamples samples at 250 Hz of an extruder running at
+ * rate usteps/s, like the one in KalmanReplayTests.
+ */
+void writeRun(const std::filesystem::path &dir, const uint32_t numSamples,
+              const float rate) {
+  std::filesystem::create_directories(dir);
+  std::vector<double> xe, xs, P;
+  float xePosition = 1000, xsPosition = 980;
+  for (uint32_t i = 0; i < numSamples; ++i) {
+    const double t = 5000000 + 4000 * i;
+    xePosition += rate * 0.004f;
+    const float Ph = 10 * (xePosition - xsPosition);
+    xsPosition += 0.08f * Ph / 1.16f * 0.004f;
+    xe.insert(xe.end(), {t, round(xePosition)});
+    xs.insert(xs.end(), {t, round(xsPosition + 0.5f * sin(i))});
+    P.insert(P.end(), {t, round(4900 + Ph + cos(i * 0.7))});
+  }
+  NpyFile::write((dir / "xe-vs-t.npy").string(), xe.data(), numSamples, 2);
+  NpyFile::write((dir / "xs-vs-t.npy").string(), xs.data(), numSamples, 2);
+  NpyFile::write((dir / "P-vs-t.npy").string(), P.data(), numSamples, 2);
+}
+}  // namespace
+
+class BatchReplayTest : public testing::Test {
+ public:
+  BatchReplayTest()
+      : root_(std::filesystem::temp_directory_path() /
+              ("clef-batch-replay-" + std::to_string(getpid()))) {
+    writeRun(root_ / "data-b", 300, 400);
+    writeRun(root_ / "data-a", 200, 200);
+    writeRun(root_ / "data-c", 100, 300);
+    std::filesystem::create_directories(root_ / "plots");
+  }
+
+  ~BatchReplayTest() { std::filesystem::remove_all(root_); }
+
+ protected:
+  std::filesystem::path root_;
+};
+
+TEST_F(BatchReplayTest, FindRuns) {
+  const std::vector<std::string> runs = BatchReplay::findRuns(root_.string());
+  ASSERT_EQ(runs.size(), 3);
+  ASSERT_EQ(runs[0], (root_ / "data-a").string());
+  ASSERT_EQ(runs[1], (root_ / "data-b").string());
+  ASSERT_EQ(runs[2], (root_ / "data-c").string());
+
+  ASSERT_EQ(BatchReplay::findRuns(runs[1]), std::vector<std::string>{runs[1]});
+  ASSERT_TRUE(BatchReplay::findRuns((root_ / "plots").string()).empty());
+}
+
+TEST_F(BatchReplayTest, MatchesFilter) {
+  const std::vector<BatchReplay::Run> runs =
+      BatchReplay::replayAll(BatchReplay::findRuns(root_.string()), 3);
+  ASSERT_EQ(runs.size(), 3);
+  const uint32_t numSamples[] = {200, 300, 100};
+  for (uint16_t i = 0; i < 3; ++i) {
+    ASSERT_TRUE(runs[i].success) << runs[i].error;
+    // The first row is dropped, as by the Python tools
+    ASSERT_EQ(runs[i].numSamples, numSamples[i] - 1);
+  }
+
+  // Replay data-b by hand
+  NpyFile xe, xs, P, states;
+  std::string error;
+  ASSERT_TRUE(xe.open((root_ / "data-b/xe-vs-t.npy").string(), &error));
+  ASSERT_TRUE(xs.open((root_ / "data-b/xs-vs-t.npy").string(), &error));
+  ASSERT_TRUE(P.open((root_ / "data-b/P-vs-t.npy").string(), &error));
+  ASSERT_TRUE(states.open(
+      (root_ / "data-b" / BatchReplay::OUTPUT_NAME).string(), &error));
+  ASSERT_EQ(states.getNumRows(), 299);
+  ASSERT_EQ(states.getNumColumns(), BatchReplay::NUM_OUTPUT_COLUMNS);
+  Clef::Fw::Kalman::DegenFilter filter;
+  for (uint64_t i = 1; i < xe.getNumRows(); ++i) {
+    filter.evolve(xe.get(i, 1) - xe.get(1, 1), xs.get(i, 1) - xs.get(1, 1),
+                  P.get(i, 1), 0.004);
+    ASSERT_NEAR(states.get(i - 1, 0), i * 0.004, 1e-9);
+    for (uint16_t j = 0; j < BatchReplay::NUM_STATES; ++j) {
+      ASSERT_FLOAT_EQ(states.get(i - 1, 1 + j), filter.getState().get(j, 0))
+          << "sample " << i << ", state " << j;
+    }
+  }
+  ASSERT_TRUE(isfinite(states.get(298, 1)));
+  ASSERT_GT(states.get(298, 1), 0);
+}
+
+TEST_F(BatchReplayTest, Errors) {
+  // A sensor which misses a sample
+  std::filesystem::remove(root_ / "data-c/P-vs-t.npy");
+  const double P[] = {5000000, 4900};
+  NpyFile::write((root_ / "data-c/P-vs-t.npy").string(), P, 1, 2);
+  const BatchReplay::Run run = BatchReplay::replay((root_ / "data-c").string());
+  ASSERT_FALSE(run.success);
+  ASSERT_EQ(run.error, (root_ / "data-c/P-vs-t.npy").string() +
+                           ": expected as many (t, value) rows as xe");
+}
+}  // namespace Clef::Host
@@ -0,0 +1,90 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <host/Compiler.h>
+#include <string.h>
+
+#include "../fw/IntegrationFixture.h"
+
+namespace Clef::Host {
+class CompilerTest : public Clef::Fw::IntegrationFixture {
+ public:
+  /**
+   * Compile lines of G-code, expecting every one to be accepted.
+   */
+  std::string compile(const std::vector<std::string> &lines) {
+    for (const std::string &line : lines) {
+      std::string error;
+      EXPECT_TRUE(compiler_.compileLine(line.c_str(), line.size(), &error))
+          << line << ": " << error;
+    }
+    compiler_.finish();
+    return compiler_.getOutput();
+  }
+
+ protected:
+  Compiler compiler_;
+};
+
+TEST_F(CompilerTest, Stream) {
+  const std::string output = compile({"G1 F3000", "G1 X10 Y0 ;comment", "",
+                                      "G1 X20 Y5", "G1 Z1", "G1 X30 Y5 E2",
+                                      "G1 X40 E4", "G1 E3"});
+  ASSERT_EQ(compiler_.getNumRecords(), 10);
+
+  // The printer accepts every record and queues the same actions as it would
+  // for the G-code
+  serial_.inject(output);
+  parser_.ingest(context_);
+  const std::string response = serial_.extract();
+  size_t numOks = 0;
+  for (size_t start = 0; start < response.size();
+       start = response.find('\n', start) + 1) {
+    ASSERT_EQ(response.compare(start, strlen(Clef::Fw::Str::OK),
+                               Clef::Fw::Str::OK),
+              0)
+        << response;
+    numOks++;
+  }
+  ASSERT_EQ(numOks, 10);
+  const Clef::Fw::Action::Type types[] = {
+      Clef::Fw::Action::Type::SET_FEEDRATE, Clef::Fw::Action::Type::MOVE_XY,
+      Clef::Fw::Action::Type::MOVE_XY,      Clef::Fw::Action::Type::MOVE_Z,
+      Clef::Fw::Action::Type::MOVE_XYE,     Clef::Fw::Action::Type::MOVE_E};
+  ASSERT_EQ(actionQueue_.size(), 6);
+  Clef::Fw::ActionQueue::Iterator it = actionQueue_.first();
+  for (uint16_t i = 0; i < 6; ++i) {
+    if (i > 0) {
+      it = it.next();
+    }
+    ASSERT_EQ(it->getType(), types[i]);
+  }
+  ASSERT_EQ(actionQueue_.getEndPosition(),
+            (Clef::Fw::XYZEPosition{40, 5, 1, 3}));
+  ASSERT_EQ(xyePositionQueue_.size(), 2);
+
+  // The XY segments keep the speeds that were planned for them
+  const Clef::Fw::MotionProfile &first =
+      actionQueue_.first().next()->get<Clef::Fw::Action::MoveXY>().getProfile();
+  ASSERT_FLOAT_EQ(first.nominalSpeed, 50);
+  ASSERT_GT(first.exitSpeed, 0);
+
+  // Z at 10 mm/s, E at a tenth of the feedrate, and XYE points at the
+  // feedrate
+  ASSERT_GT(compiler_.getPrintTime(), 0.1 + 2.0 / 5 + 20.0 / 50);
+
+  while (actionQueue_.size() > 0) {
+    actionQueue_.pop(context_);
+  }
+  while (xyePositionQueue_.size() > 0) {
+    xyePositionQueue_.pop();
+  }
+}
+
+TEST_F(CompilerTest, Rejected) {
+  std::string error;
+  ASSERT_FALSE(compiler_.compileLine("M104 S200", 9, &error));
+  ASSERT_EQ(error, "cannot compile 'M'");
+  ASSERT_FALSE(compiler_.compileLine("G1 Xa", 5, &error));
+  ASSERT_EQ(error, std::string(Clef::Fw::Str::INVALID_FLOAT_ERROR) + ": X");
+}
+}  // namespace Clef::Host
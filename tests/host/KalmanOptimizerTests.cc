@@ -0,0 +1,199 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <fw/kalman/Degen.h>
+#include <gtest/gtest.h>
+#include <host/KalmanOptimizer.h>
+#include <host/NpyFile.h>
+#include <math.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+namespace {
+/**
+ * Save a recording of numSamples samples at 250 Hz of an extruder running at
+ * rate usteps/s, like the one in BatchReplayTests.
+ */
+void writeRun(const std::filesystem::path &dir, const uint32_t numSamples,
+              const float rate) {
+  std::filesystem::create_directories(dir);
+  std::vector<double> xe, xs, P;
+  float xePosition = 1000, xsPosition = 980;
+  for (uint32_t i = 0; i < numSamples; ++i) {
+    const double t = 5000000 + 4000 * i;
+    xePosition += rate * 0.004f;
+    const float Ph = 10 * (xePosition - xsPosition);
+    xsPosition += 0.08f * Ph / 1.16f * 0.004f;
+    xe.insert(xe.end(), {t, round(xePosition)});
+    xs.insert(xs.end(), {t, round(xsPosition + 0.5f * sin(i))});
+    P.insert(P.end(), {t, round(4900 + Ph + cos(i * 0.7))});
+  }
+  NpyFile::write((dir / "xe-vs-t.npy").string(), xe.data(), numSamples, 2);
+  NpyFile::write((dir / "xs-vs-t.npy").string(), xs.data(), numSamples, 2);
+  NpyFile::write((dir / "P-vs-t.npy").string(), P.data(), numSamples, 2);
+}
+
+std::string readFile(const std::filesystem::path &path) {
+  std::ifstream input(path);
+  std::stringstream contents;
+  contents << input.rdbuf();
+  return contents.str();
+}
+}  // namespace
+
+class KalmanOptimizerTest : public testing::Test {
+ public:
+  KalmanOptimizerTest()
+      : root_(std::filesystem::temp_directory_path() /
+              ("clef-kalman-optimize-" + std::to_string(getpid()))) {
+    writeRun(root_ / "data-a", 300, 400);
+    writeRun(root_ / "data-b", 100, 200);
+  }
+
+  ~KalmanOptimizerTest() { std::filesystem::remove_all(root_); }
+
+ protected:
+  std::filesystem::path root_;
+};
+
+TEST_F(KalmanOptimizerTest, Evaluate) {
+  KalmanOptimizer optimizer(1);
+  std::string error;
+  ASSERT_FALSE(optimizer.addDataset((root_ / "data-c").string(), &error));
+  ASSERT_TRUE(optimizer.addDataset((root_ / "data-a").string(), &error))
+      << error;
+  ASSERT_EQ(optimizer.getNumDatasets(), 1);
+
+  // The default parameters give the generated filter
+  const KalmanOptimizer::Params params = KalmanOptimizer::getDefaultParams();
+  ASSERT_EQ(params.xvars.size(), 9);
+  ASSERT_EQ(params.zvars.size(), 2);
+  const KalmanOptimizer::Costs costs = optimizer.evaluate(params);
+  Clef::Fw::Kalman::DegenFilter filter;
+  std::vector<double> xs, xsIn, Ph0;
+  NpyFile xeFile, xsFile, PFile;
+  ASSERT_TRUE(xeFile.open((root_ / "data-a/xe-vs-t.npy").string(), &error));
+  ASSERT_TRUE(xsFile.open((root_ / "data-a/xs-vs-t.npy").string(), &error));
+  ASSERT_TRUE(PFile.open((root_ / "data-a/P-vs-t.npy").string(), &error));
+  for (uint64_t i = 1; i < xeFile.getNumRows(); ++i) {
+    xsIn.push_back(xsFile.get(i, 1) - xsFile.get(1, 1));
+    filter.evolve(xeFile.get(i, 1) - xeFile.get(1, 1), xsIn.back(),
+                  PFile.get(i, 1), 0.004);
+    xs.push_back(filter.getState().get(0, 0));
+    Ph0.push_back(filter.getState().get(3, 0));
+  }
+  double sumSquaredError = 0, sumAbs = 0, sumSquaredNegative = 0,
+         sumSquared = 0;
+  for (size_t i = 0; i < xs.size(); ++i) {
+    sumSquaredError += (xsIn[i] - xs[i]) * (xsIn[i] - xs[i]);
+    sumAbs += fabs(xsIn[i]);
+    sumSquaredNegative += Ph0[i] < 0 ? Ph0[i] * Ph0[i] : 0;
+    sumSquared += Ph0[i] * Ph0[i];
+  }
+  ASSERT_NEAR(costs.error.at("xs"),
+              0.1 * sqrt(sumSquaredError / xs.size()) / (sumAbs / xs.size()),
+              1e-9);
+  ASSERT_GT(costs.error.at("xs"), 0);
+
+  // Every metric of the model is there, and they add up
+  ASSERT_EQ(costs.error.size(), 3);
+  ASSERT_EQ(costs.smoothness.size(), 8);
+  ASSERT_EQ(costs.negativity.size(), 4);
+  double total = 0;
+  for (const auto *metrics :
+       {&costs.error, &costs.smoothness, &costs.negativity}) {
+    for (const auto &[name, cost] : *metrics) {
+      ASSERT_TRUE(isfinite(cost)) << name;
+      total += cost;
+    }
+  }
+  ASSERT_NEAR(costs.total, total, 1e-9);
+  ASSERT_EQ(sumSquaredNegative, 0);
+
+  // The weights of datasets are their numbers of samples
+  ASSERT_TRUE(optimizer.addDataset((root_ / "data-b").string(), &error));
+  KalmanOptimizer other(3);
+  ASSERT_TRUE(other.addDataset((root_ / "data-b").string(), &error));
+  ASSERT_NEAR(optimizer.evaluate(params).total,
+              (299 * costs.total + 99 * other.evaluate(params).total) / 398,
+              1e-9);
+}
+
+TEST_F(KalmanOptimizerTest, Optimize) {
+  KalmanOptimizer optimizer(4);
+  std::string error;
+  ASSERT_TRUE(optimizer.addDataset((root_ / "data-a").string(), &error));
+  ASSERT_TRUE(optimizer.addDataset((root_ / "data-b").string(), &error));
+  const KalmanOptimizer::Params initial = KalmanOptimizer::getDefaultParams();
+  const double initialCost = optimizer.evaluate(initial).total;
+
+  const KalmanOptimizer::Params params =
+      optimizer.optimize(initial, 0.2, 2, (root_ / "output").string());
+  const KalmanOptimizer::Costs costs = optimizer.evaluate(params);
+  ASSERT_LT(costs.total, initialCost);
+
+  // Same results on one thread
+  KalmanOptimizer serial(1);
+  ASSERT_TRUE(serial.addDataset((root_ / "data-a").string(), &error));
+  ASSERT_TRUE(serial.addDataset((root_ / "data-b").string(), &error));
+  ASSERT_EQ(serial.evaluate(params).total, costs.total);
+
+  // Update weights stay in range and observations only change noise
+  for (const Clef::Fw::KalmanTuning::Variable &var : params.xvars) {
+    ASSERT_GE(var.updateWeight, 0);
+    ASSERT_LE(var.updateWeight, 1);
+  }
+  ASSERT_EQ(params.zvars[0].updateWeight, initial.zvars[0].updateWeight);
+
+  // The summaries
+  ASSERT_TRUE(std::filesystem::exists(root_ / "output/opt0/summary.json"));
+  ASSERT_EQ(readFile(root_ / "output/summary.json"),
+            KalmanOptimizer::formatSummary(params, costs));
+}
+
+TEST(KalmanOptimizerSummaryTest, Format) {
+  KalmanOptimizer::Params params = KalmanOptimizer::getDefaultParams();
+  params.xvars.resize(1);
+  params.zvars.resize(1);
+  params.xvars[0] = {"xs", 0, 1e-05, 0.25, 1};
+  params.zvars[0] = {"xs_in", 0, 0, 12345678901234567890.0, 1};
+  const KalmanOptimizer::Costs costs = {
+      {{"xs", 0.1}}, {}, {{"a1", NAN}}, 1.0 / 3};
+
+  // As json.dump(indent=4, sort_keys=True) writes it
+  ASSERT_EQ(KalmanOptimizer::formatSummary(params, costs),
+            "{\n"
+            "    \"cost\": 0.3333333333333333,\n"
+            "    \"metrics\": {\n"
+            "        \"error\": {\n"
+            "            \"xs\": 0.1\n"
+            "        },\n"
+            "        \"negativity\": {\n"
+            "            \"a1\": NaN\n"
+            "        },\n"
+            "        \"smoothness\": {}\n"
+            "    },\n"
+            "    \"vars\": {\n"
+            "        \"xe\": {\n"
+            "            \"mode\": \"uvar\"\n"
+            "        },\n"
+            "        \"xs\": {\n"
+            "            \"initialCovariance\": 1e-05,\n"
+            "            \"initialValue\": 0.0,\n"
+            "            \"mode\": \"xvar\",\n"
+            "            \"noise\": 0.25,\n"
+            "            \"updateWeight\": 1.0\n"
+            "        },\n"
+            "        \"xs_in\": {\n"
+            "            \"mode\": \"zvar\",\n"
+            "            \"noise\": 1.2345678901234567e+19\n"
+            "        }\n"
+            "    }\n"
+            "}");
+}
+}  // namespace Clef::Host
@@ -0,0 +1,82 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <fw/Config.h>
+#include <host/KalmanReplay.h>
+#include <math.h>
+#include <stdio.h>
+
+namespace Clef::Host {
+TEST(KalmanReplayTest, ParseSample) {
+  KalmanReplay::Sample sample;
+  ASSERT_TRUE(KalmanReplay::parseSample(
+      ";t=12345678,xe=1500,xs=-20,P=4987\r\n", &sample));
+  ASSERT_DOUBLE_EQ(sample.t, 12.345678);
+  ASSERT_FLOAT_EQ(sample.xe, 1500);
+  ASSERT_FLOAT_EQ(sample.xs, -20);
+  ASSERT_FLOAT_EQ(sample.P, 4987);
+
+  // Other output of the firmware is not a sample
+  ASSERT_FALSE(KalmanReplay::parseSample(";t=12345678,xe=1500\n", &sample));
+  ASSERT_FALSE(KalmanReplay::parseSample("ok N3 P8 Q16 B120", &sample));
+  ASSERT_FALSE(KalmanReplay::parseSample(
+      ";t=12345678,xe=1500,xs=-20,P=4987,extra", &sample));
+}
+
+namespace {
+/**
+ * Replay samples at the 250 Hz rate of the calipers from an extruder which
+ * runs at the given rate (in usteps/s) for 3 s, retracts briefly and pauses;
+ * the filament follows the pressure built up behind it, as in the model.
+ * Positions are whole usteps and the pressure has a little noise, as logged.
+ * Returns the largest lag of the filament behind the extruder.
+ */
+float replaySynthetic(KalmanReplay &replay, const float rate) {
+  const float Chl = 10, gamma = 0.08, a1 = 2, Ph0 = 4900;
+  float xe = 1000, xs = 980, maxLag = 0;
+  for (uint32_t i = 0; i < 5000; ++i) {
+    const float t = i * 0.004f;
+    const float phase = fmod(t, 6);
+    xe += (phase < 3 ? rate : phase < 3.2 ? -100 : 0) * 0.004f;
+    const float Ph = Chl * (xe - xs);
+    xs += gamma * Ph / (1 + gamma * a1) * 0.004f;
+    maxLag = xe - xs > maxLag ? xe - xs : maxLag;
+
+    char line[64];
+    snprintf(line, sizeof(line), ";t=%u,xe=%ld,xs=%ld,P=%ld\n",
+             5000000 + 4000 * i, lround(xe), lround(xs + 0.5f * sin(i)),
+             lround(Ph0 + Ph + cos(i * 0.7)));
+    KalmanReplay::Sample sample;
+    EXPECT_TRUE(KalmanReplay::parseSample(line, &sample)) << line;
+    replay.evolve(sample);
+  }
+  return maxLag;
+}
+}  // namespace
+
+TEST(KalmanReplayTest, FixedPointFollowsFloat) {
+  KalmanReplay replay;
+  replaySynthetic(replay, 400);
+
+  ASSERT_EQ(replay.getNumSamples(), 5000);
+  ASSERT_TRUE(isfinite(replay.getFloatFilter().getState().get(0, 0)));
+  for (uint16_t i = 0; i < KalmanReplay::NUM_STATES; ++i) {
+    EXPECT_LT(replay.getRelativeError(i), 0.01) << "state " << i;
+    EXPECT_LE(replay.getRmsError(i), replay.getMaxError(i));
+  }
+
+  // The estimates of the filament position agree to a fraction of a ustep
+  EXPECT_NEAR(replay.getFixedFilter().getUnscaledState(0).toFloat(),
+              replay.getFloatFilter().getState().get(0, 0), 0.01);
+}
+
+TEST(KalmanReplayTest, FixedPointLargeLag) {
+  // Fast enough that the filament lags the extruder by well over 1 mm, where
+  // Chl * (xe - xs) is past the range of Q16.16 before it is scaled down
+  KalmanReplay replay;
+  ASSERT_GT(replaySynthetic(replay, 1500), 2 * USTEPS_PER_MM_E);
+  for (uint16_t i = 0; i < KalmanReplay::NUM_STATES; ++i) {
+    EXPECT_LT(replay.getRelativeError(i), 0.01) << "state " << i;
+  }
+}
+}  // namespace Clef::Host
@@ -0,0 +1,102 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <host/NpyFile.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <string>
+
+namespace Clef::Host {
+namespace {
+std::string tempPath(const char *const name) {
+  return (std::filesystem::temp_directory_path() /
+          ("clef-npy-" + std::to_string(getpid()) + "-" + name))
+      .string();
+}
+
+/**
+ * Write a file with the header that numpy.save() gives an array of int64.
+ */
+void writeInt64(const std::string &path, const char *const shape,
+                const int64_t *const data, const size_t numElements) {
+  std::string dict = std::string("{'descr': '<i8', 'fortran_order': False, ") +
+                     "'shape': " + shape + ", }";
+  dict.append((64 - (10 + dict.size() + 1) % 64) % 64, ' ');
+  dict += '\n';
+  std::string file("\x93NUMPY\x01\x00", 8);
+  file += static_cast<char>(dict.size());
+  file += '\0';
+  file += dict;
+  file.append(reinterpret_cast<const char *>(data),
+              numElements * sizeof(int64_t));
+  FILE *const output = fopen(path.c_str(), "wb");
+  fwrite(file.data(), 1, file.size(), output);
+  fclose(output);
+}
+}  // namespace
+
+TEST(NpyFileTest, WriteAndRead) {
+  const std::string path = tempPath("f8.npy");
+  const double data[] = {0.5, -1, 2, 1e10, -3.25, 6};
+  ASSERT_TRUE(NpyFile::write(path, data, 3, 2));
+
+  NpyFile file;
+  std::string error;
+  ASSERT_TRUE(file.open(path, &error)) << error;
+  ASSERT_EQ(file.getNumRows(), 3);
+  ASSERT_EQ(file.getNumColumns(), 2);
+  for (uint16_t i = 0; i < 6; ++i) {
+    ASSERT_EQ(file.get(i / 2, i % 2), data[i]);
+  }
+  file.close();
+  ASSERT_EQ(file.getNumRows(), 0);
+  std::filesystem::remove(path);
+}
+
+TEST(NpyFileTest, ReadInt64) {
+  // As saved by tools/stream_data.py
+  const std::string path = tempPath("i8.npy");
+  const int64_t data[] = {1000000, 5, 1004000, -7};
+  writeInt64(path, "(2, 2)", data, 4);
+  NpyFile file;
+  std::string error;
+  ASSERT_TRUE(file.open(path, &error)) << error;
+  ASSERT_EQ(file.getNumRows(), 2);
+  ASSERT_EQ(file.getNumColumns(), 2);
+  ASSERT_EQ(file.get(1, 0), 1004000);
+  ASSERT_EQ(file.get(1, 1), -7);
+
+  // One-dimensional arrays have one column
+  writeInt64(path, "(4,)", data, 4);
+  ASSERT_TRUE(file.open(path, &error)) << error;
+  ASSERT_EQ(file.getNumRows(), 4);
+  ASSERT_EQ(file.getNumColumns(), 1);
+  ASSERT_EQ(file.get(2, 0), 1004000);
+  std::filesystem::remove(path);
+}
+
+TEST(NpyFileTest, Invalid) {
+  const std::string path = tempPath("invalid.npy");
+  NpyFile file;
+  std::string error;
+  ASSERT_FALSE(file.open(path, &error));
+
+  FILE *const output = fopen(path.c_str(), "wb");
+  fputs("t,xe,xs,P\n", output);
+  fclose(output);
+  ASSERT_FALSE(file.open(path, &error));
+  ASSERT_EQ(error, path + ": not a .npy file");
+
+  const int64_t data[] = {1, 2, 3, 4, 5, 6, 7, 8};
+  writeInt64(path, "(2, 2, 2)", data, 8);
+  ASSERT_FALSE(file.open(path, &error));
+  ASSERT_EQ(error, path + ": unsupported shape");
+
+  writeInt64(path, "(5, 2)", data, 8);
+  ASSERT_FALSE(file.open(path, &error));
+  ASSERT_EQ(error, path + ": truncated data");
+  std::filesystem::remove(path);
+}
+}  // namespace Clef::Host
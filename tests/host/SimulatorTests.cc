@@ -0,0 +1,107 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <host/Simulator.h>
+
+#include <string>
+#include <vector>
+
+namespace Clef::Host {
+namespace {
+Simulator::Options getOptions() {
+  Simulator::Options options = Simulator::DEFAULT_OPTIONS;
+  options.predictor = Simulator::Predictor::LINEAR;
+  options.maxMicros = 600000000;
+  return options;
+}
+}  // namespace
+
+TEST(SimulatorTest, Print) {
+  const std::vector<std::string> commands = {
+      "G1 F1200", "G1 X10 Y5", "G1 Z0.3",           "G1 X20 Y10 E1",
+      "G1 X30 Y5 E2", "G2 X40 Y5 I5 J0 E3", "G1 X0 Y0"};
+  Simulator simulator(getOptions());
+  std::string error;
+  ASSERT_TRUE(simulator.run(commands, &error)) << error;
+  const Simulator::Stats &stats = simulator.getStats();
+  ASSERT_EQ(stats.numLines, commands.size() + 1);
+  ASSERT_EQ(stats.numLinesSent, commands.size() + 1);
+  ASSERT_EQ(*Clef::Impl::Emulator::xAxisStepper.getPosition(), 0);
+  ASSERT_EQ(*Clef::Impl::Emulator::yAxisStepper.getPosition(), 0);
+  ASSERT_EQ(*Clef::Impl::Emulator::zAxisStepper.getPosition(), 120);
+  ASSERT_EQ(*Clef::Impl::Emulator::eAxisStepper.getPosition(), 3 * 564);
+
+  // Each loop iteration but the last takes the same virtual time, and the
+  // 100 Hz pressure sampling sets the rate of telemetry
+  ASSERT_EQ(stats.virtualMicros,
+            (stats.numLoops - 1) * Simulator::DEFAULT_OPTIONS.loopMicros);
+  ASSERT_GT(stats.numEdges, 2 * 40 * 160);
+  const std::vector<Simulator::Sample> &telemetry = simulator.getTelemetry();
+  ASSERT_NEAR(telemetry.size(), stats.virtualMicros / 10000, 2);
+
+  // The plant builds up pressure while extruding and the material catches up
+  // with the extruder by the end
+  float maxPressure = 0;
+  for (const Simulator::Sample &sample : telemetry) {
+    maxPressure = sample.P > maxPressure ? sample.P : maxPressure;
+  }
+  ASSERT_GT(maxPressure, Simulator::DEFAULT_OPTIONS.plant.Ph0 + 100);
+  ASSERT_NEAR(telemetry.back().xs, telemetry.back().e, 5);
+
+  // The run is reproducible
+  Simulator repeat(getOptions());
+  ASSERT_TRUE(repeat.run(commands, &error)) << error;
+  ASSERT_EQ(repeat.getStats().virtualMicros, stats.virtualMicros);
+  ASSERT_EQ(repeat.getStats().numEdges, stats.numEdges);
+  ASSERT_EQ(repeat.getTelemetry().back().xs, telemetry.back().xs);
+}
+
+TEST(SimulatorTest, KalmanSeeds) {
+  // Every run finishes whatever the noise of the sensors, as the first
+  // sample of the displacement sensor can be off by a few usteps
+  const std::vector<std::string> commands = {"G1 F1200", "G1 Z0.3",
+                                             "G1 X20 Y10 E1", "G1 X30 Y5 E2"};
+  for (const Simulator::Predictor predictor :
+       {Simulator::Predictor::KALMAN,
+        Simulator::Predictor::FIXED_POINT_KALMAN}) {
+    for (const uint32_t seed : {0, 1, 13, 14, 20, 27}) {
+      Simulator::Options options = getOptions();
+      options.predictor = predictor;
+      options.seed = seed;
+      options.maxMicros = 120000000;
+      Simulator simulator(options);
+      std::string error;
+      ASSERT_TRUE(simulator.run(commands, &error))
+          << "seed " << seed << ": " << error;
+      ASSERT_EQ(*Clef::Impl::Emulator::eAxisStepper.getPosition(), 2 * 564);
+    }
+  }
+}
+
+TEST(SimulatorTest, QueueFull) {
+  // More moves than fit in the action queue, so some are refused and sent
+  // again once the queue drains
+  std::vector<std::string> commands = {"G1 F6000"};
+  for (int i = 1; i <= 40; ++i) {
+    commands.push_back("G1 X" + std::to_string(i % 2) + " Y" +
+                       std::to_string(i));
+  }
+  Simulator::Options options = getOptions();
+  options.window = 4;
+  Simulator simulator(options);
+  std::string error;
+  ASSERT_TRUE(simulator.run(commands, &error)) << error;
+  const Simulator::Stats &stats = simulator.getStats();
+  ASSERT_EQ(stats.numLines, commands.size() + 1);
+  ASSERT_GT(stats.numAllocErrors, 0);
+  ASSERT_GT(stats.numLinesSent, commands.size() + 1);
+  ASSERT_EQ(*Clef::Impl::Emulator::yAxisStepper.getPosition(), 40 * 160);
+}
+
+TEST(SimulatorTest, Error) {
+  Simulator simulator(getOptions());
+  std::string error;
+  ASSERT_FALSE(simulator.run({"G1 X1", "G7"}, &error));
+  ASSERT_EQ(error.compare(0, 7, "Line 2:"), 0) << error;
+}
+}  // namespace Clef::Host
@@ -0,0 +1,65 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <host/WorkStealingPool.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace Clef::Host {
+TEST(WorkStealingPoolTest, Basic) {
+  WorkStealingPool pool(4);
+  ASSERT_EQ(pool.getNumThreads(), 4);
+
+  std::vector<int> results(1000, 0);
+  for (size_t i = 0; i < results.size(); ++i) {
+    pool.submit([&results, i]() { results[i] = i * i; });
+  }
+  pool.wait();
+  for (size_t i = 0; i < results.size(); ++i) {
+    ASSERT_EQ(results[i], i * i);
+  }
+
+  // The pool can be waited on again
+  std::atomic<int> count(0);
+  for (int i = 0; i < 10; ++i) {
+    pool.submit([&count]() { ++count; });
+  }
+  pool.wait();
+  ASSERT_EQ(count, 10);
+  pool.wait();
+
+  // There is always at least one thread
+  WorkStealingPool emptyPool(0);
+  ASSERT_EQ(emptyPool.getNumThreads(), 1);
+  emptyPool.submit([&count]() { ++count; });
+  emptyPool.wait();
+  ASSERT_EQ(count, 11);
+}
+
+TEST(WorkStealingPoolTest, Steal) {
+  // Every task is queued by one task, on the queue of one thread, so the
+  // other threads only get work by stealing it
+  WorkStealingPool pool(4);
+  std::atomic<int> count(0);
+  std::mutex mutex;
+  std::set<std::thread::id> threads;
+  pool.submit([&]() {
+    for (int i = 0; i < 200; ++i) {
+      pool.submit([&]() {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        std::lock_guard<std::mutex> lock(mutex);
+        threads.insert(std::this_thread::get_id());
+        ++count;
+      });
+    }
+  });
+  pool.wait();
+  ASSERT_EQ(count, 200);
+  ASSERT_GT(threads.size(), 1);
+}
+}  // namespace Clef::Host
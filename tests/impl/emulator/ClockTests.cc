@@ -15,4 +15,17 @@ TEST(ClockTest, Basic) {
   ASSERT_LT(*clock.getMicros(),
             *(Clef::Util::Time<float, Clef::Util::TimeUnit::USEC>(100000)));
 }
+
+TEST(ClockTest, Virtual) {
+  VirtualClock clock;
+  ASSERT_TRUE(clock.init());
+  ASSERT_EQ(*clock.getMicros(), 0);
+  clock.advanceTo(2500);
+  ASSERT_EQ(clock.getNanos(), 2500);
+  ASSERT_EQ(*clock.getMicros(), 2);
+
+  // The clock never goes back
+  clock.advanceTo(1000);
+  ASSERT_EQ(clock.getNanos(), 2500);
+}
 }  // namespace Clef::Impl::Emulator
@@ -0,0 +1,141 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <impl/emulator/Scheduler.h>
+
+#include <vector>
+
+namespace Clef::Impl::Emulator {
+class SchedulerTest : public testing::Test {
+ public:
+  /**
+   * Record of an edge: which timer, whether it was rising and when.
+   */
+  struct Edge {
+    int timer;
+    bool isRising;
+    uint64_t nanos;
+  };
+
+  struct Source {
+    SchedulerTest *test;
+    int index;
+    GenericTimer timer;
+    int numRisingToDisable; /*!< Disable after this many rising edges. */
+    int numRising;
+  };
+
+  SchedulerTest() : scheduler_(clock_) {
+    clock_.init();
+    for (int i = 0; i < 2; ++i) {
+      sources_[i].test = this;
+      sources_[i].index = i;
+      sources_[i].numRisingToDisable = -1;
+      sources_[i].numRising = 0;
+      sources_[i].timer.init();
+      sources_[i].timer.setRisingEdgeCallback(onRisingEdge, &sources_[i]);
+      sources_[i].timer.setFallingEdgeCallback(onFallingEdge, &sources_[i]);
+      scheduler_.addTimer(sources_[i].timer);
+    }
+  }
+
+  static void onRisingEdge(void *arg) {
+    Source *source = reinterpret_cast<Source *>(arg);
+    source->test->edges_.push_back(
+        {source->index, true, source->test->clock_.getNanos()});
+    ++source->numRising;
+  }
+
+  static void onFallingEdge(void *arg) {
+    Source *source = reinterpret_cast<Source *>(arg);
+    source->test->edges_.push_back(
+        {source->index, false, source->test->clock_.getNanos()});
+    if (source->numRising == source->numRisingToDisable) {
+      source->timer.disable();
+    }
+  }
+
+ protected:
+  VirtualClock clock_;
+  Scheduler scheduler_;
+  Source sources_[2];
+  std::vector<Edge> edges_;
+};
+
+TEST_F(SchedulerTest, Frequency) {
+  sources_[0].timer.setFrequency(1000);
+  sources_[0].timer.enable();
+  ASSERT_EQ(scheduler_.runFor(10000000), 19);
+  ASSERT_EQ(*clock_.getMicros(), 10000);
+  ASSERT_EQ(edges_.size(), 19);
+  for (size_t i = 0; i < edges_.size(); ++i) {
+    ASSERT_EQ(edges_[i].timer, 0);
+    ASSERT_EQ(edges_[i].isRising, i % 2 == 0);
+    ASSERT_EQ(edges_[i].nanos, 1000000 * (i / 2 + 1) + 500000 * (i % 2));
+  }
+
+  // Nothing runs while the timer is disabled
+  sources_[0].timer.disable();
+  ASSERT_EQ(scheduler_.runFor(10000000), 0);
+  ASSERT_EQ(*clock_.getMicros(), 20000);
+}
+
+TEST_F(SchedulerTest, Interleave) {
+  sources_[0].timer.setFrequency(1000);
+  sources_[1].timer.setFrequency(2000);
+  sources_[0].timer.enable();
+  sources_[1].timer.enable();
+  scheduler_.runFor(2000000);
+  ASSERT_EQ(edges_.size(), 10);
+  ASSERT_EQ(sources_[0].numRising, 2);
+  ASSERT_EQ(sources_[1].numRising, 4);
+  for (size_t i = 1; i < edges_.size(); ++i) {
+    ASSERT_LE(edges_[i - 1].nanos, edges_[i].nanos);
+  }
+
+  // Edges at the same time run in the order in which the timers were added
+  ASSERT_EQ(edges_[2].nanos, 1000000);
+  ASSERT_EQ(edges_[2].timer, 0);
+  ASSERT_EQ(edges_[3].nanos, 1000000);
+  ASSERT_EQ(edges_[3].timer, 1);
+}
+
+TEST_F(SchedulerTest, Restart) {
+  sources_[0].timer.setFrequency(1000);
+  sources_[0].numRisingToDisable = 3;
+  sources_[0].timer.enable();
+  scheduler_.runFor(10000000);
+  ASSERT_EQ(sources_[0].numRising, 3);
+  ASSERT_FALSE(sources_[0].timer.isEnabled());
+  ASSERT_EQ(edges_.back().nanos, 3500000);
+
+  // Enabling again restarts the count from the clock
+  sources_[0].timer.enable();
+  ASSERT_TRUE(scheduler_.runNext(UINT64_MAX));
+  ASSERT_EQ(edges_.back().nanos, 11000000);
+}
+
+TEST_F(SchedulerTest, ChangeFrequency) {
+  sources_[0].timer.setFrequency(1000);
+  sources_[0].timer.enable();
+  scheduler_.runFor(1600000);
+  ASSERT_EQ(edges_.size(), 2);
+
+  // The new period applies from the last rising edge, which was long enough
+  // ago that the next one is due straight away
+  sources_[0].timer.setFrequency(4000);
+  ASSERT_TRUE(scheduler_.runNext(UINT64_MAX));
+  ASSERT_EQ(edges_.back().nanos, 1600000);
+  ASSERT_TRUE(edges_.back().isRising);
+  ASSERT_TRUE(scheduler_.runNext(UINT64_MAX));
+  ASSERT_EQ(edges_.back().nanos, 1725000);
+  ASSERT_TRUE(scheduler_.runNext(UINT64_MAX));
+  ASSERT_EQ(edges_.back().nanos, 1850000);
+
+  // A timer with no frequency finishes its pulse, then stops
+  sources_[0].timer.setFrequency(0);
+  ASSERT_TRUE(scheduler_.runNext(UINT64_MAX));
+  ASSERT_FALSE(edges_.back().isRising);
+  ASSERT_FALSE(scheduler_.runNext(UINT64_MAX));
+}
+}  // namespace Clef::Impl::Emulator
@@ -0,0 +1,73 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <impl/emulator/SyringePlant.h>
+
+namespace Clef::Impl::Emulator {
+TEST(SyringePlantTest, DegenSteadyState) {
+  const SyringePlant::Params &params = SyringePlant::DEGEN_PARAMS;
+  SyringePlant plant(params, 0);
+  plant.reset(0, 0);
+
+  // At a constant extrusion rate, the material lags behind the extruder by
+  // v * (1 + gamma * a1) / (gamma * Chl)
+  const float rate = 600;
+  for (int i = 1; i <= 100; ++i) {
+    plant.update(i * 0.1, rate * i * 0.1f);
+  }
+  const float lag = rate * (1 + params.gamma * params.a1) /
+                    (params.gamma * params.Chl);
+  ASSERT_NEAR(6000 - plant.getDisplacement(), lag, 1);
+  ASSERT_NEAR(plant.getHeadPressure(), params.Chl * lag, params.Chl);
+
+  // Once the extruder stops, the material catches up with it
+  plant.update(20, 6000);
+  ASSERT_NEAR(plant.getDisplacement(), 6000, 0.5);
+  ASSERT_NEAR(plant.getHeadPressure(), 0, params.Chl);
+}
+
+TEST(SyringePlantTest, GelFriction) {
+  const SyringePlant::Params &params = SyringePlant::GEL_PARAMS;
+  SyringePlant plant(params, 0);
+  plant.reset(0, 100);
+
+  // Static friction holds the plunger until the head pressure overcomes it
+  plant.update(1, 100 + 0.9f * params.a0 / params.AhAs / params.Chl);
+  ASSERT_EQ(plant.getDisplacement(), 100);
+
+  // After a long rest, the gel has flowed out and only the pressure held by
+  // friction is left
+  plant.update(2, 1000);
+  ASSERT_GT(plant.getDisplacement(), 100);
+  plant.update(60, 1000);
+  ASSERT_NEAR(plant.getHeadPressure(), params.a0 / params.AhAs, 5);
+}
+
+TEST(SyringePlantTest, Samples) {
+  SyringePlant::Params params = SyringePlant::DEGEN_PARAMS;
+  params.PNoise = 0;
+  SyringePlant plant(params, 0);
+  plant.reset(0, 0);
+  plant.update(0.001, 100);
+
+  // A status bit and a 14-bit reading, MSB first
+  char buffer[4] = {};
+  plant.samplePressure(sizeof(buffer), buffer);
+  const uint16_t reading = (static_cast<uint8_t>(buffer[0]) << 8) |
+                           static_cast<uint8_t>(buffer[1]);
+  ASSERT_EQ(reading, roundf(params.Ph0 + plant.getHeadPressure()));
+  ASSERT_EQ(reading & 0xc000, 0);
+
+  // The same seed gives the same noise
+  SyringePlant a(SyringePlant::DEGEN_PARAMS, 7);
+  SyringePlant b(SyringePlant::DEGEN_PARAMS, 7);
+  for (int i = 0; i < 10; ++i) {
+    char bufferA[2];
+    char bufferB[2];
+    a.samplePressure(sizeof(bufferA), bufferA);
+    b.samplePressure(sizeof(bufferB), bufferB);
+    ASSERT_EQ(bufferA[0], bufferB[0]);
+    ASSERT_EQ(bufferA[1], bufferB[1]);
+  }
+}
+}  // namespace Clef::Impl::Emulator
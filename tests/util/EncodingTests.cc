@@ -0,0 +1,65 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <util/Encoding.h>
+
+namespace Clef::Util {
+TEST(EncodingTest, Crc16) {
+  // Standard check value of CRC-16/CCITT-FALSE
+  uint16_t crc = CRC16_INIT;
+  for (const char c : std::string("123456789")) {
+    crc = crc16Update(crc, c);
+  }
+  ASSERT_EQ(crc, 0x29b1);
+}
+
+TEST(EncodingTest, Zigzag) {
+  ASSERT_EQ(encodeZigzag(0), 0);
+  ASSERT_EQ(encodeZigzag(-1), 1);
+  ASSERT_EQ(encodeZigzag(1), 2);
+  ASSERT_EQ(encodeZigzag(-2), 3);
+  for (const int32_t value : {0, 1, -1, 63, -64, 100000, -100000, INT32_MAX,
+                              INT32_MIN}) {
+    ASSERT_EQ(decodeZigzag(encodeZigzag(value)), value);
+  }
+}
+
+TEST(EncodingTest, Varint) {
+  uint8_t buffer[16];
+  ASSERT_EQ(encodeVarint(0, buffer), 1);
+  ASSERT_EQ(encodeVarint(127, buffer), 1);
+  ASSERT_EQ(encodeVarint(128, buffer), 2);
+  ASSERT_EQ(buffer[0], 0x80);
+  ASSERT_EQ(buffer[1], 0x01);
+  ASSERT_EQ(encodeVarint(UINT32_MAX, buffer), 5);
+
+  uint8_t size = 0;
+  size += encodeVarint(300, buffer + size);
+  size += encodeVarint(encodeZigzag(-5), buffer + size);
+  buffer[size++] = 7;
+  ByteReader reader(buffer, size);
+  uint32_t unsignedValue;
+  int32_t signedValue;
+  uint8_t byte;
+  ASSERT_TRUE(reader.readVarint(&unsignedValue));
+  ASSERT_EQ(unsignedValue, 300);
+  ASSERT_TRUE(reader.readSignedVarint(&signedValue));
+  ASSERT_EQ(signedValue, -5);
+  ASSERT_TRUE(reader.readByte(&byte));
+  ASSERT_EQ(byte, 7);
+  ASSERT_TRUE(reader.isAtEnd());
+  ASSERT_FALSE(reader.readByte(&byte));
+}
+
+TEST(EncodingTest, TruncatedVarint) {
+  const uint8_t truncated[] = {0x80, 0x80};
+  ByteReader reader(truncated, sizeof(truncated));
+  uint32_t value;
+  ASSERT_FALSE(reader.readVarint(&value));
+
+  // More than five bytes cannot be a 32-bit value
+  const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+  ByteReader reader2(overlong, sizeof(overlong));
+  ASSERT_FALSE(reader2.readVarint(&value));
+}
+}  // namespace Clef::Util
@@ -0,0 +1,96 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <util/FixedPoint.h>
+
+namespace Clef::Util {
+TEST(FixedPointTest, Conversions) {
+  using Q16 = Fixed<16>;
+  ASSERT_EQ(Q16(3).getRaw(), 3 << 16);
+  ASSERT_EQ(Q16(-2).getRaw(), -2 << 16);
+  ASSERT_EQ(Q16(0.5).getRaw(), 1 << 15);
+  ASSERT_EQ(Q16(-0.25).getRaw(), -(1 << 14));
+  ASSERT_FLOAT_EQ(Q16(1234.5678).toFloat(), 1234.5678f);
+
+  // Doubles are rounded to the nearest step
+  ASSERT_EQ(Q16(1.4 / 65536).getRaw(), 1);
+  ASSERT_EQ(Q16(-1.6 / 65536).getRaw(), -2);
+  ASSERT_EQ(Q16::fromRaw(12345).getRaw(), 12345);
+}
+
+TEST(FixedPointTest, Arithmetic) {
+  using Q16 = Fixed<16>;
+  ASSERT_EQ(Q16(1.5) + Q16(2.25), Q16(3.75));
+  ASSERT_EQ(Q16(1.5) - Q16(2.25), Q16(-0.75));
+  ASSERT_EQ(-Q16(1.5), Q16(-1.5));
+  ASSERT_EQ(Q16(1.5) * Q16(-2.25), Q16(-3.375));
+  ASSERT_EQ(Q16(-3.375) / Q16(1.5), Q16(-2.25));
+  ASSERT_EQ(Q16(1) / Q16(3), Q16(1.0 / 3));
+  ASSERT_EQ(Q16(-1) / Q16(3), Q16(-1.0 / 3));
+  ASSERT_EQ(Q16(2) / Q16(-3), Q16(-2.0 / 3));
+
+  // Products are rounded to the nearest step rather than truncated
+  ASSERT_EQ((Q16::fromRaw(3) * Q16(0.5)).getRaw(), 2);
+  ASSERT_EQ((Q16::fromRaw(-3) * Q16(0.5)).getRaw(), -1);
+
+  // Products of large values do not overflow in the intermediate
+  ASSERT_EQ(Q16(20000) * Q16(0.5), Q16(10000));
+
+  Q16 value(2);
+  value += Q16(0.5);
+  value *= Q16(4);
+  value -= Q16(1);
+  ASSERT_EQ(value, Q16(9));
+  ASSERT_TRUE(Q16(-1) < Q16(0.5));
+  ASSERT_TRUE(Q16(0.5) >= Q16(0.5));
+  ASSERT_TRUE(Q16(0.5) != Q16(0.25));
+}
+
+TEST(FixedPointTest, Shift) {
+  using Q16 = Fixed<16>;
+  ASSERT_EQ(Q16(3).shift(4), Q16(48));
+  ASSERT_EQ(Q16(-3).shift(4), Q16(-48));
+  ASSERT_EQ(Q16(48).shift(-4), Q16(3));
+  ASSERT_EQ(Q16(-48).shift(-4), Q16(-3));
+  ASSERT_EQ(Q16(5).shift(0), Q16(5));
+
+  // Bits shifted out are rounded
+  ASSERT_EQ(Q16::fromRaw(3).shift(-1).getRaw(), 2);
+  ASSERT_EQ(Q16::fromRaw(5).shift(-2).getRaw(), 1);
+  ASSERT_EQ(Q16::fromRaw(-5).shift(-2).getRaw(), -1);
+}
+
+TEST(FixedPointTest, Saturation) {
+  using Q16 = Fixed<16>;
+  const Q16 max = Q16::fromRaw(Q16::MAX_RAW);
+  const Q16 min = Q16::fromRaw(-Q16::MAX_RAW);
+  ASSERT_EQ(Q16(40000), max);
+  ASSERT_EQ(Q16(-40000.0), min);
+  ASSERT_EQ(Q16(30000) + Q16(30000), max);
+  ASSERT_EQ(Q16(-30000) - Q16(30000), min);
+  ASSERT_EQ(Q16(300) * Q16(300), max);
+  ASSERT_EQ(Q16(300) * Q16(-300), min);
+  ASSERT_EQ(Q16(30000) / Q16(0.25), max);
+  ASSERT_EQ(Q16(3).shift(15), max);
+  ASSERT_EQ(Q16(-3).shift(15), min);
+  ASSERT_EQ(-Q16::fromRaw(INT32_MIN), max);
+
+  // Division by zero saturates by the sign of the dividend
+  ASSERT_EQ(Q16(2) / Q16(), max);
+  ASSERT_EQ(Q16(-2) / Q16(), min);
+  ASSERT_EQ(Q16() / Q16(), Q16());
+
+  // Results back in range after a saturated operand are exact
+  ASSERT_EQ(max - Q16(1), Q16::fromRaw(Q16::MAX_RAW - Q16::ONE));
+}
+
+TEST(FixedPointTest, Sqrt) {
+  using Q16 = Fixed<16>;
+  ASSERT_EQ(sqrt(Q16(4)), Q16(2));
+  ASSERT_EQ(sqrt(Q16(0.25)), Q16(0.5));
+  ASSERT_NEAR(sqrt(Q16(2)).toFloat(), 1.414214f, 1.0f / Q16::ONE);
+  ASSERT_NEAR(sqrt(Q16(30000)).toFloat(), 173.20508f, 1.0f / Q16::ONE);
+  ASSERT_EQ(sqrt(Q16()), Q16());
+  ASSERT_EQ(sqrt(Q16(-1)), Q16());
+}
+}  // namespace Clef::Util
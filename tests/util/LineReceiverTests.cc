@@ -0,0 +1,73 @@
+// Copyright 2021 by Daniel Winkelman. All rights reserved.
+
+#include <gtest/gtest.h>
+#include <util/LineReceiver.h>
+
+#include <string>
+
+namespace Clef::Util {
+namespace {
+template <uint16_t N>
+void push(LineReceiver<N> *receiver, const std::string &str) {
+  for (const char c : str) {
+    receiver->push(c);
+  }
+}
+
+template <uint16_t N>
+std::string readAll(LineReceiver<N> *receiver) {
+  std::string result;
+  char c;
+  while (receiver->read(&c)) {
+    result += c;
+  }
+  return result;
+}
+}  // namespace
+
+TEST(LineReceiverTest, CompleteLines) {
+  LineReceiver<16> receiver;
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 15);
+  ASSERT_FALSE(receiver.isLineReady());
+
+  // A partial line cannot be read
+  push(&receiver, "G1 X1");
+  ASSERT_FALSE(receiver.isLineReady());
+  ASSERT_EQ(readAll(&receiver), "");
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 10);
+
+  push(&receiver, "\nG1");
+  ASSERT_TRUE(receiver.isLineReady());
+  ASSERT_EQ(readAll(&receiver), "G1 X1\n");
+  ASSERT_FALSE(receiver.isLineReady());
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 13);
+
+  // Lines wrap around the end of the buffer
+  push(&receiver, "\nM110\n");
+  ASSERT_EQ(readAll(&receiver), "G1\nM110\n");
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 15);
+  ASSERT_EQ(receiver.getNumOverflows(), 0);
+}
+
+TEST(LineReceiverTest, Overflow) {
+  LineReceiver<16> receiver;
+  push(&receiver, "G1 X1\n");
+
+  // The line that does not fit is dropped as a whole
+  push(&receiver, "G1 X2 Y3 Z4 E5\nG1 X6\n");
+  ASSERT_EQ(receiver.getNumOverflows(), 1);
+  ASSERT_EQ(readAll(&receiver), "G1 X1\nG1 X6\n");
+
+  // So is a line that is longer than the buffer
+  push(&receiver, "G1 X1 Y1 Z1 E1 F1\n");
+  ASSERT_EQ(receiver.getNumOverflows(), 2);
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 15);
+  ASSERT_EQ(readAll(&receiver), "");
+
+  // The buffer can be filled exactly
+  push(&receiver, "G1 X1 Y1 Z1 E1\n");
+  ASSERT_EQ(receiver.getNumOverflows(), 2);
+  ASSERT_EQ(receiver.getNumSpacesLeft(), 0);
+  ASSERT_EQ(readAll(&receiver), "G1 X1 Y1 Z1 E1\n");
+}
+}  // namespace Clef::Util
@@ -1,6 +1,8 @@
 // Copyright 2021 by Daniel Winkelman. All rights reserved.
 
 #include <gtest/gtest.h>
+#include <if/Memory.h>
+#include <util/FixedPoint.h>
 #include <util/Matrix.h>
 
 namespace Clef::Util {
@@ -180,4 +182,126 @@ TEST(MatrixTest, Inverse4x4) {
     }
   }
 }
+
+TEST(MatrixTest, StaticMatrix) {
+  float data1[] = {1, 2, 3, 4, 5, 6};
+  float data2[4];
+  StaticRamMatrix<2, 3> m1(data1);
+  StaticRamMatrix<2, 2> m2(data2);
+  ASSERT_EQ(m1.transpose().get(2, 1), 6);
+  Matrix::dot(m1, m1.transpose(), m2);
+  ASSERT_EQ(m2.get(0, 0), 14);
+  ASSERT_EQ(m2.get(0, 1), 32);
+  ASSERT_EQ(m2.get(1, 0), 32);
+  ASSERT_EQ(m2.get(1, 1), 77);
+
+  // Diagonal matrices only touch the diagonal
+  const float diagonal[] = {2, 3};
+  Clef::If::RomDiagonalMatrix<2> rom(diagonal);
+  const StaticDiagonalMatrix<Clef::If::RomDiagonalMatrix<2>, 2> d(rom);
+  float data3[6];
+  StaticRamMatrix<2, 3> m3(data3);
+  Matrix::dot(d, m1, m3);
+  ASSERT_EQ(m3.get(0, 2), 6);
+  ASSERT_EQ(m3.get(1, 0), 12);
+  Matrix::add(m2, d, m2);
+  ASSERT_EQ(m2.get(0, 0), 16);
+  ASSERT_EQ(m2.get(0, 1), 32);
+  Matrix::sub(StaticIdentityMatrix<2>(), d, m2);
+  ASSERT_EQ(m2.get(1, 1), -2);
+  ASSERT_EQ(m2.get(1, 0), 0);
+}
+
+TEST(MatrixTest, SymmetricMatrix) {
+  // Only the upper triangle is stored, row by row
+  float data[6];
+  SymmetricRamMatrix<3> m(data);
+  ASSERT_EQ(SymmetricRamMatrix<3>::size, 6);
+  m.fill(0);
+  m.set(0, 2, 3);
+  m.set(2, 1, 5);
+  m.set(1, 1, 4);
+  ASSERT_EQ(m.get(2, 0), 3);
+  ASSERT_EQ(m.get(1, 2), 5);
+  ASSERT_EQ(data[2], 3);
+  ASSERT_EQ(data[3], 4);
+  ASSERT_EQ(data[4], 5);
+
+  // The static view shares the storage and only calculates the upper
+  // triangle of a symmetric product
+  StaticSymmetricMatrix<3> s(data);
+  ASSERT_EQ(s.get(0, 2), 3);
+  float data1[] = {1, 2, 3, 4, 5, 6};
+  StaticRamMatrix<3, 2> m1(data1);
+  Matrix::dotSymmetric(m1, m1.transpose(), s);
+  ASSERT_EQ(s.get(0, 0), 5);
+  ASSERT_EQ(s.get(2, 0), 17);
+  ASSERT_EQ(s.get(1, 2), 39);
+  ASSERT_EQ(s.get(2, 2), 61);
+  ASSERT_EQ(m.get(2, 1), 39);
+}
+
+TEST(MatrixTest, FixedPointMatrix) {
+  // Every kind of matrix works with fixed-point elements
+  using Element = Fixed<16>;
+  Element data1[] = {1, 2, 3, 4, 5, Element(0.5)};
+  Element data2[4], data3[4];
+  StaticRamMatrix<2, 3, Element> m1(data1);
+  StaticRamMatrix<2, 2, Element> m2(data2);
+  Matrix::dot(m1, m1.transpose(), m2);
+  ASSERT_EQ(m2.get(0, 0), 14);
+  ASSERT_EQ(m2.get(0, 1), Element(15.5));
+  ASSERT_EQ(m2.get(1, 1), Element(41.25));
+
+  const Element diagonal[] = {2, Element(-0.25)};
+  Clef::If::RomDiagonalMatrix<2, Element> rom(diagonal);
+  const StaticDiagonalMatrix<Clef::If::RomDiagonalMatrix<2, Element>, 2> d(
+      rom);
+  Matrix::add(m2, d, m2);
+  ASSERT_EQ(m2.get(0, 0), 16);
+  ASSERT_EQ(m2.get(1, 1), 41);
+
+  RamMatrix<2, 2, Element> r1(data2), r2(data3);
+  Matrix::dot(rom, r1, r2);
+  ASSERT_EQ(r2.get(0, 1), 31);
+  ASSERT_EQ(r2.get(1, 0), Element(-3.875));
+
+  Element data4[3];
+  StaticSymmetricMatrix<2, Element> s(data4);
+  Matrix::dotSymmetric(m1, m1.transpose(), s);
+  ASSERT_EQ(s.get(1, 0), Element(15.5));
+}
+
+TEST(MatrixTest, StaticDispatch) {
+  // Covariance prediction of a 9-state filter, F P F^T + Q, with virtual and
+  // with static dispatch; both must give the same result
+  const uint16_t N = 9;
+  float memF[N * N], memP[N * N], memQ[N];
+  for (uint16_t i = 0; i < N * N; ++i) {
+    memF[i] = (i % 7) * 0.25f - 0.5f;
+    memP[i] = (i % 5) * 0.5f + 1;
+  }
+  for (uint16_t i = 0; i < N; ++i) {
+    memQ[i] = i + 1;
+  }
+  Clef::If::RomDiagonalMatrix<N> Q(memQ);
+  float scratch1[N * N], scratch2[N * N], output1[N * N], output2[N * N];
+
+  RamMatrix<N, N> F(memF), P(memP), FP(scratch1), FPFT(scratch2),
+      virtualOutput(output1);
+  Matrix::dot(F, P, FP);
+  Matrix::dot(FP, F.transpose(), FPFT);
+  Matrix::add(FPFT, Q, virtualOutput);
+
+  StaticRamMatrix<N, N> staticF(memF), staticP(memP), staticFP(scratch1),
+      staticFPFT(scratch2), staticOutput(output2);
+  const StaticDiagonalMatrix<Clef::If::RomDiagonalMatrix<N>, N> staticQ(Q);
+  Matrix::dot(staticF, staticP, staticFP);
+  Matrix::dot(staticFP, staticF.transpose(), staticFPFT);
+  Matrix::add(staticFPFT, staticQ, staticOutput);
+
+  for (uint16_t i = 0; i < N * N; ++i) {
+    ASSERT_EQ(output1[i], output2[i]);
+  }
+}
 }  // namespace Clef::Util
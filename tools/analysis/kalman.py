@@ -56,6 +56,12 @@ addModelArgs(generate_parser)
 generate_parser.add_argument(
     "--language", choices=["python3", "cpp"], required=True)
 generate_parser.add_argument("--output-dir", type=str, default=None)
+generate_parser.add_argument("--fixed-point", type=int, default=None)
+generate_parser.add_argument(
+    "--steady-state", type=float, nargs=3, default=None,
+    metavar=("TOLERANCE", "SAMPLES", "GATE"),
+    help="Freeze the gain once it changes by less than TOLERANCE (relative) "
+    "for SAMPLES samples, until an innovation exceeds GATE sigmas")
 
 logFileName = "log-{}".format(datetime.datetime.now().isoformat())
 
@@ -247,7 +253,7 @@ class Constant(Expression):
 
 
 class ProcessVariable(Expression):
-    def __init__(self, symbol, initialValue, initialCovariance, noise, units, updateWeight=1):
+    def __init__(self, symbol, initialValue, initialCovariance, noise, units, updateWeight=1, fixedPointShift=0):
         self.symbol = symbol
         self.initialValue = initialValue
         self.initialCovariance = initialCovariance
@@ -257,6 +263,9 @@ class ProcessVariable(Expression):
             print(
                 "Warning: process variable {} has an update weight greater than 1, setting to 1".format(symbol))
         self.updateWeight = updateWeight
+        # A fixed-point filter stores the variable multiplied by
+        # 2^fixedPointShift, to make the most of the bits it has
+        self.fixedPointShift = fixedPointShift
 
     def isZero(self):
         return False
@@ -360,9 +369,25 @@ class KalmanFilterGenerator:
             if str(zvar) in inputJson["vars"]:
                 setVarParams(zvar, inputJson["vars"][str(zvar)])
 
-    def generateCppFunctions(self, outputPath):
+    def generateCppFunctions(self, outputPath, fixedPoint=None,
+                             steadyState=None):
+        """
+        Write a filter using floats to <outputPath>.h/.cc or, if fixedPoint is
+        the number of fractional bits, one using Clef::Util::Fixed to
+        <outputPath>Fixed.h/.cc. The fixed-point filter works on every
+        variable v multiplied by 2^v.fixedPointShift, so its state and
+        covariance are scaled, but its inputs are not.
+
+        If steadyState is (tolerance, numSamples, innovationGate), the filter
+        is built with SteadyState and freezes its gain once it converges, as
+        in ExtendedKalmanFilter::setSteadyState().
+        """
         filterName = os.path.split(outputPath)[-1].capitalize()
+        if fixedPoint is not None:
+            filterName += "Fixed"
+            outputPath += "Fixed"
         className = "{}Filter".format(filterName)
+        scalar = "float" if fixedPoint is None else "Scalar"
 
         def indexOfVar(var):
             if var in self.xvars:
@@ -374,6 +399,107 @@ class KalmanFilterGenerator:
             elif var == self.deltat:
                 return "deltat"
 
+        def shiftOf(var):
+            return 0 if fixedPoint is None else var.fixedPointShift
+
+        def formatConstant(value):
+            if fixedPoint is not None and value != 0 and \
+                    round(value * 2 ** fixedPoint) == 0:
+                raise Exception(
+                    "{!r} rounds to 0 with {} fractional bits; adjust the "
+                    "fixedPointShift of the variable it belongs to".format(
+                        float(value), fixedPoint))
+            return "Scalar({!r})".format(float(value))
+
+        def formatShift(source, shift, isCompound):
+            if shift == 0:
+                return source
+            return "{}.shift({})".format(
+                "({})".format(source) if isCompound else source, shift)
+
+        def generateScaled(expr, target=None):
+            """
+            Get code for an expression in the variables of the fixed-point
+            filter and the power of 2 that its value is scaled by (which is
+            target if that is given), and whether the code is compound. Each
+            term of a sum is shifted to the scale of the sum, which is the
+            smallest scale of the terms unless a target is given.
+
+            A product that has to be scaled down has its factors scaled down
+            before they are multiplied, since the product at the larger scale
+            can be out of range even when the result is not.
+            """
+            if type(expr) is Constant:
+                scale = 0 if target is None else target
+                return formatConstant(expr.value * 2 ** scale), scale, False
+            if type(expr) is ProcessVariable:
+                source, scale = indexOfVar(expr), shiftOf(expr)
+                isCompound = False
+            elif type(expr) is Product and Constant in (
+                    type(expr.left), type(expr.right)):
+                constant, other = (expr.left, expr.right) \
+                    if type(expr.left) is Constant else (expr.right, expr.left)
+                source, scale, isCompound = generateScaled(other, target)
+                if constant.value == -1:
+                    source = "-{}".format(
+                        "({})".format(source) if isCompound else source)
+                else:
+                    source = "{} * {}".format(
+                        formatConstant(constant.value),
+                        "({})".format(source) if isCompound else source)
+                isCompound = True
+            elif type(expr) is Product:
+                left, leftScale, leftIsCompound = generateScaled(expr.left)
+                right, rightScale, rightIsCompound = generateScaled(
+                    expr.right)
+                excess = 0 if target is None else \
+                    leftScale + rightScale - target
+                if excess > 0:
+                    leftShift = (excess + 1) // 2
+                    left, leftScale, leftIsCompound = generateScaled(
+                        expr.left, leftScale - leftShift)
+                    right, rightScale, rightIsCompound = generateScaled(
+                        expr.right, rightScale - (excess - leftShift))
+                source = "{} * {}".format(
+                    "({})".format(left) if type(expr.left) is Sum else left,
+                    "({})".format(right) if type(expr.right) is Sum
+                    else right)
+                scale, isCompound = leftScale + rightScale, True
+            elif type(expr) is Sum:
+                terms = []
+                for term in recurseSum(expr):
+                    negate = type(term) is Product and \
+                        type(term.left) is Constant and term.left.value == -1
+                    termExpr = term.right if negate else term
+                    terms.append((negate, termExpr, generateScaled(termExpr)))
+                scale = min(termScale for _, _, (_, termScale, _) in terms) \
+                    if target is None else target
+                source = ""
+                for negate, termExpr, (term, termScale, termIsCompound) \
+                        in terms:
+                    if termScale != scale:
+                        term, _, termIsCompound = generateScaled(
+                            termExpr, scale)
+                    if source:
+                        source += " {} {}".format("-" if negate else "+", term)
+                    else:
+                        source = "-({})".format(term) if negate and \
+                            termIsCompound else ("-" if negate else "") + term
+                isCompound = True
+            else:
+                raise Exception(
+                    "Cannot generate fixed-point code for {}".format(expr))
+            if target is not None:
+                source = formatShift(source, target - scale, isCompound)
+                isCompound = isCompound and target == scale
+                scale = target
+            return source, scale, isCompound
+
+        def formatExpression(expr, target):
+            if fixedPoint is None:
+                return expr.formatVars(indexOfVar)
+            return generateScaled(expr, target)[0]
+
         def generateTransitionFunc(vars, f, suffix):
             return "\n\n".join((
                 "\n".join([
@@ -382,7 +508,7 @@ class KalmanFilterGenerator:
                         suffix,
                         expr.formatVars(lambda v: "{}(k)".format(str(v)))),
                     "  output.set({}, 0, {});".format(
-                        i, expr.formatVars(indexOfVar)),
+                        i, formatExpression(expr, shiftOf(var))),
                 ]) for i, (var, expr) in enumerate(zip(vars, f))
             ))
 
@@ -396,96 +522,369 @@ class KalmanFilterGenerator:
                             suffix,
                             expr.formatVars(lambda v: "{}(k)".format(str(v)))),
                         "  output.set({}, {}, {});".format(
-                            i1, i2, expr.formatVars(indexOfVar)),
+                            i1, i2, formatExpression(
+                                expr, shiftOf(var1) - shiftOf(var2))),
                     ]) for i2, (var2, expr) in enumerate(zip(vars2, row)) if not expr.isZero()
                 ]) for i1, (var1, row) in enumerate(zip(vars1, dfdx))
             ))
 
-        headerSource = "\n".join([
-            "#include <fw/KalmanFilter.h>\n",
+        def generateSparseSum(row, formatTerm, unitShift=lambda j: 0):
+            """
+            Sum formatTerm(j, entry) over the structural nonzeros of a row of
+            a Jacobian, in the same order as a dense product so that the
+            result is the same. Entries that are +/-1 are not multiplied; in
+            a fixed-point filter they are +/-2^unitShift(j), which is a shift.
+            """
+            source = ""
+            for j, expr in enumerate(row):
+                if expr.isZero():
+                    continue
+                if isinstance(expr, Constant) and expr.value in (1, -1):
+                    term = formatShift(
+                        formatTerm(j, None), unitShift(j), False)
+                    sign = "+" if expr.value == 1 else "-"
+                else:
+                    term = formatTerm(j, expr)
+                    sign = "+"
+                if source:
+                    source += " {} {}".format(sign, term)
+                else:
+                    source = term if sign == "+" else "-" + term
+            return source if source else "0"
+
+        def generateSparseProducts(rows, loopVar, loopSize, output, formatSet):
+            """
+            Set one entry of the output for each row of a Jacobian inside a
+            loop over the dense dimension; formatSet(i, row) gives the
+            arguments of the set() call.
+            """
+            return "\n".join([
+                "  for (uint16_t {0} = 0; {0} < {1}; ++{0}) {{".format(
+                    loopVar, loopSize),
+                "\n".join((
+                    "    {}.set({});".format(output, ", ".join(
+                        formatSet(i, row)))
+                    for i, row in enumerate(rows))),
+                "  }",
+            ])
+
+        numX = len(self.xvars)
+
+        def formatValue(value, shift):
+            if fixedPoint is None:
+                return value
+            return formatConstant(value * 2 ** shift)
+
+        def formatNoise(var):
+            """
+            The scaled noise of a variable. A fixed-point filter raises noise
+            below its resolution to the resolution, since noise which rounds
+            to 0 would keep the covariance of the variable from growing.
+            """
+            if fixedPoint is None:
+                return var.noise
+            value = var.noise * 2 ** (2 * shiftOf(var))
+            if 0 < value < 2 ** -fixedPoint:
+                print("Warning: noise of {} is below the resolution of the "
+                      "fixed-point filter, raising it from {!r} to {!r}".format(
+                          var, float(value), 2.0 ** -fixedPoint))
+                value = 2 ** -fixedPoint
+            return formatConstant(value)
+
+        def entryOf(matName, i, j):
+            return "{}.get({}, {})".format(matName, i, j)
+
+        def jacobianShift(vars, i, j):
+            return shiftOf(vars[i]) - shiftOf(self.xvars[j])
+
+        # FkP(i, k) = sum_j Fk(i, j) * P(j, k)
+        predictFkP = generateSparseProducts(
+            self.dfdx, "k", numX, "FkP", lambda i, row: [
+                str(i), "k", generateSparseSum(row, lambda j, expr: (
+                    "P.get({}, k)".format(j) if expr is None else
+                    "{} * P.get({}, k)".format(entryOf("Fk", i, j), j)),
+                    lambda j: jacobianShift(self.xvars, i, j))])
+
+        # output(i, l) = sum_j FkP(i, j) * Fk(l, j), which is symmetric, so
+        # only i <= l is calculated
+        predictOutput = "\n".join((
+            "\n".join([
+                "  for (uint16_t i = 0; i <= {}; ++i) {{".format(l),
+                "    output.set(i, {}, {});".format(l, generateSparseSum(
+                    row, lambda j, expr: (
+                        "FkP.get(i, {})".format(j) if expr is None else
+                        "FkP.get(i, {}) * {}".format(
+                            j, entryOf("Fk", l, j))),
+                    lambda j: jacobianShift(self.xvars, l, j))),
+                "  }",
+            ]) for l, row in enumerate(self.dfdx)))
+
+        # PhT(i) = sum_j P(i, j) * Hk(z, j) and the return value
+        # sum_j Hk(z, j) * PhT(j) for each observation z
+        observeCases = "\n".join((
+            "\n".join([
+                "    case {}:".format(z),
+                "      for (uint16_t i = 0; i < {}; ++i) {{".format(numX),
+                "        PhT.set(i, 0, {});".format(generateSparseSum(
+                    row, lambda j, expr: (
+                        "P.get(i, {})".format(j) if expr is None else
+                        "P.get(i, {}) * {}".format(
+                            j, entryOf("Hk", z, j))),
+                    lambda j: jacobianShift(self.zvars, z, j))),
+                "      }",
+                "      return {};".format(generateSparseSum(
+                    row, lambda j, expr: (
+                        "PhT.get({}, 0)".format(j) if expr is None else
+                        "{} * PhT.get({}, 0)".format(
+                            entryOf("Hk", z, j), j)),
+                    lambda j: jacobianShift(self.zvars, z, j))),
+            ]) for z, row in enumerate(self.dhdx)))
+
+        def metricVars(metrics):
+            # In the order that kalmanAnalysis() calculates the costs
+            return [var for var in self.xvars + self.zvars if var in metrics]
+
+        def observationFlag(var):
+            return "OBSERVE_{}".format(str(var).upper())
+
+        headerSource = "\n".join(line for line in [
+            "#pragma once\n",
+            "#include <fw/KalmanFilter.h>" if fixedPoint is not None else
+            "#include <fw/KalmanFilter.h>\n#include <fw/KalmanTuning.h>",
+            "",
             "namespace Clef::Fw::Kalman {",
-            "using Base{} = Clef::Fw::ExtendedKalmanFilter<{}, {}, {}>;".format(
-                className, len(self.xvars), len(self.uvars), len(self.zvars)),
+            "using Base{} = Clef::Fw::ExtendedKalmanFilter<{}, {}, {}{}{}>;"
+            .format(
+                className, len(self.xvars), len(self.uvars), len(self.zvars),
+                "" if fixedPoint is None and steadyState is None else
+                ", float" if fixedPoint is None else
+                ", Clef::Util::Fixed<{}>".format(fixedPoint),
+                "" if steadyState is None else ", true"),
             "class {0} : public Base{0} {{".format(className),
             " public:",
+            "\n".join(("  static constexpr uint8_t {} = 1 << {};".format(
+                observationFlag(var), i) for i, var in enumerate(self.zvars))),
+            "",
             "  {}();".format(className),
-            "  void evolve(",
-            "\n".join(("      /* {} Variables */ {}".format(
-                label,
-                " ".join(("const float {},".format(str(var)) for var in vars)))
-                for vars, label in [
-                    (self.uvars, "Control"),
-                    (self.zvars, "Observation")])),
-            "      /* Time Step */ const float deltat);",
-            """  void init() override;
-
+            "\n".join(("\n".join([
+                "  void {}(".format(method),
+                "\n".join(("      /* {} Variables */ {}".format(
+                    label,
+                    " ".join(("const {} {},".format(scalar, str(var))
+                              for var in vars)))
+                    for vars, label in [
+                        (self.uvars, "Control"),
+                        (self.zvars, "Observation")])),
+                "      /* Time Step */ const {} deltat,".format(scalar),
+                "      /* Observations Present */ "
+                "const uint8_t observed = ALL_OBSERVATIONS);",
+            ]) for method in ["evolve", "begin"])),
+            None if fixedPoint is None else "\n".join([
+                "",
+                "  /**",
+                "   * State variable i without the scaling of the fixed-point"
+                " filter.",
+                "   */",
+                "  Scalar getUnscaledState(const uint16_t i) const;",
+                "",
+            ]),
+            "  void init() override;",
+            None if fixedPoint is not None else "\n".join([
+                "",
+                "#ifndef TARGET_AVR",
+                "  /**",
+                "   * The variables and metrics of the model, for tuning the"
+                " filter on the",
+                "   * host.",
+                "   */",
+                "  static const Clef::Fw::KalmanTuning::Spec TUNING_SPEC;",
+                "#endif",
+                "",
+                " protected:",
+                "  /**",
+                "   * Use other noise covariances and update weights than the"
+                " generated ones.",
+                "   */",
+                "  {}(const QMatrix &Q, const RMatrix &R, const WxMatrix &Wx);"
+                .format(className),
+            ]),
+            """
  private:
   void calculateStateTrans(
       const typename Base{0}::XVector &xk,
-      const typename Base{0}::UVector &uk, const float deltat,
+      const typename Base{0}::UVector &uk, const {1} deltat,
       typename Base{0}::XVector &output) const override;
   void calculateStateTransGradient(
       const typename Base{0}::XVector &xk,
-      const typename Base{0}::UVector &uk, const float deltat,
+      const typename Base{0}::UVector &uk, const {1} deltat,
       typename Base{0}::FMatrix &output) const override;
   void calculateObservationTrans(
       const typename Base{0}::XVector &xk,
       typename Base{0}::ZVector &output) const override;
   void calculateObserationTransGradient(
       const typename Base{0}::XVector &xk,
-      typename Base{0}::HMatrix &output) const override;""".format(className),
+      typename Base{0}::HMatrix &output) const override;
+  void predictCovariance(
+      const typename Base{0}::StaticXXMatrix &Fk,
+      const typename Base{0}::StaticPMatrix &P,
+      typename Base{0}::StaticXXMatrix &FkP,
+      typename Base{0}::StaticPMatrix &output) const override;
+  {1} calculateObservationCovariance(
+      const typename Base{0}::StaticZXMatrix &Hk,
+      const typename Base{0}::StaticPMatrix &P, const uint16_t z,
+      typename Base{0}::StaticXVector &PhT) const override;""".format(
+                className, scalar),
             "};",
             "}  // namespace Clef::Fw::Kalman",
-        ])
+        ] if line is not None)
 
-        cppSource = "\n".join([
+        cppSource = "\n".join(line for line in [
             "#include \"{}.h\"\n".format(filterName),
             "namespace Clef::Fw::Kalman {",
             "namespace {",
-            "ARRAY(float, memQ, {{{}}});".format(
-                ", ".join(("/* {} */ {}".format(str(var), var.noise) for var in self.xvars))),
-            "ARRAY(float, memR, {{{}}});".format(
-                ", ".join(("/* {} */ {}".format(str(var), var.noise) for var in self.zvars))),
-            "ARRAY(float, memWx, {{{}}});".format(", ".join(
-                ("/* {} */ {}".format(str(var), var.updateWeight) for var in self.xvars))),
+            None if fixedPoint is None else
+            "using Scalar = Base{}::Scalar;".format(className),
+            "ARRAY({}, memQ, {{{}}});".format(scalar, ", ".join((
+                "/* {} */ {}".format(
+                    str(var), formatNoise(var))
+                for var in self.xvars))),
+            "ARRAY({}, memR, {{{}}});".format(scalar, ", ".join((
+                "/* {} */ {}".format(
+                    str(var), formatNoise(var))
+                for var in self.zvars))),
+            "ARRAY({}, memWx, {{{}}});".format(scalar, ", ".join((
+                "/* {} */ {}".format(
+                    str(var), formatValue(var.updateWeight, 0))
+                for var in self.xvars))),
             "\n".join(("typename Base{0}::{1}Matrix {1}(mem{1});".format(
                 className, matName) for matName in ["Q", "R", "Wx"])),
             "} // namespace",
             "",
-            "{0}::{0}() : Base{0}(Q, R, Wx) {{ init(); }}".format(className),
+            "{0}::{0}() : Base{0}(Q, R, Wx) {{ init(); }}".format(className)
+            if steadyState is None else "\n".join([
+                "{0}::{0}() : Base{0}(Q, R, Wx) {{".format(className),
+                "  setSteadyState({}, {}, {});".format(
+                    formatValue(steadyState[0], 0), int(steadyState[1]),
+                    formatValue(steadyState[2], 0)),
+                "  init();",
+                "}",
+            ]),
+            None if fixedPoint is not None else "\n".join([
+                "",
+                "{0}::{0}(const QMatrix &Q, const RMatrix &R, "
+                "const WxMatrix &Wx)".format(className),
+                "    : Base{}(Q, R, Wx) {{".format(className),
+                "  init();",
+                "}",
+            ]),
             "",
-            "void {}::evolve(".format(className),
-            "\n".join(("    /* {} Variables */ {}".format(
-                label,
-                " ".join(("const float {},".format(str(var)) for var in vars)))
-                for vars, label in [
-                    (self.uvars, "Control"),
-                    (self.zvars, "Observation")])),
-            "    /* Time Step */ const float deltat) {",
+            None if fixedPoint is not None else "\n".join([
+                "#ifndef TARGET_AVR",
+                "namespace {",
+                "\n".join(("\n".join([
+                    "const Clef::Fw::KalmanTuning::Variable {}[] = {{".format(
+                        group),
+                    "\n".join(("    {{\"{}\", {}, {}, {}, {}}},".format(
+                        str(var), formatValue(var.initialValue, 0),
+                        formatValue(var.initialCovariance, 0),
+                        formatValue(var.noise, 0),
+                        formatValue(var.updateWeight, 0))
+                        for var in vars)),
+                    "};",
+                ]) for group, vars in [("xvars", self.xvars),
+                                       ("zvars", self.zvars),
+                                       ("uvars", self.uvars)])),
+                "const Clef::Fw::KalmanTuning::ErrorMetric errorMetrics[] = {",
+                "\n".join(("    {{\"{}\", \"{}\", {}}},".format(
+                    str(self.mevars[var]["referenceVar"]), str(var),
+                    formatValue(self.mevars[var]["weight"], 0))
+                    for var in metricVars(self.mevars))),
+                "};",
+                "const Clef::Fw::KalmanTuning::SmoothnessMetric "
+                "smoothnessMetrics[] = {",
+                "\n".join(("    {{\"{}\", {}, {}}},".format(
+                    str(var), formatValue(self.msvars[var]["weight"], 0),
+                    formatValue(self.msvars[var]["filterCoef"], 0))
+                    for var in metricVars(self.msvars))),
+                "};",
+                "const Clef::Fw::KalmanTuning::NegativityMetric "
+                "negativityMetrics[] = {",
+                "\n".join(("    {{\"{}\", {}}},".format(
+                    str(var), formatValue(self.mnvars[var]["weight"], 0))
+                    for var in metricVars(self.mnvars))),
+                "};",
+                "}  // namespace",
+                "",
+                "const Clef::Fw::KalmanTuning::Spec {}::TUNING_SPEC = {{"
+                .format(className),
+                "    xvars, {}, zvars, {}, uvars, {},".format(
+                    len(self.xvars), len(self.zvars), len(self.uvars)),
+                "    errorMetrics, {}, smoothnessMetrics, {},".format(
+                    len(metricVars(self.mevars)),
+                    len(metricVars(self.msvars))),
+                "    negativityMetrics, {}}};".format(
+                    len(metricVars(self.mnvars))),
+                "#endif",
+                "",
+            ]),
             "\n".join(("\n".join([
-                "  float {}Mem[{}];".format(label, len(vars)),
-                "  typename Base{0}::{1}Vector {2}({2}Mem);".format(
-                    className, label.upper(), label),
-                "\n".join(("  {}.set({}, 0, {});".format(label, i, str(var))
-                          for i, var in enumerate(vars))),
-            ]) for label, vars in [("u", self.uvars), ("z", self.zvars)])),
-            "  Base{}::evolve(u, z, deltat);".format(className),
-            "}",
-            "",
+                "void {}::{}(".format(className, method),
+                "\n".join(("    /* {} Variables */ {}".format(
+                    label,
+                    " ".join(("const {} {},".format(scalar, str(var))
+                              for var in vars)))
+                    for vars, label in [
+                        (self.uvars, "Control"),
+                        (self.zvars, "Observation")])),
+                "    /* Time Step */ const {} deltat,".format(scalar),
+                "    /* Observations Present */ const uint8_t observed) {",
+                "\n".join(("\n".join([
+                    "  {} {}Mem[{}];".format(scalar, label, len(vars)),
+                    "  typename Base{0}::{1}Vector {2}({2}Mem);".format(
+                        className, label.upper(), label),
+                    "\n".join(("  {}.set({}, 0, {});".format(
+                        label, i, formatShift(str(var), shiftOf(var), False))
+                        for i, var in enumerate(vars))),
+                ]) for label, vars in [("u", self.uvars),
+                                       ("z", self.zvars)])),
+                "  Base{}::{}(u, z, {}, observed);".format(
+                    className, method,
+                    formatShift("deltat", shiftOf(self.deltat), False)),
+                "}",
+                "",
+            ]) for method in ["evolve", "begin"])),
             "void {}::init() {{".format(className),
+            None if steadyState is None else "  resetGain();",
             "  P_.fill(0);",
             "\n".join(("  x_.set({}, 0, {});  // {}".format(
-                i, var.initialValue, str(var))
+                i, formatValue(var.initialValue, shiftOf(var)), str(var))
                 for i, var in enumerate(self.xvars))),
             "\n".join(("  P_.set({0}, {0}, {1});  // {2}".format(
-                i, var.initialCovariance, str(var))
+                i, formatValue(var.initialCovariance, 2 * shiftOf(var)),
+                str(var))
                 for i, var in enumerate(self.xvars))),
             "}",
             "",
+            None if fixedPoint is None else "\n".join([
+                "{0}::Scalar {0}::getUnscaledState(const uint16_t i) const {{"
+                .format(className),
+                "  switch (i) {",
+                "\n".join(("\n".join([
+                    "    case {}:".format(i),
+                    "      return x_.get({}, 0).shift({});".format(
+                        i, -shiftOf(var)),
+                ]) for i, var in enumerate(self.xvars)
+                    if shiftOf(var) != 0)),
+                "    default:",
+                "      return x_.get(i, 0);",
+                "  }",
+                "}",
+                "",
+            ]),
             "void {}::calculateStateTrans(".format(className),
             "    const typename Base{}::XVector &xk,".format(className),
             "    const typename Base{}::UVector &uk,".format(className),
-            "    const float deltat,",
+            "    const {} deltat,".format(scalar),
             "    typename Base{}::XVector &output) const {{".format(className),
             generateTransitionFunc(self.xvars, self.f, "(k+1)"),
             "}",
@@ -493,7 +892,7 @@ class KalmanFilterGenerator:
             "void {}::calculateStateTransGradient(".format(className),
             "    const typename Base{}::XVector &xk,".format(className),
             "    const typename Base{}::UVector &uk,".format(className),
-            "    const float deltat,",
+            "    const {} deltat,".format(scalar),
             "    typename Base{}::FMatrix &output) const {{".format(className),
             "  output.fill(0);",
             "",
@@ -515,8 +914,34 @@ class KalmanFilterGenerator:
             generateTransitionGradient(
                 self.zvars, self.xvars, self.dhdx, "(k)"),
             "}",
+            "",
+            "// Only the structural nonzeros of Fk and Hk are read",
+            "void {}::predictCovariance(".format(className),
+            "    const typename Base{}::StaticXXMatrix &Fk,".format(className),
+            "    const typename Base{}::StaticPMatrix &P,".format(className),
+            "    typename Base{}::StaticXXMatrix &FkP,".format(className),
+            "    typename Base{}::StaticPMatrix &output) const {{".format(
+                className),
+            predictFkP,
+            predictOutput,
+            "}",
+            "",
+            "{}{}::calculateObservationCovariance(".format(
+                "float " if fixedPoint is None else
+                "{}::Scalar ".format(className), className),
+            "    const typename Base{}::StaticZXMatrix &Hk,".format(className),
+            "    const typename Base{}::StaticPMatrix &P, const uint16_t z,".format(
+                className),
+            "    typename Base{}::StaticXVector &PhT) const {{".format(
+                className),
+            "  switch (z) {",
+            observeCases,
+            "    default:",
+            "      return 0;",
+            "  }",
+            "}",
             "} // namespace Clef::Fw::Kalman",
-        ])
+        ] if line is not None)
 
         print("Writing to {}...".format(outputPath))
 
@@ -845,6 +1270,16 @@ def calculateSmoothnessCosts(generator, outputSeries):
     return costs
 
 
+def calculateNegativityCosts(generator, outputSeries):
+    costs = {}
+    for var in generator.xvars + generator.zvars:
+        if var in generator.mnvars:
+            costFactor = generator.mnvars[var]["weight"] * \
+                outputSeries[var].negativity()
+            costs[var] = costFactor
+    return costs
+
+
 def calculateExtrapolation(xsSeries, dxsdtSeries, deltatSeries, deltatCatchup):
     output = np.zeros((xsSeries.numRows(), 2))
     output[:, 0] = xsSeries.array[:, 0]
@@ -1019,12 +1454,17 @@ def kalmanAnalysis(
         spec.generator, kalmanInputSeries, kalmanOutputSeries, plotSeries)
     smoothnessCosts = calculateSmoothnessCosts(
         spec.generator, kalmanOutputSeries)
-    totalCost = sum(errorCosts.values()) + sum(smoothnessCosts.values())
+    negativityCosts = calculateNegativityCosts(
+        spec.generator, kalmanOutputSeries)
+    totalCost = sum(errorCosts.values()) + sum(smoothnessCosts.values()) + \
+        sum(negativityCosts.values())
     if completeSummary:
         print("Total Cost: {}".format(totalCost))
         summaries = [("error", var.symbol, cost) for var, cost in errorCosts.items()] + \
             [("smoothness", var.symbol, cost)
-             for var, cost in smoothnessCosts.items()]
+             for var, cost in smoothnessCosts.items()] + \
+            [("negativity", var.symbol, cost)
+             for var, cost in negativityCosts.items()]
         summaries.sort(key=lambda row: row[2], reverse=True)
         for category, symbol, cost in summaries:
             print(" * {}: {:.3f}% ({:.3e})".format(
@@ -1038,6 +1478,7 @@ def kalmanAnalysis(
         "metrics": {
             "error": {str(k): v for k, v in errorCosts.items()},
             "smoothness": {str(k): v for k, v in smoothnessCosts.items()},
+            "negativity": {str(k): v for k, v in negativityCosts.items()},
         },
         "cost": totalCost,
     }
@@ -1228,6 +1669,12 @@ if __name__ == "__main__":
             outputDir = os.path.join(*path[:-1], path[-1].capitalize())
         else:
             outputDir = args.output_dir
-        spec.generator.generateCppFunctions(outputDir)
+        spec.generator.generateCppFunctions(
+            outputDir, steadyState=args.steady_state)
+        if args.fixed_point is not None:
+            # Also generate a filter with this many fractional bits
+            spec.generator.generateCppFunctions(
+                outputDir, fixedPoint=args.fixed_point,
+                steadyState=args.steady_state)
     else:
         print("Please choose a command")
@@ -2,27 +2,40 @@
 
 from kalman import *
 
+# Shifts for the fixed-point filter keep the time step and the small
+# parameters clear of the resolution of Q16.16, and the pressures (whose
+# covariances grow with the square of the extrusion rate) clear of its range;
+# at the shift that keeps the covariance of Ps in range, its process noise is
+# below the resolution and the generator raises it to the resolution
+
 # Time step
-deltat = ProcessVariable("deltat", 0, 0, 0, "sec")
+deltat = ProcessVariable("deltat", 0, 0, 0, "sec", fixedPointShift=10)
 
 # Position and pressure state
 xe = ProcessVariable("xe", 0, 0, 0, "usteps")
 xs = ProcessVariable("xs", 0, 10, 0.5, "usteps")
 xs_in = ProcessVariable("xs_in", 0, 0, 5, "usteps")
-dxsdt = ProcessVariable("dxsdt", 0, 30, 0.15, "usteps/sec")
-Ph = ProcessVariable("Ph", 0, 10, 0.9, "Pa", updateWeight=0.5)
-Ph0 = ProcessVariable("Ph0", 4000, 40, 0.2, "Pa", updateWeight=1)
-Ph_in = ProcessVariable("Ph_in", 0, 0, 2, "Pa")
-Ps = ProcessVariable("Ps", 0, 10, 0.1, "Pa", updateWeight=0.35)
+dxsdt = ProcessVariable("dxsdt", 0, 30, 0.15, "usteps/sec",
+                        fixedPointShift=-4)
+Ph = ProcessVariable("Ph", 0, 10, 0.9, "Pa", updateWeight=0.5,
+                     fixedPointShift=-4)
+Ph0 = ProcessVariable("Ph0", 4000, 40, 0.2, "Pa", updateWeight=1,
+                      fixedPointShift=-4)
+Ph_in = ProcessVariable("Ph_in", 0, 0, 2, "Pa", fixedPointShift=-4)
+Ps = ProcessVariable("Ps", 0, 10, 0.1, "Pa", updateWeight=0.35,
+                     fixedPointShift=-7)
 a1 = ProcessVariable("a1", 3, 1, 0.14, "Pa/(ustep/sec)", updateWeight=0.1)
-a0 = ProcessVariable("a0", 0, 100, 10, "Pa", updateWeight=0.1)
+a0 = ProcessVariable("a0", 0, 100, 10, "Pa", updateWeight=0.1,
+                     fixedPointShift=-2)
 
 # Level 1 Capacitance
-Chl = ProcessVariable("Chl", 12, 0.2, 0.03, "Pa/ustep", updateWeight=0.03)
+Chl = ProcessVariable("Chl", 12, 0.2, 0.03, "Pa/ustep", updateWeight=0.03,
+                      fixedPointShift=2)
 
 # Level 1 Shear Thinning
 #m = ProcessVariable("m", 0.6, 0.1, 0.006, "dimensionless", updateWeight=0.01)
-gamma = ProcessVariable("gamma", 0.5, 0.1, 0.001, "idk", updateWeight=0.002)
+gamma = ProcessVariable("gamma", 0.5, 0.1, 0.001, "idk", updateWeight=0.002,
+                        fixedPointShift=4)
 
 # Model Variables
 xvars = [xs, dxsdt, Ph, Ph0, Ps, a1, a0, Chl, gamma, ]
@@ -188,15 +188,14 @@ class Series:
         ts, interp1, interp2 = interp(self.array, reference.array)
         return Series(self.ind, newDep, np.column_stack((ts, interp2 - interp1)))
 
-    def smoothness(self, name, a=0.001):
+    def smoothness(self, a=0.001):
         # Calculate "smoothness" of a function by taking the
         # RMS error of the series from its lowpass average
         return self.error(self.lowpass(a)).rms()
 
     def negativity(self):
         # Calculate the amount of signal that is negative
-        data = self.array[:, 1]
-        data[data > 0] = 0
+        data = np.minimum(self.array[:, 1], 0)
         negative = Series(self.ind, self.dep,
                           np.column_stack((self.array[:, 0], data)))
         return negative.rms() / self.rms()
@@ -12,53 +12,324 @@ parser = argparse.ArgumentParser()
 parser.add_argument("file")
 parser.add_argument("--port", type=str, default="/dev/ttyACM0")
 parser.add_argument("--baud", type=int, default=57600)
+parser.add_argument("--window", type=int, default=8,
+                    help="Maximum number of lines in flight")
+parser.add_argument("--binary", action="store_true",
+                    help="Send G1 moves as binary frames")
+parser.add_argument("--compiled", action="store_true",
+                    help="Send a file written by clef-compiler as it is")
+parser.add_argument("--poll-interval", type=float, default=0.01,
+                    help="Seconds between requests for the free capacity")
 
 
-def printFromFile(fname, port, baud):
-    ser = serial.Serial(port, baud, timeout=1)
-    time.sleep(2)
+def frameLine(lineNumber, command):
+    """
+    Prefix a command with its line number and append the checksum, which is the
+    XOR of every character before the '*'.
+    """
+    line = "N{} {}".format(lineNumber, command)
+    checksum = 0
+    for c in line.encode("utf-8"):
+        checksum ^= c
+    return "{}*{}\n".format(line, checksum).encode("utf-8")
+
+
+# Must match src/fw/Config.h
+USTEPS_PER_MM = {"X": 160, "Y": 160, "Z": 400, "E": 564}
+AXIS_FLAGS = {"X": 1 << 0, "Y": 1 << 1, "Z": 1 << 2, "E": 1 << 3}
+F_FLAG = 1 << 4
+ABSOLUTE_FLAG = 1 << 7
+BINARY_SYNC = 0xa5
+FRAME_MOVE = 1
+FRAME_ASCII = 2
+FRAME_SEGMENT = 3
+FRAME_NAMES = {FRAME_MOVE: "MOVE", FRAME_ASCII: "ASCII",
+               FRAME_SEGMENT: "SEGMENT"}
+
+
+def encodeVarint(value):
+    output = bytearray()
+    while value >= 0x80:
+        output.append((value & 0x7f) | 0x80)
+        value >>= 7
+    output.append(value)
+    return bytes(output)
+
+
+def decodeVarint(data, position):
+    """
+    Get a varint and the position after it.
+    """
+    value = 0
+    shift = 0
+    while data[position] & 0x80:
+        value |= (data[position] & 0x7f) << shift
+        shift += 7
+        position += 1
+    return value | (data[position] << shift), position + 1
+
+
+def encodeZigzag(value):
+    return (value << 1) ^ (value >> 31) if value < 0 else value << 1
+
+
+def crc16(data):
+    """
+    CRC-16/CCITT with initial value 0xffff, as in src/util/Encoding.h.
+    """
+    crc = 0xffff
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xffff
+    return crc
+
+
+def frameBinary(lineNumber, frameType, arguments=b""):
+    """
+    Wrap the arguments of a binary command in a frame with the line number and
+    a CRC. The firmware only passes on complete lines to the parser, so the
+    frame is followed by a newline, which the parser ignores.
+    """
+    body = encodeVarint(lineNumber) + bytes([frameType]) + arguments
+    header = bytes([BINARY_SYNC, len(body)])
+    crc = crc16(header[1:] + body)
+    return header + body + bytes([crc >> 8, crc & 0xff]) + b"\n"
+
+
+def parseMove(command):
+    """
+    Get the coordinates of a G0/G1 command, or None if the command is anything
+    else.
+    """
+    words = command.split()
+    if words[0] not in ("G0", "G1"):
+        return None
+    values = {}
+    for word in words[1:]:
+        if word[0] not in "XYZEF":
+            return None
+        values[word[0]] = float(word[1:])
+    return values
+
+
+def parseTarget(command):
+    """
+    Get the coordinates that a G0-G3 command ends at, or None if the command
+    is anything else.
+    """
+    words = command.split()
+    if words[0] not in ("G0", "G1", "G2", "G3"):
+        return None
+    return {word[0]: float(word[1:]) for word in words[1:]
+            if word[0] in "XYZE"}
+
+
+def encodeMove(values, targets, absolute):
+    """
+    Get the arguments of a binary MOVE frame and update the targets (in usteps)
+    of the axes. Absolute frames carry every axis.
+    """
+    flags = ABSOLUTE_FLAG if absolute else 0
+    arguments = b""
+    for axis in "XYZE":
+        if axis in values or absolute:
+            target = (int(round(values[axis] * USTEPS_PER_MM[axis]))
+                      if axis in values else targets[axis])
+            flags |= AXIS_FLAGS[axis]
+            arguments += encodeVarint(encodeZigzag(
+                target if absolute else target - targets[axis]))
+            targets[axis] = target
+    if "F" in values:
+        flags |= F_FLAG
+        arguments += encodeVarint(int(round(values["F"])))
+    return bytes([flags]) + arguments
+
+
+def buildLines(commands, binary):
+    """
+    Number and frame every command. In binary mode, moves become binary frames
+    and the firmware is switched between modes as needed; the first frame after
+    each switch is absolute. Returns the framed lines and the commands they
+    carry.
+    """
+    lines = []
+    lineCommands = []
+    targets = {axis: 0 for axis in "XYZE"}
+    isBinary = False
+    for command in commands:
+        values = parseMove(command)
+        if binary and values is not None:
+            if not isBinary:
+                lines.append(frameLine(len(lines), "M880"))
+                lineCommands.append("M880")
+            lines.append(frameBinary(len(lines), FRAME_MOVE,
+                                     encodeMove(values, targets,
+                                                not isBinary)))
+            isBinary = True
+        else:
+            if isBinary:
+                lines.append(frameBinary(len(lines), FRAME_ASCII))
+                lineCommands.append("")
+                isBinary = False
+            target = parseTarget(command)
+            if target is not None:
+                encodeMove(target, targets, False)
+            lines.append(frameLine(len(lines), command))
+        lineCommands.append(command)
+    return lines, lineCommands
+
+
+def readCommands(fname):
+    """
+    Get the commands in a file with comments and blank lines removed.
+    """
+    commands = []
     with open(fname, "r") as inputFile:
-        isFirstLine = True
         for line in inputFile:
-            print("> {}:".format(line[:-1]).ljust(60, "."), end="")
-            success = False
-            timeout = 0.001
-            resend = True
-            while not success:
-                if resend:
-                    ser.write(line.encode('utf-8'))
-                resend = False
-                time.sleep(0.001)
-                message = ""
-                while message == "":
-                    message = ser.readline().decode("utf-8").rstrip()
-                if message == "ok":
-                    success = True
-                    isFirstLine = False
-                    print("ok")
-                elif message == "alloc_error":
-                    time.sleep(timeout)
-                    timeout *= 2
-                    timeout = min(timeout, 0.1)
-                    print(message)
-                    print("".ljust(60, " "), end="")
-                    resend = True
-                elif message[0] == ";":
-                    print(message)
-                    print("".ljust(60, " "), end="")
-                elif not isFirstLine:
-                    print(message)
-                    print("Encountered error, exiting!")
-                    return
-        print("Done printing!")
-        while True:
-            for line in ser:
-                if line[0] == ";":
-                    print(line)
-                else:
-                    print("Extra line: {}".format(line))
+            command = line.split(";")[0].strip()
+            if command:
+                commands.append(command)
+    return commands
+
+
+def readCompiled(fname):
+    """
+    Split a file written by clef-compiler into its records (numbered lines and
+    binary frames, each ending in a newline). Returns the records and a
+    description of each, which names the axes that a frame moves so that
+    commandCost() applies to it.
+    """
+    with open(fname, "rb") as inputFile:
+        data = inputFile.read()
+    lines = []
+    lineCommands = []
+    position = 0
+    while position < len(data):
+        if data[position] == BINARY_SYNC:
+            end = position + data[position + 1] + 5
+            _, offset = decodeVarint(data, position + 2)
+            command = FRAME_NAMES.get(data[offset], "UNKNOWN")
+            if data[offset] in (FRAME_MOVE, FRAME_SEGMENT):
+                flags = data[offset + 1]
+                command += "".join(" " + axis for axis in "XYZE"
+                                   if flags & AXIS_FLAGS[axis])
+                if flags & F_FLAG:
+                    command += " F"
+        else:
+            end = data.index(b"\n", position) + 1
+            command = data[position:end].decode("utf-8").split(" ", 1)[1]
+            command = command.split("*")[0]
+        lines.append(data[position:end])
+        lineCommands.append(command)
+        position = end
+    return lines, lineCommands
+
+
+def commandCost(command):
+    """
+    Upper bound on the number of action queue slots and XYE position queue
+    slots that the firmware needs for a command. An arc only needs room for its
+    first point, since the firmware queues the rest as room frees up.
+    """
+    words = command.split()
+    letters = set(word[0] for word in words)
+    hasXy = "X" in letters or "Y" in letters or (
+        len(words) > 0 and words[0] in ("G2", "G3"))
+    numActions = ("F" in letters) + ("Z" in letters) + (
+        hasXy or "Z" in letters or "E" in letters)
+    numXyePoints = 1 if hasXy and "E" in letters else 0
+    return (numActions, numXyePoints)
+
+
+def parseOk(message):
+    """
+    Get the line number (or None) and the free capacity (action queue slots,
+    XYE position queue slots, receive buffer bytes) from an acknowledgement.
+    """
+    fields = {word[0]: int(word[1:]) for word in message.split()[1:]}
+    return fields.get("N"), (fields["P"], fields["Q"], fields["B"])
+
+
+def printFromFile(fname, port, baud, window, pollInterval, binary, compiled):
+    """
+    Stream a file using a sliding window. Numbered lines are sent as long as
+    the free capacity reported with the last acknowledgement covers every line
+    in flight, and each "ok N<n>" acknowledges every line up to n. When
+    nothing is in flight and there is no room, the firmware is polled with an
+    unnumbered M110 (which changes nothing) until room frees up. After a resend
+    request the firmware drops the lines behind the failed one, so streaming
+    restarts from there.
+    """
+    ser = serial.Serial(port, baud, timeout=1)
+    time.sleep(2)
+    ser.reset_input_buffer()
+
+    if compiled:
+        # Compiled files are already numbered and framed
+        lines, commands = readCompiled(fname)
+    else:
+        # Line 0 resets the line number so that commands are numbered from 1
+        lines, commands = buildLines(["M110 N0"] + readCommands(fname),
+                                     binary)
+    costs = [commandCost(command) for command in commands]
+    numAcked = 0
+    numSent = 0
+    capacity = None
+    while numAcked < len(lines):
+        while numSent < len(lines) and numSent - numAcked < window:
+            if capacity is None:
+                # Send one line to learn the capacity
+                if numSent > numAcked:
+                    break
+            elif (sum(cost[0] for cost in costs[numAcked:numSent + 1]) >
+                  capacity[0] or
+                  sum(cost[1] for cost in costs[numAcked:numSent + 1]) >
+                  capacity[1] or
+                  sum(len(line) for line in lines[numAcked:numSent + 1]) >
+                  capacity[2]):
+                break
+            ser.write(lines[numSent])
+            numSent += 1
+        if numSent == numAcked:
+            time.sleep(pollInterval)
+            ser.write("M110\n".encode("utf-8"))
+
+        message = ser.readline().decode("utf-8").rstrip()
+        if message == "":
+            # Either the line or its acknowledgement was lost; send everything
+            # that has not been acknowledged again
+            numSent = numAcked
+        elif message.startswith("ok"):
+            lineNumber, capacity = parseOk(message)
+            if lineNumber is not None and lineNumber + 1 > numAcked:
+                for command in commands[numAcked:lineNumber + 1]:
+                    print("> {}".format(command))
+                numAcked = lineNumber + 1
+        elif message.startswith("resend"):
+            print(message)
+            numAcked = int(message.split()[1])
+            numSent = numAcked
+        elif message == "alloc_error":
+            # The estimate of the capacity was wrong; wait for a fresh report
+            numSent = numAcked
+            capacity = (0, 0, 0)
+        elif message[0] == ";":
+            print(message)
+        else:
+            print(message)
+            print("Encountered error at line {}, exiting!".format(numAcked))
+            return
+    print("Done printing!")
+    while True:
+        for line in ser:
+            if line[0] == ";":
+                print(line)
+            else:
+                print("Extra line: {}".format(line))
 
 
 if __name__ == "__main__":
     args = parser.parse_args(sys.argv[1:])
-    printFromFile(args.file, args.port, args.baud)
+    printFromFile(args.file, args.port, args.baud, args.window,
+                  args.poll_interval, args.binary, args.compiled)